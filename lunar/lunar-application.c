@@ -785,7 +785,7 @@ lunar_application_launch_finished (LunarJob  *job,
         {
           if (lunar_file_is_directory (file))
             {
-              folder = lunar_folder_get_for_file (file);
+              folder = lunar_folder_get_directories_for_file (file);
               if (folder != NULL)
                 {
                   /* If the folder is connected to a folder monitor, we dont need to trigger the reload manually */
@@ -30,6 +30,7 @@
 #include <lunar/lunar-deep-count-job.h>
 #include <lunar/lunar-job.h>
 #include <lunar/lunar-marshal.h>
+#include <lunar/lunar-size-cache.h>
 #include <lunar/lunar-util.h>
 #include <lunar/lunar-private.h>
 
@@ -46,11 +47,24 @@ enum
 #define DEEP_COUNT_FILE_INFO_NAMESPACE \
   G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
   G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
-  G_FILE_ATTRIBUTE_ID_FILESYSTEM
+  G_FILE_ATTRIBUTE_STANDARD_ALLOCATED_SIZE "," \
+  G_FILE_ATTRIBUTE_ID_FILESYSTEM "," \
+  G_FILE_ATTRIBUTE_UNIX_DEVICE "," \
+  G_FILE_ATTRIBUTE_UNIX_INODE "," \
+  G_FILE_ATTRIBUTE_UNIX_NLINK
+
+/* number of directories scanned concurrently per file system */
+#define DEEP_COUNT_MAX_WORKERS_LOCAL  8
+#define DEEP_COUNT_MAX_WORKERS_REMOTE 2
+
+typedef struct _LunarDeepCountDir   LunarDeepCountDir;
+typedef struct _LunarDeepCountInode LunarDeepCountInode;
 
 static void     lunar_deep_count_job_finalize   (GObject                 *object);
 static gboolean lunar_deep_count_job_execute    (EndoJob                  *job,
                                                   GError                 **error);
+static void     lunar_deep_count_job_worker     (gpointer                 data,
+                                                  gpointer                 user_data);
 
 
 
@@ -61,6 +75,7 @@ struct _LunarDeepCountJobClass
   /* signals */
   void (*status_update) (LunarJob *job,
                          guint64    total_size,
+                         guint64    allocated_size,
                          guint      file_count,
                          guint      directory_count,
                          guint      unreadable_directory_count);
@@ -76,13 +91,47 @@ struct _LunarDeepCountJob
   /* the time of the last "status-update" emission */
   gint64              last_time;
 
+  /* directories waiting for or being scanned by the workers */
+  GThreadPool        *pool;
+  guint               n_pending;
+
+  /* protects the status information, the inodes and n_pending */
+  GMutex              lock;
+  GCond               cond;
+
+  /* (device, inode) pairs of hard linked files counted so far */
+  GHashTable         *inodes;
+
+  /* totals of directories counted before */
+  LunarSizeCache    *size_cache;
+
+  /* the directory whose totals will be remembered and the
+   * LunarSizeCacheDescendants found below it, protected by lock */
+  GFile              *cache_root;
+  GArray             *descendants;
+
   /* status information */
   guint64             total_size;
+  guint64             allocated_size;
   guint               file_count;
   guint               directory_count;
   guint               unreadable_directory_count;
 };
 
+/* a directory queued for the worker pool */
+struct _LunarDeepCountDir
+{
+  LunarDeepCountJob *job;
+  GFile              *file;
+  const gchar        *fs_id;
+};
+
+struct _LunarDeepCountInode
+{
+  guint64 device;
+  guint64 inode;
+};
+
 
 
 static guint deep_count_signals[LAST_SIGNAL];
@@ -109,12 +158,14 @@ lunar_deep_count_job_class_init (LunarDeepCountJobClass *klass)
    * LunarDeepCountJob::status-update:
    * @job                        : a #LunarJob.
    * @total_size                 : the total size in bytes.
+   * @allocated_size             : the total size allocated on disk in bytes.
    * @file_count                 : the number of files.
    * @directory_count            : the number of directories.
    * @unreadable_directory_count : the number of unreadable directories.
    *
    * Emitted by the @job to inform listeners about the number of files,
-   * directories and bytes counted so far.
+   * directories and bytes counted so far. Hard linked files are only
+   * counted once in @total_size and @allocated_size.
    **/
   deep_count_signals[STATUS_UPDATE] =
     g_signal_new ("status-update",
@@ -122,8 +173,9 @@ lunar_deep_count_job_class_init (LunarDeepCountJobClass *klass)
                   G_SIGNAL_NO_HOOKS,
                   G_STRUCT_OFFSET (LunarDeepCountJobClass, status_update),
                   NULL, NULL,
-                  _lunar_marshal_VOID__UINT64_UINT_UINT_UINT,
-                  G_TYPE_NONE, 4,
+                  _lunar_marshal_VOID__UINT64_UINT64_UINT_UINT_UINT,
+                  G_TYPE_NONE, 5,
+                  G_TYPE_UINT64,
                   G_TYPE_UINT64,
                   G_TYPE_UINT,
                   G_TYPE_UINT,
@@ -132,10 +184,39 @@ lunar_deep_count_job_class_init (LunarDeepCountJobClass *klass)
 
 
 
+static guint
+lunar_deep_count_inode_hash (gconstpointer data)
+{
+  const LunarDeepCountInode *key = data;
+
+  return (guint) (key->inode ^ (key->inode >> 32) ^ (key->device * 31));
+}
+
+
+
+static gboolean
+lunar_deep_count_inode_equal (gconstpointer a,
+                               gconstpointer b)
+{
+  const LunarDeepCountInode *key_a = a;
+  const LunarDeepCountInode *key_b = b;
+
+  return key_a->inode == key_b->inode && key_a->device == key_b->device;
+}
+
+
+
 static void
 lunar_deep_count_job_init (LunarDeepCountJob *job)
 {
   job->query_flags = G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS;
+
+  g_mutex_init (&job->lock);
+  g_cond_init (&job->cond);
+  job->inodes = g_hash_table_new_full (lunar_deep_count_inode_hash,
+                                       lunar_deep_count_inode_equal,
+                                       g_free, NULL);
+  job->size_cache = lunar_size_cache_get_default ();
 }
 
 
@@ -147,6 +228,15 @@ lunar_deep_count_job_finalize (GObject *object)
 
   g_list_free_full (job->files, g_object_unref);
 
+  g_hash_table_destroy (job->inodes);
+  g_object_unref (job->size_cache);
+  if (job->cache_root != NULL)
+    g_object_unref (job->cache_root);
+  if (job->descendants != NULL)
+    g_array_unref (job->descendants);
+  g_mutex_clear (&job->lock);
+  g_cond_clear (&job->cond);
+
   (*G_OBJECT_CLASS (lunar_deep_count_job_parent_class)->finalize) (object);
 }
 
@@ -155,15 +245,270 @@ lunar_deep_count_job_finalize (GObject *object)
 static void
 lunar_deep_count_job_status_update (LunarDeepCountJob *job)
 {
+  guint64 total_size;
+  guint64 allocated_size;
+  guint   file_count;
+  guint   directory_count;
+  guint   unreadable_directory_count;
+
   _lunar_return_if_fail (LUNAR_IS_DEEP_COUNT_JOB (job));
 
+  /* take a snapshot, the workers keep counting while we emit */
+  g_mutex_lock (&job->lock);
+  total_size = job->total_size;
+  allocated_size = job->allocated_size;
+  file_count = job->file_count;
+  directory_count = job->directory_count;
+  unreadable_directory_count = job->unreadable_directory_count;
+  g_mutex_unlock (&job->lock);
+
   endo_job_emit (ENDO_JOB (job),
                 deep_count_signals[STATUS_UPDATE],
                 0,
-                job->total_size,
-                job->file_count,
-                job->directory_count,
-                job->unreadable_directory_count);
+                total_size,
+                allocated_size,
+                file_count,
+                directory_count,
+                unreadable_directory_count);
+}
+
+
+
+/**
+ * lunar_deep_count_job_is_new_inode:
+ * @job  : a #LunarDeepCountJob.
+ * @info : the #GFileInfo of a regular file.
+ *
+ * Must be called with the lock of @job held.
+ *
+ * Return value: %FALSE if @info is a hard link to a file
+ *               whose size was already counted.
+ **/
+static gboolean
+lunar_deep_count_job_is_new_inode (LunarDeepCountJob *job,
+                                    GFileInfo          *info)
+{
+  LunarDeepCountInode  key;
+  LunarDeepCountInode *new_key;
+
+  key.device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+  key.inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+
+  if (g_hash_table_contains (job->inodes, &key))
+    return FALSE;
+
+  new_key = g_new (LunarDeepCountInode, 1);
+  *new_key = key;
+  g_hash_table_add (job->inodes, new_key);
+  return TRUE;
+}
+
+
+
+static gboolean
+lunar_deep_count_job_is_hard_link (GFileInfo *info)
+{
+  return g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR
+      && g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_NLINK) > 1
+      && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE)
+      && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+}
+
+
+
+static void
+lunar_deep_count_job_queue_directory (LunarDeepCountJob *job,
+                                       GFile              *file,
+                                       GFileInfo          *info,
+                                       const gchar        *fs_id)
+{
+  LunarSizeCacheDescendant descendant;
+  LunarDeepCountDir       *dir;
+
+  dir = g_slice_new (LunarDeepCountDir);
+  dir->job = job;
+  dir->file = g_object_ref (file);
+  dir->fs_id = fs_id;
+
+  g_mutex_lock (&job->lock);
+  job->n_pending++;
+
+  /* remember the modification time of the directory, so the size
+   * cache notices changes anywhere in the subtree */
+  if (job->descendants != NULL)
+    {
+      if (job->descendants->len < LUNAR_SIZE_CACHE_MAX_DESCENDANTS)
+        {
+          descendant.path = g_file_get_relative_path (job->cache_root, file);
+          descendant.mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+          g_array_append_val (job->descendants, descendant);
+        }
+      else
+        {
+          /* too large to be remembered */
+          g_array_unref (job->descendants);
+          job->descendants = NULL;
+        }
+    }
+  g_mutex_unlock (&job->lock);
+
+  g_thread_pool_push (job->pool, dir, NULL);
+}
+
+
+
+/**
+ * lunar_deep_count_job_scan_directory:
+ * @job   : a #LunarDeepCountJob.
+ * @file  : the directory to scan.
+ * @fs_id : the interned file system id of the toplevel file.
+ * @error : return location for errors or %NULL.
+ *
+ * Counts the children of @file on the file system @fs_id. The
+ * sub directories are queued for the worker pool instead of
+ * being recursed into, so idle workers pick them up.
+ *
+ * Return value: %FALSE if @file could not be read.
+ **/
+static gboolean
+lunar_deep_count_job_scan_directory (LunarDeepCountJob *job,
+                                      GFile              *file,
+                                      const gchar        *fs_id,
+                                      GError            **error)
+{
+  GFileEnumerator *enumerator;
+  GFileInfo       *child_info;
+  GFile           *child;
+  const gchar     *child_fs_id;
+  guint64          total_size = 0;
+  guint64          allocated_size = 0;
+  guint            file_count = 0;
+  gboolean         counted;
+
+  /* try to read from the directory */
+  enumerator = g_file_enumerate_children (file,
+                                          DEEP_COUNT_FILE_INFO_NAMESPACE ","
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                          job->query_flags,
+                                          endo_job_get_cancellable (ENDO_JOB (job)),
+                                          error);
+  if (enumerator == NULL)
+    return FALSE;
+
+  while (!endo_job_is_cancelled (ENDO_JOB (job)))
+    {
+      /* query next child info, ignoring errors of single children */
+      child_info = g_file_enumerator_next_file (enumerator,
+                                                endo_job_get_cancellable (ENDO_JOB (job)),
+                                                NULL);
+
+      /* abort on invalid child info (iteration ends) or cancellation */
+      if (child_info == NULL)
+        break;
+
+      /* only check files on the same filesystem so no remote mounts or
+       * dummy filesystems are counted */
+      child_fs_id = g_file_info_get_attribute_string (child_info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
+      if (g_strcmp0 (child_fs_id != NULL ? child_fs_id : "", fs_id) == 0)
+        {
+          if (g_file_info_get_file_type (child_info) == G_FILE_TYPE_DIRECTORY)
+            {
+              child = g_file_get_child (file, g_file_info_get_name (child_info));
+              lunar_deep_count_job_queue_directory (job, child, child_info, fs_id);
+              g_object_unref (child);
+            }
+          else
+            {
+              /* we have a regular file or at least not a directory */
+              file_count++;
+
+              counted = TRUE;
+              if (lunar_deep_count_job_is_hard_link (child_info))
+                {
+                  g_mutex_lock (&job->lock);
+                  counted = lunar_deep_count_job_is_new_inode (job, child_info);
+                  g_mutex_unlock (&job->lock);
+                }
+
+              if (counted)
+                {
+                  total_size += g_file_info_get_size (child_info);
+                  allocated_size += g_file_info_get_attribute_uint64 (child_info, G_FILE_ATTRIBUTE_STANDARD_ALLOCATED_SIZE);
+                }
+            }
+        }
+
+      g_object_unref (child_info);
+    }
+
+  g_object_unref (enumerator);
+
+  /* publish the totals of this directory at once */
+  g_mutex_lock (&job->lock);
+  job->directory_count++;
+  job->file_count += file_count;
+  job->total_size += total_size;
+  job->allocated_size += allocated_size;
+  g_mutex_unlock (&job->lock);
+
+  return TRUE;
+}
+
+
+
+static void
+lunar_deep_count_job_worker (gpointer data,
+                              gpointer user_data)
+{
+  LunarDeepCountDir *dir = data;
+  LunarDeepCountJob *job = dir->job;
+  gboolean            readable = TRUE;
+
+  if (!endo_job_is_cancelled (ENDO_JOB (job)))
+    readable = lunar_deep_count_job_scan_directory (job, dir->file, dir->fs_id, NULL);
+
+  g_object_unref (dir->file);
+  g_slice_free (LunarDeepCountDir, dir);
+
+  g_mutex_lock (&job->lock);
+  if (!readable && !endo_job_is_cancelled (ENDO_JOB (job)))
+    job->unreadable_directory_count++;
+  if (--job->n_pending == 0)
+    g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+}
+
+
+
+static void
+lunar_deep_count_job_wait (LunarDeepCountJob *job)
+{
+  gint64 real_time;
+  gint64 end_time;
+
+  g_mutex_lock (&job->lock);
+  while (job->n_pending > 0)
+    {
+      end_time = g_get_monotonic_time () + (G_USEC_PER_SEC / 4);
+      if (g_cond_wait_until (&job->cond, &job->lock, end_time) || job->n_pending == 0)
+        continue;
+
+      /* emit status updates while the workers are busy,
+       * but not more than four times per second */
+      real_time = g_get_real_time ();
+      if (real_time >= job->last_time)
+        {
+          if (job->last_time != 0)
+            {
+              g_mutex_unlock (&job->lock);
+              lunar_deep_count_job_status_update (job);
+              g_mutex_lock (&job->lock);
+            }
+          job->last_time = real_time + (G_USEC_PER_SEC / 4);
+        }
+    }
+  g_mutex_unlock (&job->lock);
 }
 
 
@@ -171,43 +516,32 @@ lunar_deep_count_job_status_update (LunarDeepCountJob *job)
 static gboolean
 lunar_deep_count_job_process (EndoJob       *job,
                                GFile        *file,
-                               GFileInfo    *file_info,
-                               const gchar  *toplevel_fs_id,
                                GError      **error)
 {
-  LunarDeepCountJob *count_job = LUNAR_DEEP_COUNT_JOB (job);
-  GFileEnumerator    *enumerator;
-  GFileInfo          *child_info;
-  GFileInfo          *info;
-  gboolean            success = TRUE;
-  GFile              *child;
-  gint64              real_time;
-  const gchar        *fs_id;
-  gboolean            toplevel_file = (toplevel_fs_id == NULL);
+  LunarDeepCountJob  *count_job = LUNAR_DEEP_COUNT_JOB (job);
+  LunarSizeCacheEntry entry;
+  GFileInfo           *info;
+  gboolean             success = TRUE;
+  gboolean             cacheable;
+  const gchar         *fs_id;
+  guint64              mtime;
+  guint                max_workers;
 
   _lunar_return_val_if_fail (LUNAR_IS_JOB (job), FALSE);
   _lunar_return_val_if_fail (G_IS_FILE (file), FALSE);
-  _lunar_return_val_if_fail (file_info == NULL || G_IS_FILE_INFO (file_info), FALSE);
   _lunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
   /* abort if job was already cancelled */
   if (endo_job_is_cancelled (job))
     return FALSE;
 
-  if (file_info != NULL)
-    {
-      /* use the enumerator info */
-      info = g_object_ref (file_info);
-    }
-  else
-    {
-      /* query size and type of the current file */
-      info = g_file_query_info (file,
-                                DEEP_COUNT_FILE_INFO_NAMESPACE,
-                                count_job->query_flags,
-                                endo_job_get_cancellable (job),
-                                error);
-    }
+  /* query size and type of the current file */
+  info = g_file_query_info (file,
+                            DEEP_COUNT_FILE_INFO_NAMESPACE ","
+                            G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                            count_job->query_flags,
+                            endo_job_get_cancellable (job),
+                            error);
 
   /* abort on invalid info or cancellation */
   if (info == NULL)
@@ -220,110 +554,99 @@ lunar_deep_count_job_process (EndoJob       *job,
       return FALSE;
     }
 
-  /* only check files on the same filesystem so no remote mounts or
-   * dummy filesystems are counted */
+  /* the file system of the toplevel file, children on other
+   * file systems are skipped */
   fs_id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM);
-  if (fs_id == NULL)
-    fs_id = "";
-
-  if (toplevel_fs_id == NULL)
-    {
-      /* first toplevel, so use this id */
-      toplevel_fs_id = fs_id;
-    }
-  else if (strcmp (fs_id, toplevel_fs_id) != 0)
-    {
-      /* release the file info */
-      g_object_unref (info);
-
-      /* other filesystem, continue */
-      return TRUE;
-    }
+  fs_id = g_intern_string (fs_id != NULL ? fs_id : "");
 
   /* recurse if we have a directory */
   if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
     {
-      /* try to read from the directory */
-      enumerator = g_file_enumerate_children (file,
-                                              DEEP_COUNT_FILE_INFO_NAMESPACE ","
-                                              G_FILE_ATTRIBUTE_STANDARD_NAME,
-                                              count_job->query_flags,
-                                              endo_job_get_cancellable (job),
-                                              error);
-
-      if (!endo_job_is_cancelled (job))
-        {
-          if (enumerator == NULL)
-            {
-              /* directory was unreadable */
-              count_job->unreadable_directory_count++;
-
-              if (toplevel_file
-                  && g_list_length (count_job->files) < 2)
-                {
-                  /* we only bail out if the job file is unreadable */
-                  success = FALSE;
-                }
-              else
-                {
-                  /* ignore errors from files other than the job file */
-                  g_clear_error (error);
-                }
-            }
-          else
-            {
-              /* directory was readable */
-              count_job->directory_count++;
+      /* the totals of a single directory are remembered, with more job
+       * files hard links may be shared and the counters are combined */
+      cacheable = (count_job->files != NULL && count_job->files->next == NULL);
+      mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
 
-              while (!endo_job_is_cancelled (job))
-                {
-                  /* query next child info */
-                  child_info = g_file_enumerator_next_file (enumerator,
-                                                            endo_job_get_cancellable (job),
-                                                            error);
-
-                  /* abort on invalid child info (iteration ends) or cancellation */
-                  if (child_info == NULL)
-                    break;
+      if (cacheable && lunar_size_cache_lookup (count_job->size_cache, file, mtime, &entry))
+        {
+          g_mutex_lock (&count_job->lock);
+          count_job->total_size = entry.total_size;
+          count_job->allocated_size = entry.allocated_size;
+          count_job->file_count = entry.file_count;
+          count_job->directory_count = entry.directory_count;
+          count_job->unreadable_directory_count = entry.unreadable_directory_count;
+          g_mutex_unlock (&count_job->lock);
+
+          g_object_unref (info);
+          return !endo_job_is_cancelled (job);
+        }
 
-                  if (!endo_job_is_cancelled (job))
-                    {
-                      /* generate a GFile for the child */
-                      child = g_file_resolve_relative_path (file, g_file_info_get_name (child_info));
+      /* collect the subdirectories the cached totals depend on */
+      if (cacheable)
+        {
+          g_mutex_lock (&count_job->lock);
+          count_job->cache_root = g_object_ref (file);
+          count_job->descendants = lunar_size_cache_descendants_new ();
+          g_mutex_unlock (&count_job->lock);
+        }
 
-                      /* recurse unless the job was cancelled before */
-                      lunar_deep_count_job_process (job, child, child_info, toplevel_fs_id, error);
+      /* remote file systems do not like many concurrent requests */
+      max_workers = g_file_is_native (file) ? DEEP_COUNT_MAX_WORKERS_LOCAL : DEEP_COUNT_MAX_WORKERS_REMOTE;
+      g_thread_pool_set_max_threads (count_job->pool, max_workers, NULL);
 
-                      /* free resources */
-                      g_object_unref (child);
-                    }
+      if (!lunar_deep_count_job_scan_directory (count_job, file, fs_id, error)
+          && !endo_job_is_cancelled (job))
+        {
+          /* directory was unreadable */
+          g_mutex_lock (&count_job->lock);
+          count_job->unreadable_directory_count++;
+          g_mutex_unlock (&count_job->lock);
 
-                  g_object_unref (child_info);
-                }
+          if (g_list_length (count_job->files) < 2)
+            {
+              /* we only bail out if the job file is unreadable */
+              success = FALSE;
+            }
+          else
+            {
+              /* ignore errors from files other than the job file */
+              g_clear_error (error);
             }
         }
 
-      /* destroy the enumerator */
-      if (enumerator != NULL)
-        g_object_unref (enumerator);
+      /* wait until the whole subtree has been counted */
+      lunar_deep_count_job_wait (count_job);
 
-      /* emit status update whenever we've finished a directory,
-       * but not more than four times per second */
-      real_time = g_get_real_time ();
-      if (real_time >= count_job->last_time)
+      if (cacheable && success && count_job->descendants != NULL
+          && !endo_job_is_cancelled (job))
         {
-          if (count_job->last_time != 0)
-            lunar_deep_count_job_status_update (count_job);
-          count_job->last_time = real_time + (G_USEC_PER_SEC / 4);
+          entry.total_size = count_job->total_size;
+          entry.allocated_size = count_job->allocated_size;
+          entry.file_count = count_job->file_count;
+          entry.directory_count = count_job->directory_count;
+          entry.unreadable_directory_count = count_job->unreadable_directory_count;
+
+          /* the size cache takes the descendants */
+          lunar_size_cache_store (count_job->size_cache, file, mtime, &entry, count_job->descendants);
+          count_job->descendants = NULL;
         }
     }
   else
     {
+      g_mutex_lock (&count_job->lock);
+
       /* we have a regular file or at least not a directory */
       count_job->file_count++;
 
       /* add size of the file to the total size */
-      count_job->total_size += g_file_info_get_size (info);
+      if (!lunar_deep_count_job_is_hard_link (info)
+          || lunar_deep_count_job_is_new_inode (count_job, info))
+        {
+          count_job->total_size += g_file_info_get_size (info);
+          count_job->allocated_size += g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_STANDARD_ALLOCATED_SIZE);
+        }
+
+      g_mutex_unlock (&count_job->lock);
     }
 
   /* destroy the file info */
@@ -355,20 +678,31 @@ lunar_deep_count_job_execute (EndoJob  *job,
 
   /* reset counters */
   count_job->total_size = 0;
+  count_job->allocated_size = 0;
   count_job->file_count = 0;
   count_job->directory_count = 0;
   count_job->unreadable_directory_count = 0;
   count_job->last_time = 0;
+  count_job->n_pending = 0;
+  g_hash_table_remove_all (count_job->inodes);
+
+  /* the workers scanning the sub directories */
+  count_job->pool = g_thread_pool_new (lunar_deep_count_job_worker, NULL,
+                                       DEEP_COUNT_MAX_WORKERS_LOCAL, FALSE, NULL);
 
   /* count files, directories and compute size of the job files */
   for (lp = count_job->files; lp != NULL; lp = lp->next)
     {
       gfile = lunar_file_get_file (LUNAR_FILE (lp->data));
-      success = lunar_deep_count_job_process (job, gfile, NULL, NULL, &err);
+      success = lunar_deep_count_job_process (job, gfile, &err);
       if (G_UNLIKELY (!success))
         break;
     }
 
+  /* all queued directories were finished by lunar_deep_count_job_wait() */
+  g_thread_pool_free (count_job->pool, FALSE, TRUE);
+  count_job->pool = NULL;
+
   if (!success)
     {
       g_assert (err != NULL || endo_job_is_cancelled (job));
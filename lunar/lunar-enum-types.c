@@ -358,6 +358,28 @@ lunar_parallel_copy_mode_get_type (void)
 }
 
 
+
+GType
+lunar_copy_backend_get_type (void)
+{
+  static GType type = G_TYPE_INVALID;
+
+  if (G_UNLIKELY (type == G_TYPE_INVALID))
+    {
+      static const GEnumValue values[] =
+      {
+        { LUNAR_COPY_BACKEND_AUTO, "LUNAR_COPY_BACKEND_AUTO", "auto", },
+        { LUNAR_COPY_BACKEND_GIO,  "LUNAR_COPY_BACKEND_GIO",  "gio",  },
+        { 0,                        NULL,                       NULL,   },
+      };
+
+      type = g_enum_register_static (I_("LunarCopyBackend"), values);
+    }
+
+  return type;
+}
+
+
 /**
  * lunar_zoom_level_to_icon_size:
  * @zoom_level : a #LunarZoomLevel.
@@ -200,6 +200,23 @@ typedef enum
 GType lunar_parallel_copy_mode_get_type (void) G_GNUC_CONST;
 
 
+#define LUNAR_TYPE_COPY_BACKEND (lunar_copy_backend_get_type ())
+
+/**
+ * LunarCopyBackend:
+ * @LUNAR_COPY_BACKEND_AUTO : let the kernel copy local files (reflink, copy_file_range
+ *                            or sendfile) and use GIO for everything else.
+ * @LUNAR_COPY_BACKEND_GIO  : always copy using GIO.
+ **/
+typedef enum
+{
+  LUNAR_COPY_BACKEND_AUTO,
+  LUNAR_COPY_BACKEND_GIO
+} LunarCopyBackend;
+
+GType lunar_copy_backend_get_type (void) G_GNUC_CONST;
+
+
 #define LUNAR_TYPE_RECURSIVE_PERMISSIONS (lunar_recursive_permissions_get_type ())
 
 /**
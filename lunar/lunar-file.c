@@ -73,6 +73,9 @@
 /* Dump the file cache every X second, set to 0 to disable */
 #define DUMP_FILE_CACHE 0
 
+/* number of independently locked parts of the file cache, a power of 2 */
+#define FILE_CACHE_N_SHARDS 16
+
 
 
 /* Signal identifiers */
@@ -118,14 +121,30 @@ static gboolean           lunar_file_same_filesystem          (const LunarFile
 
 
 
-G_LOCK_DEFINE_STATIC (file_cache_mutex);
 G_LOCK_DEFINE_STATIC (file_content_type_mutex);
 G_LOCK_DEFINE_STATIC (file_rename_mutex);
 
 
 
-static LunarUserManager *user_manager;
-static GHashTable        *file_cache;
+typedef struct _LunarFileCacheShard LunarFileCacheShard;
+
+/* one part of the file cache, selected by the hash of the GFile */
+struct _LunarFileCacheShard
+{
+  GMutex      lock;
+  GHashTable *table;   /* GFile -> GWeakRef */
+
+  /* statistics for lunar_file_cache_dump () */
+  guint64     n_hits;
+  guint64     n_misses;
+  guint64     n_contended;
+};
+
+
+
+static LunarUserManager   *user_manager;
+static LunarFileCacheShard file_cache[FILE_CACHE_N_SHARDS];
+static GQuark               lunar_file_hash_quark;
 static guint32            effective_user_id;
 static GQuark             lunar_file_watch_quark;
 static guint              file_signals[LAST_SIGNAL];
@@ -147,6 +166,8 @@ typedef enum
   LUNAR_FILE_FLAG_THUMB_MASK     = 0x03,   /* storage for LunarFileThumbState */
   LUNAR_FILE_FLAG_IN_DESTRUCTION = 1 << 2, /* for avoiding recursion during destroy */
   LUNAR_FILE_FLAG_IS_MOUNTED     = 1 << 3, /* whether this file is mounted */
+  LUNAR_FILE_FLAG_NO_THUMB_PATH  = 1 << 4, /* no thumbnail was found on disk */
+  LUNAR_FILE_FLAG_TYPE_GUESSED   = 1 << 5, /* the content type is guessed from the name */
 }
 LunarFileFlags;
 
@@ -166,15 +187,19 @@ struct _LunarFile
   GFileInfo            *info;
   GFileType             kind;
   GFile                *gfile;
-  gchar                *content_type;
-  gchar                *icon_name;
+
+  /* interned, there are only a few different ones */
+  const gchar          *content_type;
+  const gchar          *icon_name;
 
   gchar                *custom_icon_name;
-  gchar                *display_name;
   gchar                *basename;
   gchar                *thumbnail_path;
 
-  /* sorting */
+  /* points to basename if they are equal */
+  gchar                *display_name;
+
+  /* sorting, built on first use by lunar_file_compare_by_name() */
   gchar                *collate_key;
   gchar                *collate_key_nocase;
 
@@ -240,6 +265,102 @@ weak_ref_free (GWeakRef *ref)
 }
 
 
+
+/* the hash of a GFile is computed once, g_file_hash() builds the uri every time */
+static guint
+lunar_file_cache_hash (gconstpointer gfile)
+{
+  gpointer hash;
+  guint    value;
+
+  hash = g_object_get_qdata (G_OBJECT (gfile), lunar_file_hash_quark);
+  if (G_UNLIKELY (hash == NULL))
+    {
+      /* 0 means "not computed yet" */
+      value = g_file_hash (gfile);
+      if (G_UNLIKELY (value == 0))
+        value = 1;
+
+      hash = GUINT_TO_POINTER (value);
+      g_object_set_qdata (G_OBJECT (gfile), lunar_file_hash_quark, hash);
+    }
+
+  return GPOINTER_TO_UINT (hash);
+}
+
+
+
+static gpointer
+lunar_file_cache_init (gpointer data)
+{
+  guint n;
+
+  lunar_file_hash_quark = g_quark_from_static_string ("lunar-file-hash");
+
+  for (n = 0; n < FILE_CACHE_N_SHARDS; ++n)
+    {
+      g_mutex_init (&file_cache[n].lock);
+      file_cache[n].table = g_hash_table_new_full (lunar_file_cache_hash,
+                                                   (GEqualFunc) g_file_equal,
+                                                   (GDestroyNotify) g_object_unref,
+                                                   (GDestroyNotify) weak_ref_free);
+    }
+
+  return NULL;
+}
+
+
+
+/* returns the shard for gfile, locked */
+static LunarFileCacheShard *
+lunar_file_cache_lock (const GFile *gfile)
+{
+  static GOnce         cache_once = G_ONCE_INIT;
+  LunarFileCacheShard *shard;
+  guint                hash;
+
+  /* allocate the LunarFile cache on-demand */
+  g_once (&cache_once, lunar_file_cache_init, NULL);
+
+  hash = lunar_file_cache_hash (gfile);
+  shard = &file_cache[(hash ^ (hash >> 16)) & (FILE_CACHE_N_SHARDS - 1)];
+
+  if (G_UNLIKELY (!g_mutex_trylock (&shard->lock)))
+    {
+      g_mutex_lock (&shard->lock);
+      shard->n_contended++;
+    }
+
+  return shard;
+}
+
+
+
+static void
+lunar_file_cache_insert (LunarFile *file)
+{
+  LunarFileCacheShard *shard;
+
+  shard = lunar_file_cache_lock (file->gfile);
+  g_hash_table_insert (shard->table,
+                       g_object_ref (file->gfile),
+                       weak_ref_new (G_OBJECT (file)));
+  g_mutex_unlock (&shard->lock);
+}
+
+
+
+static void
+lunar_file_cache_remove (GFile *gfile)
+{
+  LunarFileCacheShard *shard;
+
+  shard = lunar_file_cache_lock (gfile);
+  g_hash_table_remove (shard->table, gfile);
+  g_mutex_unlock (&shard->lock);
+}
+
+
 #ifdef G_ENABLE_DEBUG
 #ifdef HAVE_ATEXIT
 static gboolean lunar_file_atexit_registered = FALSE;
@@ -265,22 +386,26 @@ lunar_file_atexit_foreach (gpointer key,
 static void
 lunar_file_atexit (void)
 {
-  G_LOCK (file_cache_mutex);
+  guint n;
+  guint n_files = 0;
 
-  if (file_cache == NULL || g_hash_table_size (file_cache) == 0)
-    {
-      G_UNLOCK (file_cache_mutex);
-      return;
-    }
+  for (n = 0; n < FILE_CACHE_N_SHARDS; ++n)
+    if (file_cache[n].table != NULL)
+      n_files += g_hash_table_size (file_cache[n].table);
+
+  if (n_files == 0)
+    return;
 
-  g_print ("--- Leaked a total of %u LunarFile objects:\n",
-           g_hash_table_size (file_cache));
+  g_print ("--- Leaked a total of %u LunarFile objects:\n", n_files);
 
-  g_hash_table_foreach (file_cache, lunar_file_atexit_foreach, NULL);
+  for (n = 0; n < FILE_CACHE_N_SHARDS; ++n)
+    {
+      g_mutex_lock (&file_cache[n].lock);
+      g_hash_table_foreach (file_cache[n].table, lunar_file_atexit_foreach, NULL);
+      g_mutex_unlock (&file_cache[n].lock);
+    }
 
   g_print ("\n");
-
-  G_UNLOCK (file_cache_mutex);
 }
 #endif
 #endif
@@ -305,19 +430,39 @@ lunar_file_cache_dump_foreach (gpointer gfile,
 static gboolean
 lunar_file_cache_dump (gpointer user_data)
 {
-  G_LOCK (file_cache_mutex);
+  LunarFileCacheShard *shard;
+  guint64              n_hits = 0;
+  guint64              n_misses = 0;
+  guint64              n_contended = 0;
+  guint                n_files = 0;
+  guint                n;
 
-  if (file_cache != NULL)
+  for (n = 0; n < FILE_CACHE_N_SHARDS; ++n)
     {
-      g_print ("--- %d LunarFile objects in cache:\n",
-               g_hash_table_size (file_cache));
+      shard = &file_cache[n];
+      if (shard->table == NULL)
+        continue;
+
+      g_mutex_lock (&shard->lock);
+
+      g_print ("--- shard %u: %u LunarFile objects, %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT
+               " misses, %" G_GUINT64_FORMAT " contended locks:\n",
+               n, g_hash_table_size (shard->table),
+               shard->n_hits, shard->n_misses, shard->n_contended);
 
-      g_hash_table_foreach (file_cache, lunar_file_cache_dump_foreach, NULL);
+      g_hash_table_foreach (shard->table, lunar_file_cache_dump_foreach, NULL);
 
-      g_print ("\n");
+      n_files += g_hash_table_size (shard->table);
+      n_hits += shard->n_hits;
+      n_misses += shard->n_misses;
+      n_contended += shard->n_contended;
+
+      g_mutex_unlock (&shard->lock);
     }
 
-  G_UNLOCK (file_cache_mutex);
+  g_print ("--- %u LunarFile objects in cache, %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT
+           " misses, %" G_GUINT64_FORMAT " contended locks\n\n",
+           n_files, n_hits, n_misses, n_contended);
 
   return TRUE;
 }
@@ -436,9 +581,7 @@ lunar_file_finalize (GObject *object)
 #endif
 
   /* drop the entry from the cache */
-  G_LOCK (file_cache_mutex);
-  g_hash_table_remove (file_cache, file->gfile);
-  G_UNLOCK (file_cache_mutex);
+  lunar_file_cache_remove (file->gfile);
 
   /* release file info */
   if (file->info != NULL)
@@ -447,12 +590,9 @@ lunar_file_finalize (GObject *object)
   /* free the custom icon name */
   g_free (file->custom_icon_name);
 
-  /* content type info */
-  g_free (file->content_type);
-  g_free (file->icon_name);
-
   /* free display name and basename */
-  g_free (file->display_name);
+  if (file->display_name != file->basename)
+    g_free (file->display_name);
   g_free (file->basename);
 
   /* free collate keys */
@@ -738,20 +878,15 @@ lunar_file_monitor_moved (LunarFile *file,
   /* need to re-register the monitor handle for the new uri */
   lunar_file_watch_reconnect (file);
 
-  G_LOCK (file_cache_mutex);
+  /* insert the new entry before dropping the previous one, the
+   * two may live in different shards of the cache */
+  lunar_file_cache_insert (file);
 
   /* drop the previous entry from the cache */
-  g_hash_table_remove (file_cache, previous_file);
+  lunar_file_cache_remove (previous_file);
 
   /* drop the reference on the previous file */
   g_object_unref (previous_file);
-
-  /* insert the new entry */
-  g_hash_table_insert (file_cache,
-                       g_object_ref (file->gfile),
-                       weak_ref_new (G_OBJECT (file)));
-
-  G_UNLOCK (file_cache_mutex);
 }
 
 
@@ -937,17 +1072,17 @@ lunar_file_info_clear (LunarFile *file)
   file->custom_icon_name = NULL;
 
   /* free display name and basename */
-  g_free (file->display_name);
+  if (file->display_name != file->basename)
+    g_free (file->display_name);
   file->display_name = NULL;
 
   g_free (file->basename);
   file->basename = NULL;
 
   /* content type */
-  g_free (file->content_type);
   file->content_type = NULL;
-  g_free (file->icon_name);
   file->icon_name = NULL;
+  FLAG_UNSET (file, LUNAR_FILE_FLAG_TYPE_GUESSED);
 
   /* free collate keys */
   if (file->collate_key_nocase != file->collate_key)
@@ -960,6 +1095,7 @@ lunar_file_info_clear (LunarFile *file)
   /* free thumbnail path */
   g_free (file->thumbnail_path);
   file->thumbnail_path = NULL;
+  FLAG_UNSET (file, LUNAR_FILE_FLAG_NO_THUMB_PATH);
 
   /* assume the file is mounted by default */
   FLAG_SET (file, LUNAR_FILE_FLAG_IS_MOUNTED);
@@ -979,7 +1115,6 @@ lunar_file_info_reload (LunarFile   *file,
   gchar       *p;
   const gchar *display_name;
   gboolean     is_secure = FALSE;
-  gchar       *casefold;
   gchar       *path;
 
   _lunar_return_if_fail (LUNAR_IS_FILE (file));
@@ -1011,7 +1146,7 @@ lunar_file_info_reload (LunarFile   *file,
     {
       path = g_file_get_path (file->gfile);
       if (g_strcmp0 (path, "/proc/kmsg") == 0)
-        file->content_type = g_strdup (DEFAULT_CONTENT_TYPE);
+        file->content_type = g_intern_static_string (DEFAULT_CONTENT_TYPE);
       g_free (path);
     }
 
@@ -1072,19 +1207,48 @@ lunar_file_info_reload (LunarFile   *file,
       /* fall back to a name for the gfile */
       if (file->display_name == NULL)
         file->display_name = lunar_g_file_get_display_name (file->gfile);
+
+      /* most names are valid UTF-8 already, share the string */
+      if (strcmp (file->display_name, file->basename) == 0)
+        {
+          g_free (file->display_name);
+          file->display_name = file->basename;
+        }
     }
+}
+
+
+
+/* builds the collation keys on the first name comparison, most
+ * files are never sorted by name so this saves time and memory */
+static void
+lunar_file_ensure_collate_keys (LunarFile *file)
+{
+  gchar *collate_key;
+  gchar *collate_key_nocase;
+  gchar *casefold;
+
+  if (G_LIKELY (g_atomic_pointer_get (&file->collate_key_nocase) != NULL))
+    return;
 
   /* create case sensitive collation key */
-  file->collate_key = g_utf8_collate_key_for_filename (file->display_name, -1);
+  collate_key = g_utf8_collate_key_for_filename (file->display_name, -1);
+  if (!g_atomic_pointer_compare_and_exchange (&file->collate_key, NULL, collate_key))
+    g_free (collate_key);
+  collate_key = g_atomic_pointer_get (&file->collate_key);
 
   /* lowercase the display name */
   casefold = g_utf8_casefold (file->display_name, -1);
 
   /* if the lowercase name is equal, only peek the already hash key */
   if (casefold != NULL && strcmp (casefold, file->display_name) != 0)
-    file->collate_key_nocase = g_utf8_collate_key_for_filename (casefold, -1);
+    collate_key_nocase = g_utf8_collate_key_for_filename (casefold, -1);
   else
-    file->collate_key_nocase = file->collate_key;
+    collate_key_nocase = collate_key;
+
+  if (!g_atomic_pointer_compare_and_exchange (&file->collate_key_nocase, NULL, collate_key_nocase)
+      && collate_key_nocase != collate_key)
+    g_free (collate_key_nocase);
 
   /* cleanup */
   g_free (casefold);
@@ -1132,11 +1296,7 @@ lunar_file_get_async_finish (GObject      *object,
    }
 
   /* insert the file into the cache */
-  G_LOCK (file_cache_mutex);
-  g_hash_table_insert (file_cache,
-                       g_object_ref (file->gfile),
-                       weak_ref_new (G_OBJECT (file)));
-  G_UNLOCK (file_cache_mutex);
+  lunar_file_cache_insert (file);
 
   /* pass the loaded file and possible errors to the return function */
   (data->func) (location, file, error, data->user_data);
@@ -1175,7 +1335,10 @@ lunar_file_load (LunarFile   *file,
                   GCancellable *cancellable,
                   GError      **error)
 {
-  GError *err = NULL;
+  GError      *err = NULL;
+  const gchar *content_type;
+  GFileType    kind;
+  guint64      mtime;
 
   _lunar_return_val_if_fail (LUNAR_IS_FILE (file), FALSE);
   _lunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
@@ -1183,10 +1346,12 @@ lunar_file_load (LunarFile   *file,
   _lunar_return_val_if_fail (G_IS_FILE (file->gfile), FALSE);
 
   /* remove the file from cache */
-  G_LOCK (file_cache_mutex);
-  if (g_hash_table_lookup (file_cache, file->gfile) != NULL)
-    g_hash_table_remove (file_cache, file->gfile);
-  G_UNLOCK (file_cache_mutex);
+  lunar_file_cache_remove (file->gfile);
+
+  /* remember the content type, it stays valid while the file is unchanged */
+  content_type = lunar_file_has_content_type (file) ? file->content_type : NULL;
+  kind = file->kind;
+  mtime = lunar_file_get_date (file, LUNAR_FILE_DATE_MODIFIED);
 
   /* reset the file */
   lunar_file_info_clear (file);
@@ -1200,6 +1365,15 @@ lunar_file_load (LunarFile   *file,
   /* update the file from the information */
   lunar_file_info_reload (file, cancellable);
 
+  /* sniffing the contents again is expensive, so reuse the content type */
+  if (content_type != NULL
+      && file->content_type == NULL
+      && file->info != NULL
+      && file->kind == kind
+      && mtime != 0
+      && lunar_file_get_date (file, LUNAR_FILE_DATE_MODIFIED) == mtime)
+    file->content_type = content_type;
+
   /* update the mounted info */
   if (err != NULL
       && err->domain == G_IO_ERROR
@@ -1218,11 +1392,7 @@ lunar_file_load (LunarFile   *file,
   /* (re)insert the file into the cache */
   if (file != NULL && file->kind != G_FILE_TYPE_UNKNOWN)
     {
-      G_LOCK (file_cache_mutex);
-      g_hash_table_insert (file_cache,
-                           g_object_ref (file->gfile),
-                           weak_ref_new (G_OBJECT (file)));
-      G_UNLOCK (file_cache_mutex);
+      lunar_file_cache_insert (file);
     }
   return TRUE;
 }
@@ -1266,16 +1436,8 @@ lunar_file_get (GFile   *gfile,
 
       if (lunar_file_load (file, NULL, error))
         {
-          /* setup lock until the file is inserted */
-          G_LOCK (file_cache_mutex);
-
           /* insert the file into the cache */
-          g_hash_table_insert (file_cache,
-                               g_object_ref (file->gfile),
-                               weak_ref_new (G_OBJECT (file)));
-
-          /* done inserting in the cache */
-          G_UNLOCK (file_cache_mutex);
+          lunar_file_cache_insert (file);
         }
       else
         {
@@ -1345,16 +1507,8 @@ lunar_file_get_with_info (GFile     *gfile,
       if (not_mounted)
         FLAG_UNSET (file, LUNAR_FILE_FLAG_IS_MOUNTED);
 
-      /* setup lock until the file is inserted */
-      G_LOCK (file_cache_mutex);
-
       /* insert the file into the cache */
-      g_hash_table_insert (file_cache,
-                           g_object_ref (file->gfile),
-                           weak_ref_new (G_OBJECT (file)));
-
-      /* done inserting in the cache */
-      G_UNLOCK (file_cache_mutex);
+      lunar_file_cache_insert (file);
     }
 
   return file;
@@ -2426,7 +2580,7 @@ lunar_file_get_content_type (LunarFile *file)
       if (G_UNLIKELY (file->kind == G_FILE_TYPE_DIRECTORY))
         {
           /* this we known for sure */
-          file->content_type = g_strdup ("inode/directory");
+          file->content_type = g_intern_static_string ("inode/directory");
         }
       else
         {
@@ -2445,7 +2599,7 @@ lunar_file_get_content_type (LunarFile *file)
                 content_type = g_file_info_get_attribute_string (info,
                                                                  G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
               if (G_LIKELY (content_type != NULL))
-                file->content_type = g_strdup (content_type);
+                file->content_type = g_intern_string (content_type);
               g_object_unref (G_OBJECT (info));
             }
           else
@@ -2458,7 +2612,7 @@ lunar_file_get_content_type (LunarFile *file)
 
           /* always provide a fallback */
           if (file->content_type == NULL)
-            file->content_type = g_strdup (DEFAULT_CONTENT_TYPE);
+            file->content_type = g_intern_static_string (DEFAULT_CONTENT_TYPE);
         }
 
       bailout:
@@ -2471,17 +2625,105 @@ lunar_file_get_content_type (LunarFile *file)
 
 
 
+/**
+ * lunar_file_has_content_type:
+ * @file : a #LunarFile.
+ *
+ * Checks whether the content type of @file is known already,
+ * so lunar_file_get_content_type() does not touch the disk.
+ * A content type guessed by lunar_file_guess_content_type()
+ * is not known.
+ *
+ * Return value: %TRUE if the content type of @file is known.
+ **/
 gboolean
-lunar_file_load_content_type (LunarFile *file)
+lunar_file_has_content_type (const LunarFile *file)
 {
   _lunar_return_val_if_fail (LUNAR_IS_FILE (file), TRUE);
+  return file->content_type != NULL && !FLAG_IS_SET (file, LUNAR_FILE_FLAG_TYPE_GUESSED);
+}
 
-  if (file->content_type != NULL)
-    return FALSE;
 
-  lunar_file_get_content_type (file);
 
-  return TRUE;
+/**
+ * lunar_file_guess_content_type:
+ * @file : a #LunarFile.
+ *
+ * Lets lunar_file_get_content_type() return a content type guessed
+ * from the name of @file, without touching the disk, until the
+ * sniffed content type is passed to lunar_file_set_content_type().
+ * Used while the contents of @file are sniffed off the main thread.
+ **/
+void
+lunar_file_guess_content_type (LunarFile *file)
+{
+  gchar *content_type;
+
+  _lunar_return_if_fail (LUNAR_IS_FILE (file));
+
+  if (file->content_type != NULL || file->basename == NULL)
+    return;
+
+  content_type = g_content_type_guess (file->basename, NULL, 0, NULL);
+
+  G_LOCK (file_content_type_mutex);
+
+  if (file->content_type == NULL)
+    {
+      file->content_type = g_intern_string (content_type);
+      FLAG_SET (file, LUNAR_FILE_FLAG_TYPE_GUESSED);
+    }
+
+  G_UNLOCK (file_content_type_mutex);
+
+  g_free (content_type);
+}
+
+
+
+/**
+ * lunar_file_set_content_type:
+ * @file         : a #LunarFile.
+ * @content_type : the content type of @file, or %NULL if it
+ *                could not be determined.
+ *
+ * Stores the @content_type determined for @file by a loader that
+ * sniffs the contents off the main thread, unless the content type
+ * of @file is already known. If this replaces a different guess of
+ * lunar_file_guess_content_type(), the "changed" signal is emitted
+ * on @file, so the views update its icon and type.
+ *
+ * Without @content_type the guess is dropped, and
+ * lunar_file_get_content_type() will sniff the contents itself.
+ **/
+void
+lunar_file_set_content_type (LunarFile   *file,
+                              const gchar *content_type)
+{
+  gboolean changed = FALSE;
+
+  _lunar_return_if_fail (LUNAR_IS_FILE (file));
+
+  G_LOCK (file_content_type_mutex);
+
+  if (!lunar_file_has_content_type (file))
+    {
+      if (content_type != NULL)
+        content_type = g_intern_string (content_type);
+
+      /* the icon depends on the content type */
+      changed = (file->content_type != NULL && file->content_type != content_type);
+      if (changed)
+        file->icon_name = NULL;
+
+      file->content_type = content_type;
+      FLAG_UNSET (file, LUNAR_FILE_FLAG_TYPE_GUESSED);
+    }
+
+  G_UNLOCK (file_content_type_mutex);
+
+  if (changed && content_type != NULL)
+    lunar_file_changed (file);
 }
 
 
@@ -3496,6 +3738,10 @@ lunar_file_get_thumbnail_path (LunarFile *file, LunarThumbnailSize thumbnail_siz
   if (lunar_file_get_thumb_state (file) == LUNAR_FILE_THUMB_STATE_NONE)
     return NULL;
 
+  /* don't stat both locations again until the thumb state changes */
+  if (FLAG_IS_SET (file, LUNAR_FILE_FLAG_NO_THUMB_PATH))
+    return NULL;
+
   if (G_UNLIKELY (file->thumbnail_path == NULL))
     {
       checksum = g_checksum_new (G_CHECKSUM_MD5);
@@ -3535,6 +3781,7 @@ lunar_file_get_thumbnail_path (LunarFile *file, LunarThumbnailSize thumbnail_siz
                 /* Thumbnail doesn't exist in either spot */
                 g_free(file->thumbnail_path);
                 file->thumbnail_path = NULL;
+                FLAG_SET (file, LUNAR_FILE_FLAG_NO_THUMB_PATH);
               }
             }
 
@@ -3587,6 +3834,9 @@ lunar_file_set_thumb_state (LunarFile          *file,
   /* set the new thumbnail state */
   FLAG_SET_THUMB_STATE (file, state);
 
+  /* the thumbnail may have been written (or removed) meanwhile */
+  FLAG_UNSET (file, LUNAR_FILE_FLAG_NO_THUMB_PATH);
+
   /* remove path if the type is not supported */
   if (state == LUNAR_FILE_THUMB_STATE_NONE
       && file->thumbnail_path != NULL)
@@ -3845,14 +4095,16 @@ lunar_file_get_icon_name (LunarFile          *file,
     }
 
   /* store new name, fallback to legacy names, or empty string to avoid recursion */
-  g_free (file->icon_name);
   if (G_LIKELY (icon_name != NULL))
-    file->icon_name = icon_name;
+    {
+      file->icon_name = g_intern_string (icon_name);
+      g_free (icon_name);
+    }
   else if (file->kind == G_FILE_TYPE_DIRECTORY
            && gtk_icon_theme_has_icon (icon_theme, "folder"))
-    file->icon_name = g_strdup ("folder");
+    file->icon_name = g_intern_static_string ("folder");
   else
-    file->icon_name = g_strdup ("");
+    file->icon_name = g_intern_static_string ("");
 
   return lunar_file_get_icon_name_for_state (file->icon_name, icon_state);
 }
@@ -4168,6 +4420,9 @@ lunar_file_compare_by_name (const LunarFile *file_a,
   _lunar_return_val_if_fail (LUNAR_IS_FILE (file_b), 0);
 #endif
 
+  lunar_file_ensure_collate_keys ((LunarFile *) file_a);
+  lunar_file_ensure_collate_keys ((LunarFile *) file_b);
+
   /* case insensitive checking */
   if (G_LIKELY (!case_sensitive))
     result = g_strcmp0 (file_a->collate_key_nocase, file_b->collate_key_nocase);
@@ -4235,30 +4490,27 @@ lunar_file_same_filesystem (const LunarFile *file_a,
 LunarFile *
 lunar_file_cache_lookup (const GFile *file)
 {
-  GWeakRef   *ref;
-  LunarFile *cached_file;
+  LunarFileCacheShard *shard;
+  GWeakRef             *ref;
+  LunarFile           *cached_file;
 
   _lunar_return_val_if_fail (G_IS_FILE (file), NULL);
 
-  G_LOCK (file_cache_mutex);
+  shard = lunar_file_cache_lock (file);
 
-  /* allocate the LunarFile cache on-demand */
-  if (G_UNLIKELY (file_cache == NULL))
-    {
-      file_cache = g_hash_table_new_full (g_file_hash,
-                                          (GEqualFunc) g_file_equal,
-                                          (GDestroyNotify) g_object_unref,
-                                          (GDestroyNotify) weak_ref_free);
-    }
-
-  ref = g_hash_table_lookup (file_cache, file);
+  ref = g_hash_table_lookup (shard->table, file);
 
   if (ref == NULL)
     cached_file = NULL;
   else
     cached_file = g_weak_ref_get (ref);
 
-  G_UNLOCK (file_cache_mutex);
+  if (cached_file != NULL)
+    shard->n_hits++;
+  else
+    shard->n_misses++;
+
+  g_mutex_unlock (&shard->lock);
 
   return cached_file;
 }
@@ -183,7 +183,10 @@ LunarGroup      *lunar_file_get_group                  (const LunarFile       *f
 LunarUser       *lunar_file_get_user                   (const LunarFile       *file);
 
 const gchar      *lunar_file_get_content_type           (LunarFile             *file);
-gboolean          lunar_file_load_content_type          (LunarFile             *file);
+gboolean          lunar_file_has_content_type           (const LunarFile       *file);
+void              lunar_file_guess_content_type         (LunarFile             *file);
+void              lunar_file_set_content_type           (LunarFile             *file,
+                                                          const gchar            *content_type);
 const gchar      *lunar_file_get_symlink_target         (const LunarFile       *file);
 const gchar      *lunar_file_get_basename               (const LunarFile       *file) G_GNUC_CONST;
 gboolean          lunar_file_is_symlink                 (const LunarFile       *file);
@@ -28,9 +28,22 @@
 #include <lunar/lunar-io-jobs.h>
 #include <lunar/lunar-job.h>
 #include <lunar/lunar-private.h>
+#include <lunar/lunar-size-cache.h>
 
 #define DEBUG_FILE_CHANGES FALSE
 
+/* window in milliseconds in which monitor events are collected, it
+ * doubles while event storms continue and falls back once it calms */
+#define FOLDER_MONITOR_MIN_DELAY    50
+#define FOLDER_MONITOR_MAX_DELAY    800
+#define FOLDER_MONITOR_BURST_EVENTS 64
+
+/* content types are sniffed by a small pool shared by all folders */
+#define CONTENT_TYPE_MAX_THREADS 4
+
+/* number of files handed to the pool per idle iteration */
+#define CONTENT_TYPE_CHUNK_SIZE  256
+
 
 
 /* property identifiers */
@@ -83,6 +96,11 @@ static void     lunar_folder_monitor                     (GFileMonitor
                                                            GFile                  *other_file,
                                                            GFileMonitorEvent       event_type,
                                                            gpointer                user_data);
+static gboolean lunar_folder_monitor_flush               (gpointer                user_data);
+
+
+
+typedef struct _LunarFolderContentType LunarFolderContentType;
 
 
 
@@ -107,18 +125,57 @@ struct _LunarFolder
   LunarJob         *job;
 
   LunarFile        *corresponding_file;
-  GList             *new_files;
   GList             *files;
+
+  /* the files listed by the job so far, only while reloading a
+   * folder that had files already, to find the removed ones */
+  GHashTable        *listed_files;
   gboolean           reload_info;
 
+  /* LunarFile -> link in files, to find children without walking the list */
+  GHashTable        *files_map;
+
   GList             *content_type_ptr;
   guint              content_type_idle_id;
 
+  /* LunarFile -> LunarFolderContentType handed to the pool */
+  GHashTable        *content_type_pending;
+  GCancellable      *content_type_cancellable;
+
   guint              in_destruction : 1;
 
+  /* only the subdirectories are listed, for the tree pane */
+  guint              directories_only : 1;
+
   LunarFileMonitor *file_monitor;
+  LunarSizeCache   *size_cache;
 
   GFileMonitor      *monitor;
+
+  /* GFile -> last GFileMonitorEvent of children, not handled yet */
+  GHashTable        *monitor_events;
+  guint              monitor_timer_id;
+  guint              monitor_delay;
+};
+
+
+
+struct _LunarFolderContentType
+{
+  /* only valid while cancellable is not cancelled */
+  LunarFolder *folder;
+
+  LunarFile   *file;
+  GFile        *location;
+  guint64       mtime;
+  GCancellable *cancellable;
+
+  /* the position in one of the queues, protected by content_type_lock */
+  GList        *link;
+  gboolean      visible;
+
+  /* the interned result, or NULL if sniffing failed */
+  const gchar  *content_type;
 };
 
 
@@ -126,6 +183,15 @@ struct _LunarFolder
 static guint  folder_signals[LAST_SIGNAL];
 static GQuark lunar_folder_quark;
 
+/* the content type requests of all folders, the pool
+ * takes those for visible files first */
+static GMutex       content_type_lock;
+static GQueue       content_type_visible = G_QUEUE_INIT;
+static GQueue       content_type_queue = G_QUEUE_INIT;
+static GSList      *content_type_results = NULL;
+static guint        content_type_results_id = 0;
+static GThreadPool *content_type_pool = NULL;
+
 
 
 G_DEFINE_TYPE (LunarFolder, lunar_folder, G_TYPE_OBJECT)
@@ -271,7 +337,17 @@ lunar_folder_init (LunarFolder *folder)
   g_signal_connect (G_OBJECT (folder->file_monitor), "file-changed", G_CALLBACK (lunar_folder_file_changed), folder);
   g_signal_connect (G_OBJECT (folder->file_monitor), "file-destroyed", G_CALLBACK (lunar_folder_file_destroyed), folder);
 
+  folder->size_cache = lunar_size_cache_get_default ();
+
+  folder->files_map = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  folder->content_type_pending = g_hash_table_new (g_direct_hash, g_direct_equal);
+  folder->content_type_cancellable = g_cancellable_new ();
+
   folder->monitor = NULL;
+  folder->monitor_events = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal, g_object_unref, NULL);
+  folder->monitor_timer_id = 0;
+  folder->monitor_delay = FOLDER_MONITOR_MIN_DELAY;
   folder->reload_info = FALSE;
 }
 
@@ -306,6 +382,8 @@ lunar_folder_finalize (GObject *object)
   g_signal_handlers_disconnect_matched (folder->file_monitor, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, folder);
   g_object_unref (folder->file_monitor);
 
+  g_object_unref (folder->size_cache);
+
   /* disconnect from the file alteration monitor */
   if (G_LIKELY (folder->monitor != NULL))
     {
@@ -314,6 +392,11 @@ lunar_folder_finalize (GObject *object)
       g_object_unref (folder->monitor);
     }
 
+  /* drop the events not handled yet */
+  if (folder->monitor_timer_id != 0)
+    g_source_remove (folder->monitor_timer_id);
+  g_hash_table_destroy (folder->monitor_events);
+
   /* cancel the pending job (if any) */
   if (G_UNLIKELY (folder->job != NULL))
     {
@@ -334,10 +417,17 @@ lunar_folder_finalize (GObject *object)
   if (folder->content_type_idle_id != 0)
     g_source_remove (folder->content_type_idle_id);
 
-  /* release references to the new files */
-  lunar_g_file_list_free (folder->new_files);
+  /* the pending requests must no longer touch the folder */
+  g_cancellable_cancel (folder->content_type_cancellable);
+  g_object_unref (folder->content_type_cancellable);
+  g_hash_table_destroy (folder->content_type_pending);
+
+  /* release references to the listed files */
+  if (folder->listed_files != NULL)
+    g_hash_table_destroy (folder->listed_files);
 
   /* release references to the current files */
+  g_hash_table_destroy (folder->files_map);
   lunar_g_file_list_free (folder->files);
 
   (*G_OBJECT_CLASS (lunar_folder_parent_class)->finalize) (object);
@@ -421,16 +511,90 @@ lunar_folder_error (EndoJob       *job,
 
 
 
+/* prepends file to the files list, taking over the reference */
+static void
+lunar_folder_files_insert (LunarFolder *folder,
+                           LunarFile   *file)
+{
+  folder->files = g_list_prepend (folder->files, file);
+  g_hash_table_insert (folder->files_map, file, folder->files);
+}
+
+
+
+/* returns the link of the child with the given location, or NULL. The
+ * map is keyed by the LunarFile, because a file keeps its instance but
+ * changes its location when it is moved */
+static GList *
+lunar_folder_files_lookup (LunarFolder *folder,
+                           GFile       *gfile)
+{
+  LunarFile *file;
+  GList      *lp = NULL;
+
+  /* the cache knows all our files, since we hold a reference */
+  file = lunar_file_cache_lookup (gfile);
+  if (file != NULL)
+    {
+      lp = g_hash_table_lookup (folder->files_map, file);
+      g_object_unref (file);
+    }
+
+  return lp;
+}
+
+
+
+/* unlinks lp from the files list, the reference is left to the caller */
+static void
+lunar_folder_files_remove (LunarFolder *folder,
+                           GList       *lp)
+{
+  g_hash_table_remove (folder->files_map, lp->data);
+  folder->files = g_list_delete_link (folder->files, lp);
+}
+
+
+
 static gboolean
 lunar_folder_files_ready (LunarJob    *job,
                            GList        *files,
                            LunarFolder *folder)
 {
+  GList *added = NULL;
+  GList *lp;
+
   _lunar_return_val_if_fail (LUNAR_IS_FOLDER (folder), FALSE);
   _lunar_return_val_if_fail (LUNAR_IS_JOB (job), FALSE);
 
-  /* merge the list with the existing list of new files */
-  folder->new_files = g_list_concat (folder->new_files, files);
+  /* the job sends the files in chunks while listing, add the
+   * files we don't know yet right away so the views fill up */
+  for (lp = files; lp != NULL; lp = lp->next)
+    {
+      if (folder->listed_files != NULL)
+        g_hash_table_add (folder->listed_files, g_object_ref (lp->data));
+
+      if (!g_hash_table_contains (folder->files_map, lp->data))
+        {
+          /* add to the internal files list, the reference moves along */
+          added = g_list_prepend (added, lp->data);
+          lunar_folder_files_insert (folder, lp->data);
+          lp->data = NULL;
+        }
+    }
+
+  if (added != NULL)
+    {
+      /* emit a "files-added" signal for the added files */
+      g_signal_emit (G_OBJECT (folder), folder_signals[FILES_ADDED], 0, added);
+      g_list_free (added);
+    }
+
+  /* release the files we already knew */
+  for (lp = files; lp != NULL; lp = lp->next)
+    if (lp->data != NULL)
+      g_object_unref (lp->data);
+  g_list_free (files);
 
   /* indicate that we took over ownership of the file list */
   return TRUE;
@@ -438,32 +602,199 @@ lunar_folder_files_ready (LunarJob    *job,
 
 
 
+static void
+lunar_folder_content_type_free (LunarFolderContentType *request)
+{
+  g_object_unref (request->file);
+  g_object_unref (request->location);
+  g_object_unref (request->cancellable);
+  g_slice_free (LunarFolderContentType, request);
+}
+
+
+
+static gboolean
+lunar_folder_content_type_deliver (gpointer user_data)
+{
+  LunarFolderContentType *request;
+  GSList                  *results;
+  GSList                  *lp;
+
+  g_mutex_lock (&content_type_lock);
+  results = content_type_results;
+  content_type_results = NULL;
+  content_type_results_id = 0;
+  g_mutex_unlock (&content_type_lock);
+
+  for (lp = results; lp != NULL; lp = lp->next)
+    {
+      request = lp->data;
+
+      if (!g_cancellable_is_cancelled (request->cancellable))
+        g_hash_table_remove (request->folder->content_type_pending, request->file);
+
+      /* the result is still valid if the file did not change meanwhile,
+       * otherwise this drops the guess and the type is sniffed on demand */
+      if (lunar_file_get_date (request->file, LUNAR_FILE_DATE_MODIFIED) == request->mtime)
+        lunar_file_set_content_type (request->file, request->content_type);
+      else
+        lunar_file_set_content_type (request->file, NULL);
+
+      lunar_folder_content_type_free (request);
+    }
+  g_slist_free (results);
+
+  return FALSE;
+}
+
+
+
+static void
+lunar_folder_content_type_worker (gpointer data,
+                                  gpointer user_data)
+{
+  LunarFolderContentType *request = NULL;
+  const gchar             *content_type;
+  GFileInfo               *info;
+  GList                   *link;
+
+  /* take the next request, those for visible files first */
+  g_mutex_lock (&content_type_lock);
+  link = g_queue_pop_head_link (&content_type_visible);
+  if (link == NULL)
+    link = g_queue_pop_head_link (&content_type_queue);
+  if (link != NULL)
+    {
+      request = link->data;
+      request->link = NULL;
+      g_list_free_1 (link);
+    }
+  g_mutex_unlock (&content_type_lock);
+
+  if (G_UNLIKELY (link == NULL))
+    return;
+
+  if (!g_cancellable_is_cancelled (request->cancellable))
+    {
+      info = g_file_query_info (request->location,
+                                G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
+                                G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE,
+                                G_FILE_QUERY_INFO_NONE,
+                                request->cancellable, NULL);
+      if (G_LIKELY (info != NULL))
+        {
+          content_type = g_file_info_get_content_type (info);
+          if (G_UNLIKELY (content_type == NULL))
+            content_type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+          if (G_LIKELY (content_type != NULL))
+            request->content_type = g_intern_string (content_type);
+          g_object_unref (info);
+        }
+    }
+
+  /* hand the result to the main loop, together with the others
+   * finished before the main loop got to them */
+  g_mutex_lock (&content_type_lock);
+  content_type_results = g_slist_prepend (content_type_results, request);
+  if (content_type_results_id == 0)
+    content_type_results_id = g_idle_add_full (G_PRIORITY_LOW, lunar_folder_content_type_deliver, NULL, NULL);
+  g_mutex_unlock (&content_type_lock);
+}
+
+
+
+/* hands file to the pool, unless its content type is known or requested
+ * already. Returns %TRUE if a new request was queued */
+static gboolean
+lunar_folder_content_type_request (LunarFolder *folder,
+                                   LunarFile   *file,
+                                   gboolean     visible)
+{
+  LunarFolderContentType *request;
+
+  if (lunar_file_has_content_type (file))
+    return FALSE;
+
+  /* move a queued request before the invisible ones */
+  request = g_hash_table_lookup (folder->content_type_pending, file);
+  if (request != NULL)
+    {
+      if (visible && !request->visible)
+        {
+          g_mutex_lock (&content_type_lock);
+          if (request->link != NULL)
+            {
+              g_queue_unlink (&content_type_queue, request->link);
+              g_queue_push_head_link (&content_type_visible, request->link);
+              request->visible = TRUE;
+            }
+          g_mutex_unlock (&content_type_lock);
+        }
+
+      return FALSE;
+    }
+
+  /* directories need no sniffing */
+  if (lunar_file_is_directory (file))
+    {
+      lunar_file_get_content_type (file);
+      return FALSE;
+    }
+
+  if (G_UNLIKELY (content_type_pool == NULL))
+    content_type_pool = g_thread_pool_new (lunar_folder_content_type_worker, NULL,
+                                           CONTENT_TYPE_MAX_THREADS, FALSE, NULL);
+
+  request = g_slice_new0 (LunarFolderContentType);
+  request->folder = folder;
+  request->file = g_object_ref (file);
+  request->location = g_object_ref (lunar_file_get_file (file));
+  request->mtime = lunar_file_get_date (file, LUNAR_FILE_DATE_MODIFIED);
+  request->cancellable = g_object_ref (folder->content_type_cancellable);
+  request->visible = visible;
+  g_hash_table_insert (folder->content_type_pending, file, request);
+
+  /* rows drawn meanwhile use the type matching the name */
+  lunar_file_guess_content_type (file);
+
+  g_mutex_lock (&content_type_lock);
+  request->link = g_list_alloc ();
+  request->link->data = request;
+  if (visible)
+    g_queue_push_head_link (&content_type_visible, request->link);
+  else
+    g_queue_push_tail_link (&content_type_queue, request->link);
+  g_mutex_unlock (&content_type_lock);
+
+  /* every push lets a worker take one request from the queues */
+  g_thread_pool_push (content_type_pool, GUINT_TO_POINTER (1), NULL);
+
+  return TRUE;
+}
+
+
+
 static gboolean
 lunar_folder_content_type_loader_idle (gpointer data)
 {
   LunarFolder *folder;
   GList        *lp;
+  guint         n = 0;
 
   _lunar_return_val_if_fail (LUNAR_IS_FOLDER (data), FALSE);
 
   folder = LUNAR_FOLDER (data);
 
-  /* load another files content type */
-  for (lp = folder->content_type_ptr; lp != NULL; lp = lp->next)
-    if (lunar_file_load_content_type (lp->data))
-      {
-        /* if this was the last file, abort */
-        if (G_UNLIKELY (lp->next == NULL))
-          break;
+  /* queue the next chunk of files for the pool */
+  for (lp = folder->content_type_ptr; lp != NULL && n < CONTENT_TYPE_CHUNK_SIZE; lp = lp->next)
+    if (lunar_folder_content_type_request (folder, lp->data, FALSE))
+      n++;
 
-        /* set pointer to next file for the next iteration */
-        folder->content_type_ptr = lp->next;
+  /* set pointer to next file for the next iteration */
+  folder->content_type_ptr = lp;
 
-        return TRUE;
-      }
-
-  /* all content types loaded */
-  return FALSE;
+  /* stop when all files are queued */
+  return lp != NULL;
 }
 
 
@@ -501,57 +832,40 @@ lunar_folder_finished (EndoJob       *job,
   LunarFile *file;
   GList      *files;
   GList      *lp;
+  GList      *lnext;
 
   _lunar_return_if_fail (LUNAR_IS_FOLDER (folder));
   _lunar_return_if_fail (LUNAR_IS_JOB (job));
   _lunar_return_if_fail (LUNAR_IS_FILE (folder->corresponding_file));
   _lunar_return_if_fail (folder->content_type_idle_id == 0);
 
-  /* check if we need to merge new files with existing files */
-  if (G_UNLIKELY (folder->files != NULL))
+  /* the files were added by lunar_folder_files_ready(), check
+   * if any files are gone since the folder was listed before */
+  if (G_UNLIKELY (folder->listed_files != NULL))
     {
-      /* determine all added files (files on new_files, but not on files) */
-      for (files = NULL, lp = folder->new_files; lp != NULL; lp = lp->next)
-        if (g_list_find (folder->files, lp->data) == NULL)
-          {
-            /* put the file on the added list */
-            files = g_list_prepend (files, lp->data);
-
-            /* add to the internal files list */
-            folder->files = g_list_prepend (folder->files, lp->data);
-            g_object_ref (G_OBJECT (lp->data));
-          }
-
-      /* check if any files were added */
-      if (G_UNLIKELY (files != NULL))
-        {
-          /* emit a "files-added" signal for the added files */
-          g_signal_emit (G_OBJECT (folder), folder_signals[FILES_ADDED], 0, files);
-
-          /* release the added files list */
-          g_list_free (files);
-        }
-
-      /* determine all removed files (files on files, but not on new_files) */
-      for (files = NULL, lp = folder->files; lp != NULL; )
+      /* determine all removed files (files on files, but not listed) */
+      for (files = NULL, lp = folder->files; lp != NULL; lp = lnext)
         {
           /* determine the file */
           file = LUNAR_FILE (lp->data);
 
           /* determine the next list item */
-          lp = lp->next;
+          lnext = lp->next;
 
-          /* check if the file is not on new_files */
-          if (g_list_find (folder->new_files, file) == NULL)
+          /* check if the file was not listed */
+          if (!g_hash_table_contains (folder->listed_files, file))
             {
               /* put the file on the removed list (owns the reference now) */
               files = g_list_prepend (files, file);
 
               /* remove from the internal files list */
-              folder->files = g_list_remove (folder->files, file);
+              lunar_folder_files_remove (folder, lp);
             }
         }
 
+      g_hash_table_destroy (folder->listed_files);
+      folder->listed_files = NULL;
+
       /* check if any files were removed */
       if (G_UNLIKELY (files != NULL))
         {
@@ -561,22 +875,6 @@ lunar_folder_finished (EndoJob       *job,
           /* release the removed files list */
           lunar_g_file_list_free (files);
         }
-
-      /* drop the temporary new_files list */
-      lunar_g_file_list_free (folder->new_files);
-      folder->new_files = NULL;
-    }
-  else
-    {
-      /* just use the new files for the files list */
-      folder->files = folder->new_files;
-      folder->new_files = NULL;
-
-      if (folder->files != NULL)
-        {
-          /* emit a "files-added" signal for the new files */
-          g_signal_emit (G_OBJECT (folder), folder_signals[FILES_ADDED], 0, folder->files);
-        }
     }
 
   /* schedule a reload of the file information of all files if requested */
@@ -651,14 +949,14 @@ lunar_folder_file_destroyed (LunarFileMonitor *file_monitor,
   else
     {
       /* check if we have that file */
-      lp = g_list_find (folder->files, file);
+      lp = g_hash_table_lookup (folder->files_map, file);
       if (G_LIKELY (lp != NULL))
         {
           if (folder->content_type_idle_id != 0)
             restart = g_source_remove (folder->content_type_idle_id);
 
           /* remove the file from our list */
-          folder->files = g_list_delete_link (folder->files, lp);
+          lunar_folder_files_remove (folder, lp);
 
           /* tell everybody that the file is gone */
           files.data = file; files.next = files.prev = NULL;
@@ -733,6 +1031,141 @@ lunar_file_infos_equal (LunarFile *file,
 
 
 
+/* handles the collected events of the children in one go, so an event
+ * storm results in a single "files-added" and "files-removed" */
+static gboolean
+lunar_folder_monitor_flush (gpointer user_data)
+{
+  LunarFolder    *folder = LUNAR_FOLDER (user_data);
+  GHashTableIter   iter;
+  LunarFile      *file;
+  LunarFile      *destroyed;
+  GFile           *event_file;
+  gpointer         event_type;
+  GList           *added = NULL;
+  GList           *removed = NULL;
+  GList           *changed = NULL;
+  GList           *lp;
+  gboolean         restart = FALSE;
+  guint            n_events;
+
+  folder->monitor_timer_id = 0;
+
+  n_events = g_hash_table_size (folder->monitor_events);
+  if (G_UNLIKELY (n_events == 0))
+    return FALSE;
+
+  /* keep the window open longer while the storm goes on */
+  if (n_events >= FOLDER_MONITOR_BURST_EVENTS)
+    folder->monitor_delay = MIN (folder->monitor_delay * 2, FOLDER_MONITOR_MAX_DELAY);
+  else
+    folder->monitor_delay = FOLDER_MONITOR_MIN_DELAY;
+
+  /* the handlers of our signals might drop the last reference */
+  g_object_ref (G_OBJECT (folder));
+
+  /* stop the content type collector */
+  if (folder->content_type_idle_id != 0)
+    restart = g_source_remove (folder->content_type_idle_id);
+
+  /* only the last event of every file matters, so a file that was created
+   * and deleted again is dropped, and repeated changes reload it once */
+  g_hash_table_iter_init (&iter, folder->monitor_events);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &event_file, &event_type))
+    {
+      lp = lunar_folder_files_lookup (folder, event_file);
+      if (GPOINTER_TO_UINT (event_type) == G_FILE_MONITOR_EVENT_DELETED)
+        {
+          if (lp != NULL)
+            {
+              /* the removed list owns our reference now */
+              removed = g_list_prepend (removed, lp->data);
+              lunar_folder_files_remove (folder, lp);
+            }
+        }
+      else if (lp != NULL)
+        {
+#if DEBUG_FILE_CHANGES
+          lunar_file_infos_equal (lp->data, event_file);
+#endif
+          changed = g_list_prepend (changed, g_object_ref (lp->data));
+        }
+      else
+        {
+          /* allocate a file for the path */
+          file = lunar_file_get (event_file, NULL);
+          if (G_UNLIKELY (file == NULL))
+            continue;
+
+          if (G_UNLIKELY (g_hash_table_contains (folder->files_map, file)))
+            {
+              changed = g_list_prepend (changed, file);
+            }
+          else if (folder->directories_only && !lunar_file_is_directory (file))
+            {
+              g_object_unref (file);
+            }
+          else
+            {
+              /* prepend it to our internal list */
+              lunar_folder_files_insert (folder, file);
+              added = g_list_prepend (added, file);
+            }
+        }
+    }
+  g_hash_table_remove_all (folder->monitor_events);
+
+  if (added != NULL)
+    {
+      /* tell others about the new files */
+      g_signal_emit (G_OBJECT (folder), folder_signals[FILES_ADDED], 0, added);
+
+      /* load the new files */
+      for (lp = added; lp != NULL; lp = lp->next)
+        lunar_file_reload (lp->data);
+      g_list_free (added);
+    }
+
+  if (removed != NULL)
+    {
+      /* tell everybody that the files are gone */
+      g_signal_emit (G_OBJECT (folder), folder_signals[FILES_REMOVED], 0, removed);
+
+      for (lp = removed; lp != NULL; lp = lp->next)
+        {
+          event_file = g_object_ref (lunar_file_get_file (lp->data));
+
+          /* destroy the file */
+          lunar_file_destroy (lp->data);
+
+          /* if the file has not been destroyed by now, reload it to invalidate it */
+          destroyed = lunar_file_cache_lookup (event_file);
+          if (destroyed != NULL)
+            {
+              lunar_file_reload (destroyed);
+              g_object_unref (destroyed);
+            }
+
+          g_object_unref (event_file);
+        }
+      lunar_g_file_list_free (removed);
+    }
+
+  for (lp = changed; lp != NULL; lp = lp->next)
+    lunar_file_reload (lp->data);
+  lunar_g_file_list_free (changed);
+
+  /* check if we need to restart the collector */
+  if (restart)
+    lunar_folder_content_type_loader (folder);
+
+  g_object_unref (G_OBJECT (folder));
+
+  return FALSE;
+}
+
+
+
 static void
 lunar_folder_monitor (GFileMonitor     *monitor,
                        GFile            *event_file,
@@ -753,27 +1186,51 @@ lunar_folder_monitor (GFileMonitor     *monitor,
   _lunar_return_if_fail (LUNAR_IS_FILE (folder->corresponding_file));
   _lunar_return_if_fail (G_IS_FILE (event_file));
 
+  /* the subtree totals of the file and all its parents are outdated */
+  lunar_size_cache_invalidate (folder->size_cache, event_file);
+  if (other_file != NULL)
+    lunar_size_cache_invalidate (folder->size_cache, other_file);
+
   /* check on which file the event occurred */
   if (!g_file_equal (event_file, lunar_file_get_file (folder->corresponding_file)))
     {
+      /* collect all events but moves, which also involve other_file */
+      if (event_type != G_FILE_MONITOR_EVENT_RENAMED
+          && event_type != G_FILE_MONITOR_EVENT_MOVED_IN
+          && event_type != G_FILE_MONITOR_EVENT_MOVED_OUT)
+        {
+          g_hash_table_insert (folder->monitor_events, g_object_ref (event_file),
+                               GUINT_TO_POINTER (event_type));
+          if (folder->monitor_timer_id == 0)
+            folder->monitor_timer_id = g_timeout_add (folder->monitor_delay, lunar_folder_monitor_flush, folder);
+          return;
+        }
+
+      /* handle the collected events first, to keep the order */
+      if (folder->monitor_timer_id != 0)
+        {
+          g_source_remove (folder->monitor_timer_id);
+          lunar_folder_monitor_flush (folder);
+        }
+
       /* check if we already ship the file */
-      for (lp = folder->files; lp != NULL; lp = lp->next)
-        if (g_file_equal (event_file, lunar_file_get_file (lp->data)))
-          break;
+      lp = lunar_folder_files_lookup (folder, event_file);
 
       /* stop the content type collector */
       if (folder->content_type_idle_id != 0)
         restart = g_source_remove (folder->content_type_idle_id);
 
-      /* if we don't have it, add it if the event is not an "deleted" event */
-      if (G_UNLIKELY (lp == NULL && event_type != G_FILE_MONITOR_EVENT_DELETED))
+      /* if we don't have it, add it */
+      if (G_UNLIKELY (lp == NULL))
         {
           /* allocate a file for the path */
           file = lunar_file_get (event_file, NULL);
+          if (G_UNLIKELY (file != NULL && folder->directories_only && !lunar_file_is_directory (file)))
+            g_clear_object (&file);
           if (G_UNLIKELY (file != NULL))
             {
               /* prepend it to our internal list */
-              folder->files = g_list_prepend (folder->files, file);
+              lunar_folder_files_insert (folder, file);
 
               /* tell others about the new file */
               list.data = file; list.next = list.prev = NULL;
@@ -783,63 +1240,36 @@ lunar_folder_monitor (GFileMonitor     *monitor,
               lunar_file_reload (file);
             }
         }
-      else if (lp != NULL)
+      else
         {
-          if (event_type == G_FILE_MONITOR_EVENT_DELETED)
-            {
-              LunarFile *destroyed;
-
-              /* destroy the file */
-              lunar_file_destroy (lp->data);
-
-              /* if the file has not been destroyed by now, reload it to invalidate it */
-              destroyed = lunar_file_cache_lookup (event_file);
-              if (destroyed != NULL)
-                {
-                  lunar_file_reload (destroyed);
-                  g_object_unref (destroyed);
-                }
-            }
-          else if (event_type == G_FILE_MONITOR_EVENT_RENAMED ||
-                   event_type == G_FILE_MONITOR_EVENT_MOVED_IN ||
-                   event_type == G_FILE_MONITOR_EVENT_MOVED_OUT)
+          /* destroy the old file and update the new one */
+          lunar_file_destroy (lp->data);
+          if (other_file != NULL)
             {
-              /* destroy the old file and update the new one */
-              lunar_file_destroy (lp->data);
-              if (other_file != NULL)
+              file = lunar_file_get(other_file, NULL);
+              if (file != NULL && LUNAR_IS_FILE (file))
                 {
-                  file = lunar_file_get(other_file, NULL);
-                  if (file != NULL && LUNAR_IS_FILE (file))
+                  if (lunar_file_reload (file))
                     {
-                      if (lunar_file_reload (file))
+                      /* if source and target folders are different, also tell
+                         the target folder to reload for the changes */
+                      if (lunar_file_has_parent (file))
                         {
-                          /* if source and target folders are different, also tell
-                             the target folder to reload for the changes */
-                          if (lunar_file_has_parent (file))
+                          other_parent = lunar_file_get_parent (file, NULL);
+                          if (other_parent &&
+                              !g_file_equal (lunar_file_get_file(folder->corresponding_file),
+                                             lunar_file_get_file(other_parent)))
                             {
-                              other_parent = lunar_file_get_parent (file, NULL);
-                              if (other_parent &&
-                                  !g_file_equal (lunar_file_get_file(folder->corresponding_file),
-                                                 lunar_file_get_file(other_parent)))
-                                {
-                                  lunar_file_reload (other_parent);
-                                  g_object_unref (other_parent);
-                                }
+                              lunar_file_reload (other_parent);
+                              g_object_unref (other_parent);
                             }
                         }
-
-                      /* drop reference on the other file */
-                      g_object_unref (file);
                     }
+
+                  /* drop reference on the other file */
+                  g_object_unref (file);
                 }
             }
-          else
-            {
-#if DEBUG_FILE_CHANGES
-              lunar_file_infos_equal (lp->data, event_file);
-#endif
-              lunar_file_reload (lp->data);
-            }
         }
 
       /* check if we need to restart the collector */
@@ -863,22 +1293,9 @@ lunar_folder_monitor (GFileMonitor     *monitor,
 
 
 
-/**
- * lunar_folder_get_for_file:
- * @file : a #LunarFile.
- *
- * Opens the specified @file as #LunarFolder and
- * returns a reference to the folder.
- *
- * The caller is responsible to free the returned
- * object using g_object_unref() when no longer
- * needed.
- *
- * Return value: the #LunarFolder which corresponds
- *               to @file.
- **/
-LunarFolder*
-lunar_folder_get_for_file (LunarFile *file)
+static LunarFolder*
+lunar_folder_get_for_file_internal (LunarFile *file,
+                                    gboolean   directories_only)
 {
   LunarFolder *folder;
 
@@ -903,11 +1320,19 @@ lunar_folder_get_for_file (LunarFile *file)
   if (G_UNLIKELY (folder != NULL))
     {
       g_object_ref (G_OBJECT (folder));
+
+      /* list the other files too, the folders are kept */
+      if (folder->directories_only && !directories_only)
+        {
+          folder->directories_only = FALSE;
+          lunar_folder_reload (folder, FALSE);
+        }
     }
   else
     {
       /* allocate the new instance */
       folder = g_object_new (LUNAR_TYPE_FOLDER, "corresponding-file", file, NULL);
+      folder->directories_only = directories_only;
 
       /* connect the folder to the file */
       g_object_set_qdata (G_OBJECT (file), lunar_folder_quark, folder);
@@ -921,6 +1346,53 @@ lunar_folder_get_for_file (LunarFile *file)
 
 
 
+/**
+ * lunar_folder_get_for_file:
+ * @file : a #LunarFile.
+ *
+ * Opens the specified @file as #LunarFolder and
+ * returns a reference to the folder.
+ *
+ * The caller is responsible to free the returned
+ * object using g_object_unref() when no longer
+ * needed.
+ *
+ * Return value: the #LunarFolder which corresponds
+ *               to @file.
+ **/
+LunarFolder*
+lunar_folder_get_for_file (LunarFile *file)
+{
+  return lunar_folder_get_for_file_internal (file, FALSE);
+}
+
+
+
+/**
+ * lunar_folder_get_directories_for_file:
+ * @file : a #LunarFile.
+ *
+ * Like lunar_folder_get_for_file(), but if @file is not opened as
+ * #LunarFolder yet, only its subdirectories are listed and watched.
+ * If the folder is opened with lunar_folder_get_for_file() later,
+ * the other files are added. The files of the returned folder
+ * must therefore still be checked with lunar_file_is_directory().
+ *
+ * The caller is responsible to free the returned
+ * object using g_object_unref() when no longer
+ * needed.
+ *
+ * Return value: the #LunarFolder which corresponds
+ *               to @file.
+ **/
+LunarFolder*
+lunar_folder_get_directories_for_file (LunarFile *file)
+{
+  return lunar_folder_get_for_file_internal (file, TRUE);
+}
+
+
+
 /**
  * lunar_folder_get_corresponding_file:
  * @folder : a #LunarFolder instance.
@@ -995,6 +1467,28 @@ lunar_folder_has_folder_monitor (const LunarFolder *folder)
 
 
 
+/**
+ * lunar_folder_load_content_types:
+ * @folder : a #LunarFolder instance.
+ * @files  : a list of #LunarFile<!---->s in @folder.
+ *
+ * Tells @folder that @files are visible to the user, so their
+ * content types are determined before those of the other files.
+ **/
+void
+lunar_folder_load_content_types (LunarFolder *folder,
+                                 GList       *files)
+{
+  GList *lp;
+
+  _lunar_return_if_fail (LUNAR_IS_FOLDER (folder));
+
+  for (lp = files; lp != NULL; lp = lp->next)
+    lunar_folder_content_type_request (folder, lp->data, TRUE);
+}
+
+
+
 /**
  * lunar_folder_reload:
  * @folder : a #LunarFolder instance.
@@ -1025,12 +1519,18 @@ lunar_folder_reload (LunarFolder *folder,
       folder->job = NULL;
     }
 
-  /* reset the new_files list */
-  lunar_g_file_list_free (folder->new_files);
-  folder->new_files = NULL;
+  /* remember which files are listed again, if we have any */
+  if (folder->listed_files != NULL)
+    g_hash_table_destroy (folder->listed_files);
+  folder->listed_files = NULL;
+  if (folder->files != NULL)
+    folder->listed_files = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
 
   /* start a new job */
-  folder->job = lunar_io_jobs_list_directory (lunar_file_get_file (folder->corresponding_file));
+  if (folder->directories_only)
+    folder->job = lunar_io_jobs_list_directories (lunar_file_get_file (folder->corresponding_file));
+  else
+    folder->job = lunar_io_jobs_list_directory (lunar_file_get_file (folder->corresponding_file));
   g_signal_connect (folder->job, "error", G_CALLBACK (lunar_folder_error), folder);
   g_signal_connect (folder->job, "finished", G_CALLBACK (lunar_folder_finished), folder);
   g_signal_connect (folder->job, "files-ready", G_CALLBACK (lunar_folder_files_ready), folder);
@@ -37,12 +37,16 @@ typedef struct _LunarFolder      LunarFolder;
 GType         lunar_folder_get_type               (void) G_GNUC_CONST;
 
 LunarFolder *lunar_folder_get_for_file           (LunarFile         *file);
+LunarFolder *lunar_folder_get_directories_for_file (LunarFile       *file);
 
 LunarFile   *lunar_folder_get_corresponding_file (const LunarFolder *folder);
 GList        *lunar_folder_get_files              (const LunarFolder *folder);
 gboolean      lunar_folder_get_loading            (const LunarFolder *folder);
 gboolean      lunar_folder_has_folder_monitor     (const LunarFolder *folder);
 
+void          lunar_folder_load_content_types     (LunarFolder       *folder,
+                                                    GList              *files);
+
 void          lunar_folder_reload                 (LunarFolder       *folder,
                                                     gboolean            reload_info);
 
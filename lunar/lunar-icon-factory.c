@@ -41,6 +41,25 @@
 /* the timeout until the sweeper is run (in seconds) */
 #define LUNAR_ICON_FACTORY_SWEEP_TIMEOUT (30)
 
+/* decoded icons used this recently are not evicted (in microseconds), so
+ * the rows on screen never fight over a cache that is too small for them */
+#define LUNAR_ICON_FACTORY_MIN_EVICT_AGE (2 * G_USEC_PER_SEC)
+
+/* number of threads decoding previews and thumbnails */
+#define LUNAR_ICON_FACTORY_DECODE_THREADS (2)
+
+/* maximum number of pending decodes, the oldest are cancelled first */
+#define LUNAR_ICON_FACTORY_MAX_REQUESTS (256)
+
+
+
+/* Signal identifiers */
+enum
+{
+  FILE_ICON_READY,
+  LAST_SIGNAL,
+};
+
 
 
 /* Property identifiers */
@@ -51,11 +70,13 @@ enum
   PROP_THUMBNAIL_MODE,
   PROP_THUMBNAIL_DRAW_FRAMES,
   PROP_THUMBNAIL_SIZE,
+  PROP_THUMBNAIL_CACHE_SIZE,
 };
 
 
 
-typedef struct _LunarIconKey LunarIconKey;
+typedef struct _LunarIconKey     LunarIconKey;
+typedef struct _LunarIconRequest LunarIconRequest;
 
 
 
@@ -75,9 +96,16 @@ static gboolean   lunar_icon_factory_changed               (GSignalInvocationHin
                                                              gpointer                  user_data);
 static gboolean   lunar_icon_factory_sweep_timer           (gpointer                  user_data);
 static void       lunar_icon_factory_sweep_timer_destroy   (gpointer                  user_data);
-static GdkPixbuf *lunar_icon_factory_load_from_file        (LunarIconFactory        *factory,
-                                                             const gchar              *path,
-                                                             gint                      size);
+static void       lunar_icon_factory_trim                  (LunarIconFactory        *factory,
+                                                             gsize                     max_size,
+                                                             gboolean                  force);
+#if GLIB_CHECK_VERSION (2, 64, 0)
+static void       lunar_icon_factory_low_memory            (LunarIconFactory        *factory,
+                                                             GMemoryMonitorWarningLevel level);
+#endif
+static GdkPixbuf *lunar_icon_factory_load_from_file        (const gchar              *path,
+                                                             gint                      size,
+                                                             gboolean                  draw_frames);
 static GdkPixbuf *lunar_icon_factory_lookup_icon           (LunarIconFactory        *factory,
                                                              const gchar              *name,
                                                              gint                      size,
@@ -88,6 +116,8 @@ static gboolean   lunar_icon_key_equal                     (gconstpointer
 static void       lunar_icon_key_free                      (gpointer                  data);
 static GdkPixbuf *lunar_icon_factory_load_fallback         (LunarIconFactory        *factory,
                                                              gint                      size);
+static void       lunar_icon_factory_decode_thread         (gpointer                  data,
+                                                             gpointer                  user_data);
 
 
 
@@ -118,6 +148,34 @@ struct _LunarIconFactory
 
   /* stamp that gets bumped when the theme changes */
   guint                theme_stamp;
+
+  /* LunarFile -> LunarIconRequest being decoded in a thread, the
+   * queue holds the same requests, oldest first */
+  GHashTable          *requests;
+  GQueue               requests_queue;
+  GThreadPool         *decode_pool;
+
+  /* decoded requests handed back to the main loop */
+  GMutex               results_lock;
+  GSList              *results;
+  guint                results_idle_id;
+
+  /* stores holding decoded pixbufs, most recently used first; the
+   * lock is recursive since trimming releases stores, and a store is
+   * released in whatever thread drops the last reference on its file */
+  GRecMutex            stored_lock;
+  GQueue               stored;
+  gsize                stored_size;
+  gsize                max_stored_size;
+
+  /* statistics of lunar_icon_factory_load_file_icon() */
+  guint64              n_hits;
+  guint64              n_misses;
+  guint64              n_evictions;
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+  GMemoryMonitor      *memory_monitor;
+#endif
 };
 
 struct _LunarIconKey
@@ -126,6 +184,25 @@ struct _LunarIconKey
   gint   size;
 };
 
+struct _LunarIconRequest
+{
+  LunarIconFactory    *factory;
+  LunarFile           *file;
+  LunarFileIconState   icon_state;
+  LunarFileThumbState  thumb_state;
+  gint                  icon_size;
+  guint                 stamp;
+
+  /* either a loadable preview icon or the path of a thumbnail */
+  GIcon                *gicon;
+  gchar                *path;
+  gboolean              draw_frames;
+
+  GCancellable         *cancellable;
+  GList                 link;
+  GdkPixbuf            *icon;
+};
+
 typedef struct
 {
   LunarFileIconState   icon_state;
@@ -133,6 +210,15 @@ typedef struct
   gint                  icon_size;
   guint                 stamp;
   GdkPixbuf            *icon;
+
+  /* only set for decoded pixbufs, which are not shared
+   * with the icon cache and count against the budget */
+  LunarIconFactory    *factory;
+  LunarFile           *file;
+  GList                 link;
+  gboolean              queued;
+  gsize                 size;
+  gint64                last_used;
 }
 LunarIconStore;
 
@@ -140,6 +226,7 @@ LunarIconStore;
 
 static GQuark lunar_icon_factory_quark = 0;
 static GQuark lunar_icon_factory_store_quark = 0;
+static guint  icon_factory_signals[LAST_SIGNAL];
 
 
 
@@ -217,6 +304,38 @@ lunar_icon_factory_class_init (LunarIconFactoryClass *klass)
                                                       LUNAR_TYPE_THUMBNAIL_SIZE,
                                                       LUNAR_THUMBNAIL_SIZE_NORMAL,
                                                       ENDO_PARAM_READWRITE));
+
+  /**
+   * LunarIconFactory:thumbnail-cache-size:
+   *
+   * The amount of memory in MiB used to keep decoded thumbnails
+   * and previews of files around.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_THUMBNAIL_CACHE_SIZE,
+                                   g_param_spec_uint ("thumbnail-cache-size",
+                                                      "thumbnail-cache-size",
+                                                      "thumbnail-cache-size",
+                                                      1u, G_MAXUINT / 2, 128u,
+                                                      ENDO_PARAM_READWRITE));
+
+  /**
+   * LunarIconFactory::file-icon-ready:
+   * @factory : a #LunarIconFactory.
+   * @file    : the #LunarFile whose icon was decoded.
+   *
+   * Emitted when the preview or thumbnail of @file was decoded in a
+   * thread, so widgets showing @file can redraw it. The next call to
+   * lunar_icon_factory_load_file_icon() for @file returns the decoded
+   * icon.
+   **/
+  icon_factory_signals[FILE_ICON_READY] =
+    g_signal_new (I_("file-icon-ready"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_NO_HOOKS,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__OBJECT,
+                  G_TYPE_NONE, 1, LUNAR_TYPE_FILE);
 }
 
 
@@ -237,6 +356,25 @@ lunar_icon_factory_init (LunarIconFactory *factory)
   /* allocate the hash table for the icon cache */
   factory->icon_cache = g_hash_table_new_full (lunar_icon_key_hash, lunar_icon_key_equal,
                                                lunar_icon_key_free, g_object_unref);
+
+  /* the requests are owned by the decode pool until they are delivered */
+  factory->requests = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_queue_init (&factory->requests_queue);
+  g_mutex_init (&factory->results_lock);
+  factory->decode_pool = g_thread_pool_new (lunar_icon_factory_decode_thread, NULL,
+                                            LUNAR_ICON_FACTORY_DECODE_THREADS,
+                                            FALSE, NULL);
+
+  g_rec_mutex_init (&factory->stored_lock);
+  g_queue_init (&factory->stored);
+  factory->max_stored_size = (gsize) 128 * 1024 * 1024;
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+  /* give back decoded icons when the system runs low on memory */
+  factory->memory_monitor = g_memory_monitor_dup_default ();
+  g_signal_connect_swapped (G_OBJECT (factory->memory_monitor), "low-memory-warning",
+                            G_CALLBACK (lunar_icon_factory_low_memory), factory);
+#endif
 }
 
 
@@ -251,6 +389,17 @@ lunar_icon_factory_dispose (GObject *object)
   if (G_UNLIKELY (factory->sweep_timer_id != 0))
     g_source_remove (factory->sweep_timer_id);
 
+#if GLIB_CHECK_VERSION (2, 64, 0)
+  if (factory->memory_monitor != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (G_OBJECT (factory->memory_monitor), factory);
+      g_clear_object (&factory->memory_monitor);
+    }
+#endif
+
+  /* the stores point back to the factory */
+  lunar_icon_factory_trim (factory, 0, TRUE);
+
   (*G_OBJECT_CLASS (lunar_icon_factory_parent_class)->dispose) (object);
 }
 
@@ -266,6 +415,11 @@ lunar_icon_factory_finalize (GObject *object)
   /* clear the icon cache hash table */
   g_hash_table_destroy (factory->icon_cache);
 
+  /* pending requests keep a reference on the factory, so this is empty */
+  g_thread_pool_free (factory->decode_pool, TRUE, TRUE);
+  g_hash_table_destroy (factory->requests);
+  g_mutex_clear (&factory->results_lock);
+
   /* remove the "changed" emission hook from the GtkIconTheme class */
   g_signal_remove_emission_hook (g_signal_lookup ("changed", GTK_TYPE_ICON_THEME), factory->changed_hook_id);
 
@@ -279,6 +433,9 @@ lunar_icon_factory_finalize (GObject *object)
   /* disconnect from the preferences */
   g_object_unref (G_OBJECT (factory->preferences));
 
+  /* dispose released all decoded stores */
+  g_rec_mutex_clear (&factory->stored_lock);
+
   (*G_OBJECT_CLASS (lunar_icon_factory_parent_class)->finalize) (object);
 }
 
@@ -310,6 +467,10 @@ lunar_icon_factory_get_property (GObject    *object,
       g_value_set_enum (value, factory->thumbnail_size);
       break;
 
+    case PROP_THUMBNAIL_CACHE_SIZE:
+      g_value_set_uint (value, factory->max_stored_size / (1024 * 1024));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -340,6 +501,11 @@ lunar_icon_factory_set_property (GObject      *object,
       factory->thumbnail_size = g_value_get_enum (value);
       break;
 
+    case PROP_THUMBNAIL_CACHE_SIZE:
+      factory->max_stored_size = (gsize) g_value_get_uint (value) * 1024 * 1024;
+      lunar_icon_factory_trim (factory, factory->max_stored_size, FALSE);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -406,6 +572,57 @@ lunar_icon_factory_sweep_timer_destroy (gpointer user_data)
 
 
 
+static void
+lunar_icon_factory_trim (LunarIconFactory *factory,
+                          gsize              max_size,
+                          gboolean           force)
+{
+  LunarIconStore *store;
+  gint64           now = g_get_monotonic_time ();
+
+  g_rec_mutex_lock (&factory->stored_lock);
+
+  while (factory->stored_size > max_size && factory->stored.tail != NULL)
+    {
+      store = factory->stored.tail->data;
+
+      /* everything else was used even more recently */
+      if (!force && now - store->last_used < LUNAR_ICON_FACTORY_MIN_EVICT_AGE)
+        break;
+
+      /* unlink the store here, its file may be finalized in another
+       * thread, which then waits for the lock to release the store */
+      g_queue_unlink (&factory->stored, &store->link);
+      factory->stored_size -= store->size;
+      store->queued = FALSE;
+
+      /* this releases the store, unless the file already does */
+      g_object_set_qdata (G_OBJECT (store->file), lunar_icon_factory_store_quark, NULL);
+      factory->n_evictions++;
+    }
+
+  g_rec_mutex_unlock (&factory->stored_lock);
+}
+
+
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+static void
+lunar_icon_factory_low_memory (LunarIconFactory           *factory,
+                                GMemoryMonitorWarningLevel  level)
+{
+  /* drop a larger part of the decoded icons the worse it gets */
+  if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL)
+    lunar_icon_factory_trim (factory, 0, TRUE);
+  else if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM)
+    lunar_icon_factory_trim (factory, factory->max_stored_size / 4, TRUE);
+  else
+    lunar_icon_factory_trim (factory, factory->max_stored_size / 2, FALSE);
+}
+#endif
+
+
+
 static inline gboolean
 thumbnail_needs_frame (const GdkPixbuf *thumbnail,
                        gint             width,
@@ -457,26 +674,33 @@ static GdkPixbuf*
 lunar_icon_factory_get_thumbnail_frame (void)
 {
   GInputStream *stream;
-  static GdkPixbuf *frame = NULL;
+  GdkPixbuf    *pixbuf = NULL;
+  static gsize  frame = 0;
 
-  if (G_LIKELY (frame != NULL))
-     return frame;
+  /* thumbnails are framed in worker threads too */
+  if (g_once_init_enter (&frame))
+    {
+      stream = g_resources_open_stream ("/com/expidus/lunar/thumbnail-frame.png", 0, NULL);
+      if (G_UNLIKELY (stream != NULL))
+        {
+          pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, NULL);
+          g_object_unref (stream);
+        }
 
-  stream = g_resources_open_stream ("/com/expidus/lunar/thumbnail-frame.png", 0, NULL);
-  if (G_UNLIKELY (stream != NULL)) {
-    frame = gdk_pixbuf_new_from_stream (stream, NULL, NULL);
-    g_object_unref (stream);
-  }
+      /* remember a failure as well, the resource won't appear later */
+      g_once_init_leave (&frame, pixbuf != NULL ? (gsize) pixbuf : 1);
+    }
 
-  return frame;
+  return frame != 1 ? GDK_PIXBUF ((gpointer) frame) : NULL;
 }
 
 
 
+/* may be called from any thread, the factory is not touched */
 static GdkPixbuf*
-lunar_icon_factory_load_from_file (LunarIconFactory *factory,
-                                    const gchar       *path,
-                                    gint               size)
+lunar_icon_factory_load_from_file (const gchar *path,
+                                    gint         size,
+                                    gboolean     draw_frames)
 {
   GdkPixbuf *pixbuf;
   GdkPixbuf *frame;
@@ -487,7 +711,7 @@ lunar_icon_factory_load_from_file (LunarIconFactory *factory,
   gint       width;
   gint       height;
 
-  _lunar_return_val_if_fail (LUNAR_IS_ICON_FACTORY (factory), NULL);
+  _lunar_return_val_if_fail (path != NULL, NULL);
 
   /* try to load the image from the file */
   pixbuf = gdk_pixbuf_new_from_file (path, NULL);
@@ -498,7 +722,7 @@ lunar_icon_factory_load_from_file (LunarIconFactory *factory,
       height = gdk_pixbuf_get_height (pixbuf);
 
       needs_frame = FALSE;
-      if (factory->thumbnail_draw_frames)
+      if (draw_frames)
         {
           /* check if we want to add a frame to the image (we really don't
            * want to do this for icons displayed in the details view).
@@ -533,9 +757,12 @@ lunar_icon_factory_load_from_file (LunarIconFactory *factory,
         {
           /* add a frame to the thumbnail */
           frame = lunar_icon_factory_get_thumbnail_frame ();
-          tmp = endo_gdk_pixbuf_frame (pixbuf, frame, 4, 3, 5, 6);
-          g_object_unref (G_OBJECT (pixbuf));
-          pixbuf = tmp;
+          if (G_LIKELY (frame != NULL))
+            {
+              tmp = endo_gdk_pixbuf_frame (pixbuf, frame, 4, 3, 5, 6);
+              g_object_unref (G_OBJECT (pixbuf));
+              pixbuf = tmp;
+            }
         }
     }
 
@@ -570,7 +797,7 @@ lunar_icon_factory_lookup_icon (LunarIconFactory *factory,
       if (G_UNLIKELY (g_path_is_absolute (name)))
         {
           /* load the file directly */
-          pixbuf = lunar_icon_factory_load_from_file (factory, name, size);
+          pixbuf = lunar_icon_factory_load_from_file (name, size, factory->thumbnail_draw_frames);
         }
       else
         {
@@ -672,6 +899,17 @@ lunar_icon_store_free (gpointer data)
 {
   LunarIconStore *store = data;
 
+  if (store->factory != NULL)
+    {
+      g_rec_mutex_lock (&store->factory->stored_lock);
+      if (store->queued)
+        {
+          g_queue_unlink (&store->factory->stored, &store->link);
+          store->factory->stored_size -= store->size;
+        }
+      g_rec_mutex_unlock (&store->factory->stored_lock);
+    }
+
   if (store->icon != NULL)
     g_object_unref (store->icon);
   g_slice_free (LunarIconStore, store);
@@ -688,6 +926,235 @@ lunar_icon_factory_load_fallback (LunarIconFactory *factory,
 
 
 
+static void
+lunar_icon_factory_store_icon (LunarIconFactory   *factory,
+                                LunarFile          *file,
+                                LunarFileIconState  icon_state,
+                                gint                 icon_size,
+                                GdkPixbuf           *icon,
+                                gboolean             decoded)
+{
+  LunarIconStore *store;
+
+  store = g_slice_new0 (LunarIconStore);
+  store->icon_size = icon_size;
+  store->icon_state = icon_state;
+  store->stamp = factory->theme_stamp;
+  store->thumb_state = lunar_file_get_thumb_state (file);
+  store->icon = g_object_ref (icon);
+
+  /* this releases the previous store of the file */
+  g_object_set_qdata_full (G_OBJECT (file), lunar_icon_factory_store_quark,
+                           store, lunar_icon_store_free);
+
+  if (decoded)
+    {
+      store->factory = factory;
+      store->file = file;
+      store->link.data = store;
+      store->size = (gsize) gdk_pixbuf_get_rowstride (icon) * gdk_pixbuf_get_height (icon);
+      store->last_used = g_get_monotonic_time ();
+
+      g_rec_mutex_lock (&factory->stored_lock);
+      g_queue_push_head_link (&factory->stored, &store->link);
+      factory->stored_size += store->size;
+      store->queued = TRUE;
+      g_rec_mutex_unlock (&factory->stored_lock);
+
+      lunar_icon_factory_trim (factory, factory->max_stored_size, FALSE);
+    }
+}
+
+
+
+static void
+lunar_icon_request_free (LunarIconRequest *request)
+{
+  g_object_unref (request->factory);
+  g_object_unref (request->file);
+  if (request->gicon != NULL)
+    g_object_unref (request->gicon);
+  if (request->icon != NULL)
+    g_object_unref (request->icon);
+  g_object_unref (request->cancellable);
+  g_free (request->path);
+  g_slice_free (LunarIconRequest, request);
+}
+
+
+
+/* forgets the pending request, it is released once the pool is done with it */
+static void
+lunar_icon_factory_cancel_request (LunarIconFactory *factory,
+                                    LunarIconRequest *request)
+{
+  g_cancellable_cancel (request->cancellable);
+  g_hash_table_remove (factory->requests, request->file);
+  g_queue_unlink (&factory->requests_queue, &request->link);
+}
+
+
+
+static gboolean
+lunar_icon_factory_decode_ready (gpointer user_data)
+{
+  LunarIconFactory *factory = LUNAR_ICON_FACTORY (user_data);
+  LunarIconRequest *request;
+  const gchar       *icon_name;
+  GdkPixbuf         *icon;
+  GSList            *results;
+  GSList            *lp;
+
+  g_mutex_lock (&factory->results_lock);
+  results = g_slist_reverse (factory->results);
+  factory->results = NULL;
+  factory->results_idle_id = 0;
+  g_mutex_unlock (&factory->results_lock);
+
+  for (lp = results; lp != NULL; lp = lp->next)
+    {
+      request = lp->data;
+
+      /* check if the request was cancelled or superseded while decoding */
+      if (g_cancellable_is_cancelled (request->cancellable))
+        {
+          lunar_icon_request_free (request);
+          continue;
+        }
+
+      g_hash_table_remove (factory->requests, request->file);
+      g_queue_unlink (&factory->requests_queue, &request->link);
+
+      /* drop the result if the theme or the thumbnail changed meanwhile */
+      if (request->stamp != factory->theme_stamp
+          || request->thumb_state != lunar_file_get_thumb_state (request->file))
+        {
+          lunar_icon_request_free (request);
+          continue;
+        }
+
+      if (G_LIKELY (request->icon != NULL))
+        {
+          lunar_icon_factory_store_icon (factory, request->file, request->icon_state,
+                                          request->icon_size, request->icon, TRUE);
+
+          /* let the widgets showing the file redraw it */
+          g_signal_emit (factory, icon_factory_signals[FILE_ICON_READY], 0, request->file);
+        }
+      else
+        {
+          /* keep the themed icon that is already shown, so the
+           * broken preview is not decoded again on every redraw */
+          icon_name = lunar_file_get_icon_name (request->file, request->icon_state, factory->icon_theme);
+          icon = lunar_icon_factory_load_icon (factory, icon_name, request->icon_size, TRUE);
+          if (G_LIKELY (icon != NULL))
+            {
+              lunar_icon_factory_store_icon (factory, request->file, request->icon_state,
+                                              request->icon_size, icon, FALSE);
+              g_object_unref (icon);
+            }
+        }
+
+      lunar_icon_request_free (request);
+    }
+  g_slist_free (results);
+
+  return FALSE;
+}
+
+
+
+static void
+lunar_icon_factory_decode_thread (gpointer data,
+                                   gpointer user_data)
+{
+  LunarIconRequest *request = data;
+  LunarIconFactory *factory = request->factory;
+  GInputStream      *stream;
+
+  /* requests cancelled while they were queued are skipped */
+  if (G_UNLIKELY (g_cancellable_is_cancelled (request->cancellable)))
+    request->icon = NULL;
+  else if (request->gicon != NULL)
+    {
+      /* open the loadable preview icon for reading */
+      stream = g_loadable_icon_load (G_LOADABLE_ICON (request->gicon), request->icon_size,
+                                     NULL, request->cancellable, NULL);
+      if (stream != NULL)
+        {
+          request->icon = gdk_pixbuf_new_from_stream_at_scale (stream, request->icon_size,
+                                                               request->icon_size, TRUE,
+                                                               request->cancellable, NULL);
+          g_object_unref (stream);
+        }
+    }
+  else
+    {
+      /* decode and scale the thumbnail */
+      request->icon = lunar_icon_factory_load_from_file (request->path, request->icon_size,
+                                                          request->draw_frames);
+    }
+
+  /* hand the result to the main loop, together with the others
+   * finished before the main loop got to them */
+  g_mutex_lock (&factory->results_lock);
+  factory->results = g_slist_prepend (factory->results, request);
+  if (factory->results_idle_id == 0)
+    factory->results_idle_id = g_idle_add (lunar_icon_factory_decode_ready, factory);
+  g_mutex_unlock (&factory->results_lock);
+}
+
+
+
+static void
+lunar_icon_factory_decode_async (LunarIconFactory   *factory,
+                                  LunarFile          *file,
+                                  LunarFileIconState  icon_state,
+                                  gint                 icon_size,
+                                  GIcon               *gicon,
+                                  const gchar         *path)
+{
+  LunarIconRequest *request;
+
+  /* check if the same icon is already being decoded */
+  request = g_hash_table_lookup (factory->requests, file);
+  if (request != NULL)
+    {
+      if (request->icon_state == icon_state
+          && request->icon_size == icon_size
+          && request->stamp == factory->theme_stamp
+          && request->thumb_state == lunar_file_get_thumb_state (file))
+        return;
+
+      /* the previous request is of no use anymore */
+      lunar_icon_factory_cancel_request (factory, request);
+    }
+
+  request = g_slice_new0 (LunarIconRequest);
+  request->factory = g_object_ref (factory);
+  request->file = g_object_ref (file);
+  request->icon_state = icon_state;
+  request->icon_size = icon_size;
+  request->stamp = factory->theme_stamp;
+  request->thumb_state = lunar_file_get_thumb_state (file);
+  request->gicon = gicon != NULL ? g_object_ref (gicon) : NULL;
+  request->path = g_strdup (path);
+  request->draw_frames = factory->thumbnail_draw_frames;
+  request->cancellable = g_cancellable_new ();
+  request->link.data = request;
+
+  g_hash_table_insert (factory->requests, file, request);
+  g_queue_push_tail_link (&factory->requests_queue, &request->link);
+
+  /* rows that were scrolled past long ago are not waited for */
+  while (factory->requests_queue.length > LUNAR_ICON_FACTORY_MAX_REQUESTS)
+    lunar_icon_factory_cancel_request (factory, factory->requests_queue.head->data);
+
+  g_thread_pool_push (factory->decode_pool, request, NULL);
+}
+
+
+
 /**
  * lunar_icon_factory_get_default:
  *
@@ -756,6 +1223,8 @@ lunar_icon_factory_get_for_icon_theme (GtkIconTheme *icon_theme)
       factory->preferences = lunar_preferences_get ();
       endo_binding_new (G_OBJECT (factory->preferences), "misc-thumbnail-mode",
                        G_OBJECT (factory), "thumbnail-mode");
+      endo_binding_new (G_OBJECT (factory->preferences), "misc-thumbnail-cache-size",
+                       G_OBJECT (factory), "thumbnail-cache-size");
     }
   else
     {
@@ -870,7 +1339,6 @@ lunar_icon_factory_load_file_icon (LunarIconFactory  *factory,
                                     LunarFileIconState icon_state,
                                     gint                icon_size)
 {
-  GInputStream    *stream;
   GtkIconInfo     *icon_info;
   const gchar     *thumbnail_path;
   GdkPixbuf       *icon = NULL;
@@ -878,6 +1346,7 @@ lunar_icon_factory_load_file_icon (LunarIconFactory  *factory,
   const gchar     *icon_name;
   const gchar     *custom_icon;
   LunarIconStore *store;
+  gboolean         decoding = FALSE;
 
   _lunar_return_val_if_fail (LUNAR_IS_ICON_FACTORY (factory), NULL);
   _lunar_return_val_if_fail (LUNAR_IS_FILE (file), NULL);
@@ -891,9 +1360,23 @@ lunar_icon_factory_load_file_icon (LunarIconFactory  *factory,
       && store->stamp == factory->theme_stamp
       && store->thumb_state == lunar_file_get_thumb_state (file))
     {
+      factory->n_hits++;
+
+      /* move decoded icons to the front of the queue */
+      if (store->factory != NULL)
+        {
+          store->last_used = g_get_monotonic_time ();
+          g_rec_mutex_lock (&store->factory->stored_lock);
+          g_queue_unlink (&store->factory->stored, &store->link);
+          g_queue_push_head_link (&store->factory->stored, &store->link);
+          g_rec_mutex_unlock (&store->factory->stored_lock);
+        }
+
       return g_object_ref (store->icon);
     }
 
+  factory->n_misses++;
+
   /* check if we have a custom icon for this file */
   custom_icon = lunar_file_get_custom_icon (file);
   if (custom_icon != NULL)
@@ -933,21 +1416,9 @@ lunar_icon_factory_load_file_icon (LunarIconFactory  *factory,
             }
           else if (G_IS_LOADABLE_ICON (gicon))
             {
-              /* we have a loadable icon, try to open it for reading */
-              stream = g_loadable_icon_load (G_LOADABLE_ICON (gicon), icon_size,
-                                             NULL, NULL, NULL);
-
-              /* check if we have a valid input stream */
-              if (stream != NULL)
-                {
-                  /* load the pixbuf from the stream */
-                  icon = gdk_pixbuf_new_from_stream_at_scale (stream, icon_size,
-                                                              icon_size, TRUE,
-                                                              NULL, NULL);
-
-                  /* destroy the stream */
-                  g_object_unref (stream);
-                }
+              /* we have a loadable icon, read and scale it in a thread */
+              lunar_icon_factory_decode_async (factory, file, icon_state, icon_size, gicon, NULL);
+              decoding = TRUE;
             }
 
           /* return the icon if we have one */
@@ -963,8 +1434,9 @@ lunar_icon_factory_load_file_icon (LunarIconFactory  *factory,
           /* check if we have a valid path */
           if (thumbnail_path != NULL)
             {
-              /* try to load the thumbnail */
-              icon = lunar_icon_factory_load_from_file (factory, thumbnail_path, icon_size);
+              /* decode the thumbnail in a thread */
+              lunar_icon_factory_decode_async (factory, file, icon_state, icon_size, NULL, thumbnail_path);
+              decoding = TRUE;
             }
         }
     }
@@ -976,18 +1448,10 @@ lunar_icon_factory_load_file_icon (LunarIconFactory  *factory,
       icon = lunar_icon_factory_load_icon (factory, icon_name, icon_size, TRUE);
     }
 
-  if (G_LIKELY (icon != NULL))
-    {
-      store = g_slice_new (LunarIconStore);
-      store->icon_size = icon_size;
-      store->icon_state = icon_state;
-      store->stamp = factory->theme_stamp;
-      store->thumb_state = lunar_file_get_thumb_state (file);
-      store->icon = g_object_ref (icon);
-
-      g_object_set_qdata_full (G_OBJECT (file), lunar_icon_factory_store_quark,
-                               store, lunar_icon_store_free);
-    }
+  /* the themed icon is only a placeholder while a preview is decoded,
+   * the decoded pixbuf is stored once it is ready */
+  if (G_LIKELY (icon != NULL && !decoding))
+    lunar_icon_factory_store_icon (factory, file, icon_state, icon_size, icon, FALSE);
 
   return icon;
 }
@@ -1009,3 +1473,62 @@ lunar_icon_factory_clear_pixmap_cache (LunarFile *file)
   if (lunar_icon_factory_store_quark != 0)
     g_object_set_qdata (G_OBJECT (file), lunar_icon_factory_store_quark, NULL);
 }
+
+
+
+/**
+ * lunar_icon_factory_cancel_file_icon:
+ * @factory : a #LunarIconFactory instance.
+ * @file    : a #LunarFile.
+ *
+ * Cancels decoding the preview or thumbnail of @file, if it is
+ * pending. Views call this for rows that left the visible range.
+ **/
+void
+lunar_icon_factory_cancel_file_icon (LunarIconFactory *factory,
+                                      LunarFile        *file)
+{
+  LunarIconRequest *request;
+
+  _lunar_return_if_fail (LUNAR_IS_ICON_FACTORY (factory));
+  _lunar_return_if_fail (LUNAR_IS_FILE (file));
+
+  request = g_hash_table_lookup (factory->requests, file);
+  if (request != NULL)
+    lunar_icon_factory_cancel_request (factory, request);
+}
+
+
+
+/**
+ * lunar_icon_factory_get_cache_stats:
+ * @factory     : a #LunarIconFactory instance.
+ * @hits        : return location for the number of icons served from the cache, or %NULL.
+ * @misses      : return location for the number of icons that had to be loaded, or %NULL.
+ * @evictions   : return location for the number of decoded icons dropped, or %NULL.
+ * @stored_size : return location for the bytes used by decoded icons, or %NULL.
+ *
+ * Reports how well the file icons loaded through @factory are cached.
+ **/
+void
+lunar_icon_factory_get_cache_stats (const LunarIconFactory *factory,
+                                     guint64                 *hits,
+                                     guint64                 *misses,
+                                     guint64                 *evictions,
+                                     gsize                   *stored_size)
+{
+  _lunar_return_if_fail (LUNAR_IS_ICON_FACTORY (factory));
+
+  if (hits != NULL)
+    *hits = factory->n_hits;
+  if (misses != NULL)
+    *misses = factory->n_misses;
+  if (evictions != NULL)
+    *evictions = factory->n_evictions;
+  if (stored_size != NULL)
+    {
+      g_rec_mutex_lock ((GRecMutex *) &factory->stored_lock);
+      *stored_size = factory->stored_size;
+      g_rec_mutex_unlock ((GRecMutex *) &factory->stored_lock);
+    }
+}
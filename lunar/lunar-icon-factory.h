@@ -56,6 +56,15 @@ GdkPixbuf             *lunar_icon_factory_load_file_icon     (LunarIconFactory
 
 void                   lunar_icon_factory_clear_pixmap_cache (LunarFile               *file);
 
+void                   lunar_icon_factory_cancel_file_icon   (LunarIconFactory        *factory,
+                                                               LunarFile               *file);
+
+void                   lunar_icon_factory_get_cache_stats    (const LunarIconFactory  *factory,
+                                                               guint64                  *hits,
+                                                               guint64                  *misses,
+                                                               guint64                  *evictions,
+                                                               gsize                    *stored_size);
+
 G_END_DECLS;
 
 #endif /* !__LUNAR_ICON_FACTORY_H__ */
@@ -54,6 +54,9 @@ static void lunar_image_set_property         (GObject           *object,
 static void lunar_image_file_changed         (LunarFileMonitor *monitor,
                                                LunarFile        *file,
                                                LunarImage       *image);
+static void lunar_image_file_icon_ready      (LunarIconFactory *icon_factory,
+                                               LunarFile        *file,
+                                               LunarImage       *image);
 
 
 
@@ -72,6 +75,7 @@ struct _LunarImage
 struct _LunarImagePrivate
 {
   LunarFileMonitor *monitor;
+  LunarIconFactory *icon_factory;
   LunarFile        *file;
 };
 
@@ -123,6 +127,13 @@ lunar_image_finalize (GObject *object)
                                         lunar_image_file_changed, image);
   g_object_unref (image->priv->monitor);
 
+  if (image->priv->icon_factory != NULL)
+    {
+      g_signal_handlers_disconnect_by_func (image->priv->icon_factory,
+                                            lunar_image_file_icon_ready, image);
+      g_object_unref (image->priv->icon_factory);
+    }
+
   lunar_image_set_file (image, NULL);
 
   (*G_OBJECT_CLASS (lunar_image_parent_class)->finalize) (object);
@@ -188,6 +199,21 @@ lunar_image_update (LunarImage *image)
       icon_theme = gtk_icon_theme_get_for_screen (screen);
       icon_factory = lunar_icon_factory_get_for_icon_theme (icon_theme);
 
+      /* update the image once a preview is decoded */
+      if (image->priv->icon_factory != icon_factory)
+        {
+          if (image->priv->icon_factory != NULL)
+            {
+              g_signal_handlers_disconnect_by_func (image->priv->icon_factory,
+                                                    lunar_image_file_icon_ready, image);
+              g_object_unref (image->priv->icon_factory);
+            }
+
+          image->priv->icon_factory = g_object_ref (icon_factory);
+          g_signal_connect (icon_factory, "file-icon-ready",
+                            G_CALLBACK (lunar_image_file_icon_ready), image);
+        }
+
       icon = lunar_icon_factory_load_file_icon (icon_factory, image->priv->file,
                                                  LUNAR_FILE_ICON_STATE_DEFAULT, 48);
 
@@ -214,6 +240,21 @@ lunar_image_file_changed (LunarFileMonitor *monitor,
 
 
 
+static void
+lunar_image_file_icon_ready (LunarIconFactory *icon_factory,
+                              LunarFile        *file,
+                              LunarImage       *image)
+{
+  _lunar_return_if_fail (LUNAR_IS_ICON_FACTORY (icon_factory));
+  _lunar_return_if_fail (LUNAR_IS_FILE (file));
+  _lunar_return_if_fail (LUNAR_IS_IMAGE (image));
+
+  if (file == image->priv->file)
+    lunar_image_update (image);
+}
+
+
+
 GtkWidget *
 lunar_image_new (void)
 {
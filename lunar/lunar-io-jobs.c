@@ -22,9 +22,25 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include <gio/gio.h>
 #include <glib/gstdio.h>
@@ -43,16 +59,75 @@
 
 
 
+/* delete local directory trees relative to directory fds */
+#if defined(HAVE_DIRENT_H) && defined(HAVE_FDOPENDIR) && defined(HAVE_FSTATAT) \
+    && defined(HAVE_OPENAT) && defined(HAVE_UNLINKAT)
+#define LUNAR_IO_JOBS_NATIVE_UNLINK 1
+#endif
+
+/* directories kept open while deleting a tree, the ones further up
+ * are closed and opened again through ".." once their turn comes */
+#define UNLINK_MAX_OPEN_DIRS 32
+
+/* number of deleted files sent to the thumbnail cache at once */
+#define THUMBNAIL_DELETE_BATCH_SIZE 256
+
+/* a folder listing sends the first files when this many are read, and
+ * after that at most once per interval (in microseconds), so the view
+ * fills quickly without merging every single file on its own */
+#define LS_FIRST_CHUNK_SIZE 500
+#define LS_CHUNK_INTERVAL   (200 * 1000)
+
+
+
+typedef struct _LunarUnlinkContext LunarUnlinkContext;
+typedef struct _LunarUnlinkDir     LunarUnlinkDir;
+
+struct _LunarUnlinkContext
+{
+  LunarJob            *job;
+  LunarThumbnailCache *thumbnail_cache;
+
+  /* deleted files not yet sent to the thumbnail cache */
+  GList                *thumbnail_batch;
+  guint                 n_thumbnail_batch;
+
+  guint                 n_processed;
+};
+
+/* a directory on the path of the tree being deleted natively */
+struct _LunarUnlinkDir
+{
+  GFile      *file;
+  gchar      *name;
+  DIR        *dp;
+
+  /* to recognize the directory when it is opened again */
+  dev_t       dev;
+  ino_t       ino;
+
+  /* names of children that were not deleted, or NULL */
+  GHashTable *kept;
+};
+
+
+
 static GList *
 _tij_collect_nofollow (LunarJob *job,
                        GList     *base_file_list,
                        gboolean   unlinking,
                        GError   **error)
 {
-  GError *err = NULL;
-  GList  *child_file_list = NULL;
-  GList  *file_list = NULL;
-  GList  *lp;
+  LunarIoScanFlags scan_flags;
+  GError           *err = NULL;
+  GArray           *entries;
+  GList            *file_list = NULL;
+  GList            *lp;
+  guint             n;
+
+  scan_flags = LUNAR_IO_SCAN_RECURSIVE;
+  if (unlinking)
+    scan_flags |= LUNAR_IO_SCAN_UNLINKING;
 
   /* recursively collect the files */
   for (lp = base_file_list;
@@ -60,20 +135,25 @@ _tij_collect_nofollow (LunarJob *job,
        lp = lp->next)
     {
       /* try to scan the directory */
-      child_file_list = lunar_io_scan_directory (job, lp->data,
+      entries = lunar_io_scan_directory_entries (job, lp->data,
                                                   G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                                  TRUE, unlinking, FALSE, &err);
+                                                  scan_flags, &err);
 
-      /* prepend the new files to the existing list */
+      /* prepend the file, followed by its children, to the existing list */
       file_list = lunar_g_file_list_prepend (file_list, lp->data);
-      file_list = g_list_concat (child_file_list, file_list);
+      if (entries != NULL)
+        {
+          for (n = entries->len; n > 0; --n)
+            file_list = lunar_g_file_list_prepend (file_list, g_array_index (entries, LunarIoScanEntry, n - 1).file);
+          g_array_free (entries, TRUE);
+        }
     }
 
   /* check if we failed */
   if (err != NULL || endo_job_is_cancelled (ENDO_JOB (job)))
     {
       if (endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
-        g_error_free (err);
+        g_clear_error (&err);
       else
         g_propagate_error (error, err);
 
@@ -431,127 +511,615 @@ lunar_io_jobs_make_directories (GList *file_list)
 
 
 
-static gboolean
-_lunar_io_jobs_unlink (LunarJob  *job,
-                        GArray     *param_values,
-                        GError    **error)
+static void
+_tij_unlink_flush_thumbnails (LunarUnlinkContext *context)
 {
-  LunarThumbnailCache *thumbnail_cache;
-  LunarApplication    *application;
-  LunarJobResponse     response;
-  GFileInfo            *info;
-  GError               *err = NULL;
-  GList                *file_list;
-  GList                *lp;
-  gchar                *base_name;
-  gchar                *display_name;
-  guint                 n_processed = 0;
+  /* notify the thumbnail cache that the corresponding thumbnails can also
+   * be deleted now */
+  lunar_thumbnail_cache_delete_files (context->thumbnail_cache, context->thumbnail_batch);
 
-  _lunar_return_val_if_fail (LUNAR_IS_JOB (job), FALSE);
-  _lunar_return_val_if_fail (param_values != NULL, FALSE);
-  _lunar_return_val_if_fail (param_values->len == 1, FALSE);
-  _lunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+  lunar_g_file_list_free (context->thumbnail_batch);
+  context->thumbnail_batch = NULL;
+  context->n_thumbnail_batch = 0;
+}
 
-  /* get the file list */
-  file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
 
-  /* tell the user that we're preparing to unlink the files */
-  endo_job_info_message (ENDO_JOB (job), _("Preparing..."));
 
-  /* recursively collect files for removal, not following any symlinks */
-  file_list = _tij_collect_nofollow (job, file_list, TRUE, &err);
+static void
+_tij_unlink_deleted (LunarUnlinkContext *context,
+                     GFile              *file)
+{
+  gchar *base_name;
+  gchar *display_name;
 
-  /* free the file list and fail if there was an error or the job was cancelled */
-  if (err != NULL || endo_job_is_cancelled (ENDO_JOB (job)))
+  /* update progress information, but only for every 8th file */
+  if ((context->n_processed++ % 8) == 0)
     {
-      if (endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
-        g_error_free (err);
-      else
-        g_propagate_error (error, err);
+      base_name = g_file_get_basename (file);
+      display_name = g_filename_display_name (base_name);
+      g_free (base_name);
 
-      lunar_g_file_list_free (file_list);
-      return FALSE;
+      endo_job_info_message (ENDO_JOB (context->job), "%s", display_name);
+      g_free (display_name);
     }
 
-  /* we know the total list of files to process */
-  lunar_job_set_total_files (LUNAR_JOB (job), file_list);
+  /* queue the file for the thumbnail cache */
+  context->thumbnail_batch = lunar_g_file_list_prepend (context->thumbnail_batch, file);
+  if (++context->n_thumbnail_batch >= THUMBNAIL_DELETE_BATCH_SIZE)
+    _tij_unlink_flush_thumbnails (context);
+}
 
-  /* take a reference on the thumbnail cache */
-  application = lunar_application_get ();
-  thumbnail_cache = lunar_application_get_thumbnail_cache (application);
-  g_object_unref (application);
 
-  /* remove all the files */
-  for (lp = file_list;
-       lp != NULL && !endo_job_is_cancelled (ENDO_JOB (job));
-       lp = lp->next, n_processed++)
+
+static LunarJobResponse
+_tij_unlink_ask_skip (LunarUnlinkContext *context,
+                      GFile              *file,
+                      const GError       *err)
+{
+  LunarJobResponse response;
+  GFileInfo        *info;
+  gchar            *base_name;
+  gchar            *display_name;
+
+  /* query the file info for the display name */
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME,
+                            G_FILE_QUERY_INFO_NONE,
+                            endo_job_get_cancellable (ENDO_JOB (context->job)),
+                            NULL);
+
+  /* abort if the job was cancelled */
+  if (endo_job_is_cancelled (ENDO_JOB (context->job)))
     {
-      g_assert (G_IS_FILE (lp->data));
+      if (info != NULL)
+        g_object_unref (info);
+      return LUNAR_JOB_RESPONSE_CANCEL;
+    }
 
-      /* skip root folders which cannot be deleted anyway */
-      if (lunar_g_file_is_root (lp->data))
-        continue;
+  /* determine the display name, using the basename as a fallback */
+  if (info != NULL)
+    {
+      display_name = g_strdup (g_file_info_get_display_name (info));
+      g_object_unref (info);
+    }
+  else
+    {
+      base_name = g_file_get_basename (file);
+      display_name = g_filename_display_name (base_name);
+      g_free (base_name);
+    }
 
-      /* update progress information */
-      lunar_job_processing_file (LUNAR_JOB (job), lp, n_processed);
+  /* ask the user whether he wants to skip this file */
+  response = lunar_job_ask_skip (context->job,
+                                  _("Could not delete file \"%s\": %s"),
+                                  display_name, err->message);
+  g_free (display_name);
 
-again:
+  return response;
+}
+
+
+
+static void
+_tij_unlink_file (LunarUnlinkContext *context,
+                  GFile              *file)
+{
+  LunarJobResponse response;
+  GError           *err = NULL;
+
+  do
+    {
       /* try to delete the file */
-      if (_tij_delete_file (lp->data, endo_job_get_cancellable (ENDO_JOB (job)), &err))
+      if (_tij_delete_file (file, endo_job_get_cancellable (ENDO_JOB (context->job)), &err))
         {
-          /* notify the thumbnail cache that the corresponding thumbnail can also
-           * be deleted now */
-          lunar_thumbnail_cache_delete_file (thumbnail_cache, lp->data);
+          _tij_unlink_deleted (context, file);
+          return;
         }
+
+      if (endo_job_is_cancelled (ENDO_JOB (context->job)))
+        response = LUNAR_JOB_RESPONSE_CANCEL;
       else
+        response = _tij_unlink_ask_skip (context, file, err);
+
+      g_clear_error (&err);
+    }
+  while (response == LUNAR_JOB_RESPONSE_RETRY);
+}
+
+
+
+#ifdef LUNAR_IO_JOBS_NATIVE_UNLINK
+static gboolean
+_tij_unlink_native_entry (LunarUnlinkContext *context,
+                          gint                dir_fd,
+                          const gchar        *name,
+                          GFile              *file,
+                          gboolean            is_directory)
+{
+  LunarJobResponse response;
+  GError           *err = NULL;
+  gint              errsv;
+
+  do
+    {
+      if (unlinkat (dir_fd, name, is_directory ? AT_REMOVEDIR : 0) == 0)
+        {
+          _tij_unlink_deleted (context, file);
+          return TRUE;
+        }
+
+      errsv = errno;
+      if (endo_job_is_cancelled (ENDO_JOB (context->job)))
+        return FALSE;
+
+      g_set_error (&err, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   _("Error removing file: %s"), g_strerror (errsv));
+      response = _tij_unlink_ask_skip (context, file, err);
+      g_clear_error (&err);
+    }
+  while (response == LUNAR_JOB_RESPONSE_RETRY);
+
+  return FALSE;
+}
+
+
+
+/* opens the directory name in parent_fd for reading, or deletes it like a
+ * regular file if it is none. Returns %NULL if it was not opened, with
+ * deleted telling whether it is gone */
+static LunarUnlinkDir*
+_tij_unlink_native_opendir (LunarUnlinkContext *context,
+                            gint                parent_fd,
+                            const gchar        *name,
+                            GFile              *file,
+                            gboolean           *deleted)
+{
+  LunarJobResponse response;
+  LunarUnlinkDir  *dir;
+  struct stat       statb;
+  GError           *err = NULL;
+  DIR              *dp;
+  gint              fd;
+  gint              errsv;
+
+  *deleted = FALSE;
+
+  for (;;)
+    {
+      dp = NULL;
+      fd = openat (parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd >= 0 && fstat (fd, &statb) == 0)
+        dp = fdopendir (fd);
+
+      if (G_LIKELY (dp != NULL))
+        break;
+
+      errsv = errno;
+      if (fd >= 0)
+        close (fd);
+
+      /* not a directory (anymore), delete it like a regular file */
+      if (errsv == ENOTDIR || errsv == ELOOP)
+        {
+          *deleted = _tij_unlink_native_entry (context, parent_fd, name, file, FALSE);
+          return NULL;
+        }
+
+      if (endo_job_is_cancelled (ENDO_JOB (context->job)))
+        return NULL;
+
+      g_set_error (&err, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   _("Error removing file: %s"), g_strerror (errsv));
+      response = _tij_unlink_ask_skip (context, file, err);
+      g_clear_error (&err);
+
+      if (response != LUNAR_JOB_RESPONSE_RETRY)
+        return NULL;
+    }
+
+  dir = g_slice_new0 (LunarUnlinkDir);
+  dir->file = g_object_ref (file);
+  dir->name = g_strdup (name);
+  dir->dp = dp;
+  dir->dev = statb.st_dev;
+  dir->ino = statb.st_ino;
+
+  return dir;
+}
+
+
+
+/* opens the closed parent of the directory at child_fd again, making sure
+ * it is still the same directory the tree was entered through */
+static gboolean
+_tij_unlink_native_reopen (LunarUnlinkContext *context,
+                           LunarUnlinkDir     *dir,
+                           gint                child_fd)
+{
+  LunarJobResponse response;
+  struct stat       statb;
+  GError           *err = NULL;
+  gint              fd;
+  gint              errsv;
+
+  do
+    {
+      fd = openat (child_fd, "..", O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd >= 0)
         {
-          /* query the file info for the display name */
-          info = g_file_query_info (lp->data,
-                                    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME,
-                                    G_FILE_QUERY_INFO_NONE,
-                                    endo_job_get_cancellable (ENDO_JOB (job)),
-                                    NULL);
-
-          /* abort if the job was cancelled */
-          if (endo_job_is_cancelled (ENDO_JOB (job)))
+          if (fstat (fd, &statb) == 0
+              && statb.st_dev == dir->dev
+              && statb.st_ino == dir->ino)
             {
-              g_clear_error (&err);
-              break;
+              dir->dp = fdopendir (fd);
+              if (G_LIKELY (dir->dp != NULL))
+                return TRUE;
             }
+          else
+            {
+              /* the tree was moved meanwhile */
+              errno = ESTALE;
+            }
+        }
+
+      errsv = errno;
+      if (fd >= 0)
+        close (fd);
+
+      if (endo_job_is_cancelled (ENDO_JOB (context->job)))
+        return FALSE;
+
+      g_set_error (&err, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   _("Error removing file: %s"), g_strerror (errsv));
+      response = _tij_unlink_ask_skip (context, dir->file, err);
+      g_clear_error (&err);
+    }
+  while (response == LUNAR_JOB_RESPONSE_RETRY);
+
+  return FALSE;
+}
+
+
+
+static void
+_tij_unlink_native_dir_free (LunarUnlinkDir *dir)
+{
+  if (dir->dp != NULL)
+    closedir (dir->dp);
+  if (dir->kept != NULL)
+    g_hash_table_destroy (dir->kept);
+  g_object_unref (dir->file);
+  g_free (dir->name);
+  g_slice_free (LunarUnlinkDir, dir);
+}
 
-          /* determine the display name, using the basename as a fallback */
-          if (info != NULL)
+
+
+static void
+_tij_unlink_native_keep (LunarUnlinkDir *dir,
+                         const gchar    *name)
+{
+  if (dir->kept == NULL)
+    dir->kept = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_hash_table_add (dir->kept, g_strdup (name));
+}
+
+
+
+/* deletes the directory tree name in parent_fd. The directories on the
+ * current path are kept on a stack instead of the C stack, and only the
+ * innermost UNLINK_MAX_OPEN_DIRS of them stay open, so deep trees run
+ * out of neither stack space nor file descriptors */
+static void
+_tij_unlink_native_directory (LunarUnlinkContext *context,
+                              gint                parent_fd,
+                              const gchar        *name,
+                              GFile              *file)
+{
+  LunarUnlinkDir  *dir;
+  LunarUnlinkDir  *child;
+  LunarUnlinkDir  *parent;
+  struct dirent    *d;
+  struct stat       statb;
+  GPtrArray        *stack;
+  gboolean          is_directory;
+  gboolean          deleted;
+  GFile            *child_file;
+
+  dir = _tij_unlink_native_opendir (context, parent_fd, name, file, &deleted);
+  if (dir == NULL)
+    return;
+
+  stack = g_ptr_array_new_with_free_func ((GDestroyNotify) _tij_unlink_native_dir_free);
+  g_ptr_array_add (stack, dir);
+
+  while (stack->len > 0 && !endo_job_is_cancelled (ENDO_JOB (context->job)))
+    {
+      dir = g_ptr_array_index (stack, stack->len - 1);
+
+      /* delete the children, entries are only removed after they were
+       * returned by readdir, so removing them while reading is safe */
+      d = readdir (dir->dp);
+      if (d != NULL)
+        {
+          /* skip "." and "..", and the children that were not deleted
+           * before the directory was opened again */
+          if (d->d_name[0] == '.' && (d->d_name[1] == '\0' || (d->d_name[1] == '.' && d->d_name[2] == '\0')))
+            continue;
+          if (dir->kept != NULL && g_hash_table_contains (dir->kept, d->d_name))
+            continue;
+
+#ifdef DT_UNKNOWN
+          if (d->d_type != DT_UNKNOWN)
+            is_directory = (d->d_type == DT_DIR);
+          else
+#endif
+            is_directory = fstatat (dirfd (dir->dp), d->d_name, &statb, AT_SYMLINK_NOFOLLOW) == 0
+                           && S_ISDIR (statb.st_mode);
+
+          child_file = g_file_get_child (dir->file, d->d_name);
+
+          if (is_directory)
             {
-              display_name = g_strdup (g_file_info_get_display_name (info));
-              g_object_unref (info);
+              child = _tij_unlink_native_opendir (context, dirfd (dir->dp), d->d_name,
+                                                  child_file, &deleted);
+              if (child != NULL)
+                {
+                  /* descend, closing the directory that leaves the window */
+                  g_ptr_array_add (stack, child);
+                  if (stack->len > UNLINK_MAX_OPEN_DIRS)
+                    {
+                      parent = g_ptr_array_index (stack, stack->len - 1 - UNLINK_MAX_OPEN_DIRS);
+                      closedir (parent->dp);
+                      parent->dp = NULL;
+                    }
+
+                  g_object_unref (child_file);
+                  continue;
+                }
             }
           else
             {
-              base_name = g_file_get_basename (lp->data);
-              display_name = g_filename_display_name (base_name);
-              g_free (base_name);
+              deleted = _tij_unlink_native_entry (context, dirfd (dir->dp), d->d_name, child_file, FALSE);
             }
 
-          /* ask the user whether he wants to skip this file */
-          response = lunar_job_ask_skip (LUNAR_JOB (job),
-                                          _("Could not delete file \"%s\": %s"),
-                                          display_name, err->message);
-          g_free (display_name);
+          /* don't ask about it again when the directory is read again */
+          if (!deleted)
+            _tij_unlink_native_keep (dir, d->d_name);
+
+          g_object_unref (child_file);
+          continue;
+        }
+
+      /* the directory is empty now, remove it from its parent */
+      if (stack->len > 1)
+        {
+          parent = g_ptr_array_index (stack, stack->len - 2);
+          if (parent->dp == NULL
+              && !_tij_unlink_native_reopen (context, parent, dirfd (dir->dp)))
+            break;
+
+          closedir (dir->dp);
+          dir->dp = NULL;
+
+          if (!endo_job_is_cancelled (ENDO_JOB (context->job))
+              && !_tij_unlink_native_entry (context, dirfd (parent->dp), dir->name, dir->file, TRUE))
+            _tij_unlink_native_keep (parent, dir->name);
+        }
+      else
+        {
+          closedir (dir->dp);
+          dir->dp = NULL;
+
+          if (!endo_job_is_cancelled (ENDO_JOB (context->job)))
+            _tij_unlink_native_entry (context, parent_fd, dir->name, dir->file, TRUE);
+        }
+
+      g_ptr_array_remove_index (stack, stack->len - 1);
+    }
+
+  /* release what is left after cancellation or an error */
+  g_ptr_array_free (stack, TRUE);
+}
+
+
+
+static gboolean
+_tij_unlink_native_tree (LunarUnlinkContext *context,
+                         GFile              *file)
+{
+  GFile *parent;
+  gchar *parent_path;
+  gchar *base_name;
+  gint   parent_fd;
+
+  parent = g_file_get_parent (file);
+  if (G_UNLIKELY (parent == NULL))
+    return FALSE;
+
+  parent_path = g_file_get_path (parent);
+  g_object_unref (parent);
+  if (G_UNLIKELY (parent_path == NULL))
+    return FALSE;
+
+  parent_fd = open (parent_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  g_free (parent_path);
+
+  /* let the caller fall back to gio */
+  if (G_UNLIKELY (parent_fd < 0))
+    return FALSE;
+
+  base_name = g_file_get_basename (file);
+  _tij_unlink_native_directory (context, parent_fd, base_name, file);
+  g_free (base_name);
+
+  close (parent_fd);
+
+  return TRUE;
+}
+#endif
+
+
+
+/**
+ * _tij_unlink_tree:
+ * @context : the #LunarUnlinkContext of the job.
+ * @file    : the #GFile to delete.
+ *
+ * Deletes @file and, if it is a directory, its contents. Each directory
+ * is emptied while it is read and removed as soon as its subtree is done,
+ * so only the directories on the current path are kept in memory.
+ **/
+static void
+_tij_unlink_tree (LunarUnlinkContext *context,
+                  GFile              *file)
+{
+  GFileEnumerator  *enumerator;
+  LunarJobResponse  response;
+  GCancellable     *cancellable;
+  GFileInfo        *info;
+  GError           *err = NULL;
+  GFile            *child_file;
+  gboolean          is_root;
+
+  cancellable = endo_job_get_cancellable (ENDO_JOB (context->job));
+
+  /* root folders cannot be deleted, but their contents can,
+   * i.e. when emptying the trash */
+  is_root = lunar_g_file_is_root (file);
+
+  /* don't recurse into directories in the trash, in GVfs only the
+   * top-level directories can be deleted directly */
+  if (!is_root
+      && (g_file_query_file_type (file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, cancellable) != G_FILE_TYPE_DIRECTORY
+          || lunar_g_file_is_trashed (file)))
+    {
+      _tij_unlink_file (context, file);
+      return;
+    }
+
+#ifdef LUNAR_IO_JOBS_NATIVE_UNLINK
+  if (!is_root && g_file_is_native (file) && _tij_unlink_native_tree (context, file))
+    return;
+#endif
+
+  for (;;)
+    {
+      enumerator = g_file_enumerate_children (file,
+                                              G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                              G_FILE_ATTRIBUTE_STANDARD_NAME,
+                                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                              cancellable, &err);
+      if (G_LIKELY (enumerator != NULL))
+        break;
+
+      if (endo_job_is_cancelled (ENDO_JOB (context->job)))
+        response = LUNAR_JOB_RESPONSE_CANCEL;
+      else
+        response = _tij_unlink_ask_skip (context, file, err);
+
+      g_clear_error (&err);
+
+      if (response != LUNAR_JOB_RESPONSE_RETRY)
+        return;
+    }
+
+  /* delete the children while enumerating */
+  while (!endo_job_is_cancelled (ENDO_JOB (context->job)))
+    {
+      info = g_file_enumerator_next_file (enumerator, cancellable, &err);
+      if (G_UNLIKELY (info == NULL))
+        {
+          /* the end of the directory */
+          if (err == NULL)
+            break;
+
+          if (endo_job_is_cancelled (ENDO_JOB (context->job)))
+            response = LUNAR_JOB_RESPONSE_CANCEL;
+          else
+            response = _tij_unlink_ask_skip (context, file, err);
 
-          /* clear the error */
           g_clear_error (&err);
 
-          /* check whether to retry */
           if (response == LUNAR_JOB_RESPONSE_RETRY)
-            goto again;
+            continue;
+          break;
         }
+
+      child_file = g_file_get_child (file, g_file_info_get_name (info));
+
+      if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        _tij_unlink_tree (context, child_file);
+      else
+        _tij_unlink_file (context, child_file);
+
+      g_object_unref (child_file);
+      g_object_unref (info);
     }
 
-  /* release the thumbnail cache */
-  g_object_unref (thumbnail_cache);
+  g_object_unref (enumerator);
 
-  /* release the file list */
-  lunar_g_file_list_free (file_list);
+  /* the directory itself goes last */
+  if (!is_root && !endo_job_is_cancelled (ENDO_JOB (context->job)))
+    _tij_unlink_file (context, file);
+}
+
+
+
+static gboolean
+_lunar_io_jobs_unlink (LunarJob  *job,
+                        GArray     *param_values,
+                        GError    **error)
+{
+  LunarUnlinkContext context;
+  LunarApplication  *application;
+  GList              *file_list;
+  GList              *lp;
+  guint               n_files;
+  guint               n;
+
+  _lunar_return_val_if_fail (LUNAR_IS_JOB (job), FALSE);
+  _lunar_return_val_if_fail (param_values != NULL, FALSE);
+  _lunar_return_val_if_fail (param_values->len == 1, FALSE);
+  _lunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /* get the file list */
+  file_list = g_value_get_boxed (&g_array_index (param_values, GValue, 0));
+
+  /* tell the user that we're preparing to unlink the files */
+  endo_job_info_message (ENDO_JOB (job), _("Preparing..."));
+
+  context.job = job;
+  context.thumbnail_batch = NULL;
+  context.n_thumbnail_batch = 0;
+  context.n_processed = 0;
+
+  /* take a reference on the thumbnail cache */
+  application = lunar_application_get ();
+  context.thumbnail_cache = lunar_application_get_thumbnail_cache (application);
+  g_object_unref (application);
+
+  /* the total amount of files is unknown while streaming, so
+   * the percentage is based on the toplevel files */
+  n_files = g_list_length (file_list);
+
+  /* remove all the files, each subtree is deleted as soon as it was read */
+  for (lp = file_list, n = 0;
+       lp != NULL && !endo_job_is_cancelled (ENDO_JOB (job));
+       lp = lp->next, ++n)
+    {
+      g_assert (G_IS_FILE (lp->data));
+
+      endo_job_percent (ENDO_JOB (job), (n * 100.0) / n_files);
+
+      _tij_unlink_tree (&context, lp->data);
+    }
+
+  /* send the remaining files to the thumbnail cache */
+  _tij_unlink_flush_thumbnails (&context);
+
+  /* release the thumbnail cache */
+  g_object_unref (context.thumbnail_cache);
 
   if (endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
     return FALSE;
@@ -1225,18 +1793,38 @@ lunar_io_jobs_change_mode (GList         *files,
 
 
 
+/* hands the files listed so far to the folder */
+static void
+_lunar_io_jobs_ls_chunk (GArray   *entries,
+                          gpointer  user_data)
+{
+  GList *file_list;
+
+  file_list = lunar_io_scan_entries_to_list (entries);
+
+  /* emit the "files-ready" signal */
+  if (!lunar_job_files_ready (LUNAR_JOB (user_data), file_list))
+    {
+      /* none of the handlers took over the file list, so it's up to us
+       * to destroy it */
+      lunar_g_file_list_free (file_list);
+    }
+}
+
+
+
 static gboolean
 _lunar_io_jobs_ls (LunarJob  *job,
                     GArray     *param_values,
                     GError    **error)
 {
-  GError *err = NULL;
-  GFile  *directory;
-  GList  *file_list = NULL;
+  LunarIoScanFlags scan_flags = LUNAR_IO_SCAN_LUNAR_FILES;
+  GError           *err = NULL;
+  GFile            *directory;
 
   _lunar_return_val_if_fail (LUNAR_IS_JOB (job), FALSE);
   _lunar_return_val_if_fail (param_values != NULL, FALSE);
-  _lunar_return_val_if_fail (param_values->len == 1, FALSE);
+  _lunar_return_val_if_fail (param_values->len == 2, FALSE);
   _lunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
   if (endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
@@ -1245,41 +1833,24 @@ _lunar_io_jobs_ls (LunarJob  *job,
   /* determine the directory to list */
   directory = g_value_get_object (&g_array_index (param_values, GValue, 0));
 
+  /* when only the folders are wanted the type
+   * is enough to skip all other files */
+  if (g_value_get_boolean (&g_array_index (param_values, GValue, 1)))
+    scan_flags |= LUNAR_IO_SCAN_DIRECTORIES_ONLY;
+
   /* make sure the object is valid */
   _lunar_assert (G_IS_FILE (directory));
 
-  /* collect directory contents (non-recursively) */
-  file_list = lunar_io_scan_directory (job, directory,
-                                        G_FILE_QUERY_INFO_NONE,
-                                        FALSE, FALSE, TRUE, &err);
-
-  /* abort on errors or cancellation */
-  if (err != NULL)
-    {
-      g_propagate_error (error, err);
-      return FALSE;
-    }
-  else if (endo_job_set_error_if_cancelled (ENDO_JOB (job), &err))
+  /* send the files in chunks while listing, instead of making
+   * the user wait for the whole directory on slow file systems */
+  if (!lunar_io_scan_directory_chunked (job, directory, G_FILE_QUERY_INFO_NONE, scan_flags,
+                                        LS_FIRST_CHUNK_SIZE, LS_CHUNK_INTERVAL,
+                                        _lunar_io_jobs_ls_chunk, job, &err))
     {
       g_propagate_error (error, err);
       return FALSE;
     }
 
-  /* check if we have any files to report */
-  if (G_LIKELY (file_list != NULL))
-    {
-      /* emit the "files-ready" signal */
-      if (!lunar_job_files_ready (LUNAR_JOB (job), file_list))
-        {
-          /* none of the handlers took over the file list, so it's up to us
-           * to destroy it */
-          lunar_g_file_list_free (file_list);
-        }
-    }
-
-  /* there should be no errors here */
-  _lunar_assert (err == NULL);
-
   /* propagate cancellation error */
   if (endo_job_set_error_if_cancelled (ENDO_JOB (job), &err))
     {
@@ -1297,7 +1868,23 @@ lunar_io_jobs_list_directory (GFile *directory)
 {
   _lunar_return_val_if_fail (G_IS_FILE (directory), NULL);
 
-  return lunar_simple_job_launch (_lunar_io_jobs_ls, 1, G_TYPE_FILE, directory);
+  return lunar_simple_job_launch (_lunar_io_jobs_ls, 2,
+                                   G_TYPE_FILE, directory,
+                                   G_TYPE_BOOLEAN, FALSE);
+}
+
+
+
+/* like lunar_io_jobs_list_directory(), but only the type of the
+ * children is queried and only the subdirectories are reported */
+LunarJob *
+lunar_io_jobs_list_directories (GFile *directory)
+{
+  _lunar_return_val_if_fail (G_IS_FILE (directory), NULL);
+
+  return lunar_simple_job_launch (_lunar_io_jobs_ls, 2,
+                                   G_TYPE_FILE, directory,
+                                   G_TYPE_BOOLEAN, TRUE);
 }
 
 
@@ -49,6 +49,7 @@ LunarJob *lunar_io_jobs_change_mode      (GList         *files,
                                             LunarFileMode file_mode,
                                             gboolean       recursive) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
 LunarJob *lunar_io_jobs_list_directory   (GFile         *directory) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
+LunarJob *lunar_io_jobs_list_directories (GFile         *directory) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
 LunarJob *lunar_io_jobs_rename_file      (LunarFile    *file,
                                             const gchar   *display_name) G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
 
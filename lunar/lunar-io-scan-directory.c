@@ -22,6 +22,26 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include <gio/gio.h>
 
 #include <endo/endo.h>
@@ -33,133 +53,461 @@
 
 
 
-GList *
-lunar_io_scan_directory (LunarJob          *job,
-                          GFile              *file,
-                          GFileQueryInfoFlags flags,
-                          gboolean            recursively,
-                          gboolean            unlinking,
-                          gboolean            return_lunar_files,
-                          GError            **error)
+/* use readdir/fstatat on a directory fd for local paths */
+#if defined(HAVE_DIRENT_H) && defined(HAVE_FDOPENDIR) && defined(HAVE_FSTATAT) && defined(HAVE_OPENAT)
+#define LUNAR_IO_SCAN_NATIVE 1
+#endif
+
+/* maximum number of directories that are scanned in parallel */
+#define LUNAR_IO_SCAN_MAX_WORKERS 8
+
+/* number of file infos requested from a GFileEnumerator at once */
+#define LUNAR_IO_SCAN_BATCH_SIZE 100
+
+
+
+typedef struct _ScanContext ScanContext;
+typedef struct _ScanDir     ScanDir;
+typedef struct _ScanChild   ScanChild;
+
+
+
+struct _ScanContext
 {
-  GFileEnumerator *enumerator;
-  GFileInfo       *info;
-  GFileType        type;
-  GError          *err = NULL;
-  GFile           *child_file;
-  GList           *child_files = NULL;
-  GList           *files = NULL;
-  const gchar     *namespace;
-  LunarFile      *lunar_file;
-  gboolean         is_mounted;
-  GCancellable    *cancellable = NULL;
+  LunarJob           *job;
+  GCancellable        *cancellable;
+  GFileQueryInfoFlags  flags;
+  LunarIoScanFlags    scan_flags;
+  const gchar         *namespace;
 
-  _lunar_return_val_if_fail (G_IS_FILE (file), NULL);
-  _lunar_return_val_if_fail (error == NULL || *error == NULL, NULL);
+  /* worker pool, only used for recursive scans */
+  GThreadPool         *pool;
 
-  /* abort if the job was cancelled */
-  if (job != NULL && endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
-    return NULL;
+  /* set by lunar_io_scan_directory_chunked() */
+  LunarIoScanChunkFunc chunk_func;
+  gpointer             chunk_data;
+  guint                chunk_size;
+  gint64               chunk_interval;
+  gint64               chunk_time;
 
-  /* don't recurse when we are scanning prior to unlinking and the current
-   * file/dir is in the trash. In GVfs, only the top-level directories in
-   * the trash can be modified and deleted directly. See
-   * https://bugzilla.expidus.org/show_bug.cgi?id=7147
-   * for more information */
-  if (unlinking
-      && lunar_g_file_is_trashed (file)
-      && !lunar_g_file_is_root (file))
+  /* protects n_pending and error */
+  GMutex               lock;
+  GCond                cond;
+  guint                n_pending;
+  GError              *error;
+  gint                 failed;
+};
+
+struct _ScanDir
+{
+  GFile  *file;
+  GArray *children;
+};
+
+struct _ScanChild
+{
+  gpointer  file;
+  GFileType type;
+  guint64   size;
+
+  /* the scanned directory if this is a directory we recursed into */
+  ScanDir  *dir;
+
+  /* position in the flat array, set while flattening */
+  guint     index;
+};
+
+
+
+static ScanDir *
+lunar_io_scan_dir_new (GFile *file)
+{
+  ScanDir *dir;
+
+  dir = g_slice_new (ScanDir);
+  dir->file = g_object_ref (file);
+  dir->children = g_array_new (FALSE, FALSE, sizeof (ScanChild));
+
+  return dir;
+}
+
+
+
+static void
+lunar_io_scan_dir_free (ScanDir *dir)
+{
+  ScanChild *child;
+  guint      n;
+
+  for (n = 0; n < dir->children->len; ++n)
     {
-      return NULL;
+      child = &g_array_index (dir->children, ScanChild, n);
+      if (child->file != NULL)
+        g_object_unref (child->file);
+      if (child->dir != NULL)
+        lunar_io_scan_dir_free (child->dir);
     }
 
-  if (job != NULL)
-    cancellable = endo_job_get_cancellable (ENDO_JOB (job));
+  g_array_free (dir->children, TRUE);
+  g_object_unref (dir->file);
+  g_slice_free (ScanDir, dir);
+}
 
-  /* query the file type */
-  type = g_file_query_file_type (file, flags, cancellable);
 
-  /* abort if the job was cancelled */
-  if (job != NULL && endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
-    return NULL;
 
-  /* ignore non-directory nodes */
-  if (type != G_FILE_TYPE_DIRECTORY)
-    return NULL;
+static void
+lunar_io_scan_entry_clear (gpointer data)
+{
+  LunarIoScanEntry *entry = data;
 
-  /* determine the namespace */
-  if (return_lunar_files)
-    namespace = LUNARX_FILE_INFO_NAMESPACE;
+  if (entry->file != NULL)
+    g_object_unref (entry->file);
+}
+
+
+
+static gboolean
+lunar_io_scan_is_cancelled (ScanContext *context)
+{
+  if (g_atomic_int_get (&context->failed))
+    return TRUE;
+
+  return context->job != NULL && endo_job_is_cancelled (ENDO_JOB (context->job));
+}
+
+
+
+static void
+lunar_io_scan_set_error (ScanContext *context,
+                         GError      *error)
+{
+  g_mutex_lock (&context->lock);
+
+  /* only the first error is reported */
+  if (context->error == NULL)
+    context->error = error;
   else
-    namespace = G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-                G_FILE_ATTRIBUTE_STANDARD_NAME;
+    g_error_free (error);
 
-  /* try to read from the direectory */
-  enumerator = g_file_enumerate_children (file, namespace,
-                                          flags, cancellable, &err);
+  g_mutex_unlock (&context->lock);
 
-  /* abort if there was an error or the job was cancelled */
-  if (err != NULL)
+  /* tell the other workers to stop */
+  g_atomic_int_set (&context->failed, TRUE);
+}
+
+
+
+/* passes the children of the (non-recursively scanned) dir
+ * to the chunk function and forgets them */
+static void
+lunar_io_scan_flush_chunk (ScanContext *context,
+                           ScanDir     *dir)
+{
+  LunarIoScanEntry entry;
+  ScanChild        *child;
+  GArray           *entries;
+  guint             n;
+
+  context->chunk_time = g_get_monotonic_time ();
+
+  /* only the first chunk is limited in size */
+  context->chunk_size = G_MAXUINT;
+
+  if (dir->children->len == 0)
+    return;
+
+  entries = g_array_sized_new (FALSE, FALSE, sizeof (LunarIoScanEntry), dir->children->len);
+  g_array_set_clear_func (entries, lunar_io_scan_entry_clear);
+
+  for (n = 0; n < dir->children->len; ++n)
     {
-      g_propagate_error (error, err);
-      return NULL;
+      child = &g_array_index (dir->children, ScanChild, n);
+
+      entry.file = child->file;
+      entry.type = child->type;
+      entry.size = child->size;
+      entry.parent = -1;
+      g_array_append_val (entries, entry);
     }
+  g_array_set_size (dir->children, 0);
+
+  (*context->chunk_func) (entries, context->chunk_data);
 
-  /* iterate over children one by one */
-  while (job == NULL || !endo_job_is_cancelled (ENDO_JOB (job)))
+  g_array_free (entries, TRUE);
+}
+
+
+
+static void
+lunar_io_scan_add_child (ScanContext *context,
+                         ScanDir     *dir,
+                         gpointer     file,
+                         GFile       *child_file,
+                         GFileType    type,
+                         guint64      size,
+                         gboolean     may_recurse)
+{
+  ScanChild child;
+
+  child.file = file;
+  child.type = type;
+  child.size = size;
+  child.dir = NULL;
+  child.index = 0;
+
+  /* queue subdirectories for the worker pool */
+  if (may_recurse
+      && type == G_FILE_TYPE_DIRECTORY
+      && (context->scan_flags & LUNAR_IO_SCAN_RECURSIVE) != 0)
     {
-      /* query info of the child */
-      info = g_file_enumerator_next_file (enumerator, cancellable, &err);
+      child.dir = lunar_io_scan_dir_new (child_file);
 
-      if (G_UNLIKELY (info == NULL))
-        break;
+      g_mutex_lock (&context->lock);
+      context->n_pending++;
+      g_mutex_unlock (&context->lock);
+
+      g_thread_pool_push (context->pool, child.dir, NULL);
+    }
+
+  g_array_append_val (dir->children, child);
 
-      is_mounted = TRUE;
-      if (err != NULL)
+  /* hand out the children when the chunk is full or old enough */
+  if (context->chunk_func != NULL
+      && (dir->children->len >= context->chunk_size
+          || g_get_monotonic_time () - context->chunk_time >= context->chunk_interval))
+    lunar_io_scan_flush_chunk (context, dir);
+}
+
+
+
+#ifdef LUNAR_IO_SCAN_NATIVE
+static GFileType
+lunar_io_scan_type_from_mode (mode_t mode)
+{
+  if (S_ISDIR (mode))
+    return G_FILE_TYPE_DIRECTORY;
+  else if (S_ISREG (mode))
+    return G_FILE_TYPE_REGULAR;
+  else if (S_ISLNK (mode))
+    return G_FILE_TYPE_SYMBOLIC_LINK;
+  else
+    return G_FILE_TYPE_SPECIAL;
+}
+
+
+
+static gboolean
+lunar_io_scan_native (ScanContext *context,
+                      ScanDir     *dir,
+                      const gchar *path,
+                      GError     **error)
+{
+  struct dirent *d;
+  struct stat    statb;
+  GFileType      type;
+  GFile         *child_file;
+  gpointer       file;
+  guint64        size;
+  gboolean       need_stat;
+  gboolean       nofollow;
+  gchar         *display_name;
+  DIR           *dp = NULL;
+  gint           open_flags = O_RDONLY | O_DIRECTORY;
+  gint           fd;
+  gint           errsv;
+
+  nofollow = (context->flags & G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS) != 0;
+  if (nofollow)
+    open_flags |= O_NOFOLLOW;
+#ifdef O_CLOEXEC
+  open_flags |= O_CLOEXEC;
+#endif
+
+  fd = open (path, open_flags);
+  if (fd >= 0)
+    dp = fdopendir (fd);
+
+  if (G_UNLIKELY (dp == NULL))
+    {
+      errsv = errno;
+      if (fd >= 0)
+        close (fd);
+
+      display_name = g_filename_display_name (path);
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   _("Failed to open directory \"%s\": %s"),
+                   display_name, g_strerror (errsv));
+      g_free (display_name);
+
+      return FALSE;
+    }
+
+  while (!lunar_io_scan_is_cancelled (context))
+    {
+      errno = 0;
+      d = readdir (dp);
+      if (G_UNLIKELY (d == NULL))
         {
-          if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_MOUNTED))
+          errsv = errno;
+          if (errsv != 0)
             {
-              is_mounted = FALSE;
-              g_clear_error (&err);
-            }
-          else
-            {
-              /* break on errors */
-              break;
+              display_name = g_filename_display_name (path);
+              g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                           _("Failed to open directory \"%s\": %s"),
+                           display_name, g_strerror (errsv));
+              g_free (display_name);
+
+              closedir (dp);
+              return FALSE;
             }
+          break;
         }
 
-      /* create GFile for the child */
-      child_file = g_file_get_child (file, g_file_info_get_name (info));
+      /* skip "." and ".." */
+      if (d->d_name[0] == '.' && (d->d_name[1] == '\0' || (d->d_name[1] == '.' && d->d_name[2] == '\0')))
+        continue;
+
+      type = G_FILE_TYPE_UNKNOWN;
+      size = 0;
+      need_stat = (context->scan_flags & LUNAR_IO_SCAN_QUERY_SIZE) != 0;
 
-      if (return_lunar_files)
+#ifdef DT_UNKNOWN
+      /* avoid the stat if the file system already told us the type */
+      switch (d->d_type)
         {
-          /* Prepend the LunarFile */
-          lunar_file = lunar_file_get_with_info (child_file, info, !is_mounted);
-          files = lunar_g_file_list_prepend (files, lunar_file);
-          g_object_unref (G_OBJECT (lunar_file));
+        case DT_DIR:
+          type = G_FILE_TYPE_DIRECTORY;
+          break;
+
+        case DT_REG:
+          type = G_FILE_TYPE_REGULAR;
+          break;
+
+        case DT_LNK:
+          if (nofollow)
+            type = G_FILE_TYPE_SYMBOLIC_LINK;
+          break;
+
+        case DT_CHR:
+        case DT_BLK:
+        case DT_FIFO:
+        case DT_SOCK:
+          type = G_FILE_TYPE_SPECIAL;
+          break;
+
+        default:
+          break;
         }
-      else
+#endif
+
+      if (need_stat || type == G_FILE_TYPE_UNKNOWN)
         {
-          /* Prepend the GFile */
-          files = lunar_g_file_list_prepend (files, child_file);
+          if (fstatat (dirfd (dp), d->d_name, &statb, nofollow ? AT_SYMLINK_NOFOLLOW : 0) != 0
+              && (nofollow || fstatat (dirfd (dp), d->d_name, &statb, AT_SYMLINK_NOFOLLOW) != 0))
+            {
+              /* the file disappeared in the meantime */
+              continue;
+            }
+
+          type = lunar_io_scan_type_from_mode (statb.st_mode);
+          size = statb.st_size;
         }
 
-      /* if the child is a directory and we need to recurse ... just do so */
-      if (recursively
-          && is_mounted
-          && g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+      if ((context->scan_flags & LUNAR_IO_SCAN_DIRECTORIES_ONLY) != 0
+          && type != G_FILE_TYPE_DIRECTORY)
+        continue;
+
+      child_file = g_file_get_child (dir->file, d->d_name);
+
+      if ((context->scan_flags & LUNAR_IO_SCAN_LUNAR_FILES) != 0)
+        file = lunar_file_get (child_file, NULL);
+      else
+        file = g_object_ref (child_file);
+
+      if (G_LIKELY (file != NULL))
+        lunar_io_scan_add_child (context, dir, file, child_file, type, size, TRUE);
+
+      g_object_unref (child_file);
+    }
+
+  closedir (dp);
+
+  return TRUE;
+}
+#endif
+
+
+
+static gboolean
+lunar_io_scan_gio (ScanContext *context,
+                   ScanDir     *dir,
+                   GError     **error)
+{
+  GFileEnumerator *enumerator;
+  GFileInfo       *info;
+  GError          *err = NULL;
+  GFile           *child_file;
+  GList           *infos;
+  GList           *lp;
+  gpointer         file;
+  guint64          size;
+
+  /* try to read from the directory */
+  enumerator = g_file_enumerate_children (dir->file, context->namespace,
+                                          context->flags, context->cancellable,
+                                          &err);
+
+  /* abort if there was an error or the job was cancelled */
+  if (err != NULL)
+    {
+      g_propagate_error (error, err);
+      return FALSE;
+    }
+
+  /* iterate over the children in batches */
+  while (!lunar_io_scan_is_cancelled (context))
+    {
+      /* query the infos of the next children, this only
+       * returns NULL at the end or with err set */
+      infos = g_file_enumerator_next_files (enumerator, LUNAR_IO_SCAN_BATCH_SIZE,
+                                            context->cancellable, &err);
+      if (infos == NULL)
+        break;
+
+      for (lp = infos; lp != NULL; lp = lp->next)
         {
-          child_files = lunar_io_scan_directory (job, child_file, flags, recursively,
-                                                  unlinking, return_lunar_files, &err);
+          info = lp->data;
+
+          if ((context->scan_flags & LUNAR_IO_SCAN_DIRECTORIES_ONLY) != 0
+              && g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY)
+            continue;
+
+          /* create GFile for the child */
+          child_file = g_file_get_child (dir->file, g_file_info_get_name (info));
+
+          /* the directories only have the type, query the rest */
+          if ((context->scan_flags & LUNAR_IO_SCAN_DIRECTORIES_ONLY) != 0
+              && (context->scan_flags & LUNAR_IO_SCAN_LUNAR_FILES) != 0)
+            file = lunar_file_get (child_file, NULL);
+          else if ((context->scan_flags & LUNAR_IO_SCAN_LUNAR_FILES) != 0)
+            file = lunar_file_get_with_info (child_file, info, FALSE);
+          else
+            file = g_object_ref (child_file);
 
-          /* prepend children to the file list to make sure they're
-           * processed first (required for unlinking) */
-          files = g_list_concat (child_files, files);
+          if ((context->scan_flags & LUNAR_IO_SCAN_QUERY_SIZE) != 0)
+            size = g_file_info_get_size (info);
+          else
+            size = 0;
+
+          if (G_LIKELY (file != NULL))
+            lunar_io_scan_add_child (context, dir, file, child_file,
+                                     g_file_info_get_file_type (info),
+                                     size, TRUE);
+
+          g_object_unref (child_file);
         }
 
-      g_object_unref (child_file);
-      g_object_unref (info);
+      g_list_free_full (infos, g_object_unref);
     }
 
   /* release the enumerator */
@@ -168,15 +516,421 @@ lunar_io_scan_directory (LunarJob          *job,
   if (G_UNLIKELY (err != NULL))
     {
       g_propagate_error (error, err);
-      lunar_g_file_list_free (files);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+static gboolean
+lunar_io_scan_dir (ScanContext *context,
+                   ScanDir     *dir,
+                   GError     **error)
+{
+#ifdef LUNAR_IO_SCAN_NATIVE
+  gboolean succeed;
+  gchar   *path;
+#endif
+
+  /* don't recurse when we are scanning prior to unlinking and the current
+   * file/dir is in the trash. In GVfs, only the top-level directories in
+   * the trash can be modified and deleted directly. See
+   * https://bugzilla.expidus.org/show_bug.cgi?id=7147
+   * for more information */
+  if ((context->scan_flags & LUNAR_IO_SCAN_UNLINKING) != 0
+      && lunar_g_file_is_trashed (dir->file)
+      && !lunar_g_file_is_root (dir->file))
+    {
+      return TRUE;
+    }
+
+#ifdef LUNAR_IO_SCAN_NATIVE
+  /* lunar files need the full file info, so only use the fast
+   * path if the name and type (and size) are sufficient, or the
+   * few directories are queried on their own */
+  if (((context->scan_flags & LUNAR_IO_SCAN_LUNAR_FILES) == 0
+       || (context->scan_flags & LUNAR_IO_SCAN_DIRECTORIES_ONLY) != 0)
+      && g_file_is_native (dir->file))
+    {
+      path = g_file_get_path (dir->file);
+      if (G_LIKELY (path != NULL))
+        {
+          succeed = lunar_io_scan_native (context, dir, path, error);
+          g_free (path);
+          return succeed;
+        }
+    }
+#endif
+
+  return lunar_io_scan_gio (context, dir, error);
+}
+
+
+
+static void
+lunar_io_scan_worker (gpointer data,
+                      gpointer user_data)
+{
+  ScanContext *context = user_data;
+  ScanDir     *dir = data;
+  GError      *err = NULL;
+
+  if (!lunar_io_scan_is_cancelled (context)
+      && !lunar_io_scan_dir (context, dir, &err))
+    lunar_io_scan_set_error (context, err);
+
+  /* subdirectories were queued before we get here, so the
+   * pending count only drops to zero once the whole tree is done */
+  g_mutex_lock (&context->lock);
+  if (--context->n_pending == 0)
+    g_cond_signal (&context->cond);
+  g_mutex_unlock (&context->lock);
+}
+
+
+
+static void
+lunar_io_scan_flatten (ScanDir *dir,
+                       GArray  *entries)
+{
+  LunarIoScanEntry entry;
+  ScanChild        *child;
+  guint             n;
+  guint             i;
+
+  for (n = 0; n < dir->children->len; ++n)
+    {
+      child = &g_array_index (dir->children, ScanChild, n);
+
+      /* add the children first, this is required for unlinking */
+      if (child->dir != NULL)
+        lunar_io_scan_flatten (child->dir, entries);
+
+      /* move the file into the flat array */
+      entry.file = child->file;
+      entry.type = child->type;
+      entry.size = child->size;
+      entry.parent = -1;
+      g_array_append_val (entries, entry);
+
+      child->file = NULL;
+      child->index = entries->len - 1;
+
+      if (child->dir != NULL)
+        {
+          /* point the immediate children to the directory entry */
+          for (i = 0; i < child->dir->children->len; ++i)
+            g_array_index (entries, LunarIoScanEntry, g_array_index (child->dir->children, ScanChild, i).index).parent = child->index;
+
+          /* the subtree is done */
+          lunar_io_scan_dir_free (child->dir);
+          child->dir = NULL;
+        }
+    }
+}
+
+
+
+static void
+lunar_io_scan_context_init (ScanContext        *context,
+                            LunarJob          *job,
+                            GFileQueryInfoFlags flags,
+                            LunarIoScanFlags    scan_flags)
+{
+  context->job = job;
+  context->cancellable = job != NULL ? endo_job_get_cancellable (ENDO_JOB (job)) : NULL;
+  context->flags = flags;
+  context->scan_flags = scan_flags;
+  context->pool = NULL;
+  context->chunk_func = NULL;
+  context->chunk_data = NULL;
+  context->n_pending = 0;
+  context->error = NULL;
+  context->failed = FALSE;
+
+  /* determine the namespace, directories queried
+   * as lunar files only need the type at first */
+  if ((scan_flags & LUNAR_IO_SCAN_LUNAR_FILES) != 0
+      && (scan_flags & LUNAR_IO_SCAN_DIRECTORIES_ONLY) == 0)
+    context->namespace = LUNARX_FILE_INFO_NAMESPACE;
+  else if ((scan_flags & LUNAR_IO_SCAN_QUERY_SIZE) != 0)
+    context->namespace = G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                         G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                         G_FILE_ATTRIBUTE_STANDARD_SIZE;
+  else
+    context->namespace = G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                         G_FILE_ATTRIBUTE_STANDARD_NAME;
+}
+
+
+
+/**
+ * lunar_io_scan_directory_entries:
+ * @job        : a #LunarJob or %NULL.
+ * @file       : the directory #GFile to scan.
+ * @flags      : #GFileQueryInfoFlags used to query the children.
+ * @scan_flags : #LunarIoScanFlags.
+ * @error      : return location for errors or %NULL.
+ *
+ * Collects the children of @file into a flat array of #LunarIoScanEntry<!---->s.
+ * With %LUNAR_IO_SCAN_RECURSIVE the subdirectories are scanned in parallel
+ * by a bounded pool of worker threads, using readdir() and fstatat() on
+ * local paths and #GFileEnumerator otherwise.
+ *
+ * The entries are ordered children-before-parent, so the array can be
+ * processed front to back when unlinking.
+ *
+ * Return value: the #GArray of entries, which should be released with
+ *               g_array_free(), or %NULL on error or cancellation.
+ **/
+GArray *
+lunar_io_scan_directory_entries (LunarJob          *job,
+                                 GFile              *file,
+                                 GFileQueryInfoFlags flags,
+                                 LunarIoScanFlags    scan_flags,
+                                 GError            **error)
+{
+  ScanContext context;
+  ScanDir    *root;
+  GFileType   type;
+  GArray     *entries;
+  GError     *err = NULL;
+
+  _lunar_return_val_if_fail (G_IS_FILE (file), NULL);
+  _lunar_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  /* abort if the job was cancelled */
+  if (job != NULL && endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
+    return NULL;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (LunarIoScanEntry));
+  g_array_set_clear_func (entries, lunar_io_scan_entry_clear);
+
+  /* see lunar_io_scan_dir() */
+  if ((scan_flags & LUNAR_IO_SCAN_UNLINKING) != 0
+      && lunar_g_file_is_trashed (file)
+      && !lunar_g_file_is_root (file))
+    {
+      return entries;
+    }
+
+  lunar_io_scan_context_init (&context, job, flags, scan_flags);
+
+  /* query the file type */
+  type = g_file_query_file_type (file, flags, context.cancellable);
+
+  /* abort if the job was cancelled */
+  if (job != NULL && endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
+    {
+      g_array_free (entries, TRUE);
       return NULL;
     }
-  else if (job != NULL && endo_job_set_error_if_cancelled (ENDO_JOB (job), &err))
+
+  /* ignore non-directory nodes */
+  if (type != G_FILE_TYPE_DIRECTORY)
+    return entries;
+
+  g_mutex_init (&context.lock);
+  g_cond_init (&context.cond);
+
+  root = lunar_io_scan_dir_new (file);
+
+  if ((scan_flags & LUNAR_IO_SCAN_RECURSIVE) != 0)
+    {
+      context.pool = g_thread_pool_new (lunar_io_scan_worker, &context,
+                                        LUNAR_IO_SCAN_MAX_WORKERS,
+                                        FALSE, NULL);
+
+      /* queue the root and wait until the whole tree is scanned */
+      context.n_pending = 1;
+      g_thread_pool_push (context.pool, root, NULL);
+
+      g_mutex_lock (&context.lock);
+      while (context.n_pending > 0)
+        g_cond_wait (&context.cond, &context.lock);
+      g_mutex_unlock (&context.lock);
+
+      g_thread_pool_free (context.pool, FALSE, TRUE);
+    }
+  else if (!lunar_io_scan_dir (&context, root, &err))
+    {
+      /* a single directory, scanned in the calling thread */
+      lunar_io_scan_set_error (&context, err);
+    }
+
+  g_mutex_clear (&context.lock);
+  g_cond_clear (&context.cond);
+
+  err = context.error;
+  if (err == NULL && job != NULL)
+    endo_job_set_error_if_cancelled (ENDO_JOB (job), &err);
+
+  if (G_UNLIKELY (err != NULL))
     {
       g_propagate_error (error, err);
-      lunar_g_file_list_free (files);
+      lunar_io_scan_dir_free (root);
+      g_array_free (entries, TRUE);
       return NULL;
     }
 
+  lunar_io_scan_flatten (root, entries);
+  lunar_io_scan_dir_free (root);
+
+  return entries;
+}
+
+
+
+/**
+ * lunar_io_scan_directory_chunked:
+ * @job              : a #LunarJob or %NULL.
+ * @file             : the directory #GFile to scan.
+ * @flags            : #GFileQueryInfoFlags used to query the children.
+ * @scan_flags       : #LunarIoScanFlags, without %LUNAR_IO_SCAN_RECURSIVE.
+ * @first_chunk_size : the number of children passed in the first chunk.
+ * @chunk_interval   : the maximum time in microseconds between two chunks.
+ * @chunk_func       : the function to call with every chunk.
+ * @user_data        : user data for @chunk_func.
+ * @error            : return location for errors or %NULL.
+ *
+ * Scans the children of @file like lunar_io_scan_directory_entries(),
+ * but passes them to @chunk_func while scanning: first once
+ * @first_chunk_size children are found, and then with the children
+ * found since the previous chunk every @chunk_interval. The remaining
+ * children are passed when the scan is done. @chunk_func is called in
+ * the calling thread and may steal the files from the entries.
+ *
+ * Return value: %FALSE on error or cancellation.
+ **/
+gboolean
+lunar_io_scan_directory_chunked (LunarJob            *job,
+                                 GFile                *file,
+                                 GFileQueryInfoFlags   flags,
+                                 LunarIoScanFlags      scan_flags,
+                                 guint                 first_chunk_size,
+                                 gint64                chunk_interval,
+                                 LunarIoScanChunkFunc  chunk_func,
+                                 gpointer              user_data,
+                                 GError              **error)
+{
+  ScanContext context;
+  ScanDir    *root;
+  GFileType   type;
+  GError     *err = NULL;
+
+  _lunar_return_val_if_fail (G_IS_FILE (file), FALSE);
+  _lunar_return_val_if_fail ((scan_flags & LUNAR_IO_SCAN_RECURSIVE) == 0, FALSE);
+  _lunar_return_val_if_fail (chunk_func != NULL, FALSE);
+  _lunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /* abort if the job was cancelled */
+  if (job != NULL && endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
+    return FALSE;
+
+  lunar_io_scan_context_init (&context, job, flags, scan_flags);
+  context.chunk_func = chunk_func;
+  context.chunk_data = user_data;
+  context.chunk_size = MAX (first_chunk_size, 1);
+  context.chunk_interval = chunk_interval;
+  context.chunk_time = g_get_monotonic_time ();
+
+  /* query the file type */
+  type = g_file_query_file_type (file, flags, context.cancellable);
+
+  /* abort if the job was cancelled */
+  if (job != NULL && endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
+    return FALSE;
+
+  /* non-directory nodes have no children */
+  if (type != G_FILE_TYPE_DIRECTORY)
+    return TRUE;
+
+  g_mutex_init (&context.lock);
+  g_cond_init (&context.cond);
+
+  /* a single directory, scanned in the calling thread */
+  root = lunar_io_scan_dir_new (file);
+  if (!lunar_io_scan_dir (&context, root, &err))
+    lunar_io_scan_set_error (&context, err);
+
+  g_mutex_clear (&context.lock);
+  g_cond_clear (&context.cond);
+
+  err = context.error;
+  if (err == NULL && job != NULL)
+    endo_job_set_error_if_cancelled (ENDO_JOB (job), &err);
+
+  /* pass the remaining children */
+  if (G_LIKELY (err == NULL))
+    lunar_io_scan_flush_chunk (&context, root);
+
+  lunar_io_scan_dir_free (root);
+
+  if (G_UNLIKELY (err != NULL))
+    {
+      g_propagate_error (error, err);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+/**
+ * lunar_io_scan_entries_to_list:
+ * @entries : a #GArray of #LunarIoScanEntry<!---->s.
+ *
+ * Return value: a list of the files in @entries, in the same order. Free
+ *               with lunar_g_file_list_free().
+ **/
+GList *
+lunar_io_scan_entries_to_list (GArray *entries)
+{
+  GList *files = NULL;
+  guint  n;
+
+  _lunar_return_val_if_fail (entries != NULL, NULL);
+
+  for (n = entries->len; n > 0; --n)
+    files = lunar_g_file_list_prepend (files, g_array_index (entries, LunarIoScanEntry, n - 1).file);
+
+  return files;
+}
+
+
+
+GList *
+lunar_io_scan_directory (LunarJob          *job,
+                          GFile              *file,
+                          GFileQueryInfoFlags flags,
+                          gboolean            recursively,
+                          gboolean            unlinking,
+                          gboolean            return_lunar_files,
+                          GError            **error)
+{
+  LunarIoScanFlags scan_flags = LUNAR_IO_SCAN_NONE;
+  GArray           *entries;
+  GList            *files;
+
+  _lunar_return_val_if_fail (G_IS_FILE (file), NULL);
+  _lunar_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (recursively)
+    scan_flags |= LUNAR_IO_SCAN_RECURSIVE;
+  if (unlinking)
+    scan_flags |= LUNAR_IO_SCAN_UNLINKING;
+  if (return_lunar_files)
+    scan_flags |= LUNAR_IO_SCAN_LUNAR_FILES;
+
+  entries = lunar_io_scan_directory_entries (job, file, flags, scan_flags, error);
+  if (entries == NULL)
+    return NULL;
+
+  files = lunar_io_scan_entries_to_list (entries);
+  g_array_free (entries, TRUE);
+
   return files;
 }
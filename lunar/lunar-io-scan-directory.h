@@ -28,13 +28,83 @@
 
 G_BEGIN_DECLS
 
-GList *lunar_io_scan_directory (LunarJob          *job,
-                                 GFile              *file,
-                                 GFileQueryInfoFlags flags,
-                                 gboolean            recursively,
-                                 gboolean            unlinking,
-                                 gboolean            return_lunar_files,
-                                 GError            **error);
+/**
+ * LunarIoScanFlags:
+ * @LUNAR_IO_SCAN_NONE             : only scan the immediate children.
+ * @LUNAR_IO_SCAN_RECURSIVE        : descend into subdirectories.
+ * @LUNAR_IO_SCAN_UNLINKING        : the scan is done prior to unlinking, don't
+ *                                   descend into directories in the trash.
+ * @LUNAR_IO_SCAN_LUNAR_FILES      : return #LunarFile<!---->s instead of #GFile<!---->s.
+ * @LUNAR_IO_SCAN_QUERY_SIZE       : fill in the size of the entries.
+ * @LUNAR_IO_SCAN_DIRECTORIES_ONLY : only return the directories.
+ **/
+typedef enum /*< flags >*/
+{
+  LUNAR_IO_SCAN_NONE             = 0,
+  LUNAR_IO_SCAN_RECURSIVE        = 1 << 0,
+  LUNAR_IO_SCAN_UNLINKING        = 1 << 1,
+  LUNAR_IO_SCAN_LUNAR_FILES      = 1 << 2,
+  LUNAR_IO_SCAN_QUERY_SIZE       = 1 << 3,
+  LUNAR_IO_SCAN_DIRECTORIES_ONLY = 1 << 4,
+} LunarIoScanFlags;
+
+typedef struct _LunarIoScanEntry LunarIoScanEntry;
+
+/**
+ * LunarIoScanEntry:
+ * @file   : the #GFile (or #LunarFile) of the entry, owned by the array.
+ * @type   : the #GFileType of the entry.
+ * @size   : the size of the entry, only set with %LUNAR_IO_SCAN_QUERY_SIZE.
+ * @parent : index of the parent directory entry in the array, or -1
+ *           if the entry is an immediate child of the scanned directory.
+ *
+ * Entries are stored children-before-parent, so the index of the parent
+ * is always larger than the index of the entry itself.
+ **/
+struct _LunarIoScanEntry
+{
+  gpointer  file;
+  GFileType type;
+  guint64   size;
+  gint      parent;
+};
+
+GArray *lunar_io_scan_directory_entries (LunarJob          *job,
+                                         GFile              *file,
+                                         GFileQueryInfoFlags flags,
+                                         LunarIoScanFlags    scan_flags,
+                                         GError            **error);
+
+/**
+ * LunarIoScanChunkFunc:
+ * @entries   : a #GArray of #LunarIoScanEntry<!---->s.
+ * @user_data : the user data passed to lunar_io_scan_directory_chunked().
+ *
+ * Receives the entries found by lunar_io_scan_directory_chunked()
+ * since its previous call.
+ **/
+typedef void (*LunarIoScanChunkFunc) (GArray   *entries,
+                                      gpointer  user_data);
+
+gboolean lunar_io_scan_directory_chunked (LunarJob            *job,
+                                          GFile                *file,
+                                          GFileQueryInfoFlags   flags,
+                                          LunarIoScanFlags      scan_flags,
+                                          guint                 first_chunk_size,
+                                          gint64                chunk_interval,
+                                          LunarIoScanChunkFunc  chunk_func,
+                                          gpointer              user_data,
+                                          GError              **error);
+
+GList  *lunar_io_scan_entries_to_list   (GArray             *entries);
+
+GList  *lunar_io_scan_directory         (LunarJob          *job,
+                                         GFile              *file,
+                                         GFileQueryInfoFlags flags,
+                                         gboolean            recursively,
+                                         gboolean            unlinking,
+                                         gboolean            return_lunar_files,
+                                         GError            **error);
 
 G_END_DECLS
 
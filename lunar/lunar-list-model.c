@@ -59,11 +59,41 @@ enum
 enum
 {
   ERROR,
+  STATUSBAR_CHANGED,
   LAST_SIGNAL,
 };
 
 
 
+/* the weight a folder is counted with in the totals */
+#define LUNAR_LIST_MODEL_FOLDER_WEIGHT G_MAXUINT64
+
+
+
+/* below this number of files per thread, rows are sorted in the main thread */
+#define LUNAR_LIST_MODEL_SORT_CHUNK_MIN 8192
+
+
+
+typedef struct _LunarListModelTotals      LunarListModelTotals;
+typedef struct _LunarListModelSortKey     LunarListModelSortKey;
+typedef struct _LunarListModelSortContext LunarListModelSortContext;
+typedef struct _LunarListModelSortChunk   LunarListModelSortChunk;
+
+
+
+/* what the sort keys of the rows hold */
+typedef enum
+{
+  LUNAR_SORT_KEY_NAME,         /* only the name */
+  LUNAR_SORT_KEY_NUMBER,       /* a date, size or mode */
+  LUNAR_SORT_KEY_CONTENT_TYPE, /* the content type */
+  LUNAR_SORT_KEY_ACCOUNT,      /* the owner or group name, with the id as fallback */
+  LUNAR_SORT_KEY_DESCRIPTION,  /* the type description */
+} LunarSortKeyKind;
+
+
+
 typedef gint (*LunarSortFunc) (const LunarFile *a,
                                 const LunarFile *b,
                                 gboolean          case_sensitive);
@@ -134,9 +164,25 @@ static void               lunar_list_model_set_sort_func         (GtkTreeSortabl
                                                                    gpointer                data,
                                                                    GDestroyNotify          destroy);
 static gboolean           lunar_list_model_has_default_sort_func (GtkTreeSortable        *sortable);
+static void               lunar_list_model_forget_file           (LunarListModel        *store,
+                                                                   LunarFile             *file);
+static void               lunar_list_model_forget_column         (LunarListModel        *store,
+                                                                   LunarColumn            column);
+static void               lunar_list_model_forget_all            (LunarListModel        *store);
+static void               lunar_list_model_weight_free           (gpointer                data);
+static void               lunar_list_model_count_file            (LunarListModel        *store,
+                                                                   LunarFile             *file);
+static void               lunar_list_model_uncount_file          (LunarListModel        *store,
+                                                                   LunarFile             *file);
+static gboolean           lunar_list_model_recount_file          (LunarListModel        *store,
+                                                                   LunarFile             *file);
+static void               lunar_list_model_uncount_all           (LunarListModel        *store);
+static void               lunar_list_model_cancel_image_size     (LunarListModel        *store);
 static gint               lunar_list_model_cmp_func              (gconstpointer           a,
                                                                    gconstpointer           b,
                                                                    gpointer                user_data);
+static void               lunar_list_model_insert_files          (LunarListModel        *store,
+                                                                   GPtrArray              *files);
 static void               lunar_list_model_sort                  (LunarListModel        *store);
 static void               lunar_list_model_file_changed          (LunarFileMonitor      *file_monitor,
                                                                    LunarFile             *file,
@@ -199,8 +245,47 @@ struct _LunarListModelClass
   GObjectClass __parent__;
 
   /* signals */
-  void (*error) (LunarListModel *store,
-                 const GError    *error);
+  void (*error)             (LunarListModel *store,
+                             const GError    *error);
+  void (*statusbar_changed) (LunarListModel *store);
+};
+
+struct _LunarListModelTotals
+{
+  guint   n_folders;
+  guint   n_files;
+  guint64 size;
+};
+
+/* the value a row is sorted by, extracted once per
+ * sort so comparisons don't call into the file */
+struct _LunarListModelSortKey
+{
+  LunarFile   *file;
+  const gchar  *string;
+  guint64       number;
+  guint         index;
+  guint         is_directory : 1;
+  guint         has_info : 1;
+};
+
+/* copy of the sort settings, the keys are compared in threads */
+struct _LunarListModelSortContext
+{
+  LunarSortKeyKind kind;
+  gboolean          folders_first;
+  gboolean          case_sensitive;
+  gint              sign;
+};
+
+/* a range of keys sorted or merged by one thread */
+struct _LunarListModelSortChunk
+{
+  LunarListModelSortContext *context;
+  LunarListModelSortKey     *keys;
+  LunarListModelSortKey     *dest;
+  guint                      middle;
+  guint                      n_keys;
 };
 
 struct _LunarListModel
@@ -215,7 +300,9 @@ struct _LunarListModel
   gint           stamp;
 #endif
 
-  GSequence      *rows;
+  /* the visible files in sort order, the position
+   * in this array is the row index in the model */
+  GPtrArray      *rows;
   GSList         *hidden;
   LunarFolder   *folder;
   gboolean        show_hidden : 1;
@@ -223,6 +310,35 @@ struct _LunarListModel
   LunarDateStyle date_style;
   char           *date_custom_style;
 
+  /* LunarFile -> string formatted for display, one table per column
+   * so a setting change only drops the affected column. The tables
+   * are allocated on demand for the columns that are shown.
+   */
+  GHashTable     *column_strings[LUNAR_N_VISIBLE_COLUMNS];
+
+  /* dates may be shown relative to today, so their
+   * strings are dropped at midnight */
+  gint64          date_strings_expire;
+
+  /* LunarFile -> the size (boxed guint64) each row is counted
+   * with in the totals, or LUNAR_LIST_MODEL_FOLDER_WEIGHT, so
+   * the totals can be updated without walking all rows */
+  GHashTable     *weights;
+  LunarListModelTotals totals;
+
+  /* the rows selected in the view, mapped to the stamp of the
+   * last lunar_list_model_set_selected_files() listing them */
+  GHashTable     *selection;
+  guint           selection_stamp;
+  LunarListModelTotals selection_totals;
+
+  /* dimensions of the single selected image, probed in a
+   * thread; -1 while probing and 0 if unknown */
+  LunarFile     *image_size_file;
+  GCancellable   *image_size_cancellable;
+  gint            image_width;
+  gint            image_height;
+
   /* Use the shared LunarFileMonitor instance, so we
    * do not need to connect "changed" handler to every
    * file in the model.
@@ -382,6 +498,24 @@ lunar_list_model_class_init (LunarListModelClass *klass)
                   NULL, NULL,
                   g_cclosure_marshal_VOID__POINTER,
                   G_TYPE_NONE, 1, G_TYPE_POINTER);
+
+  /**
+   * LunarListModel::statusbar-changed:
+   * @store : a #LunarListModel.
+   *
+   * Emitted when the text returned by lunar_list_model_get_statusbar_text()
+   * changed without a change of the number of files or the selection, i.e.
+   * because the size of a file changed or the dimensions of the selected
+   * image are known.
+   **/
+  list_model_signals[STATUSBAR_CHANGED] =
+    g_signal_new (I_("statusbar-changed"),
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (LunarListModelClass, statusbar_changed),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
 }
 
 
@@ -441,7 +575,9 @@ lunar_list_model_init (LunarListModel *store)
   store->sort_folders_first = TRUE;
   store->sort_sign = 1;
   store->sort_func = lunar_file_compare_by_name;
-  store->rows = g_sequence_new (g_object_unref);
+  store->rows = g_ptr_array_new ();
+  store->weights = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, lunar_list_model_weight_free);
+  store->selection = g_hash_table_new (g_direct_hash, g_direct_equal);
 
   /* connect to the shared LunarFileMonitor, so we don't need to
    * connect "changed" to every single LunarFile we own.
@@ -469,7 +605,15 @@ lunar_list_model_finalize (GObject *object)
 {
   LunarListModel *store = LUNAR_LIST_MODEL (object);
 
-  g_sequence_free (store->rows);
+  g_ptr_array_foreach (store->rows, (GFunc) (void (*)(void)) g_object_unref, NULL);
+  g_ptr_array_free (store->rows, TRUE);
+
+  lunar_list_model_forget_all (store);
+
+  g_hash_table_destroy (store->selection);
+  g_hash_table_destroy (store->weights);
+
+  lunar_list_model_cancel_image_size (store);
 
   /* disconnect from the file monitor */
   g_signal_handlers_disconnect_by_func (G_OBJECT (store->file_monitor), lunar_list_model_file_changed, store);
@@ -579,7 +723,8 @@ lunar_list_model_set_property (GObject      *object,
 static GtkTreeModelFlags
 lunar_list_model_get_flags (GtkTreeModel *model)
 {
-  return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+  /* iterators are row indices, so they do not persist */
+  return GTK_TREE_MODEL_LIST_ONLY;
 }
 
 
@@ -647,7 +792,6 @@ lunar_list_model_get_iter (GtkTreeModel *model,
                             GtkTreePath  *path)
 {
   LunarListModel *store = LUNAR_LIST_MODEL (model);
-  GSequenceIter   *row;
   gint             offset;
 
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), FALSE);
@@ -655,11 +799,9 @@ lunar_list_model_get_iter (GtkTreeModel *model,
 
   /* determine the row for the path */
   offset = gtk_tree_path_get_indices (path)[0];
-  row = g_sequence_get_iter_at_pos (store->rows, offset);
-
-  if (!g_sequence_iter_is_end (row))
+  if (offset >= 0 && (guint) offset < store->rows->len)
     {
-      GTK_TREE_ITER_INIT (*iter, store->stamp, row);
+      GTK_TREE_ITER_INIT (*iter, store->stamp, GINT_TO_POINTER (offset));
       return TRUE;
     }
 
@@ -678,8 +820,8 @@ lunar_list_model_get_path (GtkTreeModel *model,
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), NULL);
   _lunar_return_val_if_fail (iter->stamp == store->stamp, NULL);
 
-  idx = g_sequence_iter_get_position (iter->user_data);
-  if (G_LIKELY (idx >= 0))
+  idx = GPOINTER_TO_INT (iter->user_data);
+  if (G_LIKELY ((guint) idx < store->rows->len))
     return gtk_tree_path_new_from_indices (idx, -1);
 
   return NULL;
@@ -687,66 +829,28 @@ lunar_list_model_get_path (GtkTreeModel *model,
 
 
 
-static void
-lunar_list_model_get_value (GtkTreeModel *model,
-                             GtkTreeIter  *iter,
-                             gint          column,
-                             GValue       *value)
+static gchar*
+lunar_list_model_format_column (LunarListModel *store,
+                                 LunarFile      *file,
+                                 LunarColumn     column)
 {
-  LunarGroup *group;
   const gchar *content_type;
   const gchar *name;
   const gchar *real_name;
   LunarUser  *user;
-  LunarFile  *file;
-  gchar       *str;
-
-  _lunar_return_if_fail (LUNAR_IS_LIST_MODEL (model));
-  _lunar_return_if_fail (iter->stamp == (LUNAR_LIST_MODEL (model))->stamp);
-
-  file = g_sequence_get (iter->user_data);
-  _lunar_return_if_fail (LUNAR_IS_FILE (file));
+  gchar       *str = NULL;
 
   switch (column)
     {
     case LUNAR_COLUMN_DATE_ACCESSED:
-      g_value_init (value, G_TYPE_STRING);
-      str = lunar_file_get_date_string (file, LUNAR_FILE_DATE_ACCESSED, LUNAR_LIST_MODEL (model)->date_style, LUNAR_LIST_MODEL (model)->date_custom_style);
-      g_value_take_string (value, str);
+      str = lunar_file_get_date_string (file, LUNAR_FILE_DATE_ACCESSED, store->date_style, store->date_custom_style);
       break;
 
     case LUNAR_COLUMN_DATE_MODIFIED:
-      g_value_init (value, G_TYPE_STRING);
-      str = lunar_file_get_date_string (file, LUNAR_FILE_DATE_MODIFIED, LUNAR_LIST_MODEL (model)->date_style, LUNAR_LIST_MODEL (model)->date_custom_style);
-      g_value_take_string (value, str);
-      break;
-
-    case LUNAR_COLUMN_GROUP:
-      g_value_init (value, G_TYPE_STRING);
-      group = lunar_file_get_group (file);
-      if (G_LIKELY (group != NULL))
-        {
-          g_value_set_string (value, lunar_group_get_name (group));
-          g_object_unref (G_OBJECT (group));
-        }
-      else
-        {
-          g_value_set_static_string (value, _("Unknown"));
-        }
-      break;
-
-    case LUNAR_COLUMN_MIME_TYPE:
-      g_value_init (value, G_TYPE_STRING);
-      g_value_set_static_string (value, lunar_file_get_content_type (file));
-      break;
-
-    case LUNAR_COLUMN_NAME:
-      g_value_init (value, G_TYPE_STRING);
-      g_value_set_static_string (value, lunar_file_get_display_name (file));
+      str = lunar_file_get_date_string (file, LUNAR_FILE_DATE_MODIFIED, store->date_style, store->date_custom_style);
       break;
 
     case LUNAR_COLUMN_OWNER:
-      g_value_init (value, G_TYPE_STRING);
       user = lunar_file_get_user (file);
       if (G_LIKELY (user != NULL))
         {
@@ -762,42 +866,317 @@ lunar_list_model_get_value (GtkTreeModel *model,
             }
           else
             str = g_strdup (name);
-          g_value_take_string (value, str);
           g_object_unref (G_OBJECT (user));
         }
       else
         {
-          g_value_set_static_string (value, _("Unknown"));
+          str = g_strdup (_("Unknown"));
         }
       break;
 
     case LUNAR_COLUMN_PERMISSIONS:
-      g_value_init (value, G_TYPE_STRING);
-      g_value_take_string (value, lunar_file_get_mode_string (file));
+      str = lunar_file_get_mode_string (file);
       break;
 
     case LUNAR_COLUMN_SIZE:
-      g_value_init (value, G_TYPE_STRING);
-      g_value_take_string (value, lunar_file_get_size_string_formatted (file, LUNAR_LIST_MODEL (model)->file_size_binary));
+      str = lunar_file_get_size_string_formatted (file, store->file_size_binary);
       break;
 
     case LUNAR_COLUMN_SIZE_IN_BYTES:
-      g_value_init (value, G_TYPE_STRING);
-      g_value_take_string (value, lunar_file_get_size_in_bytes_string (file));
+      str = lunar_file_get_size_in_bytes_string (file);
       break;
 
     case LUNAR_COLUMN_TYPE:
-      g_value_init (value, G_TYPE_STRING);
       if (G_UNLIKELY (lunar_file_is_symlink (file)))
-        g_value_take_string (value, g_strdup_printf (_("link to %s"), lunar_file_get_symlink_target (file)));
+        str = g_strdup_printf (_("link to %s"), lunar_file_get_symlink_target (file));
       else
         {
           content_type = lunar_file_get_content_type (file);
           if (content_type != NULL)
-            g_value_take_string (value, g_content_type_get_description (content_type));
+            str = g_content_type_get_description (content_type);
+        }
+      break;
+
+    default:
+      _lunar_assert_not_reached ();
+      break;
+    }
+
+  return str;
+}
+
+
+
+/* returns the display string of column for file, which is only formatted
+ * the first time it is asked for and then kept until the file changes */
+static const gchar*
+lunar_list_model_get_column_string (LunarListModel *store,
+                                     LunarFile      *file,
+                                     LunarColumn     column)
+{
+  GHashTable *strings;
+  GDateTime  *now;
+  GDateTime  *midnight;
+  gpointer    str;
+
+  if (column == LUNAR_COLUMN_DATE_ACCESSED || column == LUNAR_COLUMN_DATE_MODIFIED)
+    {
+      if (G_UNLIKELY (g_get_real_time () >= store->date_strings_expire))
+        {
+          lunar_list_model_forget_column (store, LUNAR_COLUMN_DATE_ACCESSED);
+          lunar_list_model_forget_column (store, LUNAR_COLUMN_DATE_MODIFIED);
+
+          /* "Today" becomes "Yesterday" at the next midnight */
+          now = g_date_time_new_now_local ();
+          midnight = g_date_time_new_local (g_date_time_get_year (now), g_date_time_get_month (now),
+                                            g_date_time_get_day_of_month (now), 0, 0, 0);
+          store->date_strings_expire = (g_date_time_to_unix (midnight) + 24 * 60 * 60) * G_USEC_PER_SEC;
+          g_date_time_unref (midnight);
+          g_date_time_unref (now);
+        }
+    }
+
+  strings = store->column_strings[column];
+  if (G_UNLIKELY (strings == NULL))
+    {
+      strings = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+      store->column_strings[column] = strings;
+    }
+
+  if (!g_hash_table_lookup_extended (strings, file, NULL, &str))
+    {
+      str = lunar_list_model_format_column (store, file, column);
+      g_hash_table_insert (strings, file, str);
+    }
+
+  return str;
+}
+
+
+
+static void
+lunar_list_model_forget_file (LunarListModel *store,
+                               LunarFile      *file)
+{
+  guint n;
+
+  for (n = 0; n < G_N_ELEMENTS (store->column_strings); ++n)
+    if (store->column_strings[n] != NULL)
+      g_hash_table_remove (store->column_strings[n], file);
+}
+
+
+
+static void
+lunar_list_model_forget_column (LunarListModel *store,
+                                 LunarColumn     column)
+{
+  g_clear_pointer (&store->column_strings[column], g_hash_table_destroy);
+}
+
+
+
+static void
+lunar_list_model_forget_all (LunarListModel *store)
+{
+  guint n;
+
+  for (n = 0; n < G_N_ELEMENTS (store->column_strings); ++n)
+    g_clear_pointer (&store->column_strings[n], g_hash_table_destroy);
+}
+
+
+
+static void
+lunar_list_model_weight_free (gpointer data)
+{
+  g_slice_free (guint64, data);
+}
+
+
+
+static guint64
+lunar_list_model_get_weight (LunarFile *file)
+{
+  if (lunar_file_is_directory (file))
+    return LUNAR_LIST_MODEL_FOLDER_WEIGHT;
+
+  /* only regular files add to the size */
+  return lunar_file_is_regular (file) ? lunar_file_get_size (file) : 0;
+}
+
+
+
+static void
+lunar_list_model_totals_add (LunarListModelTotals *totals,
+                              guint64                weight)
+{
+  if (weight == LUNAR_LIST_MODEL_FOLDER_WEIGHT)
+    {
+      totals->n_folders++;
+    }
+  else
+    {
+      totals->n_files++;
+      totals->size += weight;
+    }
+}
+
+
+
+static void
+lunar_list_model_totals_subtract (LunarListModelTotals *totals,
+                                   guint64                weight)
+{
+  if (weight == LUNAR_LIST_MODEL_FOLDER_WEIGHT)
+    {
+      totals->n_folders--;
+    }
+  else
+    {
+      totals->n_files--;
+      totals->size -= weight;
+    }
+}
+
+
+
+/* adds a file that was inserted into the rows to the totals */
+static void
+lunar_list_model_count_file (LunarListModel *store,
+                              LunarFile      *file)
+{
+  guint64 *weight;
+
+  weight = g_slice_new (guint64);
+  *weight = lunar_list_model_get_weight (file);
+  g_hash_table_insert (store->weights, file, weight);
+
+  lunar_list_model_totals_add (&store->totals, *weight);
+}
+
+
+
+/* removes a file that was removed from the rows from the totals
+ * and the selection */
+static void
+lunar_list_model_uncount_file (LunarListModel *store,
+                                LunarFile      *file)
+{
+  guint64 *weight;
+
+  weight = g_hash_table_lookup (store->weights, file);
+  if (G_UNLIKELY (weight == NULL))
+    return;
+
+  lunar_list_model_totals_subtract (&store->totals, *weight);
+  if (g_hash_table_remove (store->selection, file))
+    lunar_list_model_totals_subtract (&store->selection_totals, *weight);
+
+  g_hash_table_remove (store->weights, file);
+}
+
+
+
+/* updates the totals for a changed file, returns %FALSE if the
+ * file is not in the rows */
+static gboolean
+lunar_list_model_recount_file (LunarListModel *store,
+                                LunarFile      *file)
+{
+  guint64 *weight;
+  guint64  new_weight;
+
+  weight = g_hash_table_lookup (store->weights, file);
+  if (weight == NULL)
+    return FALSE;
+
+  new_weight = lunar_list_model_get_weight (file);
+  if (new_weight != *weight)
+    {
+      lunar_list_model_totals_subtract (&store->totals, *weight);
+      lunar_list_model_totals_add (&store->totals, new_weight);
+
+      if (g_hash_table_contains (store->selection, file))
+        {
+          lunar_list_model_totals_subtract (&store->selection_totals, *weight);
+          lunar_list_model_totals_add (&store->selection_totals, new_weight);
+        }
+
+      *weight = new_weight;
+
+      g_signal_emit (G_OBJECT (store), list_model_signals[STATUSBAR_CHANGED], 0);
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+lunar_list_model_uncount_all (LunarListModel *store)
+{
+  g_hash_table_remove_all (store->selection);
+  g_hash_table_remove_all (store->weights);
+  memset (&store->totals, 0, sizeof (store->totals));
+  memset (&store->selection_totals, 0, sizeof (store->selection_totals));
+}
+
+
+
+static void
+lunar_list_model_get_value (GtkTreeModel *model,
+                             GtkTreeIter  *iter,
+                             gint          column,
+                             GValue       *value)
+{
+  LunarGroup *group;
+  LunarFile  *file;
+
+  _lunar_return_if_fail (LUNAR_IS_LIST_MODEL (model));
+  _lunar_return_if_fail (iter->stamp == (LUNAR_LIST_MODEL (model))->stamp);
+
+  file = g_ptr_array_index (LUNAR_LIST_MODEL (model)->rows, GPOINTER_TO_INT (iter->user_data));
+  _lunar_return_if_fail (LUNAR_IS_FILE (file));
+
+  switch (column)
+    {
+    case LUNAR_COLUMN_DATE_ACCESSED:
+    case LUNAR_COLUMN_DATE_MODIFIED:
+    case LUNAR_COLUMN_OWNER:
+    case LUNAR_COLUMN_PERMISSIONS:
+    case LUNAR_COLUMN_SIZE:
+    case LUNAR_COLUMN_SIZE_IN_BYTES:
+    case LUNAR_COLUMN_TYPE:
+      /* the string stays valid until the file changes */
+      g_value_init (value, G_TYPE_STRING);
+      g_value_set_static_string (value, lunar_list_model_get_column_string (LUNAR_LIST_MODEL (model), file, column));
+      break;
+
+    case LUNAR_COLUMN_GROUP:
+      g_value_init (value, G_TYPE_STRING);
+      group = lunar_file_get_group (file);
+      if (G_LIKELY (group != NULL))
+        {
+          g_value_set_string (value, lunar_group_get_name (group));
+          g_object_unref (G_OBJECT (group));
+        }
+      else
+        {
+          g_value_set_static_string (value, _("Unknown"));
         }
       break;
 
+    case LUNAR_COLUMN_MIME_TYPE:
+      g_value_init (value, G_TYPE_STRING);
+      g_value_set_static_string (value, lunar_file_get_content_type (file));
+      break;
+
+    case LUNAR_COLUMN_NAME:
+      g_value_init (value, G_TYPE_STRING);
+      g_value_set_static_string (value, lunar_file_get_display_name (file));
+      break;
+
     case LUNAR_COLUMN_FILE:
       g_value_init (value, LUNAR_TYPE_FILE);
       g_value_set_object (value, file);
@@ -823,8 +1202,8 @@ lunar_list_model_iter_next (GtkTreeModel *model,
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (model), FALSE);
   _lunar_return_val_if_fail (iter->stamp == (LUNAR_LIST_MODEL (model))->stamp, FALSE);
 
-  iter->user_data = g_sequence_iter_next (iter->user_data);
-  return !g_sequence_iter_is_end (iter->user_data);
+  iter->user_data = GINT_TO_POINTER (GPOINTER_TO_INT (iter->user_data) + 1);
+  return (guint) GPOINTER_TO_INT (iter->user_data) < LUNAR_LIST_MODEL (model)->rows->len;
 }
 
 
@@ -839,9 +1218,9 @@ lunar_list_model_iter_children (GtkTreeModel *model,
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), FALSE);
 
   if (G_LIKELY (parent == NULL
-      && g_sequence_get_length (store->rows) > 0))
+      && store->rows->len > 0))
     {
-      GTK_TREE_ITER_INIT (*iter, store->stamp, g_sequence_get_begin_iter (store->rows));
+      GTK_TREE_ITER_INIT (*iter, store->stamp, GINT_TO_POINTER (0));
       return TRUE;
     }
 
@@ -867,7 +1246,7 @@ lunar_list_model_iter_n_children (GtkTreeModel *model,
 
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), 0);
 
-  return (iter == NULL) ? g_sequence_get_length (store->rows) : 0;
+  return (iter == NULL) ? (gint) store->rows->len : 0;
 }
 
 
@@ -879,17 +1258,15 @@ lunar_list_model_iter_nth_child (GtkTreeModel *model,
                                   gint          n)
 {
   LunarListModel *store = LUNAR_LIST_MODEL (model);
-  GSequenceIter   *row;
 
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), FALSE);
 
   if (G_LIKELY (parent == NULL))
     {
-      row = g_sequence_get_iter_at_pos (store->rows, n);
-      if (g_sequence_iter_is_end (row))
+      if (n < 0 || (guint) n >= store->rows->len)
         return FALSE;
 
-      GTK_TREE_ITER_INIT (*iter, store->stamp, row);
+      GTK_TREE_ITER_INIT (*iter, store->stamp, GINT_TO_POINTER (n));
       return TRUE;
     }
 
@@ -1092,7 +1469,479 @@ lunar_list_model_cmp_func (gconstpointer a,
         return isdir_a ? -1 : 1;
     }
 
-  return (*store->sort_func) (a, b, store->sort_case_sensitive) * store->sort_sign;
+  return (*store->sort_func) (a, b, store->sort_case_sensitive) * store->sort_sign;
+}
+
+
+
+/* compares two elements of a LunarFile pointer array */
+static gint
+lunar_list_model_cmp_file_ptr (gconstpointer a,
+                                gconstpointer b,
+                                gpointer      user_data)
+{
+  return lunar_list_model_cmp_func (*(LunarFile **) a, *(LunarFile **) b, user_data);
+}
+
+
+
+/* compares two row indices by the files in those rows */
+static gint
+lunar_list_model_cmp_row_index (gconstpointer a,
+                                 gconstpointer b,
+                                 gpointer      user_data)
+{
+  LunarListModel *store = LUNAR_LIST_MODEL (user_data);
+
+  return lunar_list_model_cmp_func (g_ptr_array_index (store->rows, *(const gint *) a),
+                                     g_ptr_array_index (store->rows, *(const gint *) b),
+                                     store);
+}
+
+
+
+/* returns the row index at which file would be inserted,
+ * after all rows that compare equal to it */
+static guint
+lunar_list_model_search_position (LunarListModel *store,
+                                   LunarFile      *file)
+{
+  guint lower = 0;
+  guint upper = store->rows->len;
+  guint middle;
+
+  while (lower < upper)
+    {
+      middle = lower + (upper - lower) / 2;
+      if (lunar_list_model_cmp_func (g_ptr_array_index (store->rows, middle), file, store) <= 0)
+        lower = middle + 1;
+      else
+        upper = middle;
+    }
+
+  return lower;
+}
+
+
+
+static gboolean
+lunar_list_model_get_sort_key_kind (LunarListModel   *store,
+                                     LunarSortKeyKind *kind)
+{
+  if (store->sort_func == lunar_file_compare_by_name)
+    *kind = LUNAR_SORT_KEY_NAME;
+  else if (store->sort_func == sort_by_date_accessed
+           || store->sort_func == sort_by_date_modified
+           || store->sort_func == sort_by_permissions
+           || store->sort_func == sort_by_size
+           || store->sort_func == sort_by_size_in_bytes)
+    *kind = LUNAR_SORT_KEY_NUMBER;
+  else if (store->sort_func == sort_by_mime_type)
+    *kind = LUNAR_SORT_KEY_CONTENT_TYPE;
+  else if (store->sort_func == sort_by_owner
+           || store->sort_func == sort_by_group)
+    *kind = LUNAR_SORT_KEY_ACCOUNT;
+  else if (store->sort_func == sort_by_type)
+    *kind = LUNAR_SORT_KEY_DESCRIPTION;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+
+
+/* returns the description shown in the type column for file, symlinks
+ * are displayed as "link to ..." in the detailed list view */
+static gchar*
+lunar_list_model_get_type_description (const LunarFile *file)
+{
+  const gchar *content_type;
+
+  if (lunar_file_is_symlink (file))
+    return g_strdup_printf (_("link to %s"), lunar_file_get_symlink_target (file));
+
+  content_type = lunar_file_get_content_type (LUNAR_FILE (file));
+  if (G_UNLIKELY (content_type == NULL))
+    return NULL;
+
+  return g_content_type_get_description (content_type);
+}
+
+
+
+/* compares two descriptions of the type column, a missing description
+ * compares equal to any other, so the names of the files decide */
+static gint
+lunar_list_model_cmp_type_descriptions (const gchar *description_a,
+                                         const gchar *description_b,
+                                         gboolean     case_sensitive)
+{
+  if (description_a == NULL || description_b == NULL)
+    return 0;
+
+  if (!case_sensitive)
+    return strcasecmp (description_a, description_b);
+  else
+    return strcmp (description_a, description_b);
+}
+
+
+
+/* fills in the key of file the same way store->sort_func looks at it,
+ * strings that are not owned by the file are put in strings */
+static void
+lunar_list_model_init_sort_key (LunarListModel        *store,
+                                 LunarListModelSortKey *key,
+                                 LunarSortKeyKind       kind,
+                                 GStringChunk           *strings,
+                                 GHashTable             *descriptions)
+{
+  const gchar *content_type;
+  LunarGroup *group;
+  LunarUser  *user;
+  gchar       *description;
+
+  key->is_directory = lunar_file_is_directory (key->file);
+  key->has_info = lunar_file_get_info (key->file) != NULL;
+  key->string = NULL;
+  key->number = 0;
+
+  switch (kind)
+    {
+    case LUNAR_SORT_KEY_NAME:
+      break;
+
+    case LUNAR_SORT_KEY_NUMBER:
+      if (store->sort_func == sort_by_date_accessed)
+        key->number = lunar_file_get_date (key->file, LUNAR_FILE_DATE_ACCESSED);
+      else if (store->sort_func == sort_by_date_modified)
+        key->number = lunar_file_get_date (key->file, LUNAR_FILE_DATE_MODIFIED);
+      else if (store->sort_func == sort_by_permissions)
+        key->number = lunar_file_get_mode (key->file);
+      else
+        key->number = lunar_file_get_size (key->file);
+      break;
+
+    case LUNAR_SORT_KEY_CONTENT_TYPE:
+      key->string = lunar_file_get_content_type (key->file);
+      if (key->string == NULL)
+        key->string = "";
+      break;
+
+    case LUNAR_SORT_KEY_ACCOUNT:
+      if (!key->has_info)
+        break;
+
+      if (store->sort_func == sort_by_owner)
+        {
+          user = lunar_file_get_user (key->file);
+          if (user != NULL)
+            {
+              key->string = g_string_chunk_insert_const (strings, lunar_user_get_name (user));
+              g_object_unref (user);
+            }
+          key->number = g_file_info_get_attribute_uint32 (lunar_file_get_info (key->file),
+                                                          G_FILE_ATTRIBUTE_UNIX_UID);
+        }
+      else
+        {
+          group = lunar_file_get_group (key->file);
+          if (group != NULL)
+            {
+              key->string = g_string_chunk_insert_const (strings, lunar_group_get_name (group));
+              g_object_unref (group);
+            }
+          key->number = g_file_info_get_attribute_uint32 (lunar_file_get_info (key->file),
+                                                          G_FILE_ATTRIBUTE_UNIX_GID);
+        }
+      break;
+
+    case LUNAR_SORT_KEY_DESCRIPTION:
+      /* a folder holds few different types, so look up each description
+       * once, symlinks are described by their targets instead */
+      content_type = lunar_file_is_symlink (key->file) ? NULL : lunar_file_get_content_type (key->file);
+      if (content_type == NULL
+          || !g_hash_table_lookup_extended (descriptions, content_type, NULL, (gpointer *) &key->string))
+        {
+          description = lunar_list_model_get_type_description (key->file);
+          if (description != NULL)
+            key->string = g_string_chunk_insert_const (strings, description);
+          if (content_type != NULL)
+            g_hash_table_insert (descriptions, (gpointer) content_type, (gpointer) key->string);
+          g_free (description);
+        }
+      break;
+    }
+}
+
+
+
+/* compares two sort keys like lunar_list_model_cmp_func() compares
+ * their files, keys that compare equal stay in their old order */
+static gint
+lunar_list_model_cmp_sort_key (gconstpointer a,
+                                gconstpointer b,
+                                gpointer      user_data)
+{
+  const LunarListModelSortContext *context = user_data;
+  const LunarListModelSortKey     *key_a = a;
+  const LunarListModelSortKey     *key_b = b;
+  gint                              result = 0;
+
+  if (G_LIKELY (context->folders_first) && key_a->is_directory != key_b->is_directory)
+    return key_a->is_directory ? -1 : 1;
+
+  switch (context->kind)
+    {
+    case LUNAR_SORT_KEY_NAME:
+      break;
+
+    case LUNAR_SORT_KEY_NUMBER:
+      if (key_a->number < key_b->number)
+        result = -1;
+      else if (key_a->number > key_b->number)
+        result = 1;
+      break;
+
+    case LUNAR_SORT_KEY_CONTENT_TYPE:
+      result = strcasecmp (key_a->string, key_b->string);
+      break;
+
+    case LUNAR_SORT_KEY_ACCOUNT:
+      if (!key_a->has_info || !key_b->has_info)
+        break;
+
+      if (key_a->string != NULL && key_b->string != NULL)
+        {
+          if (!context->case_sensitive)
+            result = strcasecmp (key_a->string, key_b->string);
+          else
+            result = strcmp (key_a->string, key_b->string);
+        }
+      else
+        {
+          result = CLAMP ((gint) key_a->number - (gint) key_b->number, -1, 1);
+        }
+      break;
+
+    case LUNAR_SORT_KEY_DESCRIPTION:
+      result = lunar_list_model_cmp_type_descriptions (key_a->string, key_b->string,
+                                                        context->case_sensitive);
+      break;
+    }
+
+  /* the collation keys of the names are built with atomic operations,
+   * so this is safe to call from the sort threads */
+  if (result == 0)
+    result = lunar_file_compare_by_name (key_a->file, key_b->file, context->case_sensitive);
+
+  if (result == 0)
+    return (key_a->index < key_b->index) ? -1 : 1;
+
+  return result * context->sign;
+}
+
+
+
+static gpointer
+lunar_list_model_sort_chunk (gpointer data)
+{
+  LunarListModelSortChunk *chunk = data;
+
+  g_qsort_with_data (chunk->keys, chunk->n_keys, sizeof (LunarListModelSortKey),
+                     lunar_list_model_cmp_sort_key, chunk->context);
+
+  return NULL;
+}
+
+
+
+/* merges the sorted ranges before and after chunk->middle into chunk->dest */
+static gpointer
+lunar_list_model_merge_chunk (gpointer data)
+{
+  LunarListModelSortChunk *chunk = data;
+  guint                    i = 0;
+  guint                    j = chunk->middle;
+  guint                    n = 0;
+
+  while (i < chunk->middle && j < chunk->n_keys)
+    {
+      if (lunar_list_model_cmp_sort_key (&chunk->keys[j], &chunk->keys[i], chunk->context) < 0)
+        chunk->dest[n++] = chunk->keys[j++];
+      else
+        chunk->dest[n++] = chunk->keys[i++];
+    }
+
+  memcpy (chunk->dest + n, chunk->keys + i, (chunk->middle - i) * sizeof (LunarListModelSortKey));
+  n += chunk->middle - i;
+  memcpy (chunk->dest + n, chunk->keys + j, (chunk->n_keys - j) * sizeof (LunarListModelSortKey));
+
+  return NULL;
+}
+
+
+
+/* runs func for every chunk, all but the first in a new thread */
+static void
+lunar_list_model_run_chunks (GThreadFunc              func,
+                              LunarListModelSortChunk *chunks,
+                              guint                    n_chunks)
+{
+  GThread **threads;
+  guint     n;
+
+  threads = g_new0 (GThread *, n_chunks);
+  for (n = 1; n < n_chunks; ++n)
+    {
+      threads[n] = g_thread_try_new ("lunar-sort", func, &chunks[n], NULL);
+      if (G_UNLIKELY (threads[n] == NULL))
+        (*func) (&chunks[n]);
+    }
+
+  (*func) (&chunks[0]);
+
+  for (n = 1; n < n_chunks; ++n)
+    if (threads[n] != NULL)
+      g_thread_join (threads[n]);
+
+  g_free (threads);
+}
+
+
+
+/* sorts keys by sorting ranges of it in threads, then merging
+ * pairs of neighbouring ranges in threads until one is left */
+static void
+lunar_list_model_sort_keys (LunarListModelSortKey     *keys,
+                             guint                      n_keys,
+                             LunarListModelSortContext *context)
+{
+  LunarListModelSortChunk *chunks;
+  LunarListModelSortKey   *buffer;
+  LunarListModelSortKey   *src;
+  LunarListModelSortKey   *dest;
+  guint                   *bounds;
+  guint                    n_ranges;
+  guint                    n_chunks;
+  guint                    n;
+
+  n_ranges = MIN ((guint) g_get_num_processors (), n_keys / LUNAR_LIST_MODEL_SORT_CHUNK_MIN);
+  if (n_ranges <= 1)
+    {
+      g_qsort_with_data (keys, n_keys, sizeof (LunarListModelSortKey),
+                         lunar_list_model_cmp_sort_key, context);
+      return;
+    }
+
+  chunks = g_new0 (LunarListModelSortChunk, n_ranges);
+
+  /* bounds[n] is the start of the nth range */
+  bounds = g_new (guint, n_ranges + 1);
+  for (n = 0; n <= n_ranges; ++n)
+    bounds[n] = (guint) ((guint64) n_keys * n / n_ranges);
+
+  for (n = 0; n < n_ranges; ++n)
+    {
+      chunks[n].context = context;
+      chunks[n].keys = keys + bounds[n];
+      chunks[n].n_keys = bounds[n + 1] - bounds[n];
+    }
+  lunar_list_model_run_chunks (lunar_list_model_sort_chunk, chunks, n_ranges);
+
+  buffer = g_new (LunarListModelSortKey, n_keys);
+  src = keys;
+  dest = buffer;
+
+  while (n_ranges > 1)
+    {
+      n_chunks = n_ranges / 2;
+      for (n = 0; n < n_chunks; ++n)
+        {
+          chunks[n].keys = src + bounds[2 * n];
+          chunks[n].dest = dest + bounds[2 * n];
+          chunks[n].middle = bounds[2 * n + 1] - bounds[2 * n];
+          chunks[n].n_keys = bounds[2 * n + 2] - bounds[2 * n];
+        }
+      lunar_list_model_run_chunks (lunar_list_model_merge_chunk, chunks, n_chunks);
+
+      /* an odd range is left for the next pass */
+      if (n_ranges % 2 != 0)
+        {
+          memcpy (dest + bounds[n_ranges - 1], src + bounds[n_ranges - 1],
+                  (n_keys - bounds[n_ranges - 1]) * sizeof (LunarListModelSortKey));
+        }
+
+      for (n = 0; n <= n_chunks; ++n)
+        bounds[n] = bounds[MIN (2 * n, n_ranges)];
+      if (n_ranges % 2 != 0)
+        bounds[++n_chunks] = n_keys;
+      n_ranges = n_chunks;
+
+      src = dest;
+      dest = (dest == buffer) ? keys : buffer;
+    }
+
+  if (src != keys)
+    memcpy (keys, src, n_keys * sizeof (LunarListModelSortKey));
+
+  g_free (buffer);
+  g_free (bounds);
+  g_free (chunks);
+}
+
+
+
+/* sorts files with the sort settings of store by extracting a key
+ * per file first, so the comparisons do not have to look up owners,
+ * descriptions or content types again and again. If new_order
+ * is not NULL, it receives the old index of every sorted file.
+ * Returns FALSE if the sort function has no keys. */
+static gboolean
+lunar_list_model_sort_files (LunarListModel *store,
+                              gpointer       *files,
+                              guint           n_files,
+                              gint           *new_order)
+{
+  LunarListModelSortContext  context;
+  LunarListModelSortKey     *keys;
+  GStringChunk               *strings;
+  GHashTable                 *descriptions;
+  guint                       n;
+
+  if (!lunar_list_model_get_sort_key_kind (store, &context.kind))
+    return FALSE;
+
+  context.folders_first = store->sort_folders_first;
+  context.case_sensitive = store->sort_case_sensitive;
+  context.sign = store->sort_sign;
+
+  strings = g_string_chunk_new (4096);
+  descriptions = g_hash_table_new (g_str_hash, g_str_equal);
+
+  keys = g_new (LunarListModelSortKey, n_files);
+  for (n = 0; n < n_files; ++n)
+    {
+      keys[n].file = files[n];
+      keys[n].index = n;
+      lunar_list_model_init_sort_key (store, &keys[n], context.kind, strings, descriptions);
+    }
+
+  lunar_list_model_sort_keys (keys, n_files, &context);
+
+  for (n = 0; n < n_files; ++n)
+    {
+      files[n] = keys[n].file;
+      if (new_order != NULL)
+        new_order[n] = keys[n].index;
+    }
+
+  g_free (keys);
+  g_hash_table_destroy (descriptions);
+  g_string_chunk_free (strings);
+
+  return TRUE;
 }
 
 
@@ -1100,57 +1949,41 @@ lunar_list_model_cmp_func (gconstpointer a,
 static void
 lunar_list_model_sort (LunarListModel *store)
 {
-  GtkTreePath    *path;
-  GSequenceIter **old_order;
-  gint           *new_order;
-  gint            n;
-  gint            length;
-  GSequenceIter  *row;
+  GtkTreePath *path;
+  gpointer    *old_rows;
+  gint        *new_order;
+  guint        n;
+  guint        length;
 
   _lunar_return_if_fail (LUNAR_IS_LIST_MODEL (store));
 
-  length = g_sequence_get_length (store->rows);
+  length = store->rows->len;
   if (G_UNLIKELY (length <= 1))
     return;
 
-  /* be sure to not overuse the stack */
-  if (G_LIKELY (length < 2000))
-    {
-      old_order = g_newa (GSequenceIter *, length);
-      new_order = g_newa (gint, length);
-    }
-  else
-    {
-      old_order = g_new (GSequenceIter *, length);
-      new_order = g_new (gint, length);
-    }
-
-  /* store old order */
-  row = g_sequence_get_begin_iter (store->rows);
-  for (n = 0; n < length; ++n)
+  /* new_order[newpos] = oldpos */
+  new_order = g_new (gint, length);
+  if (!lunar_list_model_sort_files (store, store->rows->pdata, length, new_order))
     {
-      old_order[n] = row;
-      row = g_sequence_iter_next (row);
+      /* sorted by the files in the old positions */
+      for (n = 0; n < length; ++n)
+        new_order[n] = n;
+      g_qsort_with_data (new_order, length, sizeof (gint), lunar_list_model_cmp_row_index, store);
+
+      /* move the files into their new rows */
+      old_rows = g_new (gpointer, length);
+      memcpy (old_rows, store->rows->pdata, length * sizeof (gpointer));
+      for (n = 0; n < length; ++n)
+        store->rows->pdata[n] = old_rows[new_order[n]];
+      g_free (old_rows);
     }
 
-  /* sort */
-  g_sequence_sort (store->rows, lunar_list_model_cmp_func, store);
-
-  /* new_order[newpos] = oldpos */
-  for (n = 0; n < length; ++n)
-    new_order[g_sequence_iter_get_position (old_order[n])] = n;
-
   /* tell the view about the new item order */
   path = gtk_tree_path_new_first ();
   gtk_tree_model_rows_reordered (GTK_TREE_MODEL (store), path, NULL, new_order);
   gtk_tree_path_free (path);
 
-  /* clean up if we used the heap */
-  if (G_UNLIKELY (length >= 2000))
-    {
-      g_free (old_order);
-      g_free (new_order);
-    }
+  g_free (new_order);
 }
 
 
@@ -1160,10 +1993,8 @@ lunar_list_model_file_changed (LunarFileMonitor *file_monitor,
                                 LunarFile        *file,
                                 LunarListModel   *store)
 {
-  GSequenceIter *row;
-  GSequenceIter *end;
   gint           pos_after;
-  gint           pos_before = 0;
+  gint           pos_before;
   gint          *new_order;
   gint           length;
   gint           i, j;
@@ -1174,25 +2005,57 @@ lunar_list_model_file_changed (LunarFileMonitor *file_monitor,
   _lunar_return_if_fail (LUNAR_IS_LIST_MODEL (store));
   _lunar_return_if_fail (LUNAR_IS_FILE (file));
 
-  row = g_sequence_get_begin_iter (store->rows);
-  end = g_sequence_get_end_iter (store->rows);
+  /* the monitor reports the files of all folders */
+  if (!lunar_list_model_recount_file (store, file))
+    return;
+
+  /* probe the dimensions of the image again */
+  if (G_UNLIKELY (file == store->image_size_file))
+    lunar_list_model_cancel_image_size (store);
 
-  while (row != end)
+  /* format the columns of the file again when they are drawn */
+  lunar_list_model_forget_file (store, file);
+
+  /* most changes (i.e. thumbnails becoming ready) leave the sort order
+   * alone, so look for the file where it would be sorted to first */
+  for (pos_after = lunar_list_model_search_position (store, file); pos_after > 0; --pos_after)
     {
-      if (G_UNLIKELY (g_sequence_get (row) == file))
+      if (g_ptr_array_index (store->rows, pos_after - 1) == file)
         {
-          /* generate the iterator for this row */
-          GTK_TREE_ITER_INIT (iter, store->stamp, row);
+          /* the search may have passed the file itself, so the row is only
+           * in order if it still sorts between its neighbours */
+          pos_before = pos_after - 1;
+          if ((pos_before > 0
+               && lunar_list_model_cmp_func (g_ptr_array_index (store->rows, pos_before - 1), file, store) > 0)
+              || ((guint) pos_after < store->rows->len
+                  && lunar_list_model_cmp_func (file, g_ptr_array_index (store->rows, pos_after), store) > 0))
+            break;
+
+          /* the row is still in order, just redraw it */
+          GTK_TREE_ITER_INIT (iter, store->stamp, GINT_TO_POINTER (pos_before));
+          path = gtk_tree_path_new_from_indices (pos_before, -1);
+          gtk_tree_model_row_changed (GTK_TREE_MODEL (store), path, &iter);
+          gtk_tree_path_free (path);
+          return;
+        }
 
-          _lunar_assert (pos_before == g_sequence_iter_get_position (row));
+      /* stop at the first row that sorts before the file */
+      if (lunar_list_model_cmp_func (g_ptr_array_index (store->rows, pos_after - 1), file, store) != 0)
+        break;
+    }
 
+  for (pos_before = 0; (guint) pos_before < store->rows->len; ++pos_before)
+    {
+      if (G_UNLIKELY (g_ptr_array_index (store->rows, pos_before) == file))
+        {
           /* check if the sorting changed */
-          g_sequence_sort_changed (row, lunar_list_model_cmp_func, store);
-          pos_after = g_sequence_iter_get_position (row);
+          g_ptr_array_remove_index (store->rows, pos_before);
+          pos_after = lunar_list_model_search_position (store, file);
+          g_ptr_array_insert (store->rows, pos_after, file);
           if (pos_after != pos_before)
             {
               /* do swap sorting here since its much faster than a complete sort */
-              length = g_sequence_get_length (store->rows);
+              length = store->rows->len;
               if (G_LIKELY (length < 2000))
                 new_order = g_newa (gint, length);
               else
@@ -1223,15 +2086,15 @@ lunar_list_model_file_changed (LunarFileMonitor *file_monitor,
                 g_free (new_order);
             }
 
+          /* generate the iterator for this row */
+          GTK_TREE_ITER_INIT (iter, store->stamp, GINT_TO_POINTER (pos_after));
+
           /* notify the view that it has to redraw the file */
-          path = gtk_tree_path_new_from_indices (pos_before, -1);
+          path = gtk_tree_path_new_from_indices (pos_after, -1);
           gtk_tree_model_row_changed (GTK_TREE_MODEL (store), path, &iter);
           gtk_tree_path_free (path);
           break;
         }
-
-      row = g_sequence_iter_next (row);
-      pos_before++;
     }
 }
 
@@ -1269,61 +2132,128 @@ lunar_list_model_folder_error (LunarFolder    *folder,
 
 
 
+/* sorts the files into the rows of the store, the files
+ * must be referenced already and are owned by the store afterwards */
+static void
+lunar_list_model_insert_files (LunarListModel *store,
+                                GPtrArray      *files)
+{
+  GtkTreePath *path;
+  GtkTreeIter  iter;
+  GPtrArray   *rows;
+  gboolean     has_handler;
+  gint        *indices;
+  guint       *inserted;
+  guint        n_inserted = 0;
+  guint        lower, upper, middle;
+  guint        i, j;
+
+  if (G_UNLIKELY (files->len == 0))
+    return;
+
+  /* sort the new files once, then merge them into the rows
+   * in a single pass instead of moving the rows per file */
+  if (!lunar_list_model_sort_files (store, files->pdata, files->len, NULL))
+    {
+      g_qsort_with_data (files->pdata, files->len, sizeof (gpointer),
+                         lunar_list_model_cmp_file_ptr, store);
+    }
+
+  rows = g_ptr_array_sized_new (store->rows->len + files->len);
+  inserted = g_new (guint, files->len);
+  for (i = 0, j = 0; j < files->len; ++j)
+    {
+      /* look up the position of the file in the remaining rows, a
+       * loading folder adds small chunks to many rows, so this needs
+       * less comparisons than walking all rows; equal files are
+       * inserted after the existing rows */
+      lower = i;
+      upper = store->rows->len;
+      while (lower < upper)
+        {
+          middle = lower + (upper - lower) / 2;
+          if (lunar_list_model_cmp_func (g_ptr_array_index (store->rows, middle),
+                                         g_ptr_array_index (files, j), store) <= 0)
+            lower = middle + 1;
+          else
+            upper = middle;
+        }
+
+      /* move the rows before it */
+      for (; i < lower; ++i)
+        g_ptr_array_add (rows, g_ptr_array_index (store->rows, i));
+
+      inserted[n_inserted++] = rows->len;
+      g_ptr_array_add (rows, g_ptr_array_index (files, j));
+    }
+
+  /* and the rows after the last file */
+  for (; i < store->rows->len; ++i)
+    g_ptr_array_add (rows, g_ptr_array_index (store->rows, i));
+
+  g_ptr_array_free (store->rows, TRUE);
+  store->rows = rows;
+
+  for (j = 0; j < files->len; ++j)
+    lunar_list_model_count_file (store, g_ptr_array_index (files, j));
+
+  /* check if we have any handlers connected for "row-inserted" */
+  has_handler = g_signal_has_handler_pending (G_OBJECT (store), store->row_inserted_id, 0, FALSE);
+  if (has_handler)
+    {
+      /* we use a simple trick here to avoid allocating
+       * GtkTreePath's again and again, by simply accessing
+       * the indices directly and only modifying the first
+       * item in the integer array... looks a hack, eh?
+       *
+       * The rows are announced in ascending order, so all rows
+       * before the one inserted are already known to the view.
+       */
+      path = gtk_tree_path_new_first ();
+      indices = gtk_tree_path_get_indices (path);
+
+      for (i = 0; i < n_inserted; ++i)
+        {
+          GTK_TREE_ITER_INIT (iter, store->stamp, GUINT_TO_POINTER (inserted[i]));
+          indices[0] = inserted[i];
+          gtk_tree_model_row_inserted (GTK_TREE_MODEL (store), path, &iter);
+        }
+
+      gtk_tree_path_free (path);
+    }
+
+  g_free (inserted);
+}
+
+
+
 static void
 lunar_list_model_files_added (LunarFolder    *folder,
                                GList           *files,
                                LunarListModel *store)
 {
-  GtkTreePath   *path;
-  GtkTreeIter    iter;
-  LunarFile    *file;
-  gint          *indices;
-  GSequenceIter *row;
-  GList         *lp;
-  gboolean       has_handler;
-
-  /* we use a simple trick here to avoid allocating
-   * GtkTreePath's again and again, by simply accessing
-   * the indices directly and only modifying the first
-   * item in the integer array... looks a hack, eh?
-   */
-  path = gtk_tree_path_new_first ();
-  indices = gtk_tree_path_get_indices (path);
+  LunarFile *file;
+  GPtrArray  *visible;
+  GList      *lp;
 
-  /* check if we have any handlers connected for "row-inserted" */
-  has_handler = g_signal_has_handler_pending (G_OBJECT (store), store->row_inserted_id, 0, FALSE);
+  visible = g_ptr_array_new ();
 
   /* process all added files */
   for (lp = files; lp != NULL; lp = lp->next)
     {
       /* take a reference on that file */
       file = LUNAR_FILE (g_object_ref (G_OBJECT (lp->data)));
-      _lunar_return_if_fail (LUNAR_IS_FILE (file));
 
       /* check if the file should be hidden */
       if (!store->show_hidden && lunar_file_is_hidden (file))
-        {
-          store->hidden = g_slist_prepend (store->hidden, file);
-        }
+        store->hidden = g_slist_prepend (store->hidden, file);
       else
-        {
-          /* insert the file */
-          row = g_sequence_insert_sorted (store->rows, file,
-                                          lunar_list_model_cmp_func, store);
-
-          if (has_handler)
-            {
-              /* generate an iterator for the new item */
-              GTK_TREE_ITER_INIT (iter, store->stamp, row);
-
-              indices[0] = g_sequence_iter_get_position (row);
-              gtk_tree_model_row_inserted (GTK_TREE_MODEL (store), path, &iter);
-            }
-        }
+        g_ptr_array_add (visible, file);
     }
 
-  /* release the path */
-  gtk_tree_path_free (path);
+  /* insert the visible files */
+  lunar_list_model_insert_files (store, visible);
+  g_ptr_array_free (visible, TRUE);
 
   /* number of visible files may have changed */
   g_object_notify_by_pspec (G_OBJECT (store), list_model_props[PROP_NUM_FILES]);
@@ -1336,55 +2266,62 @@ lunar_list_model_files_removed (LunarFolder    *folder,
                                  GList           *files,
                                  LunarListModel *store)
 {
+  GHashTable    *removed;
+  GArray        *deleted;
+  GSList        *hp;
+  GSList        *hnext;
   GList         *lp;
-  GSequenceIter *row;
-  GSequenceIter *end;
-  GSequenceIter *next;
   GtkTreePath   *path;
-  gboolean       found;
+  LunarFile    *file;
+  guint          n;
+  guint          m;
 
-  /* drop all the referenced files from the model */
+  removed = g_hash_table_new (g_direct_hash, g_direct_equal);
   for (lp = files; lp != NULL; lp = lp->next)
-    {
-      row = g_sequence_get_begin_iter (store->rows);
-      end = g_sequence_get_end_iter (store->rows);
-
-      found = FALSE;
+    g_hash_table_add (removed, lp->data);
 
-      while (row != end)
+  /* drop the referenced files from the rows in a single pass,
+   * remembering the indices for the "row-deleted" signals */
+  deleted = g_array_new (FALSE, FALSE, sizeof (guint));
+  for (n = 0, m = 0; n < store->rows->len; ++n)
+    {
+      file = g_ptr_array_index (store->rows, n);
+      if (g_hash_table_remove (removed, file))
         {
-          next = g_sequence_iter_next (row);
-
-          if (g_sequence_get (row) == lp->data)
-            {
-              /* setup path for "row-deleted" */
-              path = gtk_tree_path_new_from_indices (g_sequence_iter_get_position (row), -1);
-
-              /* remove file from the model */
-              g_sequence_remove (row);
-
-              /* notify the view(s) */
-              gtk_tree_model_row_deleted (GTK_TREE_MODEL (store), path);
-              gtk_tree_path_free (path);
-
-              /* no need to look in the hidden files */
-              found = TRUE;
-
-              break;
-            }
-
-          row = next;
+          g_array_append_val (deleted, n);
+          lunar_list_model_uncount_file (store, file);
+          lunar_list_model_forget_file (store, file);
+          g_object_unref (G_OBJECT (file));
+        }
+      else
+        {
+          g_ptr_array_index (store->rows, m++) = file;
         }
+    }
+  g_ptr_array_set_size (store->rows, m);
 
-      /* check if the file was found */
-      if (!found)
+  /* the files not found in the rows are hidden */
+  for (hp = store->hidden; hp != NULL && g_hash_table_size (removed) > 0; hp = hnext)
+    {
+      hnext = hp->next;
+      if (g_hash_table_remove (removed, hp->data))
         {
-          /* file is hidden */
-          _lunar_assert (g_slist_find (store->hidden, lp->data) != NULL);
-          store->hidden = g_slist_remove (store->hidden, lp->data);
-          g_object_unref (G_OBJECT (lp->data));
+          g_object_unref (G_OBJECT (hp->data));
+          store->hidden = g_slist_delete_link (store->hidden, hp);
         }
     }
+  _lunar_assert (g_hash_table_size (removed) == 0);
+  g_hash_table_destroy (removed);
+
+  /* notify the view(s), from the highest index down, so the
+   * rows not announced yet keep their indices */
+  for (n = deleted->len; n > 0; --n)
+    {
+      path = gtk_tree_path_new_from_indices (g_array_index (deleted, guint, n - 1), -1);
+      gtk_tree_model_row_deleted (GTK_TREE_MODEL (store), path);
+      gtk_tree_path_free (path);
+    }
+  g_array_free (deleted, TRUE);
 
   /* this probably changed */
   g_object_notify_by_pspec (G_OBJECT (store), list_model_props[PROP_NUM_FILES]);
@@ -1619,50 +2556,14 @@ sort_by_type (const LunarFile *a,
               const LunarFile *b,
               gboolean          case_sensitive)
 {
-  const gchar *content_type_a;
-  const gchar *content_type_b;
-  gchar       *description_a = NULL;
-  gchar       *description_b = NULL;
-  gint         result;
-
-  /* we alter the description of symlinks here because they are
-   * displayed as "link to ..." in the detailed list view as well */
-
-  if (lunar_file_is_symlink (a))
-    {
-      description_a = g_strdup_printf (_("link to %s"),
-                                       lunar_file_get_symlink_target (a));
-    }
-  else
-    {
-      content_type_a = lunar_file_get_content_type (LUNAR_FILE (a));
-      description_a = g_content_type_get_description (content_type_a);
-    }
-
-  if (lunar_file_is_symlink (b))
-    {
-      description_b = g_strdup_printf (_("link to %s"),
-                                       lunar_file_get_symlink_target (b));
-    }
-  else
-    {
-      content_type_b = lunar_file_get_content_type (LUNAR_FILE (b));
-      description_b = g_content_type_get_description (content_type_b);
-    }
-
-  /* avoid calling strcasecmp with NULL parameters */
-  if (description_a == NULL || description_b == NULL)
-    {
-      g_free (description_a);
-      g_free (description_b);
+  gchar *description_a;
+  gchar *description_b;
+  gint   result;
 
-      return 0;
-    }
+  description_a = lunar_list_model_get_type_description (a);
+  description_b = lunar_list_model_get_type_description (b);
 
-  if (!case_sensitive)
-    result = strcasecmp (description_a, description_b);
-  else
-    result = strcmp (description_a, description_b);
+  result = lunar_list_model_cmp_type_descriptions (description_a, description_b, case_sensitive);
 
   g_free (description_a);
   g_free (description_b);
@@ -1784,6 +2685,8 @@ lunar_list_model_set_date_style (LunarListModel *store,
     {
       /* apply the new setting */
       store->date_style = date_style;
+      lunar_list_model_forget_column (store, LUNAR_COLUMN_DATE_ACCESSED);
+      lunar_list_model_forget_column (store, LUNAR_COLUMN_DATE_MODIFIED);
 
       /* notify listeners */
       g_object_notify_by_pspec (G_OBJECT (store), list_model_props[PROP_DATE_STYLE]);
@@ -1831,6 +2734,8 @@ lunar_list_model_set_date_custom_style (LunarListModel *store,
     {
       /* apply the new setting */
       store->date_custom_style = g_strdup (date_custom_style);
+      lunar_list_model_forget_column (store, LUNAR_COLUMN_DATE_ACCESSED);
+      lunar_list_model_forget_column (store, LUNAR_COLUMN_DATE_MODIFIED);
 
       /* notify listeners */
       g_object_notify_by_pspec (G_OBJECT (store), list_model_props[PROP_DATE_CUSTOM_STYLE]);
@@ -1872,9 +2777,7 @@ lunar_list_model_set_folder (LunarListModel *store,
   GtkTreePath   *path;
   gboolean       has_handler;
   GList         *files;
-  GSequenceIter *row;
-  GSequenceIter *end;
-  GSequenceIter *next;
+  guint          n;
 
   _lunar_return_if_fail (LUNAR_IS_LIST_MODEL (store));
   _lunar_return_if_fail (folder == NULL || LUNAR_IS_FOLDER (folder));
@@ -1889,23 +2792,23 @@ lunar_list_model_set_folder (LunarListModel *store,
       /* check if we have any handlers connected for "row-deleted" */
       has_handler = g_signal_has_handler_pending (G_OBJECT (store), store->row_deleted_id, 0, FALSE);
 
-      row = g_sequence_get_begin_iter (store->rows);
-      end = g_sequence_get_end_iter (store->rows);
-
-      /* remove existing entries */
+      /* remove existing entries, starting at the last
+       * row so no other rows have to be moved */
       path = gtk_tree_path_new_first ();
-      while (row != end)
+      for (n = store->rows->len; n > 0; --n)
         {
           /* remove the row from the list */
-          next = g_sequence_iter_next (row);
-          g_sequence_remove (row);
-          row = next;
+          g_object_unref (g_ptr_array_index (store->rows, n - 1));
+          g_ptr_array_set_size (store->rows, n - 1);
 
           /* notify the view(s) if they're actually
            * interested in the "row-deleted" signal.
            */
           if (G_LIKELY (has_handler))
-            gtk_tree_model_row_deleted (GTK_TREE_MODEL (store), path);
+            {
+              gtk_tree_path_get_indices (path)[0] = n - 1;
+              gtk_tree_model_row_deleted (GTK_TREE_MODEL (store), path);
+            }
         }
       gtk_tree_path_free (path);
 
@@ -1913,13 +2816,17 @@ lunar_list_model_set_folder (LunarListModel *store,
       g_slist_free_full (store->hidden, g_object_unref);
       store->hidden = NULL;
 
+      /* drop the strings and totals of the old files */
+      lunar_list_model_forget_all (store);
+      lunar_list_model_uncount_all (store);
+
       /* unregister signals and drop the reference */
       g_signal_handlers_disconnect_matched (G_OBJECT (store->folder), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, store);
       g_object_unref (G_OBJECT (store->folder));
     }
 
   /* ... just to be sure! */
-  _lunar_assert (g_sequence_get_length (store->rows) == 0);
+  _lunar_assert (store->rows->len == 0);
 
 #ifndef NDEBUG
   /* new stamp since the model changed */
@@ -2031,12 +2938,10 @@ lunar_list_model_set_show_hidden (LunarListModel *store,
                                    gboolean         show_hidden)
 {
   GtkTreePath   *path;
-  GtkTreeIter    iter;
+  GPtrArray     *files;
   LunarFile    *file;
   GSList        *lp;
-  GSequenceIter *row;
-  GSequenceIter *next;
-  GSequenceIter *end;
+  guint          n;
 
   _lunar_return_if_fail (LUNAR_IS_LIST_MODEL (store));
 
@@ -2048,21 +2953,13 @@ lunar_list_model_set_show_hidden (LunarListModel *store,
 
   if (store->show_hidden)
     {
+      /* move the hidden files into the rows, the references move along */
+      files = g_ptr_array_sized_new (g_slist_length (store->hidden));
       for (lp = store->hidden; lp != NULL; lp = lp->next)
-        {
-          file = LUNAR_FILE (lp->data);
+        g_ptr_array_add (files, lp->data);
+      lunar_list_model_insert_files (store, files);
+      g_ptr_array_free (files, TRUE);
 
-          /* insert file in the sorted position */
-          row = g_sequence_insert_sorted (store->rows, file,
-                                          lunar_list_model_cmp_func, store);
-
-          GTK_TREE_ITER_INIT (iter, store->stamp, row);
-
-          /* tell the view about the new row */
-          path = gtk_tree_path_new_from_indices (g_sequence_iter_get_position (row), -1);
-          gtk_tree_model_row_inserted (GTK_TREE_MODEL (store), path, &iter);
-          gtk_tree_path_free (path);
-        }
       g_slist_free (store->hidden);
       store->hidden = NULL;
     }
@@ -2071,32 +2968,30 @@ lunar_list_model_set_show_hidden (LunarListModel *store,
       _lunar_assert (store->hidden == NULL);
 
       /* remove all hidden files */
-      row = g_sequence_get_begin_iter (store->rows);
-      end = g_sequence_get_end_iter (store->rows);
-
-      while (row != end)
+      for (n = 0; n < store->rows->len;)
         {
-          next = g_sequence_iter_next (row);
-
-          file = g_sequence_get (row);
+          file = g_ptr_array_index (store->rows, n);
           if (lunar_file_is_hidden (file))
             {
-              /* store file in the list */
-              store->hidden = g_slist_prepend (store->hidden, g_object_ref (file));
+              /* move the reference of the file to the list */
+              store->hidden = g_slist_prepend (store->hidden, file);
 
               /* setup path for "row-deleted" */
-              path = gtk_tree_path_new_from_indices (g_sequence_iter_get_position (row), -1);
+              path = gtk_tree_path_new_from_indices (n, -1);
 
               /* remove file from the model */
-              g_sequence_remove (row);
+              g_ptr_array_remove_index (store->rows, n);
+              lunar_list_model_uncount_file (store, file);
+              lunar_list_model_forget_file (store, file);
 
               /* notify the view(s) */
               gtk_tree_model_row_deleted (GTK_TREE_MODEL (store), path);
               gtk_tree_path_free (path);
             }
-
-          row = next;
-          _lunar_assert (end == g_sequence_get_end_iter (store->rows));
+          else
+            {
+              ++n;
+            }
         }
     }
 
@@ -2149,6 +3044,7 @@ lunar_list_model_set_file_size_binary (LunarListModel *store,
     {
       /* apply the new setting */
       store->file_size_binary = file_size_binary;
+      lunar_list_model_forget_column (store, LUNAR_COLUMN_SIZE);
 
       /* resort the model with the new setting */
       lunar_list_model_sort (store);
@@ -2184,7 +3080,7 @@ lunar_list_model_get_file (LunarListModel *store,
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), NULL);
   _lunar_return_val_if_fail (iter->stamp == store->stamp, NULL);
 
-  return g_object_ref (g_sequence_get (iter->user_data));
+  return g_object_ref (g_ptr_array_index (store->rows, GPOINTER_TO_INT (iter->user_data)));
 }
 
 
@@ -2202,7 +3098,7 @@ static gint
 lunar_list_model_get_num_files (LunarListModel *store)
 {
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), 0);
-  return g_sequence_get_length (store->rows);
+  return store->rows->len;
 }
 
 
@@ -2230,26 +3126,15 @@ lunar_list_model_get_paths_for_files (LunarListModel *store,
                                        GList           *files)
 {
   GList         *paths = NULL;
-  GSequenceIter *row;
-  GSequenceIter *end;
-  gint           i = 0;
+  guint          i;
 
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), NULL);
 
-  row = g_sequence_get_begin_iter (store->rows);
-  end = g_sequence_get_end_iter (store->rows);
-
   /* find the rows for the given files */
-  while (row != end)
+  for (i = 0; i < store->rows->len; ++i)
     {
-      if (g_list_find (files, g_sequence_get (row)) != NULL)
-        {
-          _lunar_assert (i == g_sequence_iter_get_position (row));
-          paths = g_list_prepend (paths, gtk_tree_path_new_from_indices (i, -1));
-        }
-
-      row = g_sequence_iter_next (row);
-      i++;
+      if (g_list_find (files, g_ptr_array_index (store->rows, i)) != NULL)
+        paths = g_list_prepend (paths, gtk_tree_path_new_from_indices (i, -1));
     }
 
   return paths;
@@ -2278,10 +3163,8 @@ lunar_list_model_get_paths_for_pattern (LunarListModel *store,
 {
   GPatternSpec  *pspec;
   GList         *paths = NULL;
-  GSequenceIter *row;
-  GSequenceIter *end;
   LunarFile    *file;
-  gint           i = 0;
+  guint          i;
 
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), NULL);
   _lunar_return_val_if_fail (g_utf8_validate (pattern, -1, NULL), NULL);
@@ -2289,21 +3172,12 @@ lunar_list_model_get_paths_for_pattern (LunarListModel *store,
   /* compile the pattern */
   pspec = g_pattern_spec_new (pattern);
 
-  row = g_sequence_get_begin_iter (store->rows);
-  end = g_sequence_get_end_iter (store->rows);
-
   /* find all rows that match the given pattern */
-  while (row != end)
+  for (i = 0; i < store->rows->len; ++i)
     {
-      file = g_sequence_get (row);
+      file = g_ptr_array_index (store->rows, i);
       if (g_pattern_match_string (pspec, lunar_file_get_display_name (file)))
-        {
-          _lunar_assert (i == g_sequence_iter_get_position (row));
-          paths = g_list_prepend (paths, gtk_tree_path_new_from_indices (i, -1));
-        }
-
-      row = g_sequence_iter_next (row);
-      i++;
+        paths = g_list_prepend (paths, gtk_tree_path_new_from_indices (i, -1));
     }
 
   /* release the pattern */
@@ -2315,59 +3189,40 @@ lunar_list_model_get_paths_for_pattern (LunarListModel *store,
 
 
 /**
- * lunar_list_model_get_statusbar_text_for_files:
- * @files                        : list of files for which a text is requested
+ * lunar_list_model_get_statusbar_text_for_totals:
+ * @totals                       : the totals for which a text is requested
  * @show_file_size_binary_format : weather the file size should be displayed in binary format
  *
- * Generates the statusbar text for the given @files.
+ * Generates the statusbar text for the given @totals.
  *
  * The caller is reponsible to free the returned text using
  * g_free() when it's no longer needed.
  *
- * Return value: the statusbar text for @store with the given @files.
+ * Return value: the statusbar text for the given @totals.
  **/
 static gchar*
-lunar_list_model_get_statusbar_text_for_files (GList    *files,
-                                                gboolean  show_file_size_binary_format)
+lunar_list_model_get_statusbar_text_for_totals (const LunarListModelTotals *totals,
+                                                 gboolean                    show_file_size_binary_format)
 {
-  guint64  size_summary = 0;
-  gint     folder_count = 0;
-  gint     non_folder_count = 0;
-  GList   *lp;
   gchar   *size_string;
   gchar   *text;
   gchar   *folder_text = NULL;
   gchar   *non_folder_text = NULL;
 
-  /* analyze files */
-  for (lp = files; lp != NULL; lp = lp->next)
-    {
-      if (lunar_file_is_directory (lp->data))
-        {
-          folder_count++;
-        }
-      else
-        {
-          non_folder_count++;
-          if (lunar_file_is_regular (lp->data))
-            size_summary += lunar_file_get_size (lp->data);
-        }
-    }
-
-  if (non_folder_count > 0)
+  if (totals->n_files > 0)
     {
-      size_string = g_format_size_full (size_summary, G_FORMAT_SIZE_LONG_FORMAT | (show_file_size_binary_format ? G_FORMAT_SIZE_IEC_UNITS : G_FORMAT_SIZE_DEFAULT));
+      size_string = g_format_size_full (totals->size, G_FORMAT_SIZE_LONG_FORMAT | (show_file_size_binary_format ? G_FORMAT_SIZE_IEC_UNITS : G_FORMAT_SIZE_DEFAULT));
       non_folder_text = g_strdup_printf (ngettext ("%d file: %s",
                                                    "%d files: %s",
-                                                   non_folder_count), non_folder_count, size_string);
+                                                   totals->n_files), totals->n_files, size_string);
       g_free (size_string);
     }
 
-  if (folder_count > 0)
+  if (totals->n_folders > 0)
     {
       folder_text = g_strdup_printf (ngettext ("%d folder",
                                                "%d folders",
-                                               folder_count), folder_count);
+                                               totals->n_folders), totals->n_folders);
     }
 
   if (folder_text == NULL && non_folder_text == NULL)
@@ -2392,13 +3247,190 @@ lunar_list_model_get_statusbar_text_for_files (GList    *files,
 
 
 
+static void
+lunar_list_model_image_size_thread (GTask        *task,
+                                     gpointer      source_object,
+                                     gpointer      task_data,
+                                     GCancellable *cancellable)
+{
+  gint *size;
+
+  size = g_new (gint, 2);
+  if (gdk_pixbuf_get_file_info (task_data, &size[0], &size[1]) != NULL)
+    {
+      g_task_return_pointer (task, size, g_free);
+    }
+  else
+    {
+      g_free (size);
+      g_task_return_pointer (task, NULL, NULL);
+    }
+}
+
+
+
+static void
+lunar_list_model_image_size_ready (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  LunarListModel *store = LUNAR_LIST_MODEL (object);
+  GError          *error = NULL;
+  gint            *size;
+
+  size = g_task_propagate_pointer (G_TASK (result), &error);
+  if (error != NULL)
+    {
+      /* another file was selected in the meantime */
+      g_error_free (error);
+      return;
+    }
+
+  g_clear_object (&store->image_size_cancellable);
+
+  if (size != NULL)
+    {
+      store->image_width = size[0];
+      store->image_height = size[1];
+      g_free (size);
+    }
+  else
+    {
+      store->image_width = store->image_height = 0;
+    }
+
+  g_signal_emit (G_OBJECT (store), list_model_signals[STATUSBAR_CHANGED], 0);
+}
+
+
+
+static void
+lunar_list_model_cancel_image_size (LunarListModel *store)
+{
+  if (store->image_size_cancellable != NULL)
+    {
+      g_cancellable_cancel (store->image_size_cancellable);
+      g_clear_object (&store->image_size_cancellable);
+    }
+
+  g_clear_object (&store->image_size_file);
+}
+
+
+
+/* looks up the dimensions of the image @file, which are probed
+ * in a thread the first time, returns %FALSE if not known (yet) */
+static gboolean
+lunar_list_model_get_image_size (LunarListModel *store,
+                                  LunarFile      *file,
+                                  gint           *width,
+                                  gint           *height)
+{
+  GTask *task;
+  gchar *absolute_path;
+
+  if (store->image_size_file != file)
+    {
+      lunar_list_model_cancel_image_size (store);
+
+      absolute_path = g_file_get_path (lunar_file_get_file (file));
+      if (G_UNLIKELY (absolute_path == NULL))
+        return FALSE;
+
+      store->image_size_file = g_object_ref (file);
+      store->image_size_cancellable = g_cancellable_new ();
+      store->image_width = store->image_height = -1;
+
+      /* reading the header of the image may block on slow devices */
+      task = g_task_new (store, store->image_size_cancellable, lunar_list_model_image_size_ready, NULL);
+      g_task_set_task_data (task, absolute_path, g_free);
+      g_task_run_in_thread (task, lunar_list_model_image_size_thread);
+      g_object_unref (task);
+
+      return FALSE;
+    }
+
+  *width = store->image_width;
+  *height = store->image_height;
+
+  return store->image_width > 0;
+}
+
+
+
+/**
+ * lunar_list_model_set_selected_files:
+ * @store : a #LunarListModel instance.
+ * @files : the list of selected #LunarFile<!---->s.
+ *
+ * Tells @store which of its files are selected in the view, so
+ * lunar_list_model_get_statusbar_text() can use the totals of the
+ * selection. Only the files that were (de)selected since the last
+ * call are added to or subtracted from the totals.
+ *
+ * The stored selection is updated in place, and only walked when
+ * files were deselected.
+ **/
+void
+lunar_list_model_set_selected_files (LunarListModel *store,
+                                      GList           *files)
+{
+  GHashTableIter  iter;
+  guint64        *weight;
+  gpointer        file;
+  gpointer        stamp;
+  gpointer        file_stamp;
+  GList          *lp;
+  guint           n_selected = 0;
+
+  _lunar_return_if_fail (LUNAR_IS_LIST_MODEL (store));
+
+  /* a new stamp marks the files which are still selected */
+  if (G_UNLIKELY (++store->selection_stamp == 0))
+    store->selection_stamp = 1;
+  stamp = GUINT_TO_POINTER (store->selection_stamp);
+
+  for (lp = files; lp != NULL; lp = lp->next)
+    {
+      /* ignore files that are not in the rows */
+      weight = g_hash_table_lookup (store->weights, lp->data);
+      if (G_UNLIKELY (weight == NULL))
+        continue;
+
+      /* ignore files listed twice */
+      file_stamp = g_hash_table_lookup (store->selection, lp->data);
+      if (G_UNLIKELY (file_stamp == stamp))
+        continue;
+
+      if (file_stamp == NULL)
+        lunar_list_model_totals_add (&store->selection_totals, *weight);
+
+      g_hash_table_insert (store->selection, lp->data, stamp);
+      n_selected++;
+    }
+
+  /* the files with an older stamp were deselected */
+  if (g_hash_table_size (store->selection) > n_selected)
+    {
+      g_hash_table_iter_init (&iter, store->selection);
+      while (g_hash_table_iter_next (&iter, &file, &file_stamp))
+        if (file_stamp != stamp)
+          {
+            weight = g_hash_table_lookup (store->weights, file);
+            lunar_list_model_totals_subtract (&store->selection_totals, *weight);
+            g_hash_table_iter_remove (&iter);
+          }
+    }
+}
+
+
+
 /**
  * lunar_list_model_get_statusbar_text:
- * @store          : a #LunarListModel instance.
- * @selected_items : the list of selected items (as GtkTreePath's).
+ * @store : a #LunarListModel instance.
  *
- * Generates the statusbar text for @store with the given
- * @selected_items.
+ * Generates the statusbar text for @store with the files
+ * passed to lunar_list_model_set_selected_files().
  *
  * This function is used by the #LunarStandardView (and thereby
  * implicitly by #LunarIconView and #LunarDetailsView) to
@@ -2408,20 +3440,17 @@ lunar_list_model_get_statusbar_text_for_files (GList    *files,
  * The caller is reponsible to free the returned text using
  * g_free() when it's no longer needed.
  *
- * Return value: the statusbar text for @store with the given
- *               @selected_items.
+ * Return value: the statusbar text for @store with the
+ *               selected files.
  **/
 gchar*
-lunar_list_model_get_statusbar_text (LunarListModel *store,
-                                      GList           *selected_items)
+lunar_list_model_get_statusbar_text (LunarListModel *store)
 {
   const gchar       *content_type;
   const gchar       *original_path;
-  GtkTreeIter        iter;
+  GHashTableIter     iter;
   LunarFile        *file;
   guint64            size;
-  GList             *lp;
-  gchar             *absolute_path;
   gchar             *fspace_string;
   gchar             *display_name;
   gchar             *size_string;
@@ -2430,26 +3459,18 @@ lunar_list_model_get_statusbar_text (LunarListModel *store,
   gint               height;
   gint               width;
   gchar             *description;
-  GSequenceIter     *row;
-  GSequenceIter     *end;
+  guint              n_selected;
   LunarPreferences *preferences;
   gboolean           show_image_size;
   gboolean           show_file_size_binary_format;
-  GList             *relevant_files = NULL;
 
   _lunar_return_val_if_fail (LUNAR_IS_LIST_MODEL (store), NULL);
 
   show_file_size_binary_format = lunar_list_model_get_file_size_binary(store);
 
-  if (selected_items == NULL) /* nothing selected */
+  n_selected = g_hash_table_size (store->selection);
+  if (n_selected == 0) /* nothing selected */
     {
-      /* build a GList of all files */
-      end = g_sequence_get_end_iter (store->rows);
-      for (row = g_sequence_get_begin_iter (store->rows); row != end; row = g_sequence_iter_next (row))
-        {
-          relevant_files = g_list_append (relevant_files, g_sequence_get (row));
-        }
-
       /* try to determine a file for the current folder */
       file = (store->folder != NULL) ? lunar_folder_get_corresponding_file (store->folder) : NULL;
 
@@ -2457,7 +3478,7 @@ lunar_list_model_get_statusbar_text (LunarListModel *store,
       if (G_LIKELY (file != NULL
           && lunar_g_file_get_free_space (lunar_file_get_file (file), &size, NULL)))
         {
-          size_string = lunar_list_model_get_statusbar_text_for_files (relevant_files, show_file_size_binary_format);
+          size_string = lunar_list_model_get_statusbar_text_for_totals (&store->totals, show_file_size_binary_format);
 
           /* humanize the free space */
           fspace_string = g_format_size_full (size, show_file_size_binary_format ? G_FORMAT_SIZE_IEC_UNITS : G_FORMAT_SIZE_DEFAULT);
@@ -2470,17 +3491,14 @@ lunar_list_model_get_statusbar_text (LunarListModel *store,
         }
       else
         {
-          text = lunar_list_model_get_statusbar_text_for_files (relevant_files, show_file_size_binary_format);
+          text = lunar_list_model_get_statusbar_text_for_totals (&store->totals, show_file_size_binary_format);
         }
-      g_list_free (relevant_files);
     }
-  else if (selected_items->next == NULL) /* only one item selected */
+  else if (n_selected == 1) /* only one item selected */
     {
-      /* resolve the iter for the single path */
-      gtk_tree_model_get_iter (GTK_TREE_MODEL (store), &iter, selected_items->data);
-
-      /* get the file for the given iter */
-      file = g_sequence_get (iter.user_data);
+      /* get the selected file */
+      g_hash_table_iter_init (&iter, store->selection);
+      g_hash_table_iter_next (&iter, (gpointer *) &file, NULL);
 
       /* determine the content type of the file */
       content_type = lunar_file_get_content_type (file);
@@ -2543,35 +3561,23 @@ lunar_list_model_get_statusbar_text (LunarListModel *store,
           g_object_get (preferences, "misc-image-size-in-statusbar", &show_image_size, NULL);
           g_object_unref (preferences);
 
-          if (show_image_size)
+          /* the dimensions are probed in a thread, "statusbar-changed"
+           * is emitted when they are known */
+          if (show_image_size
+              && lunar_list_model_get_image_size (store, file, &width, &height))
             {
-              /* check if we can determine the dimension of this file (only for image files) */
-              absolute_path = g_file_get_path (lunar_file_get_file (file));
-              if (absolute_path != NULL
-                  && gdk_pixbuf_get_file_info (absolute_path, &width, &height) != NULL)
-                {
-                  /* append the image dimensions to the statusbar text */
-                  s = g_strdup_printf ("%s, %s %dx%d", text, _("Image Size:"), width, height);
-                  g_free (text);
-                  text = s;
-                }
-              g_free (absolute_path);
+              /* append the image dimensions to the statusbar text */
+              s = g_strdup_printf ("%s, %s %dx%d", text, _("Image Size:"), width, height);
+              g_free (text);
+              text = s;
             }
         }
     }
   else /* more than one item selected */
     {
-      /* build GList of files from selection */
-      for (lp = selected_items; lp != NULL; lp = lp->next)
-        {
-          gtk_tree_model_get_iter (GTK_TREE_MODEL (store), &iter, lp->data);
-          relevant_files = g_list_append (relevant_files, g_sequence_get (iter.user_data));
-        }
-        
-      size_string = lunar_list_model_get_statusbar_text_for_files (relevant_files, show_file_size_binary_format);
+      size_string = lunar_list_model_get_statusbar_text_for_totals (&store->selection_totals, show_file_size_binary_format);
       text = g_strdup_printf (_("Selection: %s"), size_string);
       g_free (size_string);
-      g_list_free (relevant_files);
     }
 
   return text;
@@ -62,8 +62,9 @@ GList           *lunar_list_model_get_paths_for_files    (LunarListModel  *store
 GList           *lunar_list_model_get_paths_for_pattern  (LunarListModel  *store,
                                                            const gchar      *pattern);
 
-gchar           *lunar_list_model_get_statusbar_text     (LunarListModel  *store,
-                                                           GList            *selected_items);
+void             lunar_list_model_set_selected_files     (LunarListModel  *store,
+                                                           GList            *files);
+gchar           *lunar_list_model_get_statusbar_text     (LunarListModel  *store);
 
 G_END_DECLS;
 
@@ -223,6 +223,41 @@ transform_parallel_copy_index_to_mode (const GValue *src_value,
 
 
 
+static gboolean
+transform_copy_backend_to_index (const GValue *src_value,
+                                 GValue       *dst_value,
+                                 gpointer      user_data)
+{
+  GEnumClass *klass;
+  guint       n;
+
+  klass = g_type_class_ref (LUNAR_TYPE_COPY_BACKEND);
+  for (n = 0; n < klass->n_values; ++n)
+    if (klass->values[n].value == g_value_get_enum (src_value))
+      g_value_set_int (dst_value, n);
+  g_type_class_unref (klass);
+
+  return TRUE;
+}
+
+
+
+static gboolean
+transform_copy_backend_index_to_backend (const GValue *src_value,
+                                         GValue       *dst_value,
+                                         gpointer      user_data)
+{
+  GEnumClass *klass;
+
+  klass = g_type_class_ref (LUNAR_TYPE_COPY_BACKEND);
+  g_value_set_enum (dst_value, klass->values[g_value_get_int (src_value)].value);
+  g_type_class_unref (klass);
+
+  return TRUE;
+}
+
+
+
 static void
 lunar_preferences_dialog_class_init (LunarPreferencesDialogClass *klass)
 {
@@ -791,6 +826,27 @@ lunar_preferences_dialog_init (LunarPreferencesDialog *dialog)
   gtk_label_set_mnemonic_widget (GTK_LABEL (label), combo);
   gtk_widget_show (combo);
 
+  label = gtk_label_new_with_mnemonic (_("Copy method:"));
+  gtk_widget_set_tooltip_text (label, _(
+                                        "Indicates how the contents of local files are copied:\n"
+                                        "- Automatic: let the kernel copy the data, sharing blocks where the file system supports it\n"
+                                        "- GIO Only: always copy through GIO"
+                                      ));
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0f);
+  gtk_grid_attach (GTK_GRID (grid), label, 0, 1, 1, 1);
+  gtk_widget_show (label);
+
+  combo = gtk_combo_box_text_new ();
+  gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), _("Automatic"));
+  gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), _("GIO Only"));
+  endo_mutual_binding_new_full (G_OBJECT (dialog->preferences), "misc-copy-backend", G_OBJECT (combo), "active",
+                               transform_copy_backend_to_index, transform_copy_backend_index_to_backend, NULL, NULL);
+  gtk_widget_set_hexpand (combo, TRUE);
+  gtk_grid_attach (GTK_GRID (grid), combo, 1, 1, 1, 1);
+  lunar_gtk_label_set_a11y_relation (GTK_LABEL (label), combo);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), combo);
+  gtk_widget_show (combo);
+
   if (lunar_g_vfs_is_uri_scheme_supported ("trash"))
     {
       frame = g_object_new (GTK_TYPE_FRAME, "border-width", 0, "shadow-type", GTK_SHADOW_NONE, NULL);
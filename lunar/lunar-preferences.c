@@ -96,9 +96,11 @@ enum
   PROP_MISC_TEXT_BESIDE_ICONS,
   PROP_MISC_THUMBNAIL_MODE,
   PROP_MISC_THUMBNAIL_DRAW_FRAMES,
+  PROP_MISC_THUMBNAIL_CACHE_SIZE,
   PROP_MISC_FILE_SIZE_BINARY,
   PROP_MISC_CONFIRM_CLOSE_MULTIPLE_TABS,
   PROP_MISC_PARALLEL_COPY_MODE,
+  PROP_MISC_COPY_BACKEND,
   PROP_MISC_WINDOW_ICON,
   PROP_SHORTCUTS_ICON_EMBLEMS,
   PROP_SHORTCUTS_ICON_SIZE,
@@ -766,6 +768,19 @@ lunar_preferences_class_init (LunarPreferencesClass *klass)
                             FALSE,
                             ENDO_PARAM_READWRITE);
 
+  /**
+   * LunarPreferences:misc-thumbnail-cache-size:
+   *
+   * The amount of memory in MiB used to keep decoded thumbnails
+   * around. The least recently shown thumbnails are dropped first.
+   **/
+  preferences_props[PROP_MISC_THUMBNAIL_CACHE_SIZE] =
+      g_param_spec_uint ("misc-thumbnail-cache-size",
+                         NULL,
+                         NULL,
+                         1u, G_MAXUINT / 2, 128u,
+                         ENDO_PARAM_READWRITE);
+
   /**
    * LunarPreferences:misc-file-size-binary:
    *
@@ -791,6 +806,21 @@ lunar_preferences_class_init (LunarPreferencesClass *klass)
                          LUNAR_PARALLEL_COPY_MODE_ONLY_LOCAL,
                          ENDO_PARAM_READWRITE);
 
+  /**
+   * LunarPreferences:misc-copy-backend:
+   *
+   * How file contents are copied. Local copies may be done by the
+   * kernel (reflinks on btrfs/XFS, copy_file_range, sendfile) or
+   * always through GIO.
+   **/
+  preferences_props[PROP_MISC_COPY_BACKEND] =
+      g_param_spec_enum ("misc-copy-backend",
+                         "MiscCopyBackend",
+                         NULL,
+                         LUNAR_TYPE_COPY_BACKEND,
+                         LUNAR_COPY_BACKEND_AUTO,
+                         ENDO_PARAM_READWRITE);
+
   /**
    * LunarPreferences:misc-change-window-icon:
    *
@@ -39,6 +39,10 @@
 
 #define LUNAR_RENAMER_MODEL_ITEM(item) ((LunarRenamerModelItem *) (item))
 
+/* the time in microseconds spent on a single update batch,
+ * short enough to keep the dialog responsive while typing */
+#define LUNAR_RENAMER_MODEL_UPDATE_SLICE (G_USEC_PER_SEC / 120)
+
 
 
 /* Property identifiers */
@@ -109,11 +113,21 @@ static void                    lunar_renamer_model_file_changed        (LunarRen
 static void                    lunar_renamer_model_file_destroyed      (LunarRenamerModel      *renamer_model,
                                                                          LunarFile              *file,
                                                                          LunarFileMonitor       *file_monitor);
+static gboolean                lunar_renamer_model_changed_idle        (gpointer                 user_data);
+static void                    lunar_renamer_model_changed_idle_destroy (gpointer                user_data);
 static void                    lunar_renamer_model_invalidate_all      (LunarRenamerModel      *renamer_model);
 static void                    lunar_renamer_model_invalidate_item     (LunarRenamerModel      *renamer_model,
                                                                          LunarRenamerModelItem  *item);
-static gboolean                lunar_renamer_model_conflict_item       (LunarRenamerModel      *renamer_model,
+static void                    lunar_renamer_model_schedule_update     (LunarRenamerModel      *renamer_model);
+static gboolean                lunar_renamer_model_add_name            (LunarRenamerModel      *renamer_model,
+                                                                         LunarRenamerModelItem  *item);
+static void                    lunar_renamer_model_remove_name         (LunarRenamerModel      *renamer_model,
                                                                          LunarRenamerModelItem  *item);
+static void                    lunar_renamer_model_recheck_conflicts   (LunarRenamerModel      *renamer_model);
+static void                    lunar_renamer_model_emit_range          (LunarRenamerModel      *renamer_model,
+                                                                         GList                   *lp,
+                                                                         guint                    first_idx,
+                                                                         guint                    last_idx);
 static gchar                  *lunar_renamer_model_process_item        (LunarRenamerModel      *renamer_model,
                                                                          LunarRenamerModelItem  *item,
                                                                          guint                    idx);
@@ -155,17 +169,40 @@ struct _LunarRenamerModel
   LunarxRenamer    *renamer;
   GList             *items;
 
+  /* LunarFile -> GList node of its item */
+  GHashTable        *files;
+
   /* TRUE if the model is currently frozen */
   gboolean           frozen;
 
   /* the idle source used to update the model */
   guint              update_idle_id;
+
+  /* the next item examined by the update idle source, NULL
+   * to start over at the head of the items, and its index */
+  GList             *update_cursor;
+  guint              update_cursor_idx;
+  guint              n_dirty;
+
+  /* "parent uri\nnew name" -> GSList of the processed items
+   * using that name, to detect conflicts in constant time */
+  GHashTable        *names;
+
+  /* processed items whose conflict state may have changed
+   * since they were processed, checked once all are done */
+  GHashTable        *recheck;
+
+  /* the nodes of items changed on disk while frozen, and the
+   * idle source that emits "row-changed" for them at once */
+  GHashTable        *changed_rows;
+  guint              changed_idle_id;
 };
 
 struct _LunarRenamerModelItem
 {
   LunarFile *file;
   gchar      *name;
+  gchar      *key;          /* the key in the names table, if any */
   guint64     date_changed;
   guint       changed : 1;  /* if the file changed */
   guint       conflict : 1; /* if the item conflicts with another item */
@@ -276,6 +313,11 @@ lunar_renamer_model_init (LunarRenamerModel *renamer_model)
   renamer_model->stamp = g_random_int ();
 #endif
 
+  renamer_model->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_slist_free);
+  renamer_model->recheck = g_hash_table_new (g_direct_hash, g_direct_equal);
+  renamer_model->files = g_hash_table_new (g_direct_hash, g_direct_equal);
+  renamer_model->changed_rows = g_hash_table_new (g_direct_hash, g_direct_equal);
+
   /* connect to the file monitor */
   renamer_model->file_monitor = lunar_file_monitor_get_default ();
   g_signal_connect_swapped (G_OBJECT (renamer_model->file_monitor), "file-changed",
@@ -296,15 +338,21 @@ lunar_renamer_model_finalize (GObject *object)
 
   /* release all items */
   g_list_free_full (renamer_model->items, lunar_renamer_model_item_free);
+  g_hash_table_destroy (renamer_model->names);
+  g_hash_table_destroy (renamer_model->recheck);
+  g_hash_table_destroy (renamer_model->files);
+  g_hash_table_destroy (renamer_model->changed_rows);
 
   /* disconnect from the file monitor */
   g_signal_handlers_disconnect_by_func (G_OBJECT (renamer_model->file_monitor), lunar_renamer_model_file_destroyed, renamer_model);
   g_signal_handlers_disconnect_by_func (G_OBJECT (renamer_model->file_monitor), lunar_renamer_model_file_changed, renamer_model);
   g_object_unref (G_OBJECT (renamer_model->file_monitor));
 
-  /* be sure to cancel any pending update idle source (must be last!) */
+  /* be sure to cancel any pending idle sources (must be last!) */
   if (G_UNLIKELY (renamer_model->update_idle_id != 0))
     g_source_remove (renamer_model->update_idle_id);
+  if (G_UNLIKELY (renamer_model->changed_idle_id != 0))
+    g_source_remove (renamer_model->changed_idle_id);
 
   (*G_OBJECT_CLASS (lunar_renamer_model_parent_class)->finalize) (object);
 }
@@ -604,8 +652,6 @@ lunar_renamer_model_file_changed (LunarRenamerModel *renamer_model,
                                    LunarFileMonitor  *file_monitor)
 {
   LunarRenamerModelItem *item;
-  GtkTreePath            *path;
-  GtkTreeIter             iter;
   GList                  *lp;
   guint64                 date_changed;
 
@@ -615,41 +661,81 @@ lunar_renamer_model_file_changed (LunarRenamerModel *renamer_model,
   _lunar_return_if_fail (renamer_model->file_monitor == file_monitor);
 
   /* check if we have that file */
-  for (lp = renamer_model->items; lp != NULL; lp = lp->next)
-    if (LUNAR_RENAMER_MODEL_ITEM (lp->data)->file == file)
-      {
-        item = LUNAR_RENAMER_MODEL_ITEM (lp->data);
+  lp = g_hash_table_lookup (renamer_model->files, file);
+  if (G_LIKELY (lp == NULL))
+    return;
 
-        /* check if the file changed on disk, this is done to prevent
-         * excessive looping when some renamers are used
-         * (lunar-media-tags-plugin is an example) */
-        date_changed = lunar_file_get_date (file, LUNAR_FILE_DATE_CHANGED);
-        if (item->date_changed == date_changed)
-          break;
+  item = LUNAR_RENAMER_MODEL_ITEM (lp->data);
 
-        /* check if we're frozen */
-        if (G_LIKELY (!renamer_model->frozen))
-          {
-            /* the file changed */
-            item->changed = TRUE;
+  /* check if the file changed on disk, this is done to prevent
+   * excessive looping when some renamers are used
+   * (lunar-media-tags-plugin is an example) */
+  date_changed = lunar_file_get_date (file, LUNAR_FILE_DATE_CHANGED);
+  if (item->date_changed == date_changed)
+    return;
 
-            /* set the new mtime */
-            item->date_changed = date_changed;
+  /* check if we're frozen */
+  if (G_LIKELY (!renamer_model->frozen))
+    {
+      /* the file changed */
+      item->changed = TRUE;
 
-            /* invalidate the item */
-            lunar_renamer_model_invalidate_item (renamer_model, item);
-            break;
-          }
+      /* set the new mtime */
+      item->date_changed = date_changed;
 
-        /* determine the iter for the item */
-        GTK_TREE_ITER_INIT (iter, renamer_model->stamp, lp);
+      /* invalidate the item */
+      lunar_renamer_model_invalidate_item (renamer_model, item);
+      return;
+    }
+
+  /* emit "row-changed" to display up2date file name, for all
+   * files changed meanwhile, i.e. while renaming the files */
+  g_hash_table_add (renamer_model->changed_rows, lp);
+  if (renamer_model->changed_idle_id == 0)
+    {
+      renamer_model->changed_idle_id = g_idle_add_full (G_PRIORITY_LOW, lunar_renamer_model_changed_idle,
+                                                        renamer_model, lunar_renamer_model_changed_idle_destroy);
+    }
+}
+
+
+
+static gboolean
+lunar_renamer_model_changed_idle (gpointer user_data)
+{
+  LunarRenamerModel *renamer_model = LUNAR_RENAMER_MODEL (user_data);
+  GtkTreePath        *path;
+  GtkTreeIter         iter;
+  GList              *lp;
+  guint               n_changed;
+  guint               idx;
+
+LUNAR_THREADS_ENTER
 
-        /* emit "row-changed" to display up2date file name */
-        path = gtk_tree_model_get_path (GTK_TREE_MODEL (renamer_model), &iter);
+  n_changed = g_hash_table_size (renamer_model->changed_rows);
+  for (idx = 0, lp = renamer_model->items; n_changed > 0 && lp != NULL; ++idx, lp = lp->next)
+    if (g_hash_table_contains (renamer_model->changed_rows, lp))
+      {
+        GTK_TREE_ITER_INIT (iter, renamer_model->stamp, lp);
+        path = gtk_tree_path_new_from_indices (idx, -1);
         gtk_tree_model_row_changed (GTK_TREE_MODEL (renamer_model), path, &iter);
         gtk_tree_path_free (path);
-        break;
+        n_changed--;
       }
+
+  g_hash_table_remove_all (renamer_model->changed_rows);
+
+LUNAR_THREADS_LEAVE
+
+  return FALSE;
+}
+
+
+
+static void
+lunar_renamer_model_changed_idle_destroy (gpointer user_data)
+{
+  LUNAR_RENAMER_MODEL (user_data)->changed_idle_id = 0;
 }
 
 
@@ -669,27 +755,30 @@ lunar_renamer_model_file_destroyed (LunarRenamerModel *renamer_model,
   _lunar_return_if_fail (LUNAR_IS_FILE (file));
 
   /* check if we have that file */
-  for (lp = renamer_model->items; lp != NULL; lp = lp->next)
-    if (LUNAR_RENAMER_MODEL_ITEM (lp->data)->file == file)
-      {
-        /* determine the idx of the item */
-        idx = g_list_position (renamer_model->items, lp);
+  lp = g_hash_table_lookup (renamer_model->files, file);
+  if (G_LIKELY (lp == NULL))
+    return;
 
-        /* free the item data */
-        lunar_renamer_model_item_free (lp->data);
+  /* determine the idx of the item */
+  idx = g_list_position (renamer_model->items, lp);
 
-        /* drop the item from the list */
-        renamer_model->items = g_list_delete_link (renamer_model->items, lp);
+  /* forget the node */
+  g_hash_table_remove (renamer_model->files, file);
+  g_hash_table_remove (renamer_model->changed_rows, lp);
 
-        /* tell the view that the item is gone */
-        path = gtk_tree_path_new_from_indices (idx, -1);
-        gtk_tree_model_row_deleted (GTK_TREE_MODEL (renamer_model), path);
-        gtk_tree_path_free (path);
+  /* free the item data */
+  lunar_renamer_model_item_free (lp->data);
 
-        /* invalidate all other items */
-        lunar_renamer_model_invalidate_all (renamer_model);
-        break;
-      }
+  /* drop the item from the list */
+  renamer_model->items = g_list_delete_link (renamer_model->items, lp);
+
+  /* tell the view that the item is gone */
+  path = gtk_tree_path_new_from_indices (idx, -1);
+  gtk_tree_model_row_deleted (GTK_TREE_MODEL (renamer_model), path);
+  gtk_tree_path_free (path);
+
+  /* invalidate all other items */
+  lunar_renamer_model_invalidate_all (renamer_model);
 }
 
 
@@ -697,11 +786,29 @@ lunar_renamer_model_file_destroyed (LunarRenamerModel *renamer_model,
 static void
 lunar_renamer_model_invalidate_all (LunarRenamerModel *renamer_model)
 {
-  GList *lp;
+  LunarRenamerModelItem *item;
+  GList                  *lp;
+
+  /* forget all processed names, everything is updated again */
+  g_hash_table_remove_all (renamer_model->names);
+  g_hash_table_remove_all (renamer_model->recheck);
 
   /* invalidate all items in the model */
+  renamer_model->n_dirty = 0;
   for (lp = renamer_model->items; lp != NULL; lp = lp->next)
-    lunar_renamer_model_invalidate_item (renamer_model, lp->data);
+    {
+      item = LUNAR_RENAMER_MODEL_ITEM (lp->data);
+      g_free (item->key);
+      item->key = NULL;
+      item->dirty = TRUE;
+      renamer_model->n_dirty++;
+    }
+
+  /* start over at the head of the list */
+  renamer_model->update_cursor = NULL;
+
+  if (G_LIKELY (renamer_model->n_dirty > 0))
+    lunar_renamer_model_schedule_update (renamer_model);
 }
 
 
@@ -711,8 +818,23 @@ lunar_renamer_model_invalidate_item (LunarRenamerModel     *renamer_model,
                                       LunarRenamerModelItem *item)
 {
   /* mark the item as dirty */
-  item->dirty = TRUE;
+  if (G_LIKELY (!item->dirty))
+    {
+      item->dirty = TRUE;
+      renamer_model->n_dirty++;
+
+      /* dirty items never conflict with other items */
+      lunar_renamer_model_remove_name (renamer_model, item);
+    }
+
+  lunar_renamer_model_schedule_update (renamer_model);
+}
 
+
+
+static void
+lunar_renamer_model_schedule_update (LunarRenamerModel *renamer_model)
+{
   /* check if the update idle source is already running and not frozen */
   if (G_UNLIKELY (renamer_model->update_idle_id == 0 && !renamer_model->frozen))
     {
@@ -728,74 +850,154 @@ lunar_renamer_model_invalidate_item (LunarRenamerModel     *renamer_model,
 
 
 static gboolean
-trm_same_directory (LunarFile *a,
-                    LunarFile *b)
+lunar_renamer_model_add_name (LunarRenamerModel     *renamer_model,
+                               LunarRenamerModelItem *item)
 {
-  GFile    *parent_a;
-  GFile    *parent_b;
-  gboolean  result;
+  GSList *members;
+  GFile  *parent;
+  gchar  *uri;
+
+  _lunar_assert (item->key == NULL);
 
-  /* determine the parent paths for both files */
-  parent_a = g_file_get_parent (lunar_file_get_file (a));
-  parent_b = g_file_get_parent (lunar_file_get_file (b));
+  /* items can only conflict if in the same directory */
+  parent = g_file_get_parent (lunar_file_get_file (item->file));
+  if (G_UNLIKELY (parent == NULL))
+    return FALSE;
 
-  /* check if both files have the same parent */
-  result = (parent_a != NULL && parent_b != NULL && g_file_equal (parent_a, parent_b));
+  /* the uri is escaped, so the first newline ends it */
+  uri = g_file_get_uri (parent);
+  item->key = g_strconcat (uri, "\n", (item->name != NULL) ? item->name : lunar_file_get_display_name (item->file), NULL);
+  g_object_unref (parent);
+  g_free (uri);
 
-  if (parent_a != NULL)
-    g_object_unref (parent_a);
-  if (parent_b != NULL)
-    g_object_unref (parent_b);
+  members = g_hash_table_lookup (renamer_model->names, item->key);
+  if (G_LIKELY (members == NULL))
+    {
+      g_hash_table_insert (renamer_model->names, g_strdup (item->key), g_slist_prepend (NULL, item));
+      return FALSE;
+    }
+
+  /* the single item using the name so far now conflicts as well */
+  if (members->next == NULL)
+    g_hash_table_add (renamer_model->recheck, members->data);
 
-  return result;
+  /* keep the head, it is owned by the table */
+  members->next = g_slist_prepend (members->next, item);
+
+  return TRUE;
 }
 
 
 
-static gboolean
-lunar_renamer_model_conflict_item (LunarRenamerModel     *renamer_model,
-                                    LunarRenamerModelItem *item)
+static void
+lunar_renamer_model_remove_name (LunarRenamerModel     *renamer_model,
+                                  LunarRenamerModelItem *item)
+{
+  GSList *members;
+
+  if (item->key == NULL)
+    return;
+
+  members = g_hash_table_lookup (renamer_model->names, item->key);
+  _lunar_assert (members != NULL);
+
+  if (members->next == NULL)
+    {
+      /* the last item using the name */
+      g_hash_table_remove (renamer_model->names, item->key);
+    }
+  else
+    {
+      /* drop the item, but keep the head owned by the table */
+      if (members->data == item)
+        {
+          members->data = members->next->data;
+          members->next = g_slist_delete_link (members->next, members->next);
+        }
+      else
+        {
+          members->next = g_slist_remove (members->next, item);
+        }
+
+      /* the item left behind no longer conflicts */
+      if (members->next == NULL)
+        g_hash_table_add (renamer_model->recheck, members->data);
+    }
+
+  g_free (item->key);
+  item->key = NULL;
+}
+
+
+
+static void
+lunar_renamer_model_recheck_conflicts (LunarRenamerModel *renamer_model)
 {
-  LunarRenamerModelItem *oitem;
+  LunarRenamerModelItem *item;
   GtkTreePath            *path;
   GtkTreeIter             iter;
-  gboolean                conflict = FALSE;
+  gboolean                conflict;
+  GSList                 *members;
   GList                  *lp;
+  guint                   n_recheck;
+  guint                   idx;
 
-  for (lp = renamer_model->items; lp != NULL; lp = lp->next)
+  n_recheck = g_hash_table_size (renamer_model->recheck);
+  for (idx = 0, lp = renamer_model->items; n_recheck > 0 && lp != NULL; ++idx, lp = lp->next)
     {
-      /* check if this item is dirty or the item we're about to check */
-      oitem = LUNAR_RENAMER_MODEL_ITEM (lp->data);
-      if (G_UNLIKELY (oitem == item || oitem->dirty))
+      item = LUNAR_RENAMER_MODEL_ITEM (lp->data);
+      if (G_LIKELY (!g_hash_table_contains (renamer_model->recheck, item)))
         continue;
 
-      /* check if this other item conflicts with the item in question (can only conflict if in same directory) */
-      if (trm_same_directory (item->file, oitem->file)
-          && ((item->name != NULL && oitem->name == NULL && strcmp (item->name, lunar_file_get_display_name (oitem->file)) == 0)
-           || (item->name == NULL && oitem->name != NULL && strcmp (lunar_file_get_display_name (item->file), oitem->name) == 0)
-           || (item->name != NULL && oitem->name != NULL && strcmp (item->name, oitem->name) == 0)))
-        {
-          /* check if the other item is already in conflict state */
-          if (G_LIKELY (!oitem->conflict))
-            {
-              /* set to conflict state */
-              oitem->conflict = TRUE;
-
-              /* determine iter for other item */
-              GTK_TREE_ITER_INIT (iter, renamer_model->stamp, lp);
+      n_recheck--;
 
-              /* emit "row-changed" for the other item */
-              path = gtk_tree_model_get_path (GTK_TREE_MODEL (renamer_model), &iter);
-              gtk_tree_model_row_changed (GTK_TREE_MODEL (renamer_model), path, &iter);
-              gtk_tree_path_free (path);
-            }
+      /* dirty items are checked when they're processed */
+      if (G_UNLIKELY (item->dirty))
+        continue;
 
-          /* this item conflicts */
-          conflict = TRUE;
+      members = (item->key != NULL) ? g_hash_table_lookup (renamer_model->names, item->key) : NULL;
+      conflict = (members != NULL && members->next != NULL);
+      if (item->conflict != conflict)
+        {
+          /* apply the new state */
+          item->conflict = conflict;
+
+          /* emit "row-changed" for the item */
+          GTK_TREE_ITER_INIT (iter, renamer_model->stamp, lp);
+          path = gtk_tree_path_new_from_indices (idx, -1);
+          gtk_tree_model_row_changed (GTK_TREE_MODEL (renamer_model), path, &iter);
+          gtk_tree_path_free (path);
         }
     }
 
-  return conflict;
+  g_hash_table_remove_all (renamer_model->recheck);
+}
+
+
+
+static void
+lunar_renamer_model_emit_range (LunarRenamerModel *renamer_model,
+                                 GList              *lp,
+                                 guint               first_idx,
+                                 guint               last_idx)
+{
+  GtkTreePath *path;
+  GtkTreeIter  iter;
+  guint        idx;
+
+  /* emit "row-changed" for all items from lp up to last_idx */
+  path = gtk_tree_path_new_from_indices (first_idx, -1);
+  for (idx = first_idx; lp != NULL; ++idx, lp = lp->next)
+    {
+      GTK_TREE_ITER_INIT (iter, renamer_model->stamp, lp);
+      gtk_tree_model_row_changed (GTK_TREE_MODEL (renamer_model), path, &iter);
+
+      if (idx == last_idx)
+        break;
+
+      gtk_tree_path_next (path);
+    }
+  gtk_tree_path_free (path);
 }
 
 
@@ -891,10 +1093,13 @@ lunar_renamer_model_update_idle (gpointer user_data)
 {
   LunarRenamerModelItem *item;
   LunarRenamerModel     *renamer_model = LUNAR_RENAMER_MODEL (user_data);
-  GtkTreePath            *path;
-  GtkTreeIter             iter;
-  gboolean                changed = FALSE;
+  gboolean                changed;
   gboolean                conflict;
+  gboolean                keep_running = FALSE;
+  gint64                  deadline;
+  GList                  *range_lp = NULL;
+  guint                   range_first = 0;
+  guint                   range_last = 0;
   guint                   idx;
   gchar                  *name;
   GList                  *lp;
@@ -904,9 +1109,27 @@ LUNAR_THREADS_ENTER
   /* don't do anything if the model is frozen */
   if (G_LIKELY (!renamer_model->frozen))
     {
-      /* process the first dirty item */
-      for (idx = 0, lp = renamer_model->items; !changed && lp != NULL; ++idx, lp = lp->next)
+      deadline = g_get_monotonic_time () + LUNAR_RENAMER_MODEL_UPDATE_SLICE;
+
+      /* process dirty items from the cursor on, until the time slice is used up */
+      while (renamer_model->n_dirty > 0 && renamer_model->items != NULL)
         {
+          /* wrap around for items invalidated behind the cursor */
+          if (renamer_model->update_cursor == NULL)
+            {
+              if (range_lp != NULL)
+                lunar_renamer_model_emit_range (renamer_model, range_lp, range_first, range_last);
+              range_lp = NULL;
+
+              renamer_model->update_cursor = renamer_model->items;
+              renamer_model->update_cursor_idx = 0;
+            }
+
+          lp = renamer_model->update_cursor;
+          idx = renamer_model->update_cursor_idx;
+          renamer_model->update_cursor = lp->next;
+          renamer_model->update_cursor_idx++;
+
           /* check if this item is dirty */
           item = LUNAR_RENAMER_MODEL_ITEM (lp->data);
           if (G_LIKELY (!item->dirty))
@@ -918,6 +1141,7 @@ LUNAR_THREADS_ENTER
           /* mark as valid, since we're updating right now */
           item->changed = FALSE;
           item->dirty = FALSE;
+          renamer_model->n_dirty--;
 
           /* determine the new name for the item */
           name = lunar_renamer_model_process_item (renamer_model, item, idx);
@@ -937,7 +1161,7 @@ LUNAR_THREADS_ENTER
             }
 
           /* check if this item conflicts with any other item */
-          conflict = lunar_renamer_model_conflict_item (renamer_model, item);
+          conflict = lunar_renamer_model_add_name (renamer_model, item);
           if (item->conflict != conflict)
             {
               /* apply the new state */
@@ -947,24 +1171,41 @@ LUNAR_THREADS_ENTER
               changed = TRUE;
             }
 
-          /* check if the item changed */
+          /* remember the range of changed items */
           if (G_LIKELY (changed))
             {
-              /* generate the iter for the item */
-              GTK_TREE_ITER_INIT (iter, renamer_model->stamp, lp);
-
-              /* emit "row-changed" for this item */
-              path = gtk_tree_path_new_from_indices (idx, -1);
-              gtk_tree_model_row_changed (GTK_TREE_MODEL (renamer_model), path, &iter);
-              gtk_tree_path_free (path);
+              if (range_lp == NULL)
+                {
+                  range_lp = lp;
+                  range_first = idx;
+                }
+              range_last = idx;
             }
+
+          if (g_get_monotonic_time () >= deadline)
+            break;
+        }
+
+      /* emit "row-changed" once for the items processed in this batch */
+      if (range_lp != NULL)
+        lunar_renamer_model_emit_range (renamer_model, range_lp, range_first, range_last);
+
+      if (G_LIKELY (renamer_model->n_dirty > 0 && renamer_model->items != NULL))
+        {
+          keep_running = TRUE;
+        }
+      else
+        {
+          /* all items are processed, update conflicts found on the way */
+          renamer_model->n_dirty = 0;
+          lunar_renamer_model_recheck_conflicts (renamer_model);
         }
     }
 
 LUNAR_THREADS_LEAVE
 
-  /* keep the idle source as long as any item changed */
-  return changed;
+  /* keep the idle source as long as any item is dirty */
+  return keep_running;
 }
 
 
@@ -989,7 +1230,6 @@ lunar_renamer_model_item_new (LunarFile *file)
   item = g_slice_new0 (LunarRenamerModelItem);
   item->file = LUNAR_FILE (g_object_ref (G_OBJECT (file)));
   item->date_changed = lunar_file_get_date (file, LUNAR_FILE_DATE_CHANGED);
-  item->dirty = TRUE;
 
   return item;
 }
@@ -1003,6 +1243,7 @@ lunar_renamer_model_item_free (gpointer data)
 
   g_object_unref (G_OBJECT (item->file));
   g_free (item->name);
+  g_free (item->key);
   g_slice_free (LunarRenamerModelItem, item);
 }
 
@@ -1303,24 +1544,28 @@ lunar_renamer_model_insert (LunarRenamerModel *renamer_model,
   _lunar_return_if_fail (LUNAR_IS_FILE (file));
 
   /* check if we already have that file */
-  for (lp = renamer_model->items; lp != NULL; lp = lp->next)
-    if (LUNAR_RENAMER_MODEL_ITEM (lp->data)->file == file)
-      return;
+  if (g_hash_table_contains (renamer_model->files, file))
+    return;
 
   /* allocate a new item for the file */
   item = lunar_renamer_model_item_new (file);
 
   /* append the item to the model */
   renamer_model->items = g_list_insert (renamer_model->items, item, position);
+  lp = g_list_find (renamer_model->items, item);
+  g_hash_table_insert (renamer_model->files, file, lp);
 
   /* determine the iterator for the new item */
-  GTK_TREE_ITER_INIT (iter, renamer_model->stamp, g_list_find (renamer_model->items, item));
+  GTK_TREE_ITER_INIT (iter, renamer_model->stamp, lp);
 
   /* emit the "row-inserted" signal */
   path = gtk_tree_model_get_path (GTK_TREE_MODEL (renamer_model), &iter);
   gtk_tree_model_row_inserted (GTK_TREE_MODEL (renamer_model), path, &iter);
   gtk_tree_path_free (path);
 
+  /* the cursor index may be off now, start over at the head */
+  renamer_model->update_cursor = NULL;
+
   /* invalidate the newly added item */
   lunar_renamer_model_invalidate_item (renamer_model, item);
 }
@@ -1508,6 +1753,10 @@ lunar_renamer_model_remove (LunarRenamerModel *renamer_model,
   if (G_UNLIKELY (lp == NULL))
     return;
 
+  /* forget the node */
+  g_hash_table_remove (renamer_model->files, LUNAR_RENAMER_MODEL_ITEM (lp->data)->file);
+  g_hash_table_remove (renamer_model->changed_rows, lp);
+
   /* free the item data */
   lunar_renamer_model_item_free (lp->data);
 
@@ -21,25 +21,34 @@
 #include <config.h>
 #endif
 
+#include <lunar/lunar-job.h>
 #include <lunar/lunar-private.h>
 #include <lunar/lunar-renamer-progress.h>
+#include <lunar/lunar-simple-job.h>
 #include <lunar/lunar-util.h>
 
 
 
-/* Signal identifiers */
-enum
-{
-  FINISHED,
-  LAST_SIGNAL,
-};
+/* the time in microseconds between two progress updates */
+#define RENAME_CHUNK_INTERVAL (100 * 1000)
+
+
 
+typedef struct _RenameOp    RenameOp;
+typedef struct _RenameChunk RenameChunk;
 
 
-static void     lunar_renamer_progress_finalize          (GObject                    *object);
-static void     lunar_renamer_progress_destroy           (GtkWidget                  *object);
-static gboolean lunar_renamer_progress_next_idle         (gpointer                    user_data);
-static void     lunar_renamer_progress_next_idle_destroy (gpointer                    user_data);
+
+static void     lunar_renamer_progress_finalize (GObject                    *object);
+static void     lunar_renamer_progress_destroy  (GtkWidget                  *object);
+static gboolean lunar_renamer_progress_job      (LunarJob                  *job,
+                                                 GArray                     *param_values,
+                                                 GError                    **error);
+static void     lunar_renamer_progress_error    (LunarJob                  *job,
+                                                 GError                     *error,
+                                                 LunarRenamerProgress      *renamer_progress);
+static void     lunar_renamer_progress_finished (LunarJob                  *job,
+                                                 LunarRenamerProgress      *renamer_progress);
 
 
 
@@ -53,15 +62,38 @@ struct _LunarRenamerProgress
   GtkAlignment __parent__;
   GtkWidget   *bar;
 
-  GList       *pairs_done;
-  guint        n_pairs_done;
-  GList       *pairs_todo;
-  guint        n_pairs_todo;
-  gboolean     pairs_undo;  /* whether we're undoing previous changes */
+  /* the pairs to rename, not modified while the job runs */
+  GList       *pairs;
+
+  /* the job renaming the pairs */
+  LunarJob    *job;
+  GError      *error;
+
+  /* set by the job if a rename failed */
+  gchar       *failed_name;
+  gchar       *failed_new_name;
+  guint        n_reverted;
+  guint        n_revert_failed;
 
   /* internal main loop for the _rename() method */
-  guint        next_idle_id;
-  GMainLoop   *next_idle_loop;
+  GMainLoop   *loop;
+};
+
+/* a single rename executed by the job */
+struct _RenameOp
+{
+  LunarFile *file;
+  gchar      *name;
+  gboolean    temporary;
+};
+
+/* files renamed since the last progress update */
+struct _RenameChunk
+{
+  LunarRenamerProgress *renamer_progress;
+  GList                 *files;
+  guint                  n_done;
+  guint                  n_total;
 };
 
 
@@ -104,12 +136,11 @@ lunar_renamer_progress_finalize (GObject *object)
   LunarRenamerProgress *renamer_progress = LUNAR_RENAMER_PROGRESS (object);
 
   /* make sure we're not finalized while the main loop is active */
-  _lunar_assert (renamer_progress->next_idle_id == 0);
-  _lunar_assert (renamer_progress->next_idle_loop == NULL);
+  _lunar_assert (renamer_progress->job == NULL);
+  _lunar_assert (renamer_progress->loop == NULL);
 
   /* release the pairs */
-  lunar_renamer_pair_list_free (renamer_progress->pairs_done);
-  lunar_renamer_pair_list_free (renamer_progress->pairs_todo);
+  lunar_renamer_pair_list_free (renamer_progress->pairs);
 
   (*G_OBJECT_CLASS (lunar_renamer_progress_parent_class)->finalize) (object);
 }
@@ -121,164 +152,378 @@ lunar_renamer_progress_destroy (GtkWidget *object)
 {
   LunarRenamerProgress *renamer_progress = LUNAR_RENAMER_PROGRESS (object);
 
-  /* exit the internal main loop on destroy */
+  /* stop the job on destroy, the internal main loop exits once it's finished */
   lunar_renamer_progress_cancel (renamer_progress);
 
   (*GTK_WIDGET_CLASS (lunar_renamer_progress_parent_class)->destroy) (object);
+
+  /* the bar was destroyed with us, but the job may still report progress */
+  renamer_progress->bar = NULL;
 }
 
 
 
-static gboolean
-lunar_renamer_progress_next_idle (gpointer user_data)
+static void
+lunar_renamer_progress_chunk_free (gpointer data)
 {
-  LunarRenamerProgress *renamer_progress = LUNAR_RENAMER_PROGRESS (user_data);
-  LunarRenamerPair     *pair;
-  GtkWindow             *toplevel;
-  GtkWidget             *message;
-  GError                *error = NULL;
-  gchar                 *oldname;
-  gchar                  text[128];
-  gint                   response;
-  guint                  n_done;
-  guint                  n_total;
-  GList                 *first;
+  RenameChunk *chunk = data;
+
+  g_list_free_full (chunk->files, g_object_unref);
+  g_object_unref (chunk->renamer_progress);
+  g_slice_free (RenameChunk, chunk);
+}
 
-LUNAR_THREADS_ENTER
 
-  /* check if we have still pairs to go */
-  if (G_LIKELY (renamer_progress->pairs_todo != NULL))
-    {
-      /* pop the first pair from the todo list */
-      first = g_list_first (renamer_progress->pairs_todo);
-      pair = first->data;
-      renamer_progress->pairs_todo = g_list_delete_link (renamer_progress->pairs_todo, first);
 
-      /* update item count */
-      renamer_progress->n_pairs_todo--;
-      _lunar_assert (g_list_length (renamer_progress->pairs_todo) == renamer_progress->n_pairs_todo);
+static gboolean
+lunar_renamer_progress_chunk_notify (gpointer user_data)
+{
+  RenameChunk *chunk = user_data;
+  GtkWidget   *bar = chunk->renamer_progress->bar;
+  GList       *lp;
+  gchar        text[128];
 
-      /* determine the done/todo items */
-      n_done = renamer_progress->n_pairs_done + 1;
-      n_total = n_done + renamer_progress->n_pairs_todo;
+  /* tell the folders about the renamed files */
+  for (lp = chunk->files; lp != NULL; lp = lp->next)
+    {
+      lunarx_file_info_renamed (LUNARX_FILE_INFO (lp->data));
+      lunar_file_changed (LUNAR_FILE (lp->data));
+    }
 
+  if (G_LIKELY (bar != NULL))
+    {
       /* update the progress bar text */
-      g_snprintf (text, sizeof (text), "%d/%d", n_done, n_total);
-      gtk_progress_bar_set_text (GTK_PROGRESS_BAR (renamer_progress->bar), text);
+      g_snprintf (text, sizeof (text), "%u/%u", chunk->n_done, chunk->n_total);
+      gtk_progress_bar_set_text (GTK_PROGRESS_BAR (bar), text);
 
       /* update the progress bar fraction */
-      gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (renamer_progress->bar), CLAMP ((gdouble) n_done / MAX (n_total, 1), 0.0, 1.0));
+      gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (bar), CLAMP ((gdouble) chunk->n_done / MAX (chunk->n_total, 1), 0.0, 1.0));
+    }
+
+  return FALSE;
+}
 
-      /* remember the old file name (for undo) */
-      oldname = g_strdup (lunar_file_get_display_name (pair->file));
 
-      /* try to rename the file */
-      if (!lunar_file_rename (pair->file, pair->name, NULL, FALSE, &error))
+
+static void
+lunar_renamer_progress_chunk_send (LunarJob              *job,
+                                   LunarRenamerProgress  *renamer_progress,
+                                   GList                **files,
+                                   guint                  n_done,
+                                   guint                  n_total)
+{
+  RenameChunk *chunk;
+
+  chunk = g_slice_new (RenameChunk);
+  chunk->renamer_progress = g_object_ref (renamer_progress);
+  chunk->files = *files;
+  chunk->n_done = n_done;
+  chunk->n_total = n_total;
+  *files = NULL;
+
+  endo_job_send_to_mainloop (ENDO_JOB (job), lunar_renamer_progress_chunk_notify,
+                             chunk, lunar_renamer_progress_chunk_free);
+}
+
+
+
+/* orders the renames of pairs, so that no file is renamed before the file
+ * currently using its new name was renamed. cycles like a -> b, b -> a are
+ * broken by moving one file to a temporary name first */
+static GArray *
+lunar_renamer_progress_plan (GList *pairs)
+{
+  LunarRenamerPair **items;
+  LunarRenamerPair  *pair;
+  GHashTable         *sources;
+  RenameOp            op;
+  GArray             *ops;
+  GFile              *parent;
+  GFile              *target;
+  GList              *lp;
+  guint8             *state;
+  gint               *blocker;
+  gint               *stack;
+  gint                n_pairs;
+  gint                top;
+  gint                b, i, k;
+
+  enum { PLAN_NEW, PLAN_ON_STACK, PLAN_DONE };
+
+  n_pairs = g_list_length (pairs);
+  ops = g_array_sized_new (FALSE, FALSE, sizeof (RenameOp), n_pairs);
+  state = g_new0 (guint8, n_pairs);
+  blocker = g_new (gint, n_pairs);
+  stack = g_new (gint, n_pairs);
+  items = g_new (LunarRenamerPair *, n_pairs);
+
+  /* location -> index + 1 of the pair currently at that location */
+  sources = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+  for (lp = pairs, i = 0; lp != NULL; lp = lp->next, ++i)
+    {
+      items[i] = lp->data;
+      g_hash_table_insert (sources, lunar_file_get_file (items[i]->file), GINT_TO_POINTER (i + 1));
+    }
+
+  /* determine the pair that must be renamed before each pair */
+  for (i = 0; i < n_pairs; ++i)
+    {
+      pair = items[i];
+      blocker[i] = -1;
+
+      parent = g_file_get_parent (lunar_file_get_file (pair->file));
+      if (G_UNLIKELY (parent == NULL))
+        continue;
+
+      target = g_file_get_child_for_display_name (parent, pair->name, NULL);
+      if (G_LIKELY (target != NULL))
         {
-          /* determine the toplevel widget */
-          toplevel = (GtkWindow *) gtk_widget_get_toplevel (GTK_WIDGET (renamer_progress));
-
-          /* tell the user that we failed */
-          message = gtk_message_dialog_new (toplevel,
-                                            GTK_DIALOG_DESTROY_WITH_PARENT
-                                            | GTK_DIALOG_MODAL,
-                                            GTK_MESSAGE_ERROR,
-                                            GTK_BUTTONS_NONE,
-                                            _("Failed to rename \"%s\" to \"%s\"."),
-                                            oldname, pair->name);
-
-          /* check if we should provide undo */
-          if (!renamer_progress->pairs_undo && renamer_progress->pairs_done != NULL)
-            {
-              gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
-                                                        _("You can either choose to skip this file and continue to rename the "
-                                                          "remaining files, or revert the previously renamed files to their "
-                                                          "previous names, or cancel the operation without reverting previous "
-                                                          "changes."));
-              gtk_dialog_add_button (GTK_DIALOG (message), _("_Cancel"), GTK_RESPONSE_CANCEL);
-              gtk_dialog_add_button (GTK_DIALOG (message), _("_Revert Changes"), GTK_RESPONSE_REJECT);
-              gtk_dialog_add_button (GTK_DIALOG (message), _("_Skip This File"), GTK_RESPONSE_ACCEPT);
-              gtk_dialog_set_default_response (GTK_DIALOG (message), GTK_RESPONSE_ACCEPT);
-            }
-          else if (renamer_progress->pairs_todo != NULL)
+          blocker[i] = GPOINTER_TO_INT (g_hash_table_lookup (sources, target)) - 1;
+          if (blocker[i] == i)
+            blocker[i] = -1;
+          g_object_unref (target);
+        }
+      g_object_unref (parent);
+    }
+
+  g_hash_table_destroy (sources);
+
+  /* walk the chains of blocking pairs, depth first */
+  for (i = 0; i < n_pairs; ++i)
+    {
+      if (state[i] != PLAN_NEW)
+        continue;
+
+      top = 0;
+      stack[top++] = i;
+      state[i] = PLAN_ON_STACK;
+
+      while (top > 0)
+        {
+          k = stack[top - 1];
+          b = blocker[k];
+
+          if (b >= 0 && state[b] == PLAN_NEW)
             {
-              gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
-                                                        _("Do you want to skip this file and continue to rename the "
-                                                          "remaining files?"));
-              gtk_dialog_add_button (GTK_DIALOG (message), _("_Cancel"), GTK_RESPONSE_CANCEL);
-              gtk_dialog_add_button (GTK_DIALOG (message), _("_Skip This File"), GTK_RESPONSE_ACCEPT);
-              gtk_dialog_set_default_response (GTK_DIALOG (message), GTK_RESPONSE_ACCEPT);
+              /* rename the blocking pair first */
+              stack[top++] = b;
+              state[b] = PLAN_ON_STACK;
+              continue;
             }
-          else
+
+          if (b >= 0 && state[b] == PLAN_ON_STACK)
             {
-              gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message), "%s.", error->message);
-              gtk_dialog_add_button (GTK_DIALOG (message), _("_Close"), GTK_RESPONSE_CANCEL);
+              /* a cycle, move the blocking pair out of the way */
+              op.file = items[b]->file;
+              op.name = g_strdup_printf (".lunar-rename-%" G_GINT64_FORMAT "-%d", g_get_real_time (), b);
+              op.temporary = TRUE;
+              g_array_append_val (ops, op);
+              blocker[k] = -1;
             }
 
-          /* run the dialog */
-          response = gtk_dialog_run (GTK_DIALOG (message));
-          if (response == GTK_RESPONSE_REJECT)
-            {
-              /* undo previous changes */
-              renamer_progress->pairs_undo = TRUE;
+          /* the new name of this pair is free now */
+          op.file = items[k]->file;
+          op.name = g_strdup (items[k]->name);
+          op.temporary = FALSE;
+          g_array_append_val (ops, op);
+
+          state[k] = PLAN_DONE;
+          top--;
+        }
+    }
 
-              /* release the todo pairs and use the done as todo */
-              lunar_renamer_pair_list_free (renamer_progress->pairs_todo);
-              renamer_progress->pairs_todo = renamer_progress->pairs_done;
-              renamer_progress->pairs_done = NULL;
+  g_free (items);
+  g_free (stack);
+  g_free (blocker);
+  g_free (state);
 
-              renamer_progress->n_pairs_done = 0;
-              renamer_progress->n_pairs_todo = g_list_length (renamer_progress->pairs_todo);
-            }
-          else if (response != GTK_RESPONSE_ACCEPT)
+  return ops;
+}
+
+
+
+static gboolean
+lunar_renamer_progress_job (LunarJob  *job,
+                            GArray     *param_values,
+                            GError    **error)
+{
+  LunarRenamerProgress *renamer_progress;
+  LunarRenamerPair     *pair;
+  GCancellable          *cancellable;
+  RenameOp              *op;
+  GError                *err = NULL;
+  GError                *revert_err = NULL;
+  GArray                *ops;
+  GList                 *journal = NULL;
+  GList                 *files = NULL;
+  GList                 *lp;
+  gint64                 last_send;
+  guint                  n_done = 0;
+  guint                  n_total;
+  guint                  n;
+
+  _lunar_return_val_if_fail (LUNAR_IS_JOB (job), FALSE);
+  _lunar_return_val_if_fail (param_values != NULL, FALSE);
+  _lunar_return_val_if_fail (param_values->len == 1, FALSE);
+  _lunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  renamer_progress = g_value_get_pointer (&g_array_index (param_values, GValue, 0));
+  cancellable = endo_job_get_cancellable (ENDO_JOB (job));
+  n_total = g_list_length (renamer_progress->pairs);
+
+  ops = lunar_renamer_progress_plan (renamer_progress->pairs);
+
+  /* rename the files, remembering the previous names (for undo) */
+  last_send = g_get_monotonic_time ();
+  for (n = 0; n < ops->len; ++n)
+    {
+      if (endo_job_set_error_if_cancelled (ENDO_JOB (job), &err))
+        break;
+
+      op = &g_array_index (ops, RenameOp, n);
+      pair = lunar_renamer_pair_new (op->file, lunar_file_get_display_name (op->file));
+
+      if (!lunar_file_rename (op->file, op->name, cancellable, TRUE, &err))
+        {
+          if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
             {
-              /* canceled, just exit the main loop */
-              g_main_loop_quit (renamer_progress->next_idle_loop);
+              renamer_progress->failed_name = g_strdup (pair->name);
+              renamer_progress->failed_new_name = g_strdup (op->name);
             }
 
-          /* release the pair */
           lunar_renamer_pair_free (pair);
+          break;
+        }
+
+      journal = g_list_prepend (journal, pair);
 
-          /* destroy the dialog */
-          gtk_widget_destroy (message);
+      if (!op->temporary)
+        {
+          files = g_list_prepend (files, g_object_ref (op->file));
+          n_done++;
+        }
 
-          /* clear the error */
-          g_clear_error (&error);
+      if (g_get_monotonic_time () - last_send >= RENAME_CHUNK_INTERVAL)
+        {
+          lunar_renamer_progress_chunk_send (job, renamer_progress, &files, n_done, n_total);
+          last_send = g_get_monotonic_time ();
+        }
+    }
 
-          /* release old name */
-          g_free (oldname);
+  /* on errors or cancellation, revert everything done so far
+   * in reverse order, including the temporary renames */
+  for (lp = (err != NULL) ? journal : NULL; lp != NULL; lp = lp->next)
+    {
+      pair = lp->data;
+      if (lunar_file_rename (pair->file, pair->name, NULL, TRUE, &revert_err))
+        {
+          files = g_list_prepend (files, g_object_ref (pair->file));
+          renamer_progress->n_reverted++;
         }
       else
         {
-          /* replace the newname with the oldname for the pair (-> undo) */
-          g_free (pair->name);
-          pair->name = oldname;
-
-          /* move the pair to the list of completed pairs */
-          renamer_progress->pairs_done = g_list_prepend (renamer_progress->pairs_done, pair);
+          g_warning ("Failed to revert \"%s\": %s", pair->name, revert_err->message);
+          g_clear_error (&revert_err);
+          renamer_progress->n_revert_failed++;
+        }
 
-          /* update counter */
-          renamer_progress->n_pairs_done++;
-          _lunar_assert (g_list_length (renamer_progress->pairs_done) == renamer_progress->n_pairs_done);
+      if (g_get_monotonic_time () - last_send >= RENAME_CHUNK_INTERVAL)
+        {
+          lunar_renamer_progress_chunk_send (job, renamer_progress, &files, 0, n_total);
+          last_send = g_get_monotonic_time ();
         }
     }
 
-  /* be sure to cancel the internal loop once we're done */
-  if (G_UNLIKELY (renamer_progress->pairs_todo == NULL))
-    g_main_loop_quit (renamer_progress->next_idle_loop);
+  /* report the remaining files */
+  if (files != NULL || err == NULL)
+    lunar_renamer_progress_chunk_send (job, renamer_progress, &files, (err != NULL) ? 0 : n_done, n_total);
 
-LUNAR_THREADS_LEAVE
+  lunar_renamer_pair_list_free (journal);
 
-  /* keep the idle source alive as long as we have anything to do */
-  return (renamer_progress->pairs_todo != NULL);
+  for (n = 0; n < ops->len; ++n)
+    g_free (g_array_index (ops, RenameOp, n).name);
+  g_array_free (ops, TRUE);
+
+  if (err != NULL)
+    {
+      g_propagate_error (error, err);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+lunar_renamer_progress_error (LunarJob             *job,
+                              GError                *error,
+                              LunarRenamerProgress *renamer_progress)
+{
+  _lunar_return_if_fail (LUNAR_IS_RENAMER_PROGRESS (renamer_progress));
+  _lunar_return_if_fail (error != NULL);
+
+  /* remember the error until the internal main loop exits */
+  if (renamer_progress->error == NULL)
+    renamer_progress->error = g_error_copy (error);
 }
 
 
 
 static void
-lunar_renamer_progress_next_idle_destroy (gpointer user_data)
+lunar_renamer_progress_finished (LunarJob             *job,
+                                 LunarRenamerProgress *renamer_progress)
 {
-  LUNAR_RENAMER_PROGRESS (user_data)->next_idle_id = 0;
+  _lunar_return_if_fail (LUNAR_IS_RENAMER_PROGRESS (renamer_progress));
+
+  /* exit the internal main loop */
+  if (G_LIKELY (renamer_progress->loop != NULL))
+    g_main_loop_quit (renamer_progress->loop);
+}
+
+
+
+static void
+lunar_renamer_progress_show_error (LunarRenamerProgress *renamer_progress)
+{
+  GtkWindow *toplevel;
+  GtkWidget *message;
+
+  /* determine the toplevel widget */
+  toplevel = (GtkWindow *) gtk_widget_get_toplevel (GTK_WIDGET (renamer_progress));
+
+  /* tell the user that we failed */
+  message = gtk_message_dialog_new (toplevel,
+                                    GTK_DIALOG_DESTROY_WITH_PARENT
+                                    | GTK_DIALOG_MODAL,
+                                    GTK_MESSAGE_ERROR,
+                                    GTK_BUTTONS_CLOSE,
+                                    _("Failed to rename \"%s\" to \"%s\"."),
+                                    renamer_progress->failed_name,
+                                    renamer_progress->failed_new_name);
+
+  if (renamer_progress->n_revert_failed > 0)
+    {
+      gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
+                                                _("%s. Some of the previously renamed files could not be "
+                                                  "reverted to their previous names."),
+                                                renamer_progress->error->message);
+    }
+  else if (renamer_progress->n_reverted > 0)
+    {
+      gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message),
+                                                _("%s. The previously renamed files were reverted to "
+                                                  "their previous names."),
+                                                renamer_progress->error->message);
+    }
+  else
+    {
+      gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (message), "%s.",
+                                                renamer_progress->error->message);
+    }
+
+  gtk_dialog_run (GTK_DIALOG (message));
+  gtk_widget_destroy (message);
 }
 
 
@@ -303,15 +548,17 @@ lunar_renamer_progress_new (void)
  * @renamer_progress : a #LunarRenamerProgress.
  *
  * Cancels any pending rename operation for @renamer_progress.
+ * The files renamed so far are reverted to their previous
+ * names before lunar_renamer_progress_run() returns.
  **/
 void
 lunar_renamer_progress_cancel (LunarRenamerProgress *renamer_progress)
 {
   _lunar_return_if_fail (LUNAR_IS_RENAMER_PROGRESS (renamer_progress));
 
-  /* exit the internal main loop (if any) */
-  if (G_UNLIKELY (renamer_progress->next_idle_loop != NULL))
-    g_main_loop_quit (renamer_progress->next_idle_loop);
+  /* cancel the job (if any), the internal main loop exits once it's finished */
+  if (G_UNLIKELY (renamer_progress->job != NULL))
+    endo_job_cancel (ENDO_JOB (renamer_progress->job));
 }
 
 
@@ -328,7 +575,7 @@ gboolean
 lunar_renamer_progress_running (LunarRenamerProgress *renamer_progress)
 {
   _lunar_return_val_if_fail (LUNAR_IS_RENAMER_PROGRESS (renamer_progress), FALSE);
-  return (renamer_progress->next_idle_loop != NULL);
+  return (renamer_progress->loop != NULL);
 }
 
 
@@ -341,8 +588,11 @@ lunar_renamer_progress_running (LunarRenamerProgress *renamer_progress)
  * Renames all #LunarRenamePair<!---->s in the specified @pair_list
  * using the @renamer_progress.
  *
- * This method starts a new main loop, and returns only after the
- * rename operation is done (or cancelled by a "destroy" signal).
+ * The files are renamed by a job in a separate thread, while this
+ * method runs a new main loop and returns only after the rename
+ * operation is done (or cancelled by a "destroy" signal). If any
+ * file cannot be renamed, all files renamed before are reverted
+ * to their previous names.
  **/
 void
 lunar_renamer_progress_run (LunarRenamerProgress *renamer_progress,
@@ -351,47 +601,53 @@ lunar_renamer_progress_run (LunarRenamerProgress *renamer_progress,
   _lunar_return_if_fail (LUNAR_IS_RENAMER_PROGRESS (renamer_progress));
 
   /* make sure we're not already renaming */
-  if (G_UNLIKELY (renamer_progress->next_idle_id != 0
-      || renamer_progress->next_idle_loop != NULL))
+  if (G_UNLIKELY (renamer_progress->job != NULL
+      || renamer_progress->loop != NULL))
     return;
 
   /* take an additional reference on the progress */
   g_object_ref (G_OBJECT (renamer_progress));
 
-  /* make sure to release the list of completed items first */
-  lunar_renamer_pair_list_free (renamer_progress->pairs_done);
-  renamer_progress->pairs_done = NULL;
-  renamer_progress->n_pairs_done = 0;
-
-  /* set the pairs on the todo list */
-  lunar_renamer_pair_list_free (renamer_progress->pairs_todo);
-  renamer_progress->pairs_todo = lunar_renamer_pair_list_copy (pairs);
-  renamer_progress->n_pairs_todo = g_list_length (renamer_progress->pairs_todo);
+  /* set the pairs to rename */
+  lunar_renamer_pair_list_free (renamer_progress->pairs);
+  renamer_progress->pairs = lunar_renamer_pair_list_copy (pairs);
 
-  /* schedule the idle source */
-  renamer_progress->next_idle_id = g_idle_add_full (G_PRIORITY_LOW, lunar_renamer_progress_next_idle,
-                                                    renamer_progress, lunar_renamer_progress_next_idle_destroy);
+  /* launch the job, the pairs are not touched until it's finished */
+  renamer_progress->job = lunar_simple_job_launch (lunar_renamer_progress_job, 1,
+                                                    G_TYPE_POINTER, renamer_progress);
+  g_signal_connect (renamer_progress->job, "error", G_CALLBACK (lunar_renamer_progress_error), renamer_progress);
+  g_signal_connect (renamer_progress->job, "finished", G_CALLBACK (lunar_renamer_progress_finished), renamer_progress);
 
   /* run the inner main loop */
-  renamer_progress->next_idle_loop = g_main_loop_new (NULL, FALSE);
-  g_main_loop_run (renamer_progress->next_idle_loop);
-  g_main_loop_unref (renamer_progress->next_idle_loop);
-  renamer_progress->next_idle_loop = NULL;
-
-  /* be sure to cancel any pending idle source */
-  if (G_UNLIKELY (renamer_progress->next_idle_id != 0))
-    g_source_remove (renamer_progress->next_idle_id);
-
-  /* release the list of completed items */
-  lunar_renamer_pair_list_free (renamer_progress->pairs_done);
-  renamer_progress->pairs_done = NULL;
+  renamer_progress->loop = g_main_loop_new (NULL, FALSE);
+  g_main_loop_run (renamer_progress->loop);
+  g_main_loop_unref (renamer_progress->loop);
+  renamer_progress->loop = NULL;
+
+  /* release the job */
+  g_signal_handlers_disconnect_matched (renamer_progress->job, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, renamer_progress);
+  g_object_unref (renamer_progress->job);
+  renamer_progress->job = NULL;
+
+  /* tell the user if a file could not be renamed */
+  if (renamer_progress->error != NULL
+      && renamer_progress->failed_name != NULL
+      && !gtk_widget_in_destruction (GTK_WIDGET (renamer_progress)))
+    lunar_renamer_progress_show_error (renamer_progress);
+
+  /* reset the job state */
+  g_clear_error (&renamer_progress->error);
+  g_free (renamer_progress->failed_name);
+  renamer_progress->failed_name = NULL;
+  g_free (renamer_progress->failed_new_name);
+  renamer_progress->failed_new_name = NULL;
+  renamer_progress->n_reverted = 0;
+  renamer_progress->n_revert_failed = 0;
 
-  /* release the list of todo items */
-  lunar_renamer_pair_list_free (renamer_progress->pairs_todo);
-  renamer_progress->pairs_todo = NULL;
+  /* release the pairs */
+  lunar_renamer_pair_list_free (renamer_progress->pairs);
+  renamer_progress->pairs = NULL;
 
   /* release the additional reference on the progress */
   g_object_unref (G_OBJECT (renamer_progress));
 }
-
-
@@ -0,0 +1,678 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 The Lunar development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libexpidus1util/libexpidus1util.h>
+
+#include <lunar/lunar-private.h>
+#include <lunar/lunar-size-cache.h>
+
+
+
+/* the location of the cache file below the user's cache directory */
+#define SIZE_CACHE_PATH "Lunar/size-cache"
+
+/* the first line of the cache file, entries in files
+ * without it don't know their descendants and are ignored */
+#define SIZE_CACHE_HEADER "lunar-size-cache 2"
+
+/* the maximum number of directories remembered */
+#define SIZE_CACHE_MAX_ENTRIES 2048
+
+/* the maximum number of descendants of all directories, which
+ * bounds the size of the cache file to a few megabytes */
+#define SIZE_CACHE_MAX_DESCENDANTS 65536
+
+/* seconds to wait after a change before the cache is written to disk */
+#define SIZE_CACHE_SAVE_DELAY 5
+
+
+
+typedef struct _LunarSizeCacheItem LunarSizeCacheItem;
+
+/* the work done by the I/O thread of the cache */
+enum
+{
+  SIZE_CACHE_LOAD = 1,
+  SIZE_CACHE_SAVE,
+};
+
+
+
+static void lunar_size_cache_finalize (GObject *object);
+
+
+
+struct _LunarSizeCacheClass
+{
+  GObjectClass __parent__;
+};
+
+struct _LunarSizeCache
+{
+  GObject __parent__;
+
+  /* protects everything below, the deep count job runs in a thread */
+  GMutex      lock;
+
+  /* uri -> LunarSizeCacheItem */
+  GHashTable *items;
+
+  /* increased for every store, to find the oldest item */
+  guint64     stamp;
+
+  /* the number of descendants of all items */
+  guint       n_descendants;
+
+  guint       save_timer_id;
+
+  /* loads and saves the cache file, one at a time and in order */
+  GThreadPool *io_pool;
+};
+
+struct _LunarSizeCacheItem
+{
+  guint64              mtime;
+  guint64              stamp;
+  LunarSizeCacheEntry entry;
+
+  /* the LunarSizeCacheDescendants of the directory */
+  GArray              *descendants;
+};
+
+
+
+G_DEFINE_TYPE (LunarSizeCache, lunar_size_cache, G_TYPE_OBJECT)
+
+
+
+static void
+lunar_size_cache_class_init (LunarSizeCacheClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = lunar_size_cache_finalize;
+}
+
+
+
+static void
+lunar_size_cache_item_free (gpointer data)
+{
+  LunarSizeCacheItem *item = data;
+
+  if (item->descendants != NULL)
+    g_array_unref (item->descendants);
+  g_slice_free (LunarSizeCacheItem, item);
+}
+
+
+
+static void
+lunar_size_cache_descendant_clear (gpointer data)
+{
+  LunarSizeCacheDescendant *descendant = data;
+
+  g_free (descendant->path);
+}
+
+
+
+/* must be called with the lock held */
+static gboolean
+lunar_size_cache_remove (LunarSizeCache *cache,
+                         const gchar    *uri)
+{
+  LunarSizeCacheItem *item;
+
+  item = g_hash_table_lookup (cache->items, uri);
+  if (item == NULL)
+    return FALSE;
+
+  cache->n_descendants -= item->descendants->len;
+  g_hash_table_remove (cache->items, uri);
+
+  return TRUE;
+}
+
+
+
+/* must be called with the lock held, takes @uri and @item */
+static void
+lunar_size_cache_insert (LunarSizeCache     *cache,
+                         gchar              *uri,
+                         LunarSizeCacheItem *item)
+{
+  LunarSizeCacheItem *oldest_item;
+  GHashTableIter       iter;
+  gpointer             oldest_uri;
+  gpointer             key;
+  gpointer             value;
+
+  lunar_size_cache_remove (cache, uri);
+
+  item->stamp = ++cache->stamp;
+  cache->n_descendants += item->descendants->len;
+  g_hash_table_insert (cache->items, uri, item);
+
+  /* forget the directories stored longest ago */
+  while (g_hash_table_size (cache->items) > SIZE_CACHE_MAX_ENTRIES
+         || cache->n_descendants > SIZE_CACHE_MAX_DESCENDANTS)
+    {
+      oldest_item = NULL;
+      oldest_uri = NULL;
+      g_hash_table_iter_init (&iter, cache->items);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        if (oldest_item == NULL || ((LunarSizeCacheItem *) value)->stamp < oldest_item->stamp)
+          {
+            oldest_item = value;
+            oldest_uri = key;
+          }
+      lunar_size_cache_remove (cache, oldest_uri);
+    }
+}
+
+
+
+static void
+lunar_size_cache_load (LunarSizeCache *cache)
+{
+  LunarSizeCacheDescendant descendant;
+  LunarSizeCacheItem      *item;
+  LunarSizeCacheItem      *last_item = NULL;
+  GHashTableIter           iter;
+  GHashTable              *loaded;
+  gpointer                 uri;
+  gchar                  **lines;
+  gchar                   *contents;
+  gchar                   *path;
+  gchar                   *end;
+  guint                    n;
+
+  path = expidus_resource_lookup (EXPIDUS_RESOURCE_CACHE, SIZE_CACHE_PATH);
+  if (path == NULL)
+    return;
+
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      g_free (path);
+      return;
+    }
+
+  /* parse without the lock, lookups just miss meanwhile */
+  loaded = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, lunar_size_cache_item_free);
+
+  /* every entry is a line "mtime size allocated files dirs unreadable uri",
+   * followed by a line "\tmtime escaped-path" for every descendant */
+  lines = g_strsplit (contents, "\n", -1);
+  for (n = (g_strcmp0 (lines[0], SIZE_CACHE_HEADER) == 0) ? 1 : g_strv_length (lines); lines[n] != NULL; ++n)
+    {
+      if (lines[n][0] == '\t')
+        {
+          /* skip descendants of broken lines */
+          if (last_item == NULL)
+            continue;
+
+          descendant.mtime = g_ascii_strtoull (lines[n] + 1, &end, 10);
+          if (*end != ' ' || end[1] == '\0')
+            continue;
+
+          descendant.path = g_uri_unescape_string (end + 1, NULL);
+          if (descendant.path != NULL)
+            g_array_append_val (last_item->descendants, descendant);
+          continue;
+        }
+
+      item = g_slice_new0 (LunarSizeCacheItem);
+      end = lines[n];
+      item->mtime = g_ascii_strtoull (end, &end, 10);
+      item->entry.total_size = g_ascii_strtoull (end, &end, 10);
+      item->entry.allocated_size = g_ascii_strtoull (end, &end, 10);
+      item->entry.file_count = g_ascii_strtoull (end, &end, 10);
+      item->entry.directory_count = g_ascii_strtoull (end, &end, 10);
+      item->entry.unreadable_directory_count = g_ascii_strtoull (end, &end, 10);
+
+      /* skip broken lines */
+      last_item = NULL;
+      if (*end != ' ' || end[1] == '\0')
+        {
+          lunar_size_cache_item_free (item);
+          continue;
+        }
+
+      item->descendants = lunar_size_cache_descendants_new ();
+      g_hash_table_replace (loaded, g_strdup (end + 1), item);
+      last_item = item;
+    }
+  g_strfreev (lines);
+  g_free (contents);
+  g_free (path);
+
+  /* directories counted since startup are more recent */
+  g_mutex_lock (&cache->lock);
+  g_hash_table_iter_init (&iter, loaded);
+  while (g_hash_table_iter_next (&iter, &uri, (gpointer *) &item))
+    if (!g_hash_table_contains (cache->items, uri))
+      {
+        g_hash_table_iter_steal (&iter);
+        lunar_size_cache_insert (cache, uri, item);
+      }
+  g_mutex_unlock (&cache->lock);
+
+  g_hash_table_destroy (loaded);
+}
+
+
+
+static void
+lunar_size_cache_save (LunarSizeCache *cache)
+{
+  LunarSizeCacheDescendant *descendant;
+  LunarSizeCacheItem       *item;
+  LunarSizeCacheItem       *copy;
+  GHashTableIter            iter;
+  GHashTable               *snapshot;
+  const gchar              *uri;
+  GString                  *contents;
+  GError                   *error = NULL;
+  gchar                    *escaped;
+  gchar                    *path;
+  guint                     n;
+
+  /* copy the items, the descendants are never modified once stored */
+  g_mutex_lock (&cache->lock);
+  snapshot = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, lunar_size_cache_item_free);
+  g_hash_table_iter_init (&iter, cache->items);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &uri, (gpointer *) &item))
+    {
+      copy = g_slice_dup (LunarSizeCacheItem, item);
+      copy->descendants = g_array_ref (item->descendants);
+      g_hash_table_insert (snapshot, g_strdup (uri), copy);
+    }
+  g_mutex_unlock (&cache->lock);
+
+  contents = g_string_sized_new (g_hash_table_size (snapshot) * 128);
+  g_string_append (contents, SIZE_CACHE_HEADER "\n");
+  g_hash_table_iter_init (&iter, snapshot);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &uri, (gpointer *) &item))
+    {
+      g_string_append_printf (contents, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT
+                              " %" G_GUINT64_FORMAT " %u %u %u %s\n",
+                              item->mtime, item->entry.total_size,
+                              item->entry.allocated_size, item->entry.file_count,
+                              item->entry.directory_count,
+                              item->entry.unreadable_directory_count, uri);
+
+      for (n = 0; n < item->descendants->len; ++n)
+        {
+          descendant = &g_array_index (item->descendants, LunarSizeCacheDescendant, n);
+          escaped = g_uri_escape_string (descendant->path, "/", TRUE);
+          g_string_append_printf (contents, "\t%" G_GUINT64_FORMAT " %s\n", descendant->mtime, escaped);
+          g_free (escaped);
+        }
+    }
+
+  g_hash_table_destroy (snapshot);
+
+  path = expidus_resource_save_location (EXPIDUS_RESOURCE_CACHE, SIZE_CACHE_PATH, TRUE);
+  if (G_LIKELY (path != NULL))
+    {
+      if (!g_file_set_contents (path, contents->str, contents->len, &error))
+        {
+          g_warning ("Failed to write the directory size cache: %s", error->message);
+          g_error_free (error);
+        }
+      g_free (path);
+    }
+
+  g_string_free (contents, TRUE);
+}
+
+
+
+static void
+lunar_size_cache_io (gpointer data,
+                     gpointer user_data)
+{
+  LunarSizeCache *cache = LUNAR_SIZE_CACHE (user_data);
+
+  if (GPOINTER_TO_UINT (data) == SIZE_CACHE_LOAD)
+    lunar_size_cache_load (cache);
+  else
+    lunar_size_cache_save (cache);
+}
+
+
+
+static gboolean
+lunar_size_cache_save_timer (gpointer user_data)
+{
+  LunarSizeCache *cache = LUNAR_SIZE_CACHE (user_data);
+
+  g_mutex_lock (&cache->lock);
+  cache->save_timer_id = 0;
+  g_mutex_unlock (&cache->lock);
+
+  /* the file is written in the I/O thread, after it was loaded */
+  g_thread_pool_push (cache->io_pool, GUINT_TO_POINTER (SIZE_CACHE_SAVE), NULL);
+
+  return FALSE;
+}
+
+
+
+/* must be called with the lock held */
+static void
+lunar_size_cache_schedule_save (LunarSizeCache *cache)
+{
+  if (cache->save_timer_id == 0)
+    cache->save_timer_id = g_timeout_add_seconds (SIZE_CACHE_SAVE_DELAY, lunar_size_cache_save_timer, cache);
+}
+
+
+
+static void
+lunar_size_cache_init (LunarSizeCache *cache)
+{
+  g_mutex_init (&cache->lock);
+  cache->items = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, lunar_size_cache_item_free);
+  cache->stamp = 0;
+  cache->save_timer_id = 0;
+
+  /* read the cache file in a thread, it may be large */
+  cache->io_pool = g_thread_pool_new (lunar_size_cache_io, cache, 1, FALSE, NULL);
+  g_thread_pool_push (cache->io_pool, GUINT_TO_POINTER (SIZE_CACHE_LOAD), NULL);
+}
+
+
+
+static void
+lunar_size_cache_finalize (GObject *object)
+{
+  LunarSizeCache *cache = LUNAR_SIZE_CACHE (object);
+
+  if (cache->save_timer_id != 0)
+    g_source_remove (cache->save_timer_id);
+
+  /* wait for pending loads and saves */
+  g_thread_pool_free (cache->io_pool, FALSE, TRUE);
+
+  g_hash_table_destroy (cache->items);
+  g_mutex_clear (&cache->lock);
+
+  (*G_OBJECT_CLASS (lunar_size_cache_parent_class)->finalize) (object);
+}
+
+
+
+/**
+ * lunar_size_cache_get_default:
+ *
+ * Returns a reference to the default #LunarSizeCache, which remembers
+ * the totals counted by #LunarDeepCountJob for directories across
+ * windows and sessions. The default instance lives until the process
+ * exits and may be used from any thread. The cache file is read and
+ * written in a thread, lookups miss until it was read.
+ *
+ * The caller is responsible to free the returned instance
+ * using g_object_unref() when no longer needed.
+ *
+ * Return value: the default #LunarSizeCache instance.
+ **/
+LunarSizeCache *
+lunar_size_cache_get_default (void)
+{
+  static gsize size_cache_default = 0;
+
+  if (g_once_init_enter (&size_cache_default))
+    g_once_init_leave (&size_cache_default, (gsize) g_object_new (LUNAR_TYPE_SIZE_CACHE, NULL));
+
+  return g_object_ref (LUNAR_SIZE_CACHE (size_cache_default));
+}
+
+
+
+/**
+ * lunar_size_cache_descendants_new:
+ *
+ * Allocates an empty array for the #LunarSizeCacheDescendant<!---->s
+ * of a directory, which frees the paths of its elements.
+ *
+ * Return value: the newly allocated #GArray.
+ **/
+GArray *
+lunar_size_cache_descendants_new (void)
+{
+  GArray *descendants;
+
+  descendants = g_array_new (FALSE, FALSE, sizeof (LunarSizeCacheDescendant));
+  g_array_set_clear_func (descendants, lunar_size_cache_descendant_clear);
+
+  return descendants;
+}
+
+
+
+/* checks that none of the descendants changed, this does
+ * blocking I/O and must be called without the lock held */
+static gboolean
+lunar_size_cache_validate (GFile  *directory,
+                           GArray *descendants)
+{
+  LunarSizeCacheDescendant *descendant;
+  GFileInfo                *info;
+  gboolean                  valid = TRUE;
+  GFile                    *file;
+  guint                     n;
+
+  for (n = 0; valid && n < descendants->len; ++n)
+    {
+      descendant = &g_array_index (descendants, LunarSizeCacheDescendant, n);
+      file = g_file_resolve_relative_path (directory, descendant->path);
+      info = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+
+      /* removed or changed while we were not watching */
+      valid = (info != NULL && g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) == descendant->mtime);
+
+      if (info != NULL)
+        g_object_unref (info);
+      g_object_unref (file);
+    }
+
+  return valid;
+}
+
+
+
+/**
+ * lunar_size_cache_lookup:
+ * @cache        : a #LunarSizeCache.
+ * @directory    : the directory to look up.
+ * @mtime        : the current modification time of @directory.
+ * @entry_return : return location for the totals of @directory.
+ *
+ * Looks up the totals of @directory. Entries recorded for a different
+ * modification time of @directory or of any directory below it are
+ * dropped, which queries all these directories.
+ *
+ * Return value: %TRUE if @entry_return was filled in.
+ **/
+gboolean
+lunar_size_cache_lookup (LunarSizeCache      *cache,
+                         GFile               *directory,
+                         guint64              mtime,
+                         LunarSizeCacheEntry *entry_return)
+{
+  LunarSizeCacheEntry entry;
+  LunarSizeCacheItem *item;
+  GArray             *descendants = NULL;
+  gboolean            found = FALSE;
+  gchar              *uri;
+
+  _lunar_return_val_if_fail (LUNAR_IS_SIZE_CACHE (cache), FALSE);
+  _lunar_return_val_if_fail (G_IS_FILE (directory), FALSE);
+  _lunar_return_val_if_fail (entry_return != NULL, FALSE);
+
+  uri = g_file_get_uri (directory);
+
+  g_mutex_lock (&cache->lock);
+  item = g_hash_table_lookup (cache->items, uri);
+  if (item != NULL)
+    {
+      if (item->mtime == mtime)
+        {
+          entry = item->entry;
+          descendants = g_array_ref (item->descendants);
+          found = TRUE;
+        }
+      else
+        {
+          /* changed while we were not watching */
+          lunar_size_cache_remove (cache, uri);
+          lunar_size_cache_schedule_save (cache);
+        }
+    }
+  g_mutex_unlock (&cache->lock);
+
+  if (found)
+    {
+      /* changes below the directory leave its mtime alone */
+      found = lunar_size_cache_validate (directory, descendants);
+      if (found)
+        {
+          *entry_return = entry;
+        }
+      else
+        {
+          /* drop the entry, unless it was replaced meanwhile */
+          g_mutex_lock (&cache->lock);
+          item = g_hash_table_lookup (cache->items, uri);
+          if (item != NULL && item->descendants == descendants)
+            {
+              lunar_size_cache_remove (cache, uri);
+              lunar_size_cache_schedule_save (cache);
+            }
+          g_mutex_unlock (&cache->lock);
+        }
+
+      g_array_unref (descendants);
+    }
+
+  g_free (uri);
+
+  return found;
+}
+
+
+
+/**
+ * lunar_size_cache_store:
+ * @cache       : a #LunarSizeCache.
+ * @directory   : the directory that was counted.
+ * @mtime       : the modification time of @directory when counting started.
+ * @entry       : the totals of @directory.
+ * @descendants : the #LunarSizeCacheDescendant<!---->s of @directory,
+ *                allocated with lunar_size_cache_descendants_new().
+ *                The cache takes ownership of the array.
+ *
+ * Remembers the totals of @directory, until @directory or one of its
+ * @descendants changes or is reported to change through
+ * lunar_size_cache_invalidate(). Nothing is remembered if there are
+ * more than %LUNAR_SIZE_CACHE_MAX_DESCENDANTS @descendants.
+ **/
+void
+lunar_size_cache_store (LunarSizeCache            *cache,
+                        GFile                     *directory,
+                        guint64                    mtime,
+                        const LunarSizeCacheEntry *entry,
+                        GArray                    *descendants)
+{
+  LunarSizeCacheItem *item;
+
+  _lunar_return_if_fail (LUNAR_IS_SIZE_CACHE (cache));
+  _lunar_return_if_fail (G_IS_FILE (directory));
+  _lunar_return_if_fail (entry != NULL);
+  _lunar_return_if_fail (descendants != NULL);
+
+  /* too expensive to check and to save */
+  if (G_UNLIKELY (descendants->len > LUNAR_SIZE_CACHE_MAX_DESCENDANTS))
+    {
+      g_array_unref (descendants);
+      return;
+    }
+
+  item = g_slice_new (LunarSizeCacheItem);
+  item->mtime = mtime;
+  item->entry = *entry;
+  item->descendants = descendants;
+
+  g_mutex_lock (&cache->lock);
+
+  lunar_size_cache_insert (cache, g_file_get_uri (directory), item);
+  lunar_size_cache_schedule_save (cache);
+
+  g_mutex_unlock (&cache->lock);
+}
+
+
+
+/**
+ * lunar_size_cache_invalidate:
+ * @cache : a #LunarSizeCache.
+ * @file  : a #GFile that changed.
+ *
+ * Drops the totals of @file and all its ancestors, because
+ * each of their subtrees contains @file.
+ **/
+void
+lunar_size_cache_invalidate (LunarSizeCache *cache,
+                             GFile          *file)
+{
+  gboolean removed = FALSE;
+  GFile   *parent;
+  gchar   *uri;
+
+  _lunar_return_if_fail (LUNAR_IS_SIZE_CACHE (cache));
+  _lunar_return_if_fail (G_IS_FILE (file));
+
+  g_mutex_lock (&cache->lock);
+
+  if (g_hash_table_size (cache->items) > 0)
+    {
+      for (file = g_object_ref (file); file != NULL; file = parent)
+        {
+          uri = g_file_get_uri (file);
+          removed |= lunar_size_cache_remove (cache, uri);
+          g_free (uri);
+
+          parent = g_file_get_parent (file);
+          g_object_unref (file);
+        }
+
+      if (removed)
+        lunar_size_cache_schedule_save (cache);
+    }
+
+  g_mutex_unlock (&cache->lock);
+}
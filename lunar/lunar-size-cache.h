@@ -0,0 +1,95 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 The Lunar development team
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __LUNAR_SIZE_CACHE_H__
+#define __LUNAR_SIZE_CACHE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _LunarSizeCacheClass      LunarSizeCacheClass;
+typedef struct _LunarSizeCache           LunarSizeCache;
+typedef struct _LunarSizeCacheEntry      LunarSizeCacheEntry;
+typedef struct _LunarSizeCacheDescendant LunarSizeCacheDescendant;
+
+#define LUNAR_TYPE_SIZE_CACHE            (lunar_size_cache_get_type ())
+#define LUNAR_SIZE_CACHE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), LUNAR_TYPE_SIZE_CACHE, LunarSizeCache))
+#define LUNAR_SIZE_CACHE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), LUNAR_TYPE_SIZE_CACHE, LunarSizeCacheClass))
+#define LUNAR_IS_SIZE_CACHE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), LUNAR_TYPE_SIZE_CACHE))
+#define LUNAR_IS_SIZE_CACHE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), LUNAR_TYPE_SIZE_CACHE))
+#define LUNAR_SIZE_CACHE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), LUNAR_TYPE_SIZE_CACHE, LunarSizeCacheClass))
+
+/* subtrees with more directories are not remembered */
+#define LUNAR_SIZE_CACHE_MAX_DESCENDANTS 16384
+
+/**
+ * LunarSizeCacheEntry:
+ * @total_size                 : the apparent size of the subtree in bytes.
+ * @allocated_size             : the size allocated on disk in bytes.
+ * @file_count                 : the number of files in the subtree.
+ * @directory_count            : the number of directories in the subtree.
+ * @unreadable_directory_count : the number of unreadable directories.
+ *
+ * The totals of a directory subtree, as counted by #LunarDeepCountJob.
+ **/
+struct _LunarSizeCacheEntry
+{
+  guint64 total_size;
+  guint64 allocated_size;
+  guint   file_count;
+  guint   directory_count;
+  guint   unreadable_directory_count;
+};
+
+/**
+ * LunarSizeCacheDescendant:
+ * @path  : the path of the directory relative to the counted directory.
+ * @mtime : the modification time of the directory when it was listed.
+ *
+ * A directory below a counted directory, which must be unchanged
+ * for the totals of the counted directory to be valid.
+ **/
+struct _LunarSizeCacheDescendant
+{
+  gchar   *path;
+  guint64  mtime;
+};
+
+GType            lunar_size_cache_get_type    (void) G_GNUC_CONST;
+
+GArray          *lunar_size_cache_descendants_new (void);
+
+LunarSizeCache *lunar_size_cache_get_default (void);
+
+gboolean         lunar_size_cache_lookup      (LunarSizeCache            *cache,
+                                               GFile                     *directory,
+                                               guint64                    mtime,
+                                               LunarSizeCacheEntry       *entry_return);
+void             lunar_size_cache_store       (LunarSizeCache            *cache,
+                                               GFile                     *directory,
+                                               guint64                    mtime,
+                                               const LunarSizeCacheEntry *entry,
+                                               GArray                    *descendants);
+void             lunar_size_cache_invalidate  (LunarSizeCache            *cache,
+                                               GFile                     *file);
+
+G_END_DECLS;
+
+#endif /* !__LUNAR_SIZE_CACHE_H__ */
@@ -68,6 +68,7 @@ static void     lunar_size_label_finished              (EndoJob               *j
                                                          LunarSizeLabel      *size_label);
 static void     lunar_size_label_status_update         (LunarDeepCountJob   *job,
                                                          guint64               total_size,
+                                                         guint64               allocated_size,
                                                          guint                 file_count,
                                                          guint                 directory_count,
                                                          guint                 unreadable_directory_count,
@@ -388,6 +389,7 @@ lunar_size_label_finished (EndoJob          *job,
 static void
 lunar_size_label_status_update (LunarDeepCountJob *job,
                                  guint64             total_size,
+                                 guint64             allocated_size,
                                  guint               file_count,
                                  guint               directory_count,
                                  guint               unreadable_directory_count,
@@ -397,6 +399,7 @@ lunar_size_label_status_update (LunarDeepCountJob *job,
   gchar             *text;
   guint              n;
   gchar             *unreable_text;
+  gchar             *allocated_text;
 
   _lunar_return_if_fail (LUNAR_IS_DEEP_COUNT_JOB (job));
   _lunar_return_if_fail (LUNAR_IS_SIZE_LABEL (size_label));
@@ -412,6 +415,19 @@ lunar_size_label_status_update (LunarDeepCountJob *job,
       text = g_strdup_printf (ngettext ("%u item, totalling %s", "%u items, totalling %s", n), n, size_string);
       g_free (size_string);
 
+      if (allocated_size > 0 && allocated_size != total_size)
+        {
+          /* TRANSLATORS: this is the space the files take up on the disk,
+           * which differs from their size for sparse or compressed files */
+          size_string = g_format_size_full (allocated_size, G_FORMAT_SIZE_LONG_FORMAT | (size_label->file_size_binary ? G_FORMAT_SIZE_IEC_UNITS : G_FORMAT_SIZE_DEFAULT));
+          allocated_text = g_strdup_printf (_("%s on disk"), size_string);
+          g_free (size_string);
+          size_string = g_strconcat (text, "\n", allocated_text, NULL);
+          g_free (allocated_text);
+          g_free (text);
+          text = size_string;
+        }
+
       if (unreadable_directory_count > 0)
         {
           /* TRANSLATORS: this is shows if during the deep count size
@@ -59,6 +59,11 @@
 
 
 
+/* the maximum number of files next to the visible range to prefetch thumbnails for */
+#define THUMBNAIL_PREFETCH_MAX (256)
+
+
+
 /* Property identifiers */
 enum
 {
@@ -256,11 +261,17 @@ static void                 lunar_standard_view_thumbnailing_destroyed     (gpoi
 static void                 lunar_standard_view_cancel_thumbnailing        (LunarStandardView       *standard_view);
 static void                 lunar_standard_view_schedule_thumbnail_timeout (LunarStandardView       *standard_view);
 static void                 lunar_standard_view_schedule_thumbnail_idle    (LunarStandardView       *standard_view);
+static GList               *lunar_standard_view_get_range_files            (LunarStandardView       *standard_view,
+                                                                             GtkTreePath              *start_path,
+                                                                             GtkTreePath              *end_path);
 static gboolean             lunar_standard_view_request_thumbnails         (gpointer                  data);
 static gboolean             lunar_standard_view_request_thumbnails_lazy    (gpointer                  data);
 static void                 lunar_standard_view_thumbnail_mode_toggled     (LunarStandardView       *standard_view,
                                                                              GParamSpec               *pspec,
                                                                              LunarIconFactory        *icon_factory);
+static void                 lunar_standard_view_cancel_file_icons          (LunarStandardView       *standard_view,
+                                                                             GHashTable               *visible_files);
+static void                 lunar_standard_view_update_visible_range       (LunarStandardView       *standard_view);
 static void                 lunar_standard_view_scrolled                   (GtkAdjustment            *adjustment,
                                                                              LunarStandardView       *standard_view);
 static void                 lunar_standard_view_size_allocate              (LunarStandardView       *standard_view,
@@ -341,9 +352,18 @@ struct _LunarStandardViewPrivate
   /* support for generating thumbnails */
   LunarThumbnailer      *thumbnailer;
   guint                   thumbnail_request;
+  guint                   thumbnail_prefetch_request;
   guint                   thumbnail_source_id;
   gboolean                thumbnailing_scheduled;
 
+  /* last scroll positions, to prefetch thumbnails in the scroll direction */
+  gdouble                 thumbnail_hscroll;
+  gdouble                 thumbnail_vscroll;
+  gboolean                thumbnail_scroll_backward;
+
+  /* files in the visible range, whose icons are decoded */
+  GHashTable             *visible_files;
+
   /* file insert signal */
   gulong                  row_changed_id;
 
@@ -661,6 +681,7 @@ lunar_standard_view_init (LunarStandardView *standard_view)
   standard_view->priv->thumbnailer = lunar_thumbnailer_get ();
   g_signal_connect (G_OBJECT (standard_view->priv->thumbnailer), "request-finished", G_CALLBACK (lunar_standard_view_finished_thumbnailing), standard_view);
   standard_view->priv->thumbnailing_scheduled = FALSE;
+  standard_view->priv->visible_files = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
 
   /* initialize the scrolled window */
   gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (standard_view),
@@ -717,6 +738,9 @@ lunar_standard_view_init (LunarStandardView *standard_view)
   /* be sure to update the statusbar text whenever the file-size-binary property changes */
   g_signal_connect_swapped (G_OBJECT (standard_view->model), "notify::file-size-binary", G_CALLBACK (lunar_standard_view_update_statusbar_text), standard_view);
 
+  /* ...and whenever the sizes in the model or the dimensions of the selected image are known */
+  g_signal_connect_swapped (G_OBJECT (standard_view->model), "statusbar-changed", G_CALLBACK (lunar_standard_view_update_statusbar_text), standard_view);
+
   /* connect to size allocation signals for generating thumbnail requests */
   g_signal_connect_after (G_OBJECT (standard_view), "size-allocate",
                           G_CALLBACK (lunar_standard_view_size_allocate), NULL);
@@ -881,6 +905,7 @@ lunar_standard_view_finalize (GObject *object)
   /* release the thumbnailer */
   g_signal_handlers_disconnect_by_func (standard_view->priv->thumbnailer, lunar_standard_view_finished_thumbnailing, standard_view);
   g_object_unref (standard_view->priv->thumbnailer);
+  g_hash_table_destroy (standard_view->priv->visible_files);
 
   /* release the scroll_to_file reference (if any) */
   if (G_UNLIKELY (standard_view->priv->scroll_to_file != NULL))
@@ -1072,6 +1097,12 @@ lunar_standard_view_realize (GtkWidget *widget)
                             G_CALLBACK (lunar_standard_view_thumbnail_mode_toggled),
                             standard_view);
 
+  /* redraw the rows whose previews were decoded in a thread */
+  g_signal_connect_swapped (standard_view->icon_factory,
+                            "file-icon-ready",
+                            G_CALLBACK (gtk_widget_queue_draw),
+                            standard_view);
+
   /* apply the thumbnail frame preferences after icon_factory got initialized */
   endo_binding_new (G_OBJECT (standard_view->preferences), "misc-thumbnail-draw-frames", G_OBJECT (standard_view), "thumbnail-draw-frames");
 
@@ -1086,6 +1117,10 @@ lunar_standard_view_unrealize (GtkWidget *widget)
 {
   LunarStandardView *standard_view = LUNAR_STANDARD_VIEW (widget);
 
+  /* stop decoding the icons of the rows that were shown */
+  lunar_standard_view_cancel_file_icons (standard_view, NULL);
+  g_hash_table_remove_all (standard_view->priv->visible_files);
+
   /* drop the reference on the icon factory */
   g_signal_handlers_disconnect_by_func (G_OBJECT (standard_view->icon_factory), gtk_widget_queue_draw, standard_view);
   g_object_unref (G_OBJECT (standard_view->icon_factory));
@@ -1531,6 +1566,9 @@ lunar_standard_view_set_loading (LunarStandardView *standard_view,
 
       /* cleanup */
       lunar_g_file_list_free (selected_files);
+
+      /* the rows on screen are final now, handle them first */
+      lunar_standard_view_update_visible_range (standard_view);
     }
 
   /* check if we're done loading and a thumbnail timeout or idle was requested */
@@ -1564,17 +1602,20 @@ lunar_standard_view_get_statusbar_text (LunarView *view)
   /* generate the statusbar text on-demand */
   if (standard_view->priv->statusbar_text == NULL)
     {
-      /* query the selected items (actually a list of GtkTreePath's) */
-      items = LUNAR_STANDARD_VIEW_GET_CLASS (standard_view)->get_selected_items (standard_view);
-
       /* we display a loading text if no items are
        * selected and the view is loading
        */
-      if (items == NULL && standard_view->loading)
-        return _("Loading folder contents...");
+      if (standard_view->loading)
+        {
+          /* selected_files holds the files to select after loading here */
+          items = LUNAR_STANDARD_VIEW_GET_CLASS (standard_view)->get_selected_items (standard_view);
+          if (items == NULL)
+            return _("Loading folder contents...");
+          g_list_free_full (items, (GDestroyNotify) gtk_tree_path_free);
+        }
 
-      standard_view->priv->statusbar_text = lunar_list_model_get_statusbar_text (standard_view->model, items);
-      g_list_free_full (items, (GDestroyNotify) gtk_tree_path_free);
+      /* the model keeps the totals of the selection */
+      standard_view->priv->statusbar_text = lunar_list_model_get_statusbar_text (standard_view->model);
     }
 
   return standard_view->priv->statusbar_text;
@@ -3402,6 +3443,8 @@ lunar_standard_view_finished_thumbnailing (LunarThumbnailer  *thumbnailer,
 
   if (standard_view->priv->thumbnail_request == request)
     standard_view->priv->thumbnail_request = 0;
+  else if (standard_view->priv->thumbnail_prefetch_request == request)
+    standard_view->priv->thumbnail_prefetch_request = 0;
 }
 
 
@@ -3435,6 +3478,14 @@ lunar_standard_view_cancel_thumbnailing (LunarStandardView *standard_view)
                                   standard_view->priv->thumbnail_request);
       standard_view->priv->thumbnail_request = 0;
     }
+
+  /* the files next to the old visible range are not interesting anymore */
+  if (standard_view->priv->thumbnail_prefetch_request > 0)
+    {
+      lunar_thumbnailer_dequeue (standard_view->priv->thumbnailer,
+                                  standard_view->priv->thumbnail_prefetch_request);
+      standard_view->priv->thumbnail_prefetch_request = 0;
+    }
 }
 
 
@@ -3493,17 +3544,61 @@ lunar_standard_view_schedule_thumbnail_idle (LunarStandardView *standard_view)
 
 
 
+static GList*
+lunar_standard_view_get_range_files (LunarStandardView *standard_view,
+                                      GtkTreePath        *start_path,
+                                      GtkTreePath        *end_path)
+{
+  GtkTreePath *path;
+  GtkTreeIter  iter;
+  gboolean     valid_iter;
+  GList       *files = NULL;
+
+  /* iterate over the range to collect all files */
+  valid_iter = gtk_tree_model_get_iter (GTK_TREE_MODEL (standard_view->model),
+                                        &iter, start_path);
+
+  while (valid_iter)
+    {
+      /* prepend the file to the visible items list */
+      files = g_list_prepend (files, lunar_list_model_get_file (standard_view->model, &iter));
+
+      /* check if we've reached the end of the visible range */
+      path = gtk_tree_model_get_path (GTK_TREE_MODEL (standard_view->model), &iter);
+      if (gtk_tree_path_compare (path, end_path) != 0)
+        {
+          /* try to compute the next visible item */
+          valid_iter =
+            gtk_tree_model_iter_next (GTK_TREE_MODEL (standard_view->model), &iter);
+        }
+      else
+        {
+          /* we have reached the end, terminate the loop */
+          valid_iter = FALSE;
+        }
+
+      /* release the tree path */
+      gtk_tree_path_free (path);
+    }
+
+  return files;
+}
+
+
+
 static gboolean
 lunar_standard_view_request_thumbnails_real (LunarStandardView *standard_view,
                                               gboolean            lazy_request)
 {
   GtkTreePath *start_path;
   GtkTreePath *end_path;
-  GtkTreePath *path;
   GtkTreeIter  iter;
   LunarFile  *file;
   gboolean     valid_iter;
-  GList       *visible_files = NULL;
+  GList       *visible_files;
+  GList       *prefetch_files = NULL;
+  guint        n_visible;
+  guint        n;
 
   _lunar_return_val_if_fail (LUNAR_IS_STANDARD_VIEW (standard_view), FALSE);
   _lunar_return_val_if_fail (LUNAR_IS_ICON_FACTORY (standard_view->icon_factory), FALSE);
@@ -3522,38 +3617,41 @@ lunar_standard_view_request_thumbnails_real (LunarStandardView *standard_view,
                                                                             &start_path,
                                                                             &end_path))
     {
-      /* iterate over the range to collect all files */
-      valid_iter = gtk_tree_model_get_iter (GTK_TREE_MODEL (standard_view->model),
-                                            &iter, start_path);
+      /* collect all files in the range */
+      visible_files = lunar_standard_view_get_range_files (standard_view, start_path, end_path);
+      n_visible = g_list_length (visible_files);
+
+      /* queue a thumbnail request */
+      lunar_thumbnailer_queue_files (standard_view->priv->thumbnailer,
+                                      lazy_request, visible_files,
+                                      &standard_view->priv->thumbnail_request);
+
+      /* prefetch about a screen of files in the scroll direction, those are
+       * generated after the visible files and dequeued once the view scrolls */
+      if (standard_view->priv->thumbnail_scroll_backward)
+        valid_iter = gtk_tree_model_get_iter (GTK_TREE_MODEL (standard_view->model), &iter, start_path)
+                     && gtk_tree_model_iter_previous (GTK_TREE_MODEL (standard_view->model), &iter);
+      else
+        valid_iter = gtk_tree_model_get_iter (GTK_TREE_MODEL (standard_view->model), &iter, end_path)
+                     && gtk_tree_model_iter_next (GTK_TREE_MODEL (standard_view->model), &iter);
 
-      while (valid_iter)
+      for (n = MIN (n_visible, THUMBNAIL_PREFETCH_MAX); valid_iter && n > 0; --n)
         {
-          /* prepend the file to the visible items list */
           file = lunar_list_model_get_file (standard_view->model, &iter);
-          visible_files = g_list_prepend (visible_files, file);
+          prefetch_files = g_list_prepend (prefetch_files, file);
 
-          /* check if we've reached the end of the visible range */
-          path = gtk_tree_model_get_path (GTK_TREE_MODEL (standard_view->model), &iter);
-          if (gtk_tree_path_compare (path, end_path) != 0)
-            {
-              /* try to compute the next visible item */
-              valid_iter =
-                gtk_tree_model_iter_next (GTK_TREE_MODEL (standard_view->model), &iter);
-            }
+          if (standard_view->priv->thumbnail_scroll_backward)
+            valid_iter = gtk_tree_model_iter_previous (GTK_TREE_MODEL (standard_view->model), &iter);
           else
-            {
-              /* we have reached the end, terminate the loop */
-              valid_iter = FALSE;
-            }
-
-          /* release the tree path */
-          gtk_tree_path_free (path);
+            valid_iter = gtk_tree_model_iter_next (GTK_TREE_MODEL (standard_view->model), &iter);
         }
 
-      /* queue a thumbnail request */
-      lunar_thumbnailer_queue_files (standard_view->priv->thumbnailer,
-                                      lazy_request, visible_files,
-                                      &standard_view->priv->thumbnail_request);
+      if (prefetch_files != NULL)
+        {
+          lunar_thumbnailer_prefetch_files (standard_view->priv->thumbnailer, prefetch_files,
+                                             &standard_view->priv->thumbnail_prefetch_request);
+          g_list_free_full (prefetch_files, g_object_unref);
+        }
 
       /* release the file list */
       g_list_free_full (visible_files, g_object_unref);
@@ -3614,13 +3712,91 @@ lunar_standard_view_thumbnail_mode_toggled (LunarStandardView *standard_view,
 
 
 
+static void
+lunar_standard_view_cancel_file_icons (LunarStandardView *standard_view,
+                                        GHashTable         *visible_files)
+{
+  GHashTableIter iter;
+  gpointer       file;
+
+  if (G_UNLIKELY (standard_view->icon_factory == NULL))
+    return;
+
+  /* cancel the icon decodes of the files no longer in the visible range */
+  g_hash_table_iter_init (&iter, standard_view->priv->visible_files);
+  while (g_hash_table_iter_next (&iter, &file, NULL))
+    if (visible_files == NULL || !g_hash_table_contains (visible_files, file))
+      lunar_icon_factory_cancel_file_icon (standard_view->icon_factory, file);
+}
+
+
+
+static void
+lunar_standard_view_update_visible_range (LunarStandardView *standard_view)
+{
+  LunarFolder *folder;
+  GtkTreePath *start_path;
+  GtkTreePath *end_path;
+  GHashTable  *visible_files;
+  GList       *files = NULL;
+  GList       *lp;
+
+  _lunar_return_if_fail (LUNAR_IS_STANDARD_VIEW (standard_view));
+
+  /* compute visible item range */
+  if ((*LUNAR_STANDARD_VIEW_GET_CLASS (standard_view)->get_visible_range) (standard_view,
+                                                                            &start_path,
+                                                                            &end_path))
+    {
+      files = lunar_standard_view_get_range_files (standard_view, start_path, end_path);
+
+      gtk_tree_path_free (start_path);
+      gtk_tree_path_free (end_path);
+    }
+
+  /* sniff the content types of the visible rows before the others */
+  folder = lunar_list_model_get_folder (standard_view->model);
+  if (G_LIKELY (folder != NULL && files != NULL))
+    lunar_folder_load_content_types (folder, files);
+
+  /* the set takes over the references of the list */
+  visible_files = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
+  for (lp = files; lp != NULL; lp = lp->next)
+    g_hash_table_add (visible_files, lp->data);
+  g_list_free (files);
+
+  /* rows scrolled out of view don't wait for their previews */
+  lunar_standard_view_cancel_file_icons (standard_view, visible_files);
+  g_hash_table_destroy (standard_view->priv->visible_files);
+  standard_view->priv->visible_files = visible_files;
+}
+
+
+
 static void
 lunar_standard_view_scrolled (GtkAdjustment      *adjustment,
                                LunarStandardView *standard_view)
 {
+  gdouble *last_value;
+  gdouble  value;
+
   _lunar_return_if_fail (GTK_IS_ADJUSTMENT (adjustment));
   _lunar_return_if_fail (LUNAR_IS_STANDARD_VIEW (standard_view));
 
+  /* remember in which direction the user is scrolling */
+  if (adjustment == gtk_scrolled_window_get_hadjustment (GTK_SCROLLED_WINDOW (standard_view)))
+    last_value = &standard_view->priv->thumbnail_hscroll;
+  else
+    last_value = &standard_view->priv->thumbnail_vscroll;
+
+  value = gtk_adjustment_get_value (adjustment);
+  if (value != *last_value)
+    standard_view->priv->thumbnail_scroll_backward = (value < *last_value);
+  *last_value = value;
+
+  /* rows scrolled into view come first, those scrolled out are dropped */
+  lunar_standard_view_update_visible_range (standard_view);
+
   /* ignore adjustment changes when the view is still loading */
   if (lunar_view_get_loading (LUNAR_VIEW (standard_view)))
     return;
@@ -3637,6 +3813,9 @@ lunar_standard_view_size_allocate (LunarStandardView *standard_view,
 {
   _lunar_return_if_fail (LUNAR_IS_STANDARD_VIEW (standard_view));
 
+  /* rows shown by the new size come first, those hidden are dropped */
+  lunar_standard_view_update_visible_range (standard_view);
+
   /* ignore size changes when the view is still loading */
   if (lunar_view_get_loading (LUNAR_VIEW (standard_view)))
     return;
@@ -3825,6 +4004,9 @@ lunar_standard_view_selection_changed (LunarStandardView *standard_view)
   /* and setup the new selected files list */
   standard_view->priv->selected_files = selected_files;
 
+  /* let the model update the totals of the selection */
+  lunar_list_model_set_selected_files (standard_view->model, selected_files);
+
   /* update the statusbar text */
   lunar_standard_view_update_statusbar_text (standard_view);
 
@@ -614,29 +614,52 @@ void
 lunar_thumbnail_cache_delete_file (LunarThumbnailCache *cache,
                                     GFile                *file)
 {
+  GList files = { file, NULL, NULL };
+
   _lunar_return_if_fail (LUNAR_IS_THUMBNAIL_CACHE (cache));
   _lunar_return_if_fail (G_IS_FILE (file));
 
+  lunar_thumbnail_cache_delete_files (cache, &files);
+}
+
+
+
+/**
+ * lunar_thumbnail_cache_delete_files:
+ * @cache : a #LunarThumbnailCache.
+ * @files : a #GList of #GFile<!---->s.
+ *
+ * Queues the thumbnails of all @files for removal, taking the cache
+ * lock only once. The queue is sent to the cache service in a single
+ * call at most 500ms after the first file was queued, so a long running
+ * delete job keeps flushing it instead of growing it until it finishes.
+ **/
+void
+lunar_thumbnail_cache_delete_files (LunarThumbnailCache *cache,
+                                     GList                *files)
+{
+  GList *lp;
+
+  _lunar_return_if_fail (LUNAR_IS_THUMBNAIL_CACHE (cache));
+
+  if (G_UNLIKELY (files == NULL))
+    return;
+
   /* acquire a cache lock */
   _thumbnail_cache_lock (cache);
 
   /* check if we have a valid proxy for the cache service */
   if (cache->proxy_state != LUNAR_THUMBNAIL_CACHE_PROXY_FAILED)
     {
-      /* add the file to the delete queue */
-      cache->delete_queue = g_list_prepend (cache->delete_queue, g_object_ref (file));
+      /* add the files to the delete queue */
+      for (lp = files; lp != NULL; lp = lp->next)
+        cache->delete_queue = g_list_prepend (cache->delete_queue, g_object_ref (lp->data));
     }
 
-  if (cache->proxy_state == LUNAR_THUMBNAIL_CACHE_PROXY_AVAILABLE)
+  /* process the delete queue in a 500ms timeout, unless already scheduled */
+  if (cache->proxy_state == LUNAR_THUMBNAIL_CACHE_PROXY_AVAILABLE
+      && cache->delete_queue_idle_id == 0)
     {
-      /* cancel any pending timeout to process the delete queue */
-      if (cache->delete_queue_idle_id > 0)
-        {
-          g_source_remove (cache->delete_queue_idle_id);
-          cache->delete_queue_idle_id = 0;
-        }
-
-      /* process the delete queue in a 250ms timeout */
       cache->delete_queue_idle_id =
         g_timeout_add (500, lunar_thumbnail_cache_process_delete_queue, cache);
     }
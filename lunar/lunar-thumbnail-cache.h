@@ -48,6 +48,8 @@ void                  lunar_thumbnail_cache_copy_file    (LunarThumbnailCache *c
                                                            GFile                *target_file);
 void                  lunar_thumbnail_cache_delete_file  (LunarThumbnailCache *cache,
                                                            GFile                *file);
+void                  lunar_thumbnail_cache_delete_files (LunarThumbnailCache *cache,
+                                                           GList                *files);
 void                  lunar_thumbnail_cache_cleanup_file (LunarThumbnailCache *cache,
                                                            GFile                *file);
 
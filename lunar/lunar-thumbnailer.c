@@ -63,13 +63,26 @@
  * the Ready idle function sets the thumb state of the corresponding
  * LunarFile objects to _READY and the Error signal sets the state to _NONE.
  *
+ * Every job remembers the LunarFile of each URI it sent out, so the URIs of
+ * a signal are resolved in one go when it arrives, without creating GFiles
+ * or going through the global file cache.
+ *
  *
  * Finished
  * ========
  *
  * The Finished signal handler looks up the internal request ID based on
  * the D-Bus thumbnailer handle. It then drops all corresponding information
- * from handle_request_mapping and request_handle_mapping.
+ * from the jobs and handles tables.
+ *
+ *
+ * Priorities
+ * ==========
+ *
+ * Requests for the files on screen are sent to the "foreground" scheduler
+ * of tumbler, requests to prefetch the files next to them to the
+ * "background" scheduler, so the latter never delay the former. Views
+ * dequeue both as soon as the visible range changes.
  */
 
 
@@ -160,8 +173,11 @@ struct _LunarThumbnailer
   LunarThumbnailerDBus      *thumbnailer_proxy;
   LunarThumbnailerProxyState proxy_state;
 
-  /* running jobs */
-  GSList     *jobs;
+  /* running jobs, request ID -> LunarThumbnailerJob */
+  GHashTable *jobs;
+
+  /* jobs that were accepted by tumbler, handle -> LunarThumbnailerJob */
+  GHashTable *handles;
 
   GMutex      lock;
 
@@ -176,6 +192,11 @@ struct _LunarThumbnailer
 
   /* IDs of idle functions */
   GSList     *idles;
+
+  /* statistics of the requests sent to tumbler */
+  guint       n_issued;
+  guint       n_cancelled;
+  guint       n_completed;
 };
 
 struct _LunarThumbnailerJob
@@ -187,10 +208,16 @@ struct _LunarThumbnailerJob
 
   guint              lazy_checks : 1;
 
+  /* the tumbler scheduler to queue the files on */
+  const gchar       *scheduler;
+
   /* data is saved here in case the queueing is delayed */
   /* If this is NULL, the request has been sent off. */
   GList             *files; /* element type: LunarFile */
 
+  /* URI -> LunarFile of the files sent off that are not done yet */
+  GHashTable        *uris;
+
   /* request number returned by LunarThumbnailer */
   guint              request;
 
@@ -203,6 +230,11 @@ struct _LunarThumbnailerIdle
   LunarThumbnailerIdleType  type;
   LunarThumbnailer          *thumbnailer;
   guint                       id;
+
+  /* the files resolved from the URIs of the signal */
+  GPtrArray                  *files;
+
+  /* URIs that were not sent by the job, if any */
   gchar                     **uris;
 };
 
@@ -300,14 +332,26 @@ lunar_thumbnailer_set_property (GObject      *object,
     }
 }
 
+
+
+/* NOTE: assumes that the lock is held by the caller */
 static void
 lunar_thumbnailer_free_job (LunarThumbnailerJob *job)
 {
   if (job->files)
     g_list_free_full (job->files, g_object_unref);
 
-  if (job->thumbnailer && job->thumbnailer->thumbnailer_proxy && job->handle)
-    lunar_thumbnailer_dbus_call_dequeue (job->thumbnailer->thumbnailer_proxy, job->handle, NULL, NULL, NULL);
+  if (job->uris)
+    g_hash_table_destroy (job->uris);
+
+  if (job->thumbnailer && job->handle)
+    {
+      if (job->thumbnailer->handles != NULL)
+        g_hash_table_remove (job->thumbnailer->handles, GUINT_TO_POINTER (job->handle));
+
+      if (job->thumbnailer->thumbnailer_proxy)
+        lunar_thumbnailer_dbus_call_dequeue (job->thumbnailer->thumbnailer_proxy, job->handle, NULL, NULL, NULL);
+    }
 
   g_slice_free (LunarThumbnailerJob, job);
 }
@@ -341,8 +385,7 @@ lunar_thumbnailer_queue_async_reply (GObject      *proxy,
       lunar_thumbnailer_dbus_call_dequeue (LUNAR_THUMBNAILER_DBUS (proxy), handle, NULL, NULL, NULL);
 
       /* cleanup */
-      thumbnailer->jobs = g_slist_remove (thumbnailer->jobs, job);
-      lunar_thumbnailer_free_job (job);
+      g_hash_table_remove (thumbnailer->jobs, GUINT_TO_POINTER (job->request));
     }
   else if (error == NULL)
     {
@@ -354,6 +397,7 @@ lunar_thumbnailer_queue_async_reply (GObject      *proxy,
         {
           /* store the handle returned by tumbler */
           job->handle = handle;
+          g_hash_table_insert (thumbnailer->handles, GUINT_TO_POINTER (handle), job);
         }
     }
   else
@@ -377,14 +421,14 @@ lunar_thumbnailer_begin_job (LunarThumbnailer *thumbnailer,
 {
   gboolean               success = FALSE;
   const gchar          **mime_hints;
-  gchar                **uris;
+  const gchar          **uris;
+  gchar                 *uri;
   GList                 *lp;
   GList                 *supported_files = NULL;
   guint                  n;
   guint                  n_items = 0;
   LunarFileThumbState   thumb_state;
   const gchar           *thumbnail_path;
-  gint                   request_no;
 
   if (thumbnailer->proxy_state == LUNAR_THUMBNAILER_PROXY_WAITING)
     {
@@ -446,51 +490,55 @@ lunar_thumbnailer_begin_job (LunarThumbnailer *thumbnailer,
   if (n_items > 0)
     {
       /* allocate arrays for URIs and mime hints */
-      uris = g_new0 (gchar *, n_items + 1);
+      uris = g_new0 (const gchar *, n_items + 1);
       mime_hints = g_new0 (const gchar *, n_items + 1);
 
+      /* the URIs are owned by the table, which maps them back to the files */
+      job->uris = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+
       /* fill URI and MIME hint arrays with items from the wait queue */
-      for (lp = supported_files, n = 0; lp != NULL; lp = lp->next, ++n)
+      for (lp = supported_files, n = 0; lp != NULL; lp = lp->next)
         {
+          /* skip files passed more than once */
+          uri = lunar_file_dup_uri (lp->data);
+          if (G_UNLIKELY (g_hash_table_contains (job->uris, uri)))
+            {
+              g_free (uri);
+              continue;
+            }
+
+          g_hash_table_insert (job->uris, uri, g_object_ref (lp->data));
+
           /* set the thumbnail state to loading */
           lunar_file_set_thumb_state (lp->data, LUNAR_FILE_THUMB_STATE_LOADING);
 
           /* save URI and MIME hint in the arrays */
-          uris[n] = lunar_file_dup_uri (lp->data);
+          uris[n] = uri;
           mime_hints[n] = lunar_file_get_content_type (lp->data);
+          ++n;
         }
 
       /* NULL-terminate both arrays */
       uris[n] = NULL;
       mime_hints[n] = NULL;
 
-      /* queue a thumbnail request for the URIs from the wait queue */
-      /* compute the next request ID, making sure it's never 0 */
-      request_no = thumbnailer->last_request + 1;
-      request_no = MAX (request_no, 1);
-
-      /* remember the ID for the next request */
-      thumbnailer->last_request = request_no;
-
-      /* save the request number */
-      job->request = request_no;
-
       /* increase the reference count while the dbus call is running */
       g_object_ref (thumbnailer);
+      thumbnailer->n_issued++;
 
       /* queue the request - asynchronously, of course */
       lunar_thumbnailer_dbus_call_queue (thumbnailer->thumbnailer_proxy,
                                           (const gchar *const *)uris,
                                           (const gchar *const *)mime_hints,
                                           lunar_thumbnail_size_get_nick (thumbnailer->thumbnail_size),
-                                          "foreground", 0,
+                                          job->scheduler, 0,
                                           NULL,
                                           lunar_thumbnailer_queue_async_reply,
                                           job);
 
-      /* free mime hints array */
+      /* free mime hints and URIs arrays */
       g_free (mime_hints);
-      g_strfreev (uris);
+      g_free (uris);
 
       /* free the list of supported files */
       g_list_free (supported_files);
@@ -513,6 +561,10 @@ lunar_thumbnailer_init (LunarThumbnailer *thumbnailer)
 {
   g_mutex_init (&thumbnailer->lock);
 
+  thumbnailer->jobs = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                             (GDestroyNotify) lunar_thumbnailer_free_job);
+  thumbnailer->handles = g_hash_table_new (g_direct_hash, g_direct_equal);
+
   /* initialize the proxies */
   lunar_thumbnailer_init_thumbnailer_proxy (thumbnailer);
 }
@@ -546,7 +598,9 @@ lunar_thumbnailer_finalize (GObject *object)
   g_slist_free (thumbnailer->idles);
 
   /* remove all jobs */
-  g_slist_free_full (thumbnailer->jobs, (GDestroyNotify)lunar_thumbnailer_free_job);
+  g_hash_table_destroy (thumbnailer->jobs);
+  g_hash_table_destroy (thumbnailer->handles);
+  thumbnailer->handles = NULL;
 
   /* release the thumbnailer proxy */
   if (thumbnailer->thumbnailer_proxy != NULL)
@@ -611,7 +665,8 @@ lunar_thumbnailer_received_supported_types (LunarThumbnailerDBus  *proxy,
   gchar     **schemes = NULL;
   gchar     **types = NULL;
   GPtrArray  *schemes_array;
-  GSList     *lp = NULL;
+  GHashTableIter iter;
+  gpointer    job;
   GError     *error = NULL;
 
   _lunar_return_if_fail (LUNAR_IS_THUMBNAILER (thumbnailer));
@@ -622,8 +677,7 @@ lunar_thumbnailer_received_supported_types (LunarThumbnailerDBus  *proxy,
 
   if (!lunar_thumbnailer_dbus_call_get_supported_finish (proxy, &schemes, &types, result, &error))
     {
-      g_slist_free_full (thumbnailer->jobs, (GDestroyNotify)lunar_thumbnailer_free_job);
-      thumbnailer->jobs = NULL;
+      g_hash_table_remove_all (thumbnailer->jobs);
 
       g_printerr ("LunarThumbnailer: Failed to retrieve supported types: %s\n", error->message);
       g_clear_error (&error);
@@ -672,15 +726,10 @@ lunar_thumbnailer_received_supported_types (LunarThumbnailerDBus  *proxy,
   thumbnailer->thumbnailer_proxy = proxy;
 
   /* now start delayed jobs */
-  for (lp = thumbnailer->jobs; lp; lp = lp->next)
-    {
-      if (!lunar_thumbnailer_begin_job (thumbnailer, lp->data))
-        {
-          lunar_thumbnailer_free_job (lp->data);
-          lp->data = NULL;
-        }
-    }
-  thumbnailer->jobs = g_slist_remove_all (thumbnailer->jobs, NULL);
+  g_hash_table_iter_init (&iter, thumbnailer->jobs);
+  while (g_hash_table_iter_next (&iter, NULL, &job))
+    if (!lunar_thumbnailer_begin_job (thumbnailer, job))
+      g_hash_table_iter_remove (&iter);
 
   g_clear_error (&error);
 
@@ -710,8 +759,7 @@ lunar_thumbnailer_proxy_created (GObject       *object,
       g_printerr ("LunarThumbnailer: failed to create proxy: %s", error->message);
       g_clear_error (&error);
 
-      g_slist_free_full (thumbnailer->jobs, (GDestroyNotify)lunar_thumbnailer_free_job);
-      thumbnailer->jobs = NULL;
+      g_hash_table_remove_all (thumbnailer->jobs);
 
       _thumbnailer_unlock (thumbnailer);
 
@@ -855,7 +903,6 @@ lunar_thumbnailer_thumbnailer_finished (GDBusProxy        *proxy,
                                          LunarThumbnailer *thumbnailer)
 {
   LunarThumbnailerJob *job;
-  GSList               *lp;
 
   _lunar_return_if_fail (G_IS_DBUS_PROXY (proxy));
   _lunar_return_if_fail (LUNAR_IS_THUMBNAILER (thumbnailer));
@@ -868,24 +915,19 @@ lunar_thumbnailer_thumbnailer_finished (GDBusProxy        *proxy,
 
   _thumbnailer_lock (thumbnailer);
 
-  for (lp = thumbnailer->jobs; lp != NULL; lp = lp->next)
+  job = g_hash_table_lookup (thumbnailer->handles, GUINT_TO_POINTER (handle));
+  if (job != NULL)
     {
-      job = lp->data;
+      /* this job is finished, forget about the handle */
+      g_hash_table_remove (thumbnailer->handles, GUINT_TO_POINTER (handle));
+      job->handle = 0;
+      thumbnailer->n_completed++;
 
-      if (job->handle == handle)
-        {
-          /* this job is finished, forget about the handle */
-          job->handle = 0;
-
-          /* tell everybody we're done here */
-          g_signal_emit (G_OBJECT (thumbnailer), thumbnailer_signals[REQUEST_FINISHED], 0, job->request);
+      /* tell everybody we're done here */
+      g_signal_emit (G_OBJECT (thumbnailer), thumbnailer_signals[REQUEST_FINISHED], 0, job->request);
 
-          /* remove job from the list */
-          thumbnailer->jobs = g_slist_delete_link (thumbnailer->jobs, lp);
-
-          lunar_thumbnailer_free_job (job);
-          break;
-        }
+      /* remove job from the table */
+      g_hash_table_remove (thumbnailer->jobs, GUINT_TO_POINTER (job->request));
     }
 
   _thumbnailer_unlock (thumbnailer);
@@ -899,9 +941,11 @@ lunar_thumbnailer_idle (LunarThumbnailer          *thumbnailer,
                          LunarThumbnailerIdleType   type,
                          const gchar               **uris)
 {
-  GSList                *lp;
   LunarThumbnailerIdle *idle;
   LunarThumbnailerJob  *job;
+  GPtrArray             *unresolved = NULL;
+  LunarFile            *file;
+  guint                  n;
 
   /* leave if there are no uris */
   if (G_UNLIKELY (uris == NULL))
@@ -920,30 +964,46 @@ lunar_thumbnailer_idle (LunarThumbnailer          *thumbnailer,
    * want each window (because they all have a connection to the
    * same proxy) emit the file change, only the window that requested
    * the data */
-  for (lp = thumbnailer->jobs; lp != NULL; lp = lp->next)
+  job = g_hash_table_lookup (thumbnailer->handles, GUINT_TO_POINTER (handle));
+  if (job != NULL)
     {
-      job = lp->data;
-
-      if (job->handle == handle)
+      /* allocate a new idle struct */
+      idle = g_slice_new0 (LunarThumbnailerIdle);
+      idle->type = type;
+      idle->thumbnailer = thumbnailer;
+      idle->files = g_ptr_array_new_with_free_func (g_object_unref);
+
+      /* resolve the URIs to the files of the job, each is only reported once */
+      for (n = 0; uris[n] != NULL; ++n)
         {
-          /* allocate a new idle struct */
-          idle = g_slice_new0 (LunarThumbnailerIdle);
-          idle->type = type;
-          idle->thumbnailer = thumbnailer;
-
-          /* copy the URI array because we need it in the idle function */
-          idle->uris = g_strdupv ((gchar **)uris);
+          file = job->uris != NULL ? g_hash_table_lookup (job->uris, uris[n]) : NULL;
+          if (G_LIKELY (file != NULL))
+            {
+              g_ptr_array_add (idle->files, g_object_ref (file));
+              g_hash_table_remove (job->uris, uris[n]);
+            }
+          else
+            {
+              /* look it up in the file cache in the idle function */
+              if (unresolved == NULL)
+                unresolved = g_ptr_array_new ();
+              g_ptr_array_add (unresolved, g_strdup (uris[n]));
+            }
+        }
 
-          /* remember the idle struct because we might have to remove it in finalize() */
-          thumbnailer->idles = g_slist_prepend (thumbnailer->idles, idle);
+      if (G_UNLIKELY (unresolved != NULL))
+        {
+          g_ptr_array_add (unresolved, NULL);
+          idle->uris = (gchar **) g_ptr_array_free (unresolved, FALSE);
+        }
 
-          /* call the idle function when we have the time */
-          idle->id = g_idle_add_full (G_PRIORITY_LOW,
-                                      lunar_thumbnailer_idle_func, idle,
-                                      lunar_thumbnailer_idle_free);
+      /* remember the idle struct because we might have to remove it in finalize() */
+      thumbnailer->idles = g_slist_prepend (thumbnailer->idles, idle);
 
-          break;
-        }
+      /* call the idle function when we have the time */
+      idle->id = g_idle_add_full (G_PRIORITY_LOW,
+                                  lunar_thumbnailer_idle_func, idle,
+                                  lunar_thumbnailer_idle_free);
     }
 
   _thumbnailer_unlock (thumbnailer);
@@ -962,34 +1022,37 @@ lunar_thumbnailer_idle_func (gpointer user_data)
   _lunar_return_val_if_fail (idle != NULL, FALSE);
   _lunar_return_val_if_fail (LUNAR_IS_THUMBNAILER (idle->thumbnailer), FALSE);
 
-  /* iterate over all failed URIs */
+  /* look up the files of unexpected URIs from the cache */
   for (n = 0; idle->uris != NULL && idle->uris[n] != NULL; ++n)
     {
-      /* look up the corresponding LunarFile from the cache */
       gfile = g_file_new_for_uri (idle->uris[n]);
       file = lunar_file_cache_lookup (gfile);
       g_object_unref (gfile);
 
-      /* check if we have a file for this URI in the cache */
       if (file != NULL)
+        g_ptr_array_add (idle->files, file);
+    }
+
+  /* iterate over all files */
+  for (n = 0; n < idle->files->len; ++n)
+    {
+      file = g_ptr_array_index (idle->files, n);
+
+      if (idle->type == LUNAR_THUMBNAILER_IDLE_ERROR)
         {
-          if (idle->type == LUNAR_THUMBNAILER_IDLE_ERROR)
-            {
-              /* set thumbnail state to none unless the thumbnail has already been created.
-               * This is to prevent race conditions with the other idle functions */
-              if (lunar_file_get_thumb_state (file) != LUNAR_FILE_THUMB_STATE_READY)
-                lunar_file_set_thumb_state (file, LUNAR_FILE_THUMB_STATE_NONE);
-            }
-          else if (idle->type == LUNAR_THUMBNAILER_IDLE_READY)
-            {
-              /* set thumbnail state to ready - we now have a thumbnail */
-              lunar_file_set_thumb_state (file, LUNAR_FILE_THUMB_STATE_READY);
-            }
-          else
-            {
-              _lunar_assert_not_reached ();
-            }
-          g_object_unref (file);
+          /* set thumbnail state to none unless the thumbnail has already been created.
+           * This is to prevent race conditions with the other idle functions */
+          if (lunar_file_get_thumb_state (file) != LUNAR_FILE_THUMB_STATE_READY)
+            lunar_file_set_thumb_state (file, LUNAR_FILE_THUMB_STATE_NONE);
+        }
+      else if (idle->type == LUNAR_THUMBNAILER_IDLE_READY)
+        {
+          /* set thumbnail state to ready - we now have a thumbnail */
+          lunar_file_set_thumb_state (file, LUNAR_FILE_THUMB_STATE_READY);
+        }
+      else
+        {
+          _lunar_assert_not_reached ();
         }
     }
 
@@ -1011,12 +1074,9 @@ lunar_thumbnailer_idle_free (gpointer data)
 
   _lunar_return_if_fail (idle != NULL);
 
-  /* free the URI array if necessary */
-  if (idle->type == LUNAR_THUMBNAILER_IDLE_READY
-      || idle->type == LUNAR_THUMBNAILER_IDLE_ERROR)
-    {
-      g_strfreev (idle->uris);
-    }
+  /* free the files and URI array */
+  g_ptr_array_unref (idle->files);
+  g_strfreev (idle->uris);
 
   /* free the struct */
   g_slice_free (LunarThumbnailerIdle, idle);
@@ -1072,18 +1132,16 @@ lunar_thumbnailer_queue_file (LunarThumbnailer *thumbnailer,
 
 
 
-gboolean
-lunar_thumbnailer_queue_files (LunarThumbnailer *thumbnailer,
-                                gboolean           lazy_checks,
-                                GList             *files,
-                                guint             *request)
+static gboolean
+lunar_thumbnailer_queue_files_on (LunarThumbnailer *thumbnailer,
+                                   const gchar       *scheduler,
+                                   gboolean           lazy_checks,
+                                   GList             *files,
+                                   guint             *request)
 {
   gboolean               success = FALSE;
   LunarThumbnailerJob  *job = NULL;
 
-  _lunar_return_val_if_fail (LUNAR_IS_THUMBNAILER (thumbnailer), FALSE);
-  _lunar_return_val_if_fail (files != NULL, FALSE);
-
   /* acquire the thumbnailer lock */
   _thumbnailer_lock (thumbnailer);
 
@@ -1092,12 +1150,18 @@ lunar_thumbnailer_queue_files (LunarThumbnailer *thumbnailer,
   job->thumbnailer = thumbnailer;
   job->files = g_list_copy_deep (files, (GCopyFunc) (void (*)(void)) g_object_ref, NULL);
   job->lazy_checks = lazy_checks ? 1 : 0;
+  job->scheduler = scheduler;
+
+  /* compute the next request ID, making sure it's never 0, it is
+   * assigned right away so jobs waiting for the proxy can be dequeued */
+  job->request = MAX (thumbnailer->last_request + 1, 1);
+  thumbnailer->last_request = job->request;
 
   success = lunar_thumbnailer_begin_job (thumbnailer, job);
   if (success)
     {
-      thumbnailer->jobs = g_slist_prepend (thumbnailer->jobs, job);
-      if (*request)
+      g_hash_table_insert (thumbnailer->jobs, GUINT_TO_POINTER (job->request), job);
+      if (request != NULL)
         *request = job->request;
     }
   else
@@ -1113,40 +1177,101 @@ lunar_thumbnailer_queue_files (LunarThumbnailer *thumbnailer,
 
 
 
+gboolean
+lunar_thumbnailer_queue_files (LunarThumbnailer *thumbnailer,
+                                gboolean           lazy_checks,
+                                GList             *files,
+                                guint             *request)
+{
+  _lunar_return_val_if_fail (LUNAR_IS_THUMBNAILER (thumbnailer), FALSE);
+  _lunar_return_val_if_fail (files != NULL, FALSE);
+
+  return lunar_thumbnailer_queue_files_on (thumbnailer, "foreground", lazy_checks, files, request);
+}
+
+
+
+/**
+ * lunar_thumbnailer_prefetch_files:
+ * @thumbnailer : a #LunarThumbnailer.
+ * @files       : the #LunarFile<!---->s likely to be shown next.
+ * @request     : return location for the request ID, or %NULL.
+ *
+ * Like lunar_thumbnailer_queue_files() with lazy checks, but the
+ * thumbnails are generated by the background scheduler of the
+ * thumbnail service, after all requests for visible files.
+ *
+ * Return value: %TRUE if a request was queued.
+ **/
+gboolean
+lunar_thumbnailer_prefetch_files (LunarThumbnailer *thumbnailer,
+                                   GList             *files,
+                                   guint             *request)
+{
+  _lunar_return_val_if_fail (LUNAR_IS_THUMBNAILER (thumbnailer), FALSE);
+  _lunar_return_val_if_fail (files != NULL, FALSE);
+
+  return lunar_thumbnailer_queue_files_on (thumbnailer, "background", TRUE, files, request);
+}
+
+
+
 void
 lunar_thumbnailer_dequeue (LunarThumbnailer *thumbnailer,
                             guint              request)
 {
   LunarThumbnailerJob *job;
-  GSList               *lp;
 
   _lunar_return_if_fail (LUNAR_IS_THUMBNAILER (thumbnailer));
 
   /* acquire the thumbnailer lock */
   _thumbnailer_lock (thumbnailer);
 
-  for (lp = thumbnailer->jobs; lp != NULL; lp = lp->next)
+  job = g_hash_table_lookup (thumbnailer->jobs, GUINT_TO_POINTER (request));
+  if (job != NULL && !job->cancelled)
     {
-      job = lp->data;
+      /* this job is cancelled */
+      job->cancelled = TRUE;
+      thumbnailer->n_cancelled++;
+
+      /* remove the job unless the queue call is still running, the
+       * reply handler will dequeue it from tumbler in that case */
+      if (job->handle != 0 || job->files != NULL)
+        g_hash_table_remove (thumbnailer->jobs, GUINT_TO_POINTER (request));
+    }
 
-      /* find the request in the list */
-      if (job->request == request)
-        {
-          /* this job is cancelled */
-          job->cancelled = TRUE;
+  /* release the thumbnailer lock */
+  _thumbnailer_unlock (thumbnailer);
+}
 
-          if (job->handle != 0)
-            {
-              /* remove job */
-              thumbnailer->jobs = g_slist_delete_link (thumbnailer->jobs, lp);
 
-              lunar_thumbnailer_free_job (job);
-            }
 
-          break;
-        }
-    }
+/**
+ * lunar_thumbnailer_get_stats:
+ * @thumbnailer : a #LunarThumbnailer.
+ * @n_issued    : return location for the number of requests sent, or %NULL.
+ * @n_cancelled : return location for the number of requests dequeued, or %NULL.
+ * @n_completed : return location for the number of requests finished, or %NULL.
+ *
+ * Reports how many thumbnail requests @thumbnailer sent to the
+ * thumbnail service, and what became of them.
+ **/
+void
+lunar_thumbnailer_get_stats (LunarThumbnailer *thumbnailer,
+                              guint             *n_issued,
+                              guint             *n_cancelled,
+                              guint             *n_completed)
+{
+  _lunar_return_if_fail (LUNAR_IS_THUMBNAILER (thumbnailer));
+
+  _thumbnailer_lock (thumbnailer);
+
+  if (n_issued != NULL)
+    *n_issued = thumbnailer->n_issued;
+  if (n_cancelled != NULL)
+    *n_cancelled = thumbnailer->n_cancelled;
+  if (n_completed != NULL)
+    *n_completed = thumbnailer->n_completed;
 
-  /* release the thumbnailer lock */
   _thumbnailer_unlock (thumbnailer);
 }
@@ -46,9 +46,17 @@ gboolean           lunar_thumbnailer_queue_files     (LunarThumbnailer        *t
                                                        gboolean                  lazy_checks,
                                                        GList                    *files,
                                                        guint                    *request);
+gboolean           lunar_thumbnailer_prefetch_files  (LunarThumbnailer        *thumbnailer,
+                                                       GList                    *files,
+                                                       guint                    *request);
 void               lunar_thumbnailer_dequeue         (LunarThumbnailer        *thumbnailer,
                                                        guint                     request);
 
+void               lunar_thumbnailer_get_stats       (LunarThumbnailer        *thumbnailer,
+                                                       guint                    *n_issued,
+                                                       guint                    *n_cancelled,
+                                                       guint                    *n_completed);
+
 G_END_DECLS
 
 #endif /* !__LUNAR_THUMBNAILER_H__ */
@@ -23,7 +23,34 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_IOCTL_H
+#include <sys/ioctl.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 
 #include <lunar/lunar-application.h>
 #include <lunar/lunar-gio-extensions.h>
@@ -40,6 +67,24 @@
 /* seconds before we show the transfer rate + remaining time */
 #define MINIMUM_TRANSFER_TIME (10 * G_USEC_PER_SEC) /* 10 seconds */
 
+/* bytes handed to the kernel per copy_file_range()/sendfile() call, small
+ * enough to keep progress updates and cancellation responsive */
+#define KERNEL_COPY_CHUNK_SIZE (8 * 1024 * 1024)
+
+/* whether local files can be copied by the kernel without a userspace buffer */
+#if defined(HAVE_FCNTL_H) && defined(HAVE_UNISTD_H) && defined(HAVE_ERRNO_H) \
+ && (defined(HAVE_COPY_FILE_RANGE) || defined(HAVE_SENDFILE) || defined(FICLONE))
+#define LUNAR_TRANSFER_JOB_KERNEL_COPY
+#endif
+
+/* number of small file copies kept in flight per device class */
+#define PIPELINE_DEPTH_LOCAL     8 /* internal disks on both ends */
+#define PIPELINE_DEPTH_REMOTE    4 /* network shares, fuse and gvfs mounts */
+#define PIPELINE_DEPTH_REMOVABLE 1 /* USB keys and other removable media */
+
+/* files larger than this are bandwidth bound and copied one at a time */
+#define PIPELINE_MAX_FILE_SIZE   (4 * 1024 * 1024)
+
 
 
 /* Property identifiers */
@@ -48,11 +93,14 @@ enum
   PROP_0,
   PROP_FILE_SIZE_BINARY,
   PROP_PARALLEL_COPY_MODE,
+  PROP_COPY_BACKEND,
 };
 
 
 
-typedef struct _LunarTransferNode LunarTransferNode;
+typedef struct _LunarTransferNode  LunarTransferNode;
+typedef struct _LunarTransferBatch LunarTransferBatch;
+typedef struct _LunarTransferCopy  LunarTransferCopy;
 
 
 
@@ -70,6 +118,14 @@ static void     lunar_transfer_job_finalize     (GObject                *object)
 static gboolean lunar_transfer_job_execute      (EndoJob                 *job,
                                                   GError                **error);
 static void     lunar_transfer_node_free        (gpointer                data);
+static void     lunar_transfer_job_copy_worker  (gpointer                data,
+                                                  gpointer                user_data);
+static void     lunar_transfer_job_copy_node    (LunarTransferJob      *job,
+                                                  LunarTransferNode     *node,
+                                                  GFile                  *target_file,
+                                                  GFile                  *target_parent_file,
+                                                  GList                 **target_file_list_return,
+                                                  GError                **error);
 
 
 
@@ -98,10 +154,19 @@ struct _LunarTransferJob
   guint64                 total_progress;
   guint64                 file_progress;
   guint64                 transfer_rate;
+  GMutex                  progress_lock;
+
+  /* whether the job is registered with the device scheduler */
+  gboolean                scheduled;
+
+  /* concurrent copies of small files, NULL if copying sequentially */
+  GThreadPool            *copy_pool;
+  guint                   pipeline_depth;
 
   LunarPreferences      *preferences;
   gboolean                file_size_binary;
   LunarParallelCopyMode  parallel_copy_mode;
+  LunarCopyBackend       copy_backend;
 };
 
 struct _LunarTransferNode
@@ -109,16 +174,47 @@ struct _LunarTransferNode
   LunarTransferNode *next;
   LunarTransferNode *children;
   GFile              *source_file;
+  GFileType           type;
+  guint64             size;
   gboolean            replace_confirmed;
   gboolean            rename_confirmed;
 };
 
+/* the copies submitted by one lunar_transfer_job_copy_node() call */
+struct _LunarTransferBatch
+{
+  GMutex  lock;
+  GCond   cond;
+  GQueue  done;
+  guint   n_pending;
+};
+
+/* a single file copy running in the copy pool */
+struct _LunarTransferCopy
+{
+  LunarTransferJob   *job;
+  LunarTransferBatch *batch;
+  LunarTransferNode  *node;
+  GFile              *target_file;
+  guint64             progress;
+  gboolean            copied;
+  GError             *error;
+};
+
 
 
 G_DEFINE_TYPE (LunarTransferJob, lunar_transfer_job, LUNAR_TYPE_JOB)
 
 
 
+/* the transfer jobs currently doing I/O, see lunar_transfer_job_freeze_optional() */
+static GMutex      scheduler_lock;
+static GCond       scheduler_cond;
+static GList      *scheduler_jobs = NULL;
+static GHashTable *scheduler_devices = NULL; /* device_fs_id -> GList of jobs */
+
+
+
 static void
 lunar_transfer_job_class_init (LunarTransferJobClass *klass)
 {
@@ -160,6 +256,21 @@ lunar_transfer_job_class_init (LunarTransferJobClass *klass)
                                                       LUNAR_TYPE_PARALLEL_COPY_MODE,
                                                       LUNAR_PARALLEL_COPY_MODE_ONLY_LOCAL,
                                                       ENDO_PARAM_READWRITE));
+
+  /**
+   * LunarTransferJob:copy_backend:
+   *
+   * Whether the contents of local files may be copied by the
+   * kernel instead of through GIO.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_COPY_BACKEND,
+                                   g_param_spec_enum ("copy-backend",
+                                                      "CopyBackend",
+                                                      NULL,
+                                                      LUNAR_TYPE_COPY_BACKEND,
+                                                      LUNAR_COPY_BACKEND_AUTO,
+                                                      ENDO_PARAM_READWRITE));
 }
 
 
@@ -172,6 +283,8 @@ lunar_transfer_job_init (LunarTransferJob *job)
                    G_OBJECT (job), "file-size-binary");
   endo_binding_new (G_OBJECT (job->preferences), "misc-parallel-copy-mode",
                    G_OBJECT (job), "parallel-copy-mode");
+  endo_binding_new (G_OBJECT (job->preferences), "misc-copy-backend",
+                   G_OBJECT (job), "copy-backend");
 
   job->type = 0;
   job->source_node_list = NULL;
@@ -187,6 +300,10 @@ lunar_transfer_job_init (LunarTransferJob *job)
   job->last_total_progress = 0;
   job->transfer_rate = 0;
   job->start_time = 0;
+  job->scheduled = FALSE;
+  job->copy_pool = NULL;
+  job->pipeline_depth = 1;
+  g_mutex_init (&job->progress_lock);
 }
 
 
@@ -205,6 +322,8 @@ lunar_transfer_job_finalize (GObject *object)
 
   lunar_g_file_list_free (job->target_file_list);
 
+  g_mutex_clear (&job->progress_lock);
+
   g_object_unref (job->preferences);
 
   (*G_OBJECT_CLASS (lunar_transfer_job_parent_class)->finalize) (object);
@@ -228,6 +347,9 @@ lunar_transfer_job_get_property (GObject     *object,
     case PROP_PARALLEL_COPY_MODE:
       g_value_set_enum (value, job->parallel_copy_mode);
       break;
+    case PROP_COPY_BACKEND:
+      g_value_set_enum (value, job->copy_backend);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -252,6 +374,9 @@ lunar_transfer_job_set_property (GObject      *object,
     case PROP_PARALLEL_COPY_MODE:
       job->parallel_copy_mode = g_value_get_enum (value);
       break;
+    case PROP_COPY_BACKEND:
+      job->copy_backend = g_value_get_enum (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -260,10 +385,19 @@ lunar_transfer_job_set_property (GObject      *object,
 
 
 
+static void lunar_transfer_job_scheduler_wake (void);
+
+
+
 static void
 lunar_transfer_job_check_pause (LunarTransferJob *job)
 {
   _lunar_return_if_fail (LUNAR_IS_TRANSFER_JOB (job));
+
+  /* paused jobs do not block others, let waiting jobs re-check */
+  if (G_UNLIKELY (job->scheduled && lunar_job_is_paused (LUNAR_JOB (job))))
+    lunar_transfer_job_scheduler_wake ();
+
   while (lunar_job_is_paused (LUNAR_JOB (job)) && !endo_job_is_cancelled (ENDO_JOB (job)))
     {
       g_usleep (500 * 1000); /* 500ms pause */
@@ -272,56 +406,106 @@ lunar_transfer_job_check_pause (LunarTransferJob *job)
 
 
 
+static void
+lunar_transfer_job_add_progress (LunarTransferJob *job,
+                                  guint64            n_bytes)
+{
+  guint64 new_percentage;
+  gint64  current_time;
+  gint64  expired_time;
+  guint64 transfer_rate;
+
+  _lunar_return_if_fail (LUNAR_IS_TRANSFER_JOB (job));
+
+  if (G_UNLIKELY (job->total_size == 0))
+    return;
+
+  /* copies in the copy pool report concurrently */
+  g_mutex_lock (&job->progress_lock);
+
+  /* update total progress */
+  job->total_progress += n_bytes;
+
+  /* compute the new percentage after the progress we've made */
+  new_percentage = (job->total_progress * 100.0) / job->total_size;
+
+  /* get current time */
+  current_time = g_get_real_time ();
+  expired_time = current_time - job->last_update_time;
+
+  /* notify callers not more then every 500ms */
+  if (expired_time > (500 * 1000))
+    {
+      /* calculate the transfer rate in the last expired time */
+      transfer_rate = (job->total_progress - job->last_total_progress) / ((gfloat) expired_time / G_USEC_PER_SEC);
+
+      /* take the average of the last 10 rates (5 sec), so the output is less jumpy */
+      if (job->transfer_rate > 0)
+        job->transfer_rate = ((job->transfer_rate * 10) + transfer_rate) / 11;
+      else
+        job->transfer_rate = transfer_rate;
+
+      /* emit the percent signal */
+      endo_job_percent (ENDO_JOB (job), new_percentage);
+
+      /* update internals */
+      job->last_update_time = current_time;
+      job->last_total_progress = job->total_progress;
+    }
+
+  g_mutex_unlock (&job->progress_lock);
+}
+
+
+
+static void
+lunar_transfer_job_remove_progress (LunarTransferJob *job,
+                                     guint64            n_bytes)
+{
+  _lunar_return_if_fail (LUNAR_IS_TRANSFER_JOB (job));
+
+  g_mutex_lock (&job->progress_lock);
+
+  /* forget the bytes of an attempt that is done again, the transfer
+   * rate is computed from the difference, so move its base as well */
+  job->total_progress -= MIN (n_bytes, job->total_progress);
+  job->last_total_progress -= MIN (n_bytes, job->last_total_progress);
+
+  g_mutex_unlock (&job->progress_lock);
+}
+
+
+
 static void
 lunar_transfer_job_progress (goffset  current_num_bytes,
                               goffset  total_num_bytes,
                               gpointer user_data)
 {
   LunarTransferJob *job = user_data;
-  guint64            new_percentage;
-  gint64             current_time;
-  gint64             expired_time;
-  guint64            transfer_rate;
 
   _lunar_return_if_fail (LUNAR_IS_TRANSFER_JOB (job));
 
   lunar_transfer_job_check_pause (job);
 
-  if (G_LIKELY (job->total_size > 0))
-    {
-      /* update total progress */
-      job->total_progress += (current_num_bytes - job->file_progress);
-
-      /* update file progress */
-      job->file_progress = current_num_bytes;
+  lunar_transfer_job_add_progress (job, current_num_bytes - job->file_progress);
 
-      /* compute the new percentage after the progress we've made */
-      new_percentage = (job->total_progress * 100.0) / job->total_size;
+  /* update file progress */
+  job->file_progress = current_num_bytes;
+}
 
-      /* get current time */
-      current_time = g_get_real_time ();
-      expired_time = current_time - job->last_update_time;
 
-      /* notify callers not more then every 500ms */
-      if (expired_time > (500 * 1000))
-        {
-          /* calculate the transfer rate in the last expired time */
-          transfer_rate = (job->total_progress - job->last_total_progress) / ((gfloat) expired_time / G_USEC_PER_SEC);
 
-          /* take the average of the last 10 rates (5 sec), so the output is less jumpy */
-          if (job->transfer_rate > 0)
-            job->transfer_rate = ((job->transfer_rate * 10) + transfer_rate) / 11;
-          else
-            job->transfer_rate = transfer_rate;
+static void
+lunar_transfer_copy_progress (goffset  current_num_bytes,
+                              goffset  total_num_bytes,
+                              gpointer user_data)
+{
+  LunarTransferCopy *copy = user_data;
 
-          /* emit the percent signal */
-          endo_job_percent (ENDO_JOB (job), new_percentage);
+  lunar_transfer_job_check_pause (copy->job);
 
-          /* update internals */
-          job->last_update_time = current_time;
-          job->last_total_progress = job->total_progress;
-        }
-    }
+  lunar_transfer_job_add_progress (copy->job, current_num_bytes - copy->progress);
+  copy->progress = current_num_bytes;
 }
 
 
@@ -331,11 +515,14 @@ lunar_transfer_job_collect_node (LunarTransferJob  *job,
                                   LunarTransferNode *node,
                                   GError            **error)
 {
-  LunarTransferNode *child_node;
-  GFileInfo          *info;
-  GError             *err = NULL;
-  GList              *file_list;
-  GList              *lp;
+  LunarTransferNode  *child_node;
+  LunarTransferNode  *parent_node;
+  LunarTransferNode **nodes;
+  LunarIoScanEntry   *entry;
+  GFileInfo           *info;
+  GError              *err = NULL;
+  GArray              *entries;
+  guint                n;
 
   _lunar_return_val_if_fail (LUNAR_IS_TRANSFER_JOB (job), FALSE);
   _lunar_return_val_if_fail (node != NULL && G_IS_FILE (node->source_file), FALSE);
@@ -354,37 +541,53 @@ lunar_transfer_job_collect_node (LunarTransferJob  *job,
   if (G_UNLIKELY (info == NULL))
     return FALSE;
 
-  job->total_size += g_file_info_get_size (info);
+  node->type = g_file_info_get_file_type (info);
+  node->size = g_file_info_get_size (info);
+  job->total_size += node->size;
 
   /* check if we have a directory here */
-  if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+  if (node->type == G_FILE_TYPE_DIRECTORY)
     {
-      /* scan the directory for immediate children */
-      file_list = lunar_io_scan_directory (LUNAR_JOB (job), node->source_file,
-                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                            FALSE, FALSE, FALSE, &err);
-
-      /* add children to the transfer node */
-      for (lp = file_list; err == NULL && lp != NULL; lp = lp->next)
+      /* scan the whole subtree at once, sizes included */
+      entries = lunar_io_scan_directory_entries (LUNAR_JOB (job), node->source_file,
+                                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                  LUNAR_IO_SCAN_RECURSIVE
+                                                  | LUNAR_IO_SCAN_QUERY_SIZE,
+                                                  &err);
+
+      if (G_LIKELY (entries != NULL))
         {
-          lunar_transfer_job_check_pause (job);
+          /* parents are stored after their children, so walking the
+           * entries backwards always finds the parent node allocated */
+          nodes = g_new (LunarTransferNode *, entries->len);
+          for (n = entries->len; err == NULL && n > 0; --n)
+            {
+              lunar_transfer_job_check_pause (job);
 
-          /* allocate a new transfer node for the child */
-          child_node = g_slice_new0 (LunarTransferNode);
-          child_node->source_file = g_object_ref (lp->data);
-          child_node->replace_confirmed = node->replace_confirmed;
-          child_node->rename_confirmed = FALSE;
+              entry = &g_array_index (entries, LunarIoScanEntry, n - 1);
+              parent_node = (entry->parent < 0) ? node : nodes[entry->parent];
 
-          /* hook the child node into the child list */
-          child_node->next = node->children;
-          node->children = child_node;
+              /* allocate a new transfer node for the child */
+              child_node = g_slice_new0 (LunarTransferNode);
+              child_node->source_file = g_object_ref (entry->file);
+              child_node->type = entry->type;
+              child_node->size = entry->size;
+              child_node->replace_confirmed = parent_node->replace_confirmed;
+              child_node->rename_confirmed = FALSE;
 
-          /* collect the child node */
-          lunar_transfer_job_collect_node (job, child_node, &err);
-        }
+              /* hook the child node into the child list */
+              child_node->next = parent_node->children;
+              parent_node->children = child_node;
+              nodes[n - 1] = child_node;
+
+              job->total_size += entry->size;
 
-      /* release the child files */
-      lunar_g_file_list_free (file_list);
+              endo_job_set_error_if_cancelled (ENDO_JOB (job), &err);
+            }
+
+          g_free (nodes);
+          g_array_free (entries, TRUE);
+        }
     }
 
   /* release file info */
@@ -401,44 +604,273 @@ lunar_transfer_job_collect_node (LunarTransferJob  *job,
 
 
 
+#ifdef LUNAR_TRANSFER_JOB_KERNEL_COPY
 static gboolean
-ttj_copy_file (LunarTransferJob *job,
-               GFile             *source_file,
-               GFile             *target_file,
-               GFileCopyFlags     copy_flags,
-               gboolean           merge_directories,
-               GError           **error)
+ttj_copy_file_kernel_unsupported (gint errsv)
 {
-  GFileType source_type;
-  GFileType target_type;
-  gboolean  target_exists;
-  GError   *err = NULL;
+  return errsv == ENOSYS || errsv == EXDEV || errsv == EINVAL
+      || errsv == EOPNOTSUPP || errsv == EBADF;
+}
+#endif
+
+
+
+/**
+ * ttj_copy_file_kernel:
+ * @job         : a #LunarTransferJob.
+ * @source_file : the source #GFile to copy.
+ * @target_file : the destination #GFile to create.
+ * @source_info       : a #GFileInfo for @source_file.
+ * @copy_flags        : the #GFileCopyFlags for the copy.
+ * @progress_callback : function to report the number of bytes copied to.
+ * @progress_data     : user data for @progress_callback.
+ * @error             : return location for errors or %NULL.
+ *
+ * Tries to copy the regular local file @source_file to @target_file without
+ * moving the data through userspace, first by sharing the blocks (reflink),
+ * then with copy_file_range() and finally with sendfile().
+ *
+ * Return value: %TRUE if the file was copied. %FALSE with @error unset if
+ *               the fast path does not apply and the caller should fall
+ *               back to g_file_copy(), %FALSE with @error set on errors
+ *               or cancellation.
+ **/
+static gboolean
+ttj_copy_file_kernel (LunarTransferJob     *job,
+                      GFile                 *source_file,
+                      GFile                 *target_file,
+                      GFileInfo             *source_info,
+                      GFileCopyFlags         copy_flags,
+                      GFileProgressCallback  progress_callback,
+                      gpointer               progress_data,
+                      GError               **error)
+{
+#ifdef LUNAR_TRANSFER_JOB_KERNEL_COPY
+  GCancellable *cancellable;
+  gboolean      unsupported = FALSE;
+  gboolean      copied = FALSE;
+  goffset       size;
+  goffset       written = 0;
+  ssize_t       n;
+  gchar        *source_path;
+  gchar        *target_path;
+  gint          source_fd;
+  gint          target_fd;
+  gint          errsv = 0;
+
+  _lunar_return_val_if_fail (LUNAR_IS_TRANSFER_JOB (job), FALSE);
+  _lunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /* replacing an existing file is left to GIO, which does it atomically */
+  if (job->copy_backend != LUNAR_COPY_BACKEND_AUTO
+      || (copy_flags & G_FILE_COPY_OVERWRITE) != 0
+      || g_file_info_get_file_type (source_info) != G_FILE_TYPE_REGULAR
+      || !g_file_is_native (source_file)
+      || !g_file_is_native (target_file))
+    return FALSE;
+
+  source_path = g_file_get_path (source_file);
+  target_path = g_file_get_path (target_file);
+  if (G_UNLIKELY (source_path == NULL || target_path == NULL))
+    {
+      g_free (source_path);
+      g_free (target_path);
+      return FALSE;
+    }
+
+  /* any failure to open is reported by the GIO fallback instead */
+  source_fd = g_open (source_path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC, 0);
+  if (G_UNLIKELY (source_fd < 0))
+    {
+      g_free (source_path);
+      g_free (target_path);
+      return FALSE;
+    }
+
+  target_fd = g_open (target_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (G_UNLIKELY (target_fd < 0))
+    {
+      close (source_fd);
+      g_free (source_path);
+      g_free (target_path);
+      return FALSE;
+    }
+
+  cancellable = endo_job_get_cancellable (ENDO_JOB (job));
+  size = g_file_info_get_size (source_info);
+
+#ifdef FICLONE
+  /* share the data blocks on file systems that support it */
+  if (ioctl (target_fd, FICLONE, source_fd) == 0)
+    {
+      written = size;
+      copied = TRUE;
+      (*progress_callback) (written, size, progress_data);
+    }
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+  if (!copied)
+    {
+      for (;;)
+        {
+          if (g_cancellable_is_cancelled (cancellable))
+            break;
+
+          n = copy_file_range (source_fd, NULL, target_fd, NULL, KERNEL_COPY_CHUNK_SIZE, 0);
+          if (n > 0)
+            {
+              written += n;
+              (*progress_callback) (written, MAX (size, written), progress_data);
+            }
+          else if (n == 0)
+            {
+              copied = TRUE;
+              break;
+            }
+          else if (errno != EINTR)
+            {
+              errsv = errno;
+              break;
+            }
+        }
+
+      /* let the next method try if nothing was copied yet */
+      if (errsv != 0 && written == 0 && ttj_copy_file_kernel_unsupported (errsv))
+        errsv = 0;
+    }
+#endif
+
+#ifdef HAVE_SENDFILE
+  if (!copied && errsv == 0 && written == 0 && !g_cancellable_is_cancelled (cancellable))
+    {
+      for (;;)
+        {
+          if (g_cancellable_is_cancelled (cancellable))
+            break;
+
+          n = sendfile (target_fd, source_fd, NULL, KERNEL_COPY_CHUNK_SIZE);
+          if (n > 0)
+            {
+              written += n;
+              (*progress_callback) (written, MAX (size, written), progress_data);
+            }
+          else if (n == 0)
+            {
+              copied = TRUE;
+              break;
+            }
+          else if (errno != EINTR)
+            {
+              errsv = errno;
+              break;
+            }
+        }
+    }
+#endif
+
+  /* nothing worked before any data was written, leave it to GIO */
+  if (!copied && written == 0 && !g_cancellable_is_cancelled (cancellable)
+      && (errsv == 0 || ttj_copy_file_kernel_unsupported (errsv)))
+    unsupported = TRUE;
+
+  close (source_fd);
+  if (close (target_fd) != 0 && copied)
+    {
+      errsv = errno;
+      copied = FALSE;
+    }
+
+  if (copied)
+    {
+      /* copy the same attributes g_file_copy() would have */
+      copied = g_file_copy_attributes (source_file, target_file,
+                                       copy_flags & G_FILE_COPY_NOFOLLOW_SYMLINKS,
+                                       cancellable, error);
+    }
+  else if (!unsupported)
+    {
+      if (!endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
+        {
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                       _("Error writing to file \"%s\": %s"),
+                       target_path, g_strerror (errsv));
+        }
+    }
+
+  /* do not leave partial copies behind */
+  if (!copied)
+    g_unlink (target_path);
+
+  g_free (source_path);
+  g_free (target_path);
+
+  return copied;
+#else
+  return FALSE;
+#endif
+}
+
+
+
+static gboolean
+ttj_copy_file (LunarTransferJob     *job,
+               GFile                 *source_file,
+               GFile                 *target_file,
+               GFileCopyFlags         copy_flags,
+               gboolean               merge_directories,
+               GFileProgressCallback  progress_callback,
+               gpointer               progress_data,
+               GError               **error)
+{
+  GFileInfo *source_info;
+  GFileType  source_type = G_FILE_TYPE_UNKNOWN;
+  GFileType  target_type = G_FILE_TYPE_UNKNOWN;
+  gboolean   target_exists;
+  gboolean   copied = FALSE;
+  GError    *err = NULL;
 
   _lunar_return_val_if_fail (LUNAR_IS_TRANSFER_JOB (job), FALSE);
   _lunar_return_val_if_fail (G_IS_FILE (source_file), FALSE);
   _lunar_return_val_if_fail (G_IS_FILE (target_file), FALSE);
   _lunar_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-  /* reset the file progress */
-  job->file_progress = 0;
-
   if (endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
     return FALSE;
   lunar_transfer_job_check_pause (job);
 
-  source_type = g_file_query_file_type (source_file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                        endo_job_get_cancellable (ENDO_JOB (job)));
+  /* query everything needed about the source in one go */
+  source_info = g_file_query_info (source_file,
+                                   G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                   G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                   G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                   endo_job_get_cancellable (ENDO_JOB (job)),
+                                   NULL);
+  if (G_LIKELY (source_info != NULL))
+    source_type = g_file_info_get_file_type (source_info);
 
   if (endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
-    return FALSE;
+    {
+      if (source_info != NULL)
+        g_object_unref (source_info);
+      return FALSE;
+    }
   lunar_transfer_job_check_pause (job);
 
-  target_type = g_file_query_file_type (target_file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                        endo_job_get_cancellable (ENDO_JOB (job)));
+  /* the target type only matters when replacing a symlink */
+  if ((copy_flags & G_FILE_COPY_OVERWRITE) != 0)
+    {
+      target_type = g_file_query_file_type (target_file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            endo_job_get_cancellable (ENDO_JOB (job)));
 
-  if (endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
-    return FALSE;
-  lunar_transfer_job_check_pause (job);
+      if (endo_job_set_error_if_cancelled (ENDO_JOB (job), error))
+        {
+          if (source_info != NULL)
+            g_object_unref (source_info);
+          return FALSE;
+        }
+      lunar_transfer_job_check_pause (job);
+    }
 
   /* check if the target is a symlink and we are in overwrite mode */
   if (target_type == G_FILE_TYPE_SYMBOLIC_LINK && (copy_flags & G_FILE_COPY_OVERWRITE) != 0)
@@ -446,19 +878,48 @@ ttj_copy_file (LunarTransferJob *job,
       /* try to delete the symlink */
       if (!g_file_delete (target_file, endo_job_get_cancellable (ENDO_JOB (job)), &err))
         {
+          if (source_info != NULL)
+            g_object_unref (source_info);
           g_propagate_error (error, err);
           return FALSE;
         }
     }
 
+  /* let the kernel copy plain local files if possible */
+  if (source_info != NULL)
+    {
+      copied = ttj_copy_file_kernel (job, source_file, target_file, source_info, copy_flags,
+                                     progress_callback, progress_data, &err);
+      g_object_unref (source_info);
+    }
+
+  if (G_UNLIKELY (err != NULL))
+    {
+      g_propagate_error (error, err);
+      return FALSE;
+    }
+  else if (copied)
+    {
+      return TRUE;
+    }
+
   /* try to copy the file */
   g_file_copy (source_file, target_file, copy_flags,
                endo_job_get_cancellable (ENDO_JOB (job)),
-               lunar_transfer_job_progress, job, &err);
+               progress_callback, progress_data, &err);
 
   /* check if there were errors */
   if (G_UNLIKELY (err != NULL && err->domain == G_IO_ERROR))
     {
+      /* only look at the target type when it decides about a merge */
+      if (err->code == G_IO_ERROR_EXISTS
+          && source_type == G_FILE_TYPE_DIRECTORY
+          && target_type == G_FILE_TYPE_UNKNOWN)
+        {
+          target_type = g_file_query_file_type (target_file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                endo_job_get_cancellable (ENDO_JOB (job)));
+        }
+
       if (err->code == G_IO_ERROR_WOULD_MERGE
           || (err->code == G_IO_ERROR_EXISTS
               && source_type == G_FILE_TYPE_DIRECTORY
@@ -581,8 +1042,12 @@ lunar_transfer_job_copy_file (LunarTransferJob *job,
       lunar_transfer_job_check_pause (job);
       if (G_LIKELY (!g_file_equal (source_file, dest_file)))
         {
+          /* reset the file progress */
+          job->file_progress = 0;
+
           /* try to copy the file from source_file to the dest_file */
-          if (ttj_copy_file (job, source_file, dest_file, copy_flags, TRUE, &err))
+          if (ttj_copy_file (job, source_file, dest_file, copy_flags, TRUE,
+                             lunar_transfer_job_progress, job, &err))
             {
               /* return the real target file */
               return g_object_ref (dest_file);
@@ -599,8 +1064,12 @@ lunar_transfer_job_copy_file (LunarTransferJob *job,
 
               if (err == NULL)
                 {
+                  /* reset the file progress */
+                  job->file_progress = 0;
+
                   /* try to copy the file from source file to the duplicate file */
-                  if (ttj_copy_file (job, source_file, duplicate_file, copy_flags, TRUE, &err))
+                  if (ttj_copy_file (job, source_file, duplicate_file, copy_flags, TRUE,
+                                     lunar_transfer_job_progress, job, &err))
                     {
                       /* return the real target file */
                       return duplicate_file;
@@ -617,60 +1086,352 @@ lunar_transfer_job_copy_file (LunarTransferJob *job,
             }
         }
 
-      /* check if we can recover from this error */
-      if (err->domain == G_IO_ERROR && err->code == G_IO_ERROR_EXISTS)
-        {
-          /* reset the error */
-          g_clear_error (&err);
+      /* check if we can recover from this error */
+      if (err->domain == G_IO_ERROR && err->code == G_IO_ERROR_EXISTS)
+        {
+          /* reset the error */
+          g_clear_error (&err);
+
+          /* if necessary, ask the user whether to replace or rename the target file */
+          if (replace_confirmed)
+            response = LUNAR_JOB_RESPONSE_REPLACE;
+          else if (rename_confirmed)
+            response = LUNAR_JOB_RESPONSE_RENAME;
+          else
+            response = lunar_job_ask_replace (LUNAR_JOB (job), source_file,
+                                               dest_file, &err);
+
+          if (err != NULL)
+            break;
+
+          /* add overwrite flag and retry if we should overwrite */
+          if (response == LUNAR_JOB_RESPONSE_REPLACE)
+            {
+              copy_flags |= G_FILE_COPY_OVERWRITE;
+              continue;
+            }
+          else if (response == LUNAR_JOB_RESPONSE_RENAME)
+            {
+              GFile *renamed_file;
+              renamed_file = lunar_io_jobs_util_next_renamed_file (LUNAR_JOB (job),
+                                                                    source_file,
+                                                                    dest_file,
+                                                                    ++n_rename, &err);
+              if (renamed_file != NULL)
+                {
+                  if (err != NULL)
+                    g_object_unref (renamed_file);
+                  else
+                    {
+                      dest_file = renamed_file;
+                      rename_confirmed = TRUE;
+                    }
+                }
+            }
+
+          /* tell the caller we skipped the file if the user
+           * doesn't want to retry/overwrite */
+          if (response == LUNAR_JOB_RESPONSE_SKIP)
+            return g_object_ref (source_file);
+        }
+    }
+
+  _lunar_assert (err != NULL);
+
+  g_propagate_error (error, err);
+  return NULL;
+}
+
+
+
+static void
+lunar_transfer_job_remove_source (LunarTransferJob    *job,
+                                   LunarTransferNode   *node,
+                                   LunarThumbnailCache *thumbnail_cache)
+{
+  LunarJobResponse response;
+  GError           *err = NULL;
+
+  /* only remove the source if we are on copy+remove fallback for move */
+  if (job->type != LUNAR_TRANSFER_JOB_MOVE)
+    return;
+
+retry_remove:
+  lunar_transfer_job_check_pause (job);
+
+  if (g_file_delete (node->source_file,
+                     endo_job_get_cancellable (ENDO_JOB (job)),
+                     &err))
+    {
+      /* notify the thumbnail cache of the delete operation */
+      lunar_thumbnail_cache_delete_file (thumbnail_cache,
+                                          node->source_file);
+    }
+  else
+    {
+      /* ask the user to retry */
+      response = lunar_job_ask_skip (LUNAR_JOB (job), "%s",
+                                      err->message);
+
+      /* reset the error */
+      g_clear_error (&err);
+
+      /* check whether to retry */
+      if (G_UNLIKELY (response == LUNAR_JOB_RESPONSE_RETRY))
+        goto retry_remove;
+    }
+}
+
+
+
+static void
+lunar_transfer_job_copy_single_node (LunarTransferJob    *job,
+                                      LunarTransferNode   *node,
+                                      GFile                *target_file,
+                                      LunarThumbnailCache *thumbnail_cache,
+                                      GList               **target_file_list_return,
+                                      GError              **error)
+{
+  LunarJobResponse response;
+  GFileInfo            *info;
+  GError               *err = NULL;
+  GFile                *real_target_file = NULL;
+
+  /* query file info */
+  info = g_file_query_info (node->source_file,
+                            G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME,
+                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                            endo_job_get_cancellable (ENDO_JOB (job)),
+                            &err);
+
+  /* abort on error or cancellation */
+  if (info == NULL)
+    {
+      g_propagate_error (error, err);
+      return;
+    }
+
+  /* update progress information */
+  endo_job_info_message (ENDO_JOB (job), "%s", g_file_info_get_display_name (info));
+
+retry_copy:
+  lunar_transfer_job_check_pause (job);
+
+  /* copy the item specified by this node (not recursively) */
+  real_target_file = lunar_transfer_job_copy_file (job, node->source_file,
+                                                    target_file,
+                                                    node->replace_confirmed,
+                                                    node->rename_confirmed,
+                                                    &err);
+  if (G_LIKELY (real_target_file != NULL))
+    {
+      /* node->source_file == real_target_file means to skip the file */
+      if (G_LIKELY (node->source_file != real_target_file))
+        {
+          /* notify the thumbnail cache of the copy operation */
+          lunar_thumbnail_cache_copy_file (thumbnail_cache,
+                                            node->source_file,
+                                            real_target_file);
+
+          /* check if we have children to copy */
+          if (node->children != NULL)
+            {
+              /* copy all children of this node */
+              lunar_transfer_job_copy_node (job, node->children, NULL, real_target_file, NULL, &err);
+
+              /* free resources allocted for the children */
+              lunar_transfer_node_free (node->children);
+              node->children = NULL;
+            }
+
+          /* check if the child copy failed */
+          if (G_UNLIKELY (err != NULL))
+            {
+              /* outa here, freeing the target paths */
+              g_object_unref (real_target_file);
+              g_object_unref (info);
+              g_propagate_error (error, err);
+              return;
+            }
+
+          /* add the real target file to the return list */
+          if (G_LIKELY (target_file_list_return != NULL))
+            {
+              *target_file_list_return =
+                lunar_g_file_list_prepend (*target_file_list_return,
+                                            real_target_file);
+            }
+
+          lunar_transfer_job_remove_source (job, node, thumbnail_cache);
+        }
+
+      g_object_unref (real_target_file);
+    }
+  else if (err != NULL)
+    {
+      /* we can only skip if there is space left on the device */
+      if (err->domain != G_IO_ERROR || err->code != G_IO_ERROR_NO_SPACE)
+        {
+          /* ask the user to skip this node and all subnodes */
+          response = lunar_job_ask_skip (LUNAR_JOB (job), "%s", err->message);
+
+          /* reset the error */
+          g_clear_error (&err);
+
+          /* check whether to retry */
+          if (G_UNLIKELY (response == LUNAR_JOB_RESPONSE_RETRY))
+            goto retry_copy;
+        }
+    }
+
+  /* release file info */
+  g_object_unref (info);
+
+  if (G_UNLIKELY (err != NULL))
+    g_propagate_error (error, err);
+}
+
+
+
+static void
+lunar_transfer_job_copy_worker (gpointer data,
+                                 gpointer user_data)
+{
+  LunarTransferCopy  *copy = data;
+  LunarTransferBatch *batch = copy->batch;
+
+  /* only try the plain copy here, conflicts and errors are
+   * resolved later in the job thread where the user can be asked.
+   * An existing target is left to that conflict handling as well */
+  if (!endo_job_is_cancelled (ENDO_JOB (copy->job))
+      && g_file_query_file_type (copy->target_file, G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                 NULL) == G_FILE_TYPE_UNKNOWN)
+    {
+      copy->copied = ttj_copy_file (copy->job, copy->node->source_file, copy->target_file,
+                                    G_FILE_COPY_NOFOLLOW_SYMLINKS, FALSE,
+                                    lunar_transfer_copy_progress, copy, &copy->error);
+
+      /* the target did not exist before, so whatever the failed copy left
+       * behind is removed, instead of asking to replace it on the retry */
+      if (!copy->copied)
+        g_file_delete (copy->target_file, NULL, NULL);
+    }
+
+  g_mutex_lock (&batch->lock);
+  g_queue_push_tail (&batch->done, copy);
+  g_cond_signal (&batch->cond);
+  g_mutex_unlock (&batch->lock);
+}
+
+
+
+static gboolean
+lunar_transfer_job_can_pipeline (LunarTransferJob  *job,
+                                  LunarTransferNode *node,
+                                  GFile              *target_parent_file)
+{
+  return job->copy_pool != NULL
+      && target_parent_file != NULL
+      && node->type == G_FILE_TYPE_REGULAR
+      && node->children == NULL
+      && node->size <= PIPELINE_MAX_FILE_SIZE;
+}
+
+
+
+static void
+lunar_transfer_job_copy_submit (LunarTransferJob   *job,
+                                 LunarTransferBatch *batch,
+                                 LunarTransferNode  *node,
+                                 GFile               *target_file)
+{
+  LunarTransferCopy *copy;
+  gchar              *display_name;
+
+  /* update progress information */
+  display_name = g_file_get_basename (node->source_file);
+  endo_job_info_message (ENDO_JOB (job), "%s", display_name);
+  g_free (display_name);
+
+  copy = g_slice_new0 (LunarTransferCopy);
+  copy->job = job;
+  copy->batch = batch;
+  copy->node = node;
+  copy->target_file = g_object_ref (target_file);
+
+  g_mutex_lock (&batch->lock);
+  batch->n_pending++;
+  g_mutex_unlock (&batch->lock);
+
+  g_thread_pool_push (job->copy_pool, copy, NULL);
+}
+
+
+
+/**
+ * lunar_transfer_job_copy_collect:
+ * @job             : a #LunarTransferJob.
+ * @batch           : the #LunarTransferBatch to collect from.
+ * @wait            : whether to block until a copy finished.
+ * @thumbnail_cache : the #LunarThumbnailCache to notify.
+ * @error           : return location for errors, may already be set.
+ *
+ * Finishes one copy of @batch, in completion order. Successful
+ * copies are handed to the thumbnail cache (and removed from the source
+ * on move), failed copies are retried through the sequential path so
+ * conflicts and errors are asked about one at a time. The bytes the
+ * failed attempt reported are taken back from the progress first. If
+ * @error is already set, the finished copy is only released.
+ *
+ * Return value: %TRUE if a copy was collected.
+ **/
+static gboolean
+lunar_transfer_job_copy_collect (LunarTransferJob    *job,
+                                  LunarTransferBatch  *batch,
+                                  gboolean              wait,
+                                  LunarThumbnailCache *thumbnail_cache,
+                                  GError              **error)
+{
+  LunarTransferCopy *copy;
 
-          /* if necessary, ask the user whether to replace or rename the target file */
-          if (replace_confirmed)
-            response = LUNAR_JOB_RESPONSE_REPLACE;
-          else if (rename_confirmed)
-            response = LUNAR_JOB_RESPONSE_RENAME;
-          else
-            response = lunar_job_ask_replace (LUNAR_JOB (job), source_file,
-                                               dest_file, &err);
+  g_mutex_lock (&batch->lock);
+  while (wait && batch->n_pending > 0 && g_queue_is_empty (&batch->done))
+    g_cond_wait (&batch->cond, &batch->lock);
+  copy = g_queue_pop_head (&batch->done);
+  if (copy != NULL)
+    batch->n_pending--;
+  g_mutex_unlock (&batch->lock);
 
-          if (err != NULL)
-            break;
+  if (copy == NULL)
+    return FALSE;
 
-          /* add overwrite flag and retry if we should overwrite */
-          if (response == LUNAR_JOB_RESPONSE_REPLACE)
-            {
-              copy_flags |= G_FILE_COPY_OVERWRITE;
-              continue;
-            }
-          else if (response == LUNAR_JOB_RESPONSE_RENAME)
-            {
-              GFile *renamed_file;
-              renamed_file = lunar_io_jobs_util_next_renamed_file (LUNAR_JOB (job),
-                                                                    source_file,
-                                                                    dest_file,
-                                                                    ++n_rename, &err);
-              if (renamed_file != NULL)
-                {
-                  if (err != NULL)
-                    g_object_unref (renamed_file);
-                  else
-                    {
-                      dest_file = renamed_file;
-                      rename_confirmed = TRUE;
-                    }
-                }
-            }
+  if (*error == NULL)
+    {
+      if (copy->copied)
+        {
+          /* notify the thumbnail cache of the copy operation */
+          lunar_thumbnail_cache_copy_file (thumbnail_cache,
+                                            copy->node->source_file,
+                                            copy->target_file);
 
-          /* tell the caller we skipped the file if the user
-           * doesn't want to retry/overwrite */
-          if (response == LUNAR_JOB_RESPONSE_SKIP)
-            return g_object_ref (source_file);
+          lunar_transfer_job_remove_source (job, copy->node, thumbnail_cache);
+        }
+      else
+        {
+          /* the retry reports the whole file again */
+          lunar_transfer_job_remove_progress (job, copy->progress);
+
+          /* let the sequential path handle conflicts, errors and cancellation */
+          lunar_transfer_job_copy_single_node (job, copy->node, copy->target_file,
+                                                thumbnail_cache, NULL, error);
         }
     }
 
-  _lunar_assert (err != NULL);
+  g_clear_error (&copy->error);
+  g_object_unref (copy->target_file);
+  g_slice_free (LunarTransferCopy, copy);
 
-  g_propagate_error (error, err);
-  return NULL;
+  return TRUE;
 }
 
 
@@ -684,11 +1445,9 @@ lunar_transfer_job_copy_node (LunarTransferJob  *job,
                                GError            **error)
 {
   LunarThumbnailCache *thumbnail_cache;
+  LunarTransferBatch   batch;
   LunarApplication    *application;
-  LunarJobResponse     response;
-  GFileInfo            *info;
   GError               *err = NULL;
-  GFile                *real_target_file = NULL;
   gchar                *base_name;
 
   _lunar_return_if_fail (LUNAR_IS_TRANSFER_JOB (job));
@@ -707,6 +1466,11 @@ lunar_transfer_job_copy_node (LunarTransferJob  *job,
   thumbnail_cache = lunar_application_get_thumbnail_cache (application);
   g_object_unref (application);
 
+  g_mutex_init (&batch.lock);
+  g_cond_init (&batch.cond);
+  g_queue_init (&batch.done);
+  batch.n_pending = 0;
+
   for (; err == NULL && node != NULL; node = node->next)
     {
       /* guess the target file for this node (unless already provided) */
@@ -719,127 +1483,38 @@ lunar_transfer_job_copy_node (LunarTransferJob  *job,
       else
         target_file = g_object_ref (target_file);
 
-      /* query file info */
-      info = g_file_query_info (node->source_file,
-                                G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME,
-                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                endo_job_get_cancellable (ENDO_JOB (job)),
-                                &err);
-
-      /* abort on error or cancellation */
-      if (info == NULL)
-        {
-          g_object_unref (target_file);
-          break;
-        }
-
-      /* update progress information */
-      endo_job_info_message (ENDO_JOB (job), "%s", g_file_info_get_display_name (info));
-
-retry_copy:
-      lunar_transfer_job_check_pause (job);
-
-      /* copy the item specified by this node (not recursively) */
-      real_target_file = lunar_transfer_job_copy_file (job, node->source_file,
-                                                        target_file,
-                                                        node->replace_confirmed,
-                                                        node->rename_confirmed,
-                                                        &err);
-      if (G_LIKELY (real_target_file != NULL))
+      if (lunar_transfer_job_can_pipeline (job, node, target_parent_file))
         {
-          /* node->source_file == real_target_file means to skip the file */
-          if (G_LIKELY (node->source_file != real_target_file))
-            {
-              /* notify the thumbnail cache of the copy operation */
-              lunar_thumbnail_cache_copy_file (thumbnail_cache,
-                                                node->source_file,
-                                                real_target_file);
-
-              /* check if we have children to copy */
-              if (node->children != NULL)
-                {
-                  /* copy all children of this node */
-                  lunar_transfer_job_copy_node (job, node->children, NULL, real_target_file, NULL, &err);
-
-                  /* free resources allocted for the children */
-                  lunar_transfer_node_free (node->children);
-                  node->children = NULL;
-                }
-
-              /* check if the child copy failed */
-              if (G_UNLIKELY (err != NULL))
-                {
-                  /* outa here, freeing the target paths */
-                  g_object_unref (real_target_file);
-                  g_object_unref (target_file);
-                  break;
-                }
-
-              /* add the real target file to the return list */
-              if (G_LIKELY (target_file_list_return != NULL))
-                {
-                  *target_file_list_return =
-                    lunar_g_file_list_prepend (*target_file_list_return,
-                                                real_target_file);
-                }
-
-retry_remove:
-              lunar_transfer_job_check_pause (job);
-
-              /* try to remove the source directory if we are on copy+remove fallback for move */
-              if (job->type == LUNAR_TRANSFER_JOB_MOVE)
-                {
-                  if (g_file_delete (node->source_file,
-                                     endo_job_get_cancellable (ENDO_JOB (job)),
-                                     &err))
-                    {
-                      /* notify the thumbnail cache of the delete operation */
-                      lunar_thumbnail_cache_delete_file (thumbnail_cache,
-                                                          node->source_file);
-                    }
-                  else
-                    {
-                      /* ask the user to retry */
-                      response = lunar_job_ask_skip (LUNAR_JOB (job), "%s",
-                                                      err->message);
-
-                      /* reset the error */
-                      g_clear_error (&err);
-
-                      /* check whether to retry */
-                      if (G_UNLIKELY (response == LUNAR_JOB_RESPONSE_RETRY))
-                        goto retry_remove;
-                    }
-                }
-            }
+          /* keep at most pipeline_depth copies in flight */
+          if (batch.n_pending >= job->pipeline_depth)
+            lunar_transfer_job_copy_collect (job, &batch, TRUE, thumbnail_cache, &err);
 
-          g_object_unref (real_target_file);
+          if (err == NULL)
+            lunar_transfer_job_copy_submit (job, &batch, node, target_file);
         }
-      else if (err != NULL)
+      else
         {
-          /* we can only skip if there is space left on the device */
-          if (err->domain != G_IO_ERROR || err->code != G_IO_ERROR_NO_SPACE)
-            {
-              /* ask the user to skip this node and all subnodes */
-              response = lunar_job_ask_skip (LUNAR_JOB (job), "%s", err->message);
-
-              /* reset the error */
-              g_clear_error (&err);
-
-              /* check whether to retry */
-              if (G_UNLIKELY (response == LUNAR_JOB_RESPONSE_RETRY))
-                goto retry_copy;
-            }
+          /* directories are created here, before their children are copied */
+          lunar_transfer_job_copy_single_node (job, node, target_file, thumbnail_cache,
+                                                target_file_list_return, &err);
         }
 
+      /* finish whatever completed in the meantime */
+      while (lunar_transfer_job_copy_collect (job, &batch, FALSE, thumbnail_cache, &err))
+        ;
+
       /* release the guessed target file */
       g_object_unref (target_file);
       target_file = NULL;
-
-      /* release file info */
-      g_object_unref (info);
     }
 
+  /* wait for the remaining copies, the nodes must outlive them */
+  while (lunar_transfer_job_copy_collect (job, &batch, TRUE, thumbnail_cache, &err))
+    ;
+
+  g_mutex_clear (&batch.lock);
+  g_cond_clear (&batch.cond);
+
   /* release the thumbnail cache */
   g_object_unref (thumbnail_cache);
 
@@ -1166,52 +1841,6 @@ lunar_transfer_job_move_file (EndoJob                *job,
 }
 
 
-static GList *
-lunar_transfer_job_filter_running_jobs (GList     *jobs,
-                                         LunarJob *own_job)
-{
-  LunarJob *job;
-  GList     *run_jobs = NULL;
-
-  _lunar_return_val_if_fail (LUNAR_IS_TRANSFER_JOB (own_job), NULL);
-
-  for (GList *ljobs = jobs; ljobs != NULL; ljobs = ljobs->next)
-    {
-      job = ljobs->data;
-      if (job == own_job)
-        continue;
-      if (!endo_job_is_cancelled (ENDO_JOB (job)) && !lunar_job_is_paused (job) && !lunar_job_is_frozen (job))
-        {
-          run_jobs = g_list_append (run_jobs, job);
-        }
-    }
-
-  return run_jobs;
-}
-
-
-
-static gboolean
-lunar_transfer_job_device_id_in_job_list (const char *device_fs_id,
-                                           GList      *jobs)
-{
-  LunarTransferJob *job;
-
-  for (GList *ljobs = jobs; device_fs_id != NULL && ljobs != NULL; ljobs = ljobs->next)
-    {
-      if (LUNAR_IS_TRANSFER_JOB (ljobs->data))
-        {
-          job = LUNAR_TRANSFER_JOB (ljobs->data);
-          if (g_strcmp0 (device_fs_id, job->source_device_fs_id) == 0)
-            return TRUE;
-          if (g_strcmp0 (device_fs_id, job->target_device_fs_id) == 0)
-            return TRUE;
-        }
-    }
-  return FALSE;
-}
-
-
 /**
  * lunar_transfer_job_is_file_on_local_device:
  * @file : the source or target #GFile to test.
@@ -1399,6 +2028,134 @@ lunar_transfer_job_determine_copy_behavior (LunarTransferJob *transfer_job,
 
 
 
+static void
+lunar_transfer_job_scheduler_wake (void)
+{
+  g_mutex_lock (&scheduler_lock);
+  g_cond_broadcast (&scheduler_cond);
+  g_mutex_unlock (&scheduler_lock);
+}
+
+
+
+static void
+lunar_transfer_job_scheduler_wake_cancelled (GCancellable *cancellable,
+                                             gpointer      user_data)
+{
+  lunar_transfer_job_scheduler_wake ();
+}
+
+
+
+static void
+lunar_transfer_job_scheduler_wake_unfrozen (LunarJob *job,
+                                            gpointer   user_data)
+{
+  lunar_transfer_job_scheduler_wake ();
+}
+
+
+
+/* must be called with the scheduler_lock held */
+static gboolean
+lunar_transfer_job_scheduler_is_busy (LunarTransferJob *transfer_job,
+                                       GList             *jobs)
+{
+  LunarJob *job;
+
+  for (; jobs != NULL; jobs = jobs->next)
+    {
+      job = jobs->data;
+      if (job == LUNAR_JOB (transfer_job))
+        continue;
+      if (!endo_job_is_cancelled (ENDO_JOB (job)) && !lunar_job_is_paused (job) && !lunar_job_is_frozen (job))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+
+/* must be called with the scheduler_lock held */
+static gboolean
+lunar_transfer_job_scheduler_is_device_busy (LunarTransferJob *transfer_job,
+                                              const gchar       *device_fs_id)
+{
+  if (device_fs_id == NULL || scheduler_devices == NULL)
+    return FALSE;
+
+  return lunar_transfer_job_scheduler_is_busy (transfer_job, g_hash_table_lookup (scheduler_devices, device_fs_id));
+}
+
+
+
+/* must be called with the scheduler_lock held */
+static void
+lunar_transfer_job_scheduler_add_device (LunarTransferJob *transfer_job,
+                                          const gchar       *device_fs_id)
+{
+  GList *jobs;
+
+  if (device_fs_id == NULL)
+    return;
+
+  if (G_UNLIKELY (scheduler_devices == NULL))
+    scheduler_devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  jobs = g_hash_table_lookup (scheduler_devices, device_fs_id);
+  if (g_list_find (jobs, transfer_job) == NULL)
+    g_hash_table_replace (scheduler_devices, g_strdup (device_fs_id), g_list_prepend (jobs, transfer_job));
+}
+
+
+
+/* must be called with the scheduler_lock held */
+static void
+lunar_transfer_job_scheduler_remove_device (LunarTransferJob *transfer_job,
+                                             const gchar       *device_fs_id)
+{
+  GList *jobs;
+
+  if (device_fs_id == NULL || scheduler_devices == NULL)
+    return;
+
+  jobs = g_hash_table_lookup (scheduler_devices, device_fs_id);
+  jobs = g_list_remove (jobs, transfer_job);
+  if (jobs == NULL)
+    g_hash_table_remove (scheduler_devices, device_fs_id);
+  else
+    g_hash_table_replace (scheduler_devices, g_strdup (device_fs_id), jobs);
+}
+
+
+
+/**
+ * lunar_transfer_job_scheduler_remove:
+ * @transfer_job : a #LunarTransferJob.
+ *
+ * Tells the device scheduler that @transfer_job finished its I/O and
+ * wakes up the jobs waiting for one of its devices.
+ **/
+static void
+lunar_transfer_job_scheduler_remove (LunarTransferJob *transfer_job)
+{
+  _lunar_return_if_fail (LUNAR_IS_TRANSFER_JOB (transfer_job));
+
+  if (!transfer_job->scheduled)
+    return;
+
+  g_mutex_lock (&scheduler_lock);
+  scheduler_jobs = g_list_remove (scheduler_jobs, transfer_job);
+  lunar_transfer_job_scheduler_remove_device (transfer_job, transfer_job->source_device_fs_id);
+  lunar_transfer_job_scheduler_remove_device (transfer_job, transfer_job->target_device_fs_id);
+  transfer_job->scheduled = FALSE;
+  g_cond_broadcast (&scheduler_cond);
+  g_mutex_unlock (&scheduler_lock);
+}
+
+
+
 /**
  * lunar_transfer_job_freeze_optional:
  * @job : a #LunarTransferJob.
@@ -1407,6 +2164,10 @@ lunar_transfer_job_determine_copy_behavior (LunarTransferJob *transfer_job,
  * doing IO on the source files or target files devices are completed.
  * The unblocking could be forced by the user in the UI.
  *
+ * Once unblocked, the job is registered with the device scheduler
+ * until lunar_transfer_job_scheduler_remove() is called. Waiting jobs
+ * sleep until a registered job finishes or pauses, or until they are
+ * cancelled or unfrozen by the user.
  **/
 static void
 lunar_transfer_job_freeze_optional (LunarTransferJob *transfer_job)
@@ -1416,6 +2177,10 @@ lunar_transfer_job_freeze_optional (LunarTransferJob *transfer_job)
   gboolean            always_parallel_copy;
   gboolean            should_freeze_on_any_other_job;
   gboolean            been_frozen;
+  gboolean            busy;
+  GCancellable       *cancellable;
+  gulong              cancelled_id;
+  gulong              unfrozen_id;
 
   _lunar_return_if_fail (LUNAR_IS_TRANSFER_JOB (transfer_job));
 
@@ -1431,50 +2196,111 @@ lunar_transfer_job_freeze_optional (LunarTransferJob *transfer_job)
                                                &freeze_if_tgt_busy,
                                                &always_parallel_copy,
                                                &should_freeze_on_any_other_job);
-  if (always_parallel_copy)
-    return;
+
+  /* connect before taking the lock, the handlers take it themselves */
+  cancellable = endo_job_get_cancellable (ENDO_JOB (transfer_job));
+  cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (lunar_transfer_job_scheduler_wake_cancelled), NULL, NULL);
+  unfrozen_id = g_signal_connect (G_OBJECT (transfer_job), "unfrozen", G_CALLBACK (lunar_transfer_job_scheduler_wake_unfrozen), NULL);
+
+  g_mutex_lock (&scheduler_lock);
 
   been_frozen = FALSE; /* this boolean can only take the TRUE value once. */
-  while (TRUE)
+  while (!always_parallel_copy)
     {
-      GList *jobs = lunar_job_ask_jobs (LUNAR_JOB (transfer_job));
-      GList *other_jobs = lunar_transfer_job_filter_running_jobs (jobs, LUNAR_JOB (transfer_job));
-      g_list_free (g_steal_pointer (&jobs));
-      if
+      busy =
         (
           /* should freeze because another job is running */
-          (should_freeze_on_any_other_job && other_jobs != NULL) ||
+          (should_freeze_on_any_other_job && lunar_transfer_job_scheduler_is_busy (transfer_job, scheduler_jobs)) ||
           /* should freeze because source is busy and source device id appears in another job */
-          (freeze_if_src_busy && lunar_transfer_job_device_id_in_job_list (transfer_job->source_device_fs_id, other_jobs)) ||
+          (freeze_if_src_busy && lunar_transfer_job_scheduler_is_device_busy (transfer_job, transfer_job->source_device_fs_id)) ||
           /* should freeze because target is busy and target device id appears in another job */
-          (freeze_if_tgt_busy && lunar_transfer_job_device_id_in_job_list (transfer_job->target_device_fs_id, other_jobs))
-        )
-        g_list_free (g_steal_pointer (&other_jobs));
-      else
-        {
-          g_list_free (g_steal_pointer (&other_jobs));
-          break;
-        }
+          (freeze_if_tgt_busy && lunar_transfer_job_scheduler_is_device_busy (transfer_job, transfer_job->target_device_fs_id))
+        );
+      if (!busy)
+        break;
       if (endo_job_is_cancelled (ENDO_JOB (transfer_job)))
         break;
       if (!lunar_job_is_frozen (LUNAR_JOB (transfer_job)))
         {
           if (been_frozen)
             break; /* cannot re-freeze. It means that the user force to unfreeze */
-          else
-            {
-              been_frozen = TRUE; /* first time here. The job needs to change to frozen state */
-              lunar_job_freeze (LUNAR_JOB (transfer_job));
-            }
+
+          /* first time here. The job needs to change to frozen state. Emitting
+           * the signal must not happen with the lock held, so check again after */
+          been_frozen = TRUE;
+          g_mutex_unlock (&scheduler_lock);
+          lunar_job_freeze (LUNAR_JOB (transfer_job));
+          g_mutex_lock (&scheduler_lock);
+          continue;
         }
-      g_usleep(500 * 1000); /* pause for 500ms */
+
+      /* sleep until a running job finishes or pauses, or we are cancelled or unfrozen */
+      g_cond_wait (&scheduler_cond, &scheduler_lock);
     }
+
+  /* register the job, so other jobs can wait for its devices */
+  scheduler_jobs = g_list_prepend (scheduler_jobs, transfer_job);
+  lunar_transfer_job_scheduler_add_device (transfer_job, transfer_job->source_device_fs_id);
+  lunar_transfer_job_scheduler_add_device (transfer_job, transfer_job->target_device_fs_id);
+  transfer_job->scheduled = TRUE;
+
+  g_mutex_unlock (&scheduler_lock);
+
+  g_signal_handler_disconnect (G_OBJECT (transfer_job), unfrozen_id);
+  g_cancellable_disconnect (cancellable, cancelled_id);
+
   if (lunar_job_is_frozen (LUNAR_JOB (transfer_job)))
     lunar_job_unfreeze (LUNAR_JOB (transfer_job));
 }
 
 
 
+static guint
+lunar_transfer_job_device_pipeline_depth (GFile    *file,
+                                          gboolean  is_local)
+{
+  if (is_local)
+    return PIPELINE_DEPTH_LOCAL;
+  else if (file == NULL || !g_file_is_native (file))
+    return PIPELINE_DEPTH_REMOTE;
+  else
+    return PIPELINE_DEPTH_REMOVABLE;
+}
+
+
+
+/**
+ * lunar_transfer_job_pipeline_depth:
+ * @transfer_job : a #LunarTransferJob.
+ *
+ * Determines how many small files may be copied concurrently by
+ * @transfer_job, based on the device info filled in by
+ * lunar_transfer_job_freeze_optional(). The slower of source and
+ * target device class decides.
+ *
+ * Return value: the number of copies to keep in flight.
+ **/
+static guint
+lunar_transfer_job_pipeline_depth (LunarTransferJob *transfer_job)
+{
+  GFile *source_file = NULL;
+  GFile *target_file = NULL;
+
+  /* the user asked for strictly sequential transfers */
+  if (transfer_job->parallel_copy_mode == LUNAR_PARALLEL_COPY_MODE_NEVER)
+    return 1;
+
+  if (transfer_job->source_node_list != NULL)
+    source_file = ((LunarTransferNode *) transfer_job->source_node_list->data)->source_file;
+  if (transfer_job->target_file_list != NULL)
+    target_file = transfer_job->target_file_list->data;
+
+  return MIN (lunar_transfer_job_device_pipeline_depth (source_file, transfer_job->is_source_device_local),
+              lunar_transfer_job_device_pipeline_depth (target_file, transfer_job->is_target_device_local));
+}
+
+
+
 static gboolean
 lunar_transfer_job_execute (EndoJob  *job,
                              GError **error)
@@ -1576,6 +2402,15 @@ lunar_transfer_job_execute (EndoJob  *job,
 
       lunar_transfer_job_freeze_optional (transfer_job);
 
+      /* copy small files concurrently if the devices allow it */
+      transfer_job->pipeline_depth = lunar_transfer_job_pipeline_depth (transfer_job);
+      if (transfer_job->pipeline_depth > 1)
+        {
+          transfer_job->copy_pool = g_thread_pool_new (lunar_transfer_job_copy_worker, NULL,
+                                                       transfer_job->pipeline_depth,
+                                                       FALSE, NULL);
+        }
+
       /* transfer starts now */
       transfer_job->start_time = g_get_real_time ();
 
@@ -1587,6 +2422,16 @@ lunar_transfer_job_execute (EndoJob  *job,
           lunar_transfer_job_copy_node (transfer_job, sp->data, tp->data, NULL,
                                          &new_files_list, &err);
         }
+
+      /* every copy has been collected by now */
+      if (transfer_job->copy_pool != NULL)
+        {
+          g_thread_pool_free (transfer_job->copy_pool, FALSE, TRUE);
+          transfer_job->copy_pool = NULL;
+        }
+
+      /* let the jobs waiting for our devices continue */
+      lunar_transfer_job_scheduler_remove (transfer_job);
     }
 
   /* check if we failed */
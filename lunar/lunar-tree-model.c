@@ -1447,8 +1447,9 @@ LUNAR_THREADS_ENTER
   /* verify that we have a file */
   if (G_LIKELY (item->file != NULL))
     {
-      /* open the folder for the item */
-      item->folder = lunar_folder_get_for_file (item->file);
+      /* open the folder for the item, only the subdirectories
+       * are listed unless a view opened the folder already */
+      item->folder = lunar_folder_get_directories_for_file (item->file);
       if (G_LIKELY (item->folder != NULL))
         {
           /* connect signals */
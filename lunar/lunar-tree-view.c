@@ -1684,7 +1684,7 @@ LUNAR_THREADS_ENTER
       file = LUNAR_FILE (lp->data);
 
       /* 3. Check if the contents of the corresponding folder is still being loaded */
-      folder = lunar_folder_get_for_file (file);
+      folder = lunar_folder_get_directories_for_file (file);
       if (folder != NULL && lunar_folder_get_loading (folder))
         {
           g_object_unref (folder);
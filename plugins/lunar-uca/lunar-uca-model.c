@@ -128,6 +128,9 @@ static gboolean           lunar_uca_model_load_from_file   (LunarUcaModel
                                                              GError              **error);
 static void               lunar_uca_model_item_reset       (LunarUcaModelItem   *item);
 static void               lunar_uca_model_item_free        (gpointer              data);
+static void               lunar_uca_model_item_compile     (LunarUcaModelItem   *item);
+static void               lunar_uca_model_index_items      (LunarUcaModel       *uca_model);
+static void               lunar_uca_model_index_clear      (LunarUcaModel       *uca_model);
 static void               start_element_handler             (GMarkupParseContext  *context,
                                                              const gchar          *element_name,
                                                              const gchar         **attribute_names,
@@ -157,6 +160,11 @@ struct _LunarUcaModel
 
   GList          *items;
   gint            stamp;
+
+  /* the items in order and their positions by type bit and
+   * extension, built by lunar_uca_model_match() on demand */
+  GPtrArray      *indexed_items;
+  GHashTable     *index;
 };
 
 struct _LunarUcaModelItem
@@ -174,6 +182,9 @@ struct _LunarUcaModelItem
 
   /* derived attributes */
   guint          multiple_selection : 1;
+  guint          match_all : 1;    /* one of the patterns is "*" */
+  GHashTable    *extensions;       /* the "*.ext" patterns, as "ext" */
+  GPatternSpec **pattern_specs;    /* all other patterns, compiled */
 };
 
 typedef EXPIDUS_GENERIC_STACK(ParserState) ParserStack;
@@ -283,6 +294,7 @@ lunar_uca_model_finalize (GObject *object)
   LunarUcaModel *uca_model = LUNAR_UCA_MODEL (object);
 
   /* release all items */
+  lunar_uca_model_index_clear (uca_model);
   g_list_free_full (uca_model->items, lunar_uca_model_item_free);
 
   (*G_OBJECT_CLASS (lunar_uca_model_parent_class)->finalize) (object);
@@ -621,6 +633,8 @@ lunar_uca_model_load_from_file (LunarUcaModel *uca_model,
 static void
 lunar_uca_model_item_reset (LunarUcaModelItem *item)
 {
+  guint n;
+
   /* release the previous values... */
   g_strfreev (item->patterns);
   g_free (item->description);
@@ -633,6 +647,15 @@ lunar_uca_model_item_reset (LunarUcaModelItem *item)
   if (item->gicon != NULL)
     g_object_unref (item->gicon);
 
+  if (item->extensions != NULL)
+    g_hash_table_destroy (item->extensions);
+  if (item->pattern_specs != NULL)
+    {
+      for (n = 0; item->pattern_specs[n] != NULL; ++n)
+        g_pattern_spec_free (item->pattern_specs[n]);
+      g_free (item->pattern_specs);
+    }
+
   /* ...and reset the item memory */
   memset (item, 0, sizeof (*item));
 }
@@ -649,6 +672,152 @@ lunar_uca_model_item_free (gpointer data)
 
 
 
+static void
+lunar_uca_model_item_compile (LunarUcaModelItem *item)
+{
+  const gchar *pattern;
+  guint        n_specs = 0;
+  guint        n;
+
+  for (n = 0; item->patterns[n] != NULL; ++n)
+    {
+      pattern = item->patterns[n];
+      if (strcmp (pattern, "*") == 0)
+        {
+          /* matches all names, the other patterns don't matter */
+          item->match_all = TRUE;
+        }
+      else if (pattern[0] == '*' && pattern[1] == '.' && pattern[2] != '\0'
+               && strpbrk (pattern + 2, "*?") == NULL)
+        {
+          /* looked up by the suffixes of the name */
+          if (item->extensions == NULL)
+            item->extensions = g_hash_table_new (g_str_hash, g_str_equal);
+          g_hash_table_add (item->extensions, (gpointer) (pattern + 2));
+        }
+      else
+        {
+          if (item->pattern_specs == NULL)
+            item->pattern_specs = g_new0 (GPatternSpec *, g_strv_length (item->patterns) + 1);
+          item->pattern_specs[n_specs++] = g_pattern_spec_new (pattern);
+        }
+    }
+}
+
+
+
+/* checks the "*.ext" patterns against all suffixes
+ * of the name following a dot, starting at suffix */
+static inline gboolean
+lunar_uca_model_item_match_extension (LunarUcaModelItem *item,
+                                      const gchar        *suffix)
+{
+  const gchar *dot;
+
+  if (item->extensions == NULL)
+    return FALSE;
+
+  for (dot = suffix; dot != NULL; dot = strchr (dot + 1, '.'))
+    if (g_hash_table_contains (item->extensions, dot + 1))
+      return TRUE;
+
+  return FALSE;
+}
+
+
+
+static void
+lunar_uca_model_index_add (GHashTable *index,
+                           gchar      *key,
+                           guint       position)
+{
+  GArray *positions;
+
+  positions = g_hash_table_lookup (index, key);
+  if (positions == NULL)
+    {
+      positions = g_array_new (FALSE, FALSE, sizeof (guint));
+      g_hash_table_insert (index, key, positions);
+    }
+  else
+    {
+      g_free (key);
+    }
+
+  g_array_append_val (positions, position);
+}
+
+
+
+/* maps "<type bit>" to the positions of the items which may match
+ * any name of that type, and "<type bit>.<ext>" to the positions of
+ * the items with only "*.ext" patterns, so the candidates for a file
+ * are found without looking at every item */
+static void
+lunar_uca_model_index_items (LunarUcaModel *uca_model)
+{
+  LunarUcaModelItem *item;
+  GHashTableIter      iter;
+  gpointer            extension;
+  GList              *lp;
+  guint               position;
+  guint               bit;
+
+  uca_model->indexed_items = g_ptr_array_new ();
+  uca_model->index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_array_unref);
+
+  for (lp = uca_model->items, position = 0; lp != NULL; lp = lp->next, ++position)
+    {
+      item = lp->data;
+      g_ptr_array_add (uca_model->indexed_items, item);
+
+      for (bit = LUNAR_UCA_TYPE_DIRECTORIES; bit <= LUNAR_UCA_TYPE_VIDEO_FILES; bit <<= 1)
+        {
+          if ((item->types & bit) == 0)
+            continue;
+
+          if (item->match_all || item->pattern_specs != NULL)
+            {
+              lunar_uca_model_index_add (uca_model->index, g_strdup_printf ("%u", bit), position);
+            }
+          else if (item->extensions != NULL)
+            {
+              g_hash_table_iter_init (&iter, item->extensions);
+              while (g_hash_table_iter_next (&iter, &extension, NULL))
+                lunar_uca_model_index_add (uca_model->index, g_strdup_printf ("%u.%s", bit, (const gchar *) extension), position);
+            }
+        }
+    }
+}
+
+
+
+static void
+lunar_uca_model_index_clear (LunarUcaModel *uca_model)
+{
+  if (uca_model->index != NULL)
+    {
+      g_hash_table_destroy (uca_model->index);
+      g_ptr_array_free (uca_model->indexed_items, TRUE);
+      uca_model->index = NULL;
+      uca_model->indexed_items = NULL;
+    }
+}
+
+
+
+static gint
+lunar_uca_model_compare_positions (gconstpointer a,
+                                   gconstpointer b)
+{
+  guint position_a = *((const guint *) a);
+  guint position_b = *((const guint *) b);
+
+  return (position_a > position_b) - (position_a < position_b);
+}
+
+
+
 static void
 start_element_handler (GMarkupParseContext *context,
                        const gchar         *element_name,
@@ -1104,17 +1273,37 @@ lunar_uca_model_match (LunarUcaModel *uca_model,
   typedef struct
   {
     gchar          *name;
-    LunarUcaTypes  types;
+    const gchar    *suffix;
   } LunarUcaFile;
 
+  /* files with the same types and the same suffix following
+   * the first dot of the name, except for the pattern specs
+   * every item matches either all files of a class or none */
+  typedef struct
+  {
+    LunarUcaTypes  types;
+    const gchar    *suffix;
+  } LunarUcaClass;
+
   LunarUcaModelItem *item;
+  LunarUcaClass     *classes;
   LunarUcaFile      *files;
+  LunarUcaTypes      types;
+  GHashTable         *class_table;
+  GArray             *candidates;
+  GArray             *positions;
+  GString            *index_key;
+  const gchar        *dot;
+  guint               position;
+  guint               bit;
   GFile              *location;
   gchar              *mime_type;
+  gchar              *key;
   gboolean            matches;
   GList              *paths = NULL;
   GList              *lp;
   gint                n_files;
+  gint                n_classes = 0;
   gint                i, m, n;
   gchar              *path_test;
 
@@ -1128,68 +1317,148 @@ lunar_uca_model_match (LunarUcaModel *uca_model,
   /* determine the LunarUcaFile's for the given file_infos */
   n_files = g_list_length (file_infos);
   files = g_new (LunarUcaFile, n_files);
+  classes = g_new (LunarUcaClass, n_files);
+  class_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
   for (lp = file_infos, n = 0; lp != NULL; lp = lp->next, ++n)
     {
       location = lunarx_file_info_get_location (lp->data);
 
-      path_test = g_file_get_path (location);
-      if (path_test == NULL)
+      /* native files always have a path */
+      if (!g_file_is_native (location))
         {
-          /* cannot handle non-local files */
-          g_object_unref (location);
-          g_free (files);
-          return NULL;
+          path_test = g_file_get_path (location);
+          if (path_test == NULL)
+            {
+              /* cannot handle non-local files */
+              g_object_unref (location);
+              for (m = 0; m < n; ++m)
+                g_free (files[m].name);
+              g_free (files);
+              g_free (classes);
+              g_hash_table_destroy (class_table);
+              return NULL;
+            }
+          g_free (path_test);
         }
-      g_free (path_test);
 
       g_object_unref (location);
 
       mime_type = lunarx_file_info_get_mime_type (lp->data);
 
       files[n].name = lunarx_file_info_get_name (lp->data);
-      files[n].types = types_from_mime_type (mime_type);
+      files[n].suffix = strchr (files[n].name, '.');
 
-      if (G_UNLIKELY (files[n].types == 0))
-        files[n].types = LUNAR_UCA_TYPE_OTHER_FILES;
+      types = types_from_mime_type (mime_type);
+      if (G_UNLIKELY (types == 0))
+        types = LUNAR_UCA_TYPE_OTHER_FILES;
 
       g_free (mime_type);
+
+      /* add the class of the file */
+      key = g_strdup_printf ("%u%s", types, (files[n].suffix != NULL) ? files[n].suffix : "");
+      if (!g_hash_table_contains (class_table, key))
+        {
+          classes[n_classes].types = types;
+          classes[n_classes].suffix = strchr (key, '.');
+          n_classes++;
+          g_hash_table_add (class_table, key);
+        }
+      else
+        {
+          g_free (key);
+        }
+    }
+
+  if (uca_model->index == NULL)
+    lunar_uca_model_index_items (uca_model);
+
+  /* every matching item matches the first class, so only
+   * the items indexed for its types and suffixes are candidates */
+  candidates = g_array_new (FALSE, FALSE, sizeof (guint));
+  index_key = g_string_new (NULL);
+  for (bit = LUNAR_UCA_TYPE_DIRECTORIES; bit <= LUNAR_UCA_TYPE_VIDEO_FILES; bit <<= 1)
+    {
+      if ((classes[0].types & bit) == 0)
+        continue;
+
+      g_string_printf (index_key, "%u", bit);
+      positions = g_hash_table_lookup (uca_model->index, index_key->str);
+      if (positions != NULL)
+        g_array_append_vals (candidates, positions->data, positions->len);
+
+      for (dot = classes[0].suffix; dot != NULL; dot = strchr (dot + 1, '.'))
+        {
+          g_string_printf (index_key, "%u%s", bit, dot);
+          positions = g_hash_table_lookup (uca_model->index, index_key->str);
+          if (positions != NULL)
+            g_array_append_vals (candidates, positions->data, positions->len);
+        }
     }
+  g_string_free (index_key, TRUE);
+
+  /* keep the order of the model */
+  g_array_sort (candidates, lunar_uca_model_compare_positions);
 
   /* lookup the matching items */
-  for (i = 0, lp = uca_model->items; lp != NULL; ++i, lp = lp->next)
+  for (i = 0; i < (gint) candidates->len; ++i)
     {
+      /* skip candidates found for several types or suffixes */
+      position = g_array_index (candidates, guint, i);
+      if (i > 0 && position == g_array_index (candidates, guint, i - 1))
+        continue;
+
       /* check if we can just ignore this item */
-      item = (LunarUcaModelItem *) lp->data;
+      item = g_ptr_array_index (uca_model->indexed_items, position);
       if (!item->multiple_selection && n_files > 1)
         continue;
 
-      /* match the specified files */
-      for (n = 0; n < n_files; ++n)
+      /* match the classes of the specified files */
+      for (n = 0; n < n_classes; ++n)
         {
           /* verify that we support this type of file */
-          if ((files[n].types & item->types) == 0)
+          if ((classes[n].types & item->types) == 0)
             break;
 
-          /* atleast on pattern must match the file name */
-          for (m = 0, matches = FALSE; item->patterns[m] != NULL && !matches; ++m)
-            matches = g_pattern_match_simple (item->patterns[m], files[n].name);
-
-          /* no need to continue if none of the patterns match */
-          if (!matches)
+          /* the pattern specs are checked per file below */
+          if (!item->match_all && item->pattern_specs == NULL
+              && !lunar_uca_model_item_match_extension (item, classes[n].suffix))
             break;
         }
 
+      if (n < n_classes)
+        continue;
+
+      /* atleast one pattern must match the file names */
+      if (!item->match_all && item->pattern_specs != NULL)
+        {
+          for (n = 0; n < n_files; ++n)
+            {
+              matches = lunar_uca_model_item_match_extension (item, files[n].suffix);
+              for (m = 0; item->pattern_specs[m] != NULL && !matches; ++m)
+                matches = g_pattern_match_string (item->pattern_specs[m], files[n].name);
+
+              /* no need to continue if none of the patterns match */
+              if (!matches)
+                break;
+            }
+
+          if (n < n_files)
+            continue;
+        }
+
       /* add the path if all files match one of the patterns */
-      if (G_UNLIKELY (n == n_files))
-        paths = g_list_append (paths, gtk_tree_path_new_from_indices (i, -1));
+      paths = g_list_prepend (paths, gtk_tree_path_new_from_indices (position, -1));
     }
 
   /* cleanup */
+  g_array_free (candidates, TRUE);
   for (n = 0; n < n_files; ++n)
     g_free (files[n].name);
   g_free (files);
+  g_free (classes);
+  g_hash_table_destroy (class_table);
 
-  return paths;
+  return g_list_reverse (paths);
 }
 
 
@@ -1213,6 +1482,7 @@ lunar_uca_model_append (LunarUcaModel *uca_model,
   g_return_if_fail (iter != NULL);
 
   /* append the new item */
+  lunar_uca_model_index_clear (uca_model);
   item = g_new0 (LunarUcaModelItem, 1);
   uca_model->items = g_list_append (uca_model->items, item);
 
@@ -1265,6 +1535,7 @@ lunar_uca_model_exchange (LunarUcaModel *uca_model,
   new_order[g_list_position (uca_model->items, list_b)] = g_list_position (uca_model->items, list_a);
 
   /* perform the exchange */
+  lunar_uca_model_index_clear (uca_model);
   item = list_a->data;
   list_a->data = list_b->data;
   list_b->data = item;
@@ -1313,6 +1584,7 @@ lunar_uca_model_remove (LunarUcaModel *uca_model,
   path = gtk_tree_model_get_path (GTK_TREE_MODEL (uca_model), iter);
 
   /* remove the node from the list */
+  lunar_uca_model_index_clear (uca_model);
   item = ((GList *) iter->user_data)->data;
   uca_model->items = g_list_delete_link (uca_model->items, iter->user_data);
   lunar_uca_model_item_free (item);
@@ -1365,6 +1637,7 @@ lunar_uca_model_update (LunarUcaModel *uca_model,
   g_return_if_fail (iter->stamp == uca_model->stamp);
 
   /* reset the previous item values */
+  lunar_uca_model_index_clear (uca_model);
   item = ((GList *) iter->user_data)->data;
   lunar_uca_model_item_reset (item);
 
@@ -1401,6 +1674,7 @@ lunar_uca_model_update (LunarUcaModel *uca_model,
         item->patterns[n++] = g_strstrip (item->patterns[m]);
     }
   item->patterns[n] = NULL;
+  lunar_uca_model_item_compile (item);
 
   /* check if this item will work for multiple files */
   item->multiple_selection = (command != NULL && (strstr (command, "%F") != NULL